@@ -0,0 +1,351 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageResize.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+/// Weights of a one-dimensional convolution, centered on the middle tap.
+struct ConvolutionKernel {
+    /// Weights of the `2 * radius() + 1` taps.
+    std::vector<float> weights;
+
+    /// Returns the number of taps on each side of the center.
+    int radius() const noexcept
+    {
+        return static_cast<int>(this->weights.size() / 2);
+    }
+};
+
+/// Returns a normalized Gaussian kernel, truncated at three standard deviations.
+///
+/// @param sigma Standard deviation in pixels.
+inline ConvolutionKernel gaussian_kernel(float sigma)
+{
+    if (!(sigma > 0.0f)) {
+        throw std::runtime_error { "The standard deviation must be positive." };
+    }
+    int radius = std::max(static_cast<int>(std::ceil(sigma * 3.0f)), 1);
+    ConvolutionKernel kernel { std::vector<float>(static_cast<std::size_t>(2 * radius + 1)) };
+    double sum = 0.0;
+    for (int i = -radius; i <= radius; i++) {
+        double weight = std::exp(-0.5 * i * i / (static_cast<double>(sigma) * sigma));
+        kernel.weights[static_cast<std::size_t>(i + radius)] = static_cast<float>(weight);
+        sum += weight;
+    }
+    for (auto& weight : kernel.weights) {
+        weight = static_cast<float>(weight / sum);
+    }
+    return kernel;
+}
+
+/// Returns a normalized box kernel.
+///
+/// `box_blur()` is faster than convolving with it for any radius.
+///
+/// @param radius Number of taps on each side of the center.
+inline ConvolutionKernel box_kernel(int radius)
+{
+    if (radius < 0) {
+        throw std::runtime_error { "The radius must not be negative." };
+    }
+    auto taps = static_cast<std::size_t>(2 * radius + 1);
+    return { std::vector<float>(taps, 1.0f / static_cast<float>(taps)) };
+}
+
+namespace detail {
+
+/// Size of the tiles of a convolution, before adding the halos. A tile of
+/// RGBA floats with a moderate halo stays within the L2 cache.
+inline constexpr int convolution_tile_width = 256;
+inline constexpr int convolution_tile_height = 64;
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline std::size_t box_slide_avx2(
+    float* sum, const float* entering, const float* leaving, float* out, float scale, std::size_t count) noexcept
+{
+    const __m256 factor = _mm256_set1_ps(scale);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 total = _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_loadu_ps(entering + i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(total, factor));
+        _mm256_storeu_ps(sum + i, _mm256_sub_ps(total, _mm256_loadu_ps(leaving + i)));
+    }
+    return i;
+}
+#endif
+
+/// Advances the running sums of the vertical box pass by one row.
+///
+/// @param sum Running sums, updated in place.
+/// @param entering Row entering the window.
+/// @param leaving Row leaving the window after this one.
+/// @param out Destination of the averages.
+/// @param scale Inverse of the window size.
+/// @param count Number of floats per row.
+inline void box_slide(
+    float* sum, const float* entering, const float* leaving, float* out, float scale, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = box_slide_avx2(sum, entering, leaving, out, scale, count);
+    }
+#endif
+    for (; i < count; i++) {
+        float total = sum[i] + entering[i];
+        out[i] = total * scale;
+        sum[i] = total - leaving[i];
+    }
+}
+
+/// Averages a padded row over a sliding window of `2 * radius + 1` pixels.
+///
+/// @param line Row padded with `radius` pixels on both sides.
+/// @param out Destination of the `width` averages.
+template <int N>
+void box_slide_row(const float* line, float* out, int radius, float scale, int width) noexcept
+{
+    float sum[N] = {};
+    for (int i = 0; i < 2 * radius * N; i++) {
+        sum[i % N] += line[i];
+    }
+    const float* entering = line + 2 * radius * N;
+    for (int x = 0; x < width; x++) {
+        for (int c = 0; c < N; c++) {
+            sum[c] += entering[x * N + c];
+            out[x * N + c] = sum[c] * scale;
+            sum[c] -= line[x * N + c];
+        }
+    }
+}
+
+inline void validate_kernel(const ConvolutionKernel& kernel)
+{
+    if (kernel.weights.size() % 2 == 0) {
+        throw std::runtime_error { "A convolution kernel must have an odd number of taps." };
+    }
+}
+
+} // namespace detail
+
+/// Convolves an image with a separable kernel, clamping to the edges.
+///
+/// The image is split into tiles that are filtered independently on the
+/// pool. Each tile converts its pixels and the halo needed by the kernels
+/// to floats, runs the horizontal then the vertical pass with the vector
+/// kernels of the resizer, and converts back. Values are filtered as
+/// stored, without any color space conversion.
+///
+/// @param image Source image.
+/// @param horizontal Kernel applied along the rows.
+/// @param vertical Kernel applied along the columns.
+/// @param pool Pool used to process the tiles.
+template <typename T, int C>
+BasicImage<T, C> convolve(const BasicImage<T, C>& image, const ConvolutionKernel& horizontal,
+    const ConvolutionKernel& vertical, ThreadPool& pool = ThreadPool::global())
+{
+    detail::validate_kernel(horizontal);
+    detail::validate_kernel(vertical);
+
+    int width = image.width();
+    int height = image.height();
+    int channels = image.channels();
+    auto channels_sz = static_cast<std::size_t>(channels);
+    int radius_x = horizontal.radius();
+    int radius_y = vertical.radius();
+    int tiles_x = (width + detail::convolution_tile_width - 1) / detail::convolution_tile_width;
+    int tiles_y = (height + detail::convolution_tile_height - 1) / detail::convolution_tile_height;
+    BasicImage<T, C> result { width, height, channels };
+
+    pool.parallel_for(static_cast<std::size_t>(tiles_x) * static_cast<std::size_t>(tiles_y), 1,
+        [&](std::size_t begin, std::size_t end) {
+            std::vector<float> source {};
+            std::vector<float> filtered {};
+            std::vector<float> out {};
+            std::vector<const float*> rows {};
+            for (auto tile = begin; tile < end; tile++) {
+                int left = static_cast<int>(tile % static_cast<std::size_t>(tiles_x)) * detail::convolution_tile_width;
+                int top = static_cast<int>(tile / static_cast<std::size_t>(tiles_x)) * detail::convolution_tile_height;
+                int tile_width = std::min(detail::convolution_tile_width, width - left);
+                int tile_height = std::min(detail::convolution_tile_height, height - top);
+                int halo_width = tile_width + 2 * radius_x;
+                int halo_height = tile_height + 2 * radius_y;
+                auto source_stride = static_cast<std::size_t>(halo_width) * channels_sz;
+                auto row_size = static_cast<std::size_t>(tile_width) * channels_sz;
+
+                // Converts the tile and its halo, replicating the edge pixels.
+                source.resize(source_stride * static_cast<std::size_t>(halo_height));
+                int first = std::max(left - radius_x, 0);
+                int last = std::min(left + tile_width + radius_x, width);
+                for (int y = 0; y < halo_height; y++) {
+                    int row = std::clamp(top - radius_y + y, 0, height - 1);
+                    float* line = &source[static_cast<std::size_t>(y) * source_stride];
+                    float* inside = line + static_cast<std::size_t>(first - (left - radius_x)) * channels_sz;
+                    detail::resample_load_row(image.pixel(first, row), inside, static_cast<std::size_t>(last - first),
+                        channels, false, false);
+                    for (float* pixel = line; pixel < inside; pixel += channels) {
+                        std::copy(inside, inside + channels, pixel);
+                    }
+                    const float* edge = line + static_cast<std::size_t>(last - 1 - (left - radius_x)) * channels_sz;
+                    for (float* pixel = line + static_cast<std::size_t>(last - (left - radius_x)) * channels_sz;
+                         pixel < line + source_stride; pixel += channels) {
+                        std::copy(edge, edge + channels, pixel);
+                    }
+                }
+
+                // The horizontal pass sums the row shifted by each tap.
+                filtered.resize(row_size * static_cast<std::size_t>(halo_height));
+                rows.resize(horizontal.weights.size());
+                for (int y = 0; y < halo_height; y++) {
+                    const float* line = &source[static_cast<std::size_t>(y) * source_stride];
+                    for (std::size_t t = 0; t < rows.size(); t++) {
+                        rows[t] = line + t * channels_sz;
+                    }
+                    detail::resample_column(rows.data(), horizontal.weights.data(), static_cast<int>(rows.size()),
+                        &filtered[static_cast<std::size_t>(y) * row_size], row_size);
+                }
+
+                out.resize(row_size);
+                rows.resize(vertical.weights.size());
+                for (int y = 0; y < tile_height; y++) {
+                    for (std::size_t t = 0; t < rows.size(); t++) {
+                        rows[t] = &filtered[(static_cast<std::size_t>(y) + t) * row_size];
+                    }
+                    detail::resample_column(rows.data(), vertical.weights.data(), static_cast<int>(rows.size()),
+                        out.data(), row_size);
+                    detail::resample_store_row(out.data(), result.pixel(left, top + y),
+                        static_cast<std::size_t>(tile_width), channels, false, false);
+                }
+            }
+        });
+    return result;
+}
+
+/// Blurs an image with a Gaussian filter.
+///
+/// @param image Source image.
+/// @param sigma Standard deviation in pixels.
+/// @param pool Pool used to process the tiles.
+template <typename T, int C>
+BasicImage<T, C> gaussian_blur(const BasicImage<T, C>& image, float sigma, ThreadPool& pool = ThreadPool::global())
+{
+    auto kernel = gaussian_kernel(sigma);
+    return convolve(image, kernel, kernel, pool);
+}
+
+/// Averages every pixel with its neighbours in a square window, clamping to the edges.
+///
+/// Both passes keep running sums, so the cost does not depend on the
+/// radius. Bands of rows are processed in parallel: each band slides a row
+/// of column sums down the image, then slides along every averaged row.
+///
+/// @param image Source image.
+/// @param radius Number of pixels on each side of the center.
+/// @param pool Pool used to process the bands.
+template <typename T, int C>
+BasicImage<T, C> box_blur(const BasicImage<T, C>& image, int radius, ThreadPool& pool = ThreadPool::global())
+{
+    if (radius < 0) {
+        throw std::runtime_error { "The radius must not be negative." };
+    }
+    int width = image.width();
+    int height = image.height();
+    int channels = image.channels();
+    auto channels_sz = static_cast<std::size_t>(channels);
+    auto row_size = static_cast<std::size_t>(width) * channels_sz;
+    auto padding = static_cast<std::size_t>(radius) * channels_sz;
+    float scale = 1.0f / static_cast<float>(2 * radius + 1);
+    BasicImage<T, C> result { width, height, channels };
+
+    // Every band first sums the `2 * radius` rows above its first row, so
+    // bands are kept a few times taller than the window.
+    auto grain = std::max<std::size_t>(16, static_cast<std::size_t>(radius) * 8);
+    pool.parallel_for(static_cast<std::size_t>(height), grain, [&](std::size_t begin, std::size_t end) {
+        std::vector<float> sum(row_size, 0.0f);
+        std::vector<float> entering(row_size);
+        std::vector<float> leaving(row_size);
+        // Averaged row, padded with `radius` copies of the edge pixels on both sides.
+        std::vector<float> line(row_size + 2 * padding);
+        std::vector<float> out(row_size);
+        auto load = [&](int y, float* dst) {
+            detail::resample_load_row(image.pixel(0, std::clamp(y, 0, height - 1)), dst,
+                static_cast<std::size_t>(width), channels, false, false);
+        };
+
+        for (int y = static_cast<int>(begin) - radius; y < static_cast<int>(begin) + radius; y++) {
+            load(y, entering.data());
+            for (std::size_t i = 0; i < row_size; i++) {
+                sum[i] += entering[i];
+            }
+        }
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            load(y + radius, entering.data());
+            load(y - radius, leaving.data());
+            float* inside = line.data() + padding;
+            detail::box_slide(sum.data(), entering.data(), leaving.data(), inside, scale, row_size);
+            for (std::size_t i = 0; i < padding; i++) {
+                line[i] = inside[i % channels_sz];
+                inside[row_size + i] = inside[row_size - channels_sz + i % channels_sz];
+            }
+
+            switch (channels) {
+            case 1:
+                detail::box_slide_row<1>(line.data(), out.data(), radius, scale, width);
+                break;
+            case 2:
+                detail::box_slide_row<2>(line.data(), out.data(), radius, scale, width);
+                break;
+            case 3:
+                detail::box_slide_row<3>(line.data(), out.data(), radius, scale, width);
+                break;
+            default:
+                detail::box_slide_row<4>(line.data(), out.data(), radius, scale, width);
+                break;
+            }
+            detail::resample_store_row(out.data(), result.pixel(0, y), static_cast<std::size_t>(width), channels,
+                false, false);
+        }
+    });
+    return result;
+}
+
+/// Sharpens an image with an unsharp mask, adding back the difference to a blurred copy.
+///
+/// @param image Source image.
+/// @param sigma Standard deviation of the blur in pixels.
+/// @param amount Strength of the sharpening, `0` leaves the image unchanged.
+/// @param pool Pool used to process the tiles.
+template <typename T, int C>
+BasicImage<T, C> unsharp_mask(
+    const BasicImage<T, C>& image, float sigma, float amount, ThreadPool& pool = ThreadPool::global())
+{
+    auto blurred = gaussian_blur(image, sigma, pool);
+    int width = image.width();
+    int channels = image.channels();
+    auto row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(channels);
+
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 16, [&](std::size_t begin, std::size_t end) {
+        std::vector<float> original(row_size);
+        std::vector<float> blur(row_size);
+        for (auto y = begin; y < end; y++) {
+            int row = static_cast<int>(y);
+            detail::resample_load_row(image.pixel(0, row), original.data(), static_cast<std::size_t>(width), channels,
+                false, false);
+            detail::resample_load_row(blurred.pixel(0, row), blur.data(), static_cast<std::size_t>(width), channels,
+                false, false);
+            for (std::size_t i = 0; i < row_size; i++) {
+                blur[i] = original[i] + amount * (original[i] - blur[i]);
+            }
+            detail::resample_store_row(blur.data(), blurred.pixel(0, row), static_cast<std::size_t>(width), channels,
+                false, false);
+        }
+    });
+    return blurred;
+}
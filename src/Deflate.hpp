@@ -0,0 +1,1277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+// DEFLATE (RFC 1951) and zlib (RFC 1950) compression and decompression.
+//
+// Matches are found with hash chains and written as dynamic Huffman
+// blocks, or as fixed Huffman or stored blocks when those are smaller.
+// Large inputs can be split into chunks compressed in parallel: every chunk
+// still matches against the 32 KiB before it and ends on a byte boundary
+// with an empty stored block, so the chunks join into a single stream.
+//
+// Decompression streams: the output is produced on demand, keeping only the
+// 32 KiB window of history, so large streams never need to fit in memory.
+
+namespace detail {
+
+inline constexpr std::size_t deflate_window = 32768;
+inline constexpr int deflate_min_match = 3;
+inline constexpr int deflate_max_match = 258;
+inline constexpr int deflate_litlen_codes = 286;
+/// Number of symbols of the fixed literal/length code, two more than can be
+/// used, which still take their place in the canonical code.
+inline constexpr int deflate_fixed_litlen_codes = 288;
+inline constexpr int deflate_distance_codes = 30;
+inline constexpr int deflate_length_codes = 19;
+/// Number of symbols collected before a block is written.
+inline constexpr std::size_t deflate_block_symbols = 16384;
+
+/// Lookup tables of the CRC-32 polynomial, for eight bytes at a time.
+struct CrcTables {
+    std::array<std::array<std::uint32_t, 256>, 8> table {};
+
+    constexpr CrcTables()
+    {
+        for (std::uint32_t i = 0; i < 256; i++) {
+            std::uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0xEDB88320u : 0u);
+            }
+            this->table[0][i] = crc;
+        }
+        for (std::uint32_t i = 0; i < 256; i++) {
+            for (int t = 1; t < 8; t++) {
+                std::uint32_t previous = this->table[t - 1][i];
+                this->table[t][i] = (previous >> 8) ^ this->table[0][previous & 0xFF];
+            }
+        }
+    }
+};
+
+inline constexpr CrcTables crc_tables {};
+
+/// Base values and extra bits of the length and distance codes.
+struct DeflateTables {
+    std::array<std::uint16_t, 29> length_base {};
+    std::array<std::uint8_t, 29> length_extra {};
+    std::array<std::uint16_t, deflate_distance_codes> distance_base {};
+    std::array<std::uint8_t, deflate_distance_codes> distance_extra {};
+    /// Length code of every match length.
+    std::array<std::uint8_t, deflate_max_match + 1> length_code {};
+    /// Distance code of `distance - 1` below 256, then of `256 + ((distance - 1) >> 7)`.
+    std::array<std::uint8_t, 512> distance_code {};
+
+    constexpr DeflateTables()
+    {
+        int length = 3;
+        for (int code = 0; code < 28; code++) {
+            this->length_extra[code] = static_cast<std::uint8_t>(code < 8 ? 0 : (code - 4) / 4);
+            this->length_base[code] = static_cast<std::uint16_t>(length);
+            for (int i = 0; i < (1 << this->length_extra[code]); i++) {
+                this->length_code[length++] = static_cast<std::uint8_t>(code);
+            }
+        }
+        // 258 has a code of its own, taking over the last value of code 27.
+        this->length_base[28] = 258;
+        this->length_code[258] = 28;
+
+        int distance = 1;
+        for (int code = 0; code < deflate_distance_codes; code++) {
+            this->distance_extra[code] = static_cast<std::uint8_t>(code < 4 ? 0 : (code - 2) / 2);
+            this->distance_base[code] = static_cast<std::uint16_t>(distance);
+            for (int i = 0; i < (1 << this->distance_extra[code]); i++, distance++) {
+                int index = distance - 1 < 256 ? distance - 1 : 256 + ((distance - 1) >> 7);
+                this->distance_code[index] = static_cast<std::uint8_t>(code);
+            }
+        }
+    }
+
+    int distance_code_of(int distance) const noexcept
+    {
+        return distance - 1 < 256 ? this->distance_code[distance - 1] : this->distance_code[256 + ((distance - 1) >> 7)];
+    }
+};
+
+inline constexpr DeflateTables deflate_tables {};
+
+/// Order in which the lengths of the code length codes are stored.
+inline constexpr std::array<std::uint8_t, deflate_length_codes> deflate_length_order {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+
+/// Computes Huffman code lengths of at most `limit` bits.
+///
+/// Symbols with a zero frequency get no code. Frequencies are halved until
+/// the tree fits within the limit.
+///
+/// @param frequencies Frequency of every symbol.
+/// @param count Number of symbols.
+/// @param limit Maximal code length.
+/// @param lengths Destination of the code lengths.
+inline void huffman_lengths(const std::uint32_t* frequencies, int count, int limit, std::uint8_t* lengths)
+{
+    std::fill_n(lengths, count, std::uint8_t { 0 });
+    std::vector<std::pair<std::uint32_t, int>> leaves {};
+    for (int i = 0; i < count; i++) {
+        if (frequencies[i] != 0) {
+            leaves.emplace_back(frequencies[i], i);
+        }
+    }
+    if (leaves.size() == 1) {
+        lengths[leaves[0].second] = 1;
+    }
+    if (leaves.size() <= 1) {
+        return;
+    }
+
+    auto n = leaves.size();
+    std::vector<std::uint64_t> weights(2 * n - 1);
+    std::vector<std::size_t> parents(2 * n - 1);
+    std::vector<int> depths(2 * n - 1);
+    while (true) {
+        std::sort(leaves.begin(), leaves.end());
+        for (std::size_t i = 0; i < n; i++) {
+            weights[i] = leaves[i].first;
+        }
+        // Two queues: the sorted leaves and the internal nodes, created in
+        // increasing order of weight.
+        std::size_t leaf = 0;
+        std::size_t node = n;
+        for (std::size_t next = n; next < 2 * n - 1; next++) {
+            std::size_t children[2];
+            for (auto& child : children) {
+                if (leaf < n && (node >= next || weights[leaf] <= weights[node])) {
+                    child = leaf++;
+                } else {
+                    child = node++;
+                }
+            }
+            weights[next] = weights[children[0]] + weights[children[1]];
+            parents[children[0]] = next;
+            parents[children[1]] = next;
+        }
+
+        int deepest = 0;
+        depths[2 * n - 2] = 0;
+        for (std::size_t i = 2 * n - 2; i-- > 0;) {
+            depths[i] = depths[parents[i]] + 1;
+            deepest = std::max(deepest, depths[i]);
+        }
+        if (deepest <= limit) {
+            for (std::size_t i = 0; i < n; i++) {
+                lengths[leaves[i].second] = static_cast<std::uint8_t>(depths[i]);
+            }
+            return;
+        }
+        for (auto& entry : leaves) {
+            entry.first = (entry.first + 1) / 2;
+        }
+    }
+}
+
+/// Computes the canonical codes of code lengths, bit reversed for the LSB-first stream.
+inline void huffman_codes(const std::uint8_t* lengths, int count, std::uint16_t* codes) noexcept
+{
+    std::array<int, 16> length_count {};
+    for (int i = 0; i < count; i++) {
+        length_count[lengths[i]]++;
+    }
+    length_count[0] = 0;
+    std::array<int, 16> next_code {};
+    int code = 0;
+    for (int bits = 1; bits < 16; bits++) {
+        code = (code + length_count[bits - 1]) << 1;
+        next_code[bits] = code;
+    }
+    for (int i = 0; i < count; i++) {
+        int length = lengths[i];
+        if (length == 0) {
+            codes[i] = 0;
+            continue;
+        }
+        int value = next_code[length]++;
+        int reversed = 0;
+        for (int bit = 0; bit < length; bit++) {
+            reversed = (reversed << 1) | ((value >> bit) & 1);
+        }
+        codes[i] = static_cast<std::uint16_t>(reversed);
+    }
+}
+
+/// Writes values of up to 32 bits, least significant bit first.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<unsigned char>& out)
+        : m_out { &out }
+    {
+    }
+
+    void put(std::uint32_t bits, int count)
+    {
+        this->m_buffer |= static_cast<std::uint64_t>(bits) << this->m_count;
+        this->m_count += count;
+        if (this->m_count >= 32) {
+            for (int i = 0; i < 4; i++) {
+                this->m_out->push_back(static_cast<unsigned char>(this->m_buffer >> (8 * i)));
+            }
+            this->m_buffer >>= 32;
+            this->m_count -= 32;
+        }
+    }
+
+    /// Pads the last byte with zeros and writes out the pending bits.
+    void align()
+    {
+        while (this->m_count > 0) {
+            this->m_out->push_back(static_cast<unsigned char>(this->m_buffer));
+            this->m_buffer >>= 8;
+            this->m_count = std::max(this->m_count - 8, 0);
+        }
+        this->m_buffer = 0;
+    }
+
+private:
+    std::vector<unsigned char>* m_out;
+    std::uint64_t m_buffer { 0 };
+    int m_count { 0 };
+};
+
+/// Search settings of a compression level.
+struct DeflateLevel {
+    /// Maximal number of earlier positions compared per match search.
+    int chain;
+    /// Length at which a match is taken without searching further.
+    int nice;
+    /// Whether a match is deferred when the next position has a longer one.
+    bool lazy;
+};
+
+inline constexpr std::array<DeflateLevel, 10> deflate_levels { {
+    { 0, 0, false },
+    { 4, 16, false },
+    { 8, 32, false },
+    { 16, 64, false },
+    { 16, 64, true },
+    { 32, 128, true },
+    { 64, 128, true },
+    { 128, 258, true },
+    { 512, 258, true },
+    { 2048, 258, true },
+} };
+
+/// DEFLATE encoder of a single chunk of data.
+class DeflateEncoder {
+public:
+    /// @param level 0 for stored blocks, 1 fastest to 9 smallest.
+    explicit DeflateEncoder(int level)
+        : m_level { deflate_levels[static_cast<std::size_t>(std::clamp(level, 0, 9))] }
+        , m_stored { level <= 0 }
+    {
+    }
+
+    /// Compresses `data[dictionary, size)`, matching against the whole of `data`.
+    ///
+    /// @param data Bytes preceding the chunk, then the chunk itself.
+    /// @param dictionary Number of bytes preceding the chunk, at most 32 KiB.
+    /// @param size Number of bytes of `data`.
+    /// @param last Whether the chunk ends the stream. Otherwise it ends with
+    /// an empty stored block, on a byte boundary.
+    /// @param out Destination of the compressed bytes.
+    void compress(
+        const unsigned char* data, std::size_t dictionary, std::size_t size, bool last, std::vector<unsigned char>& out)
+    {
+        BitWriter writer { out };
+        this->m_data = data;
+        this->m_size = size;
+        this->m_writer = &writer;
+        this->m_block_start = dictionary;
+        this->m_covered = dictionary;
+        this->reset_block();
+
+        if (this->m_stored) {
+            this->write_stored(dictionary, size, last);
+        } else {
+            this->m_head.assign(std::size_t { 1 } << hash_bits, -1);
+            this->m_previous.assign(deflate_window, -1);
+            for (std::size_t position = 0; position < dictionary; position++) {
+                this->insert(position);
+            }
+            if (this->m_level.lazy) {
+                this->match_lazy(dictionary);
+            } else {
+                this->match_greedy(dictionary);
+            }
+            this->write_block(this->m_block_start, size, last);
+        }
+
+        if (last) {
+            writer.align();
+        } else {
+            // Empty stored block, which aligns the stream on a byte boundary.
+            writer.put(0, 3);
+            writer.align();
+            out.insert(out.end(), { 0x00, 0x00, 0xFF, 0xFF });
+        }
+    }
+
+private:
+    static constexpr int hash_bits = 15;
+
+    struct Match {
+        int length;
+        int distance;
+    };
+
+    std::uint32_t hash(std::size_t position) const noexcept
+    {
+        const unsigned char* p = this->m_data + position;
+        std::uint32_t bytes = p[0] | (static_cast<std::uint32_t>(p[1]) << 8) | (static_cast<std::uint32_t>(p[2]) << 16);
+        return (bytes * 2654435761u) >> (32 - hash_bits);
+    }
+
+    void insert(std::size_t position) noexcept
+    {
+        if (position + deflate_min_match > this->m_size) {
+            return;
+        }
+        auto& head = this->m_head[this->hash(position)];
+        this->m_previous[position % deflate_window] = head;
+        head = static_cast<std::int32_t>(position);
+    }
+
+    /// Finds the longest earlier match of the bytes at a position, before inserting it.
+    Match find(std::size_t position) const noexcept
+    {
+        Match best { 0, 0 };
+        if (position + deflate_min_match > this->m_size) {
+            return best;
+        }
+        int limit = static_cast<int>(std::min<std::size_t>(deflate_max_match, this->m_size - position));
+        const unsigned char* current = this->m_data + position;
+        std::int32_t candidate = this->m_head[this->hash(position)];
+        for (int chain = this->m_level.chain; candidate >= 0 && chain > 0; chain--) {
+            auto distance = position - static_cast<std::size_t>(candidate);
+            if (distance > deflate_window) {
+                break;
+            }
+            const unsigned char* earlier = this->m_data + candidate;
+            if (earlier[best.length] == current[best.length] && earlier[0] == current[0]) {
+                int length = 1;
+                while (length < limit && earlier[length] == current[length]) {
+                    length++;
+                }
+                if (length > best.length) {
+                    best = { length, static_cast<int>(distance) };
+                    if (length >= this->m_level.nice || length == limit) {
+                        break;
+                    }
+                }
+            }
+            std::int32_t next = this->m_previous[static_cast<std::size_t>(candidate) % deflate_window];
+            if (next >= candidate) {
+                break;
+            }
+            candidate = next;
+        }
+        if (best.length < deflate_min_match) {
+            best = { 0, 0 };
+        }
+        return best;
+    }
+
+    void match_greedy(std::size_t position)
+    {
+        while (position < this->m_size) {
+            auto match = this->find(position);
+            this->insert(position);
+            if (match.length == 0) {
+                this->add_literal(position);
+                position++;
+                continue;
+            }
+            this->add_match(position, match);
+            for (std::size_t i = position + 1; i < position + static_cast<std::size_t>(match.length); i++) {
+                this->insert(i);
+            }
+            position += static_cast<std::size_t>(match.length);
+        }
+    }
+
+    void match_lazy(std::size_t position)
+    {
+        // Match found at the previous position, written once the current
+        // position has no longer one.
+        bool pending = false;
+        Match previous { 0, 0 };
+        while (position < this->m_size) {
+            auto match = this->find(position);
+            this->insert(position);
+            if (pending && previous.length > 0 && match.length <= previous.length) {
+                this->add_match(position - 1, previous);
+                auto end = position - 1 + static_cast<std::size_t>(previous.length);
+                for (std::size_t i = position + 1; i < end; i++) {
+                    this->insert(i);
+                }
+                position = end;
+                pending = false;
+                continue;
+            }
+            if (pending) {
+                this->add_literal(position - 1);
+            }
+            pending = true;
+            previous = match;
+            position++;
+        }
+        if (pending) {
+            if (previous.length > 0) {
+                this->add_match(position - 1, previous);
+            } else {
+                this->add_literal(position - 1);
+            }
+        }
+    }
+
+    void add_literal(std::size_t position)
+    {
+        unsigned char literal = this->m_data[position];
+        this->m_symbols.push_back(literal);
+        this->m_litlen_frequencies[literal]++;
+        this->m_covered = position + 1;
+        this->flush_full_block();
+    }
+
+    void add_match(std::size_t position, Match match)
+    {
+        const auto& tables = deflate_tables;
+        this->m_symbols.push_back(static_cast<std::uint32_t>(match.distance) << 16 | static_cast<std::uint32_t>(match.length));
+        this->m_litlen_frequencies[257 + tables.length_code[match.length]]++;
+        this->m_distance_frequencies[tables.distance_code_of(match.distance)]++;
+        this->m_covered = position + static_cast<std::size_t>(match.length);
+        this->flush_full_block();
+    }
+
+    void flush_full_block()
+    {
+        if (this->m_symbols.size() >= deflate_block_symbols) {
+            this->write_block(this->m_block_start, this->m_covered, false);
+            this->m_block_start = this->m_covered;
+        }
+    }
+
+    void reset_block()
+    {
+        this->m_symbols.clear();
+        this->m_litlen_frequencies.fill(0);
+        this->m_distance_frequencies.fill(0);
+    }
+
+    /// Writes the collected symbols, covering `data[begin, end)`, as the smallest kind of block.
+    void write_block(std::size_t begin, std::size_t end, bool last)
+    {
+        const auto& tables = deflate_tables;
+        auto& litlen = this->m_litlen_frequencies;
+        auto& distances = this->m_distance_frequencies;
+        litlen[256] = 1;
+        // Complete codes need two symbols, which every decoder accepts.
+        if (std::count_if(litlen.begin(), litlen.end(), [](auto f) { return f != 0; }) < 2) {
+            litlen[litlen[0] == 0 ? 0 : 1]++;
+        }
+        while (std::count_if(distances.begin(), distances.end(), [](auto f) { return f != 0; }) < 2) {
+            distances[distances[0] == 0 ? 0 : 1]++;
+        }
+
+        std::array<std::uint8_t, deflate_litlen_codes + deflate_distance_codes> lengths {};
+        std::uint8_t* litlen_lengths = lengths.data();
+        std::uint8_t* distance_lengths = lengths.data() + deflate_litlen_codes;
+        huffman_lengths(litlen.data(), deflate_litlen_codes, 15, litlen_lengths);
+        huffman_lengths(distances.data(), deflate_distance_codes, 15, distance_lengths);
+
+        int litlen_count = deflate_litlen_codes;
+        while (litlen_count > 257 && litlen_lengths[litlen_count - 1] == 0) {
+            litlen_count--;
+        }
+        int distance_count = deflate_distance_codes;
+        while (distance_count > 1 && distance_lengths[distance_count - 1] == 0) {
+            distance_count--;
+        }
+
+        // Run length encodes the code lengths, as symbol | repeat << 8.
+        std::array<std::uint8_t, deflate_litlen_codes + deflate_distance_codes> sequence {};
+        std::copy_n(litlen_lengths, litlen_count, sequence.begin());
+        std::copy_n(distance_lengths, distance_count, sequence.begin() + litlen_count);
+        int sequence_size = litlen_count + distance_count;
+        std::vector<std::uint16_t> runs {};
+        std::array<std::uint32_t, deflate_length_codes> length_frequencies {};
+        for (int i = 0; i < sequence_size;) {
+            int value = sequence[i];
+            int run = 1;
+            while (i + run < sequence_size && sequence[i + run] == value) {
+                run++;
+            }
+            i += run;
+            if (value == 0) {
+                while (run >= 11) {
+                    int repeat = std::min(run, 138);
+                    runs.push_back(static_cast<std::uint16_t>(18 | (repeat - 11) << 8));
+                    run -= repeat;
+                }
+                if (run >= 3) {
+                    runs.push_back(static_cast<std::uint16_t>(17 | (run - 3) << 8));
+                    run = 0;
+                }
+            } else {
+                runs.push_back(static_cast<std::uint16_t>(value));
+                run--;
+                while (run >= 3) {
+                    int repeat = std::min(run, 6);
+                    runs.push_back(static_cast<std::uint16_t>(16 | (repeat - 3) << 8));
+                    run -= repeat;
+                }
+            }
+            for (; run > 0; run--) {
+                runs.push_back(static_cast<std::uint16_t>(value));
+            }
+        }
+        for (auto entry : runs) {
+            length_frequencies[entry & 0xFF]++;
+        }
+        std::array<std::uint8_t, deflate_length_codes> length_lengths {};
+        huffman_lengths(length_frequencies.data(), deflate_length_codes, 7, length_lengths.data());
+        int length_count = deflate_length_codes;
+        while (length_count > 4 && length_lengths[deflate_length_order[length_count - 1]] == 0) {
+            length_count--;
+        }
+
+        // Sizes of the three kinds of blocks, in bits.
+        std::uint64_t extra_bits = 0;
+        for (int code = 0; code < 29; code++) {
+            extra_bits += static_cast<std::uint64_t>(litlen[257 + code]) * tables.length_extra[code];
+        }
+        for (int code = 0; code < deflate_distance_codes; code++) {
+            extra_bits += static_cast<std::uint64_t>(distances[code]) * tables.distance_extra[code];
+        }
+        std::uint64_t dynamic_bits = 3 + 14 + 3 * static_cast<std::uint64_t>(length_count) + extra_bits;
+        std::uint64_t fixed_bits = 3 + extra_bits;
+        for (auto entry : runs) {
+            static constexpr int repeat_bits[3] = { 2, 3, 7 };
+            int symbol = entry & 0xFF;
+            dynamic_bits += length_lengths[symbol] + (symbol >= 16 ? repeat_bits[symbol - 16] : 0);
+        }
+        for (int i = 0; i < deflate_litlen_codes; i++) {
+            dynamic_bits += static_cast<std::uint64_t>(litlen[i]) * litlen_lengths[i];
+            fixed_bits += static_cast<std::uint64_t>(litlen[i]) * fixed_litlen_length(i);
+        }
+        for (int i = 0; i < deflate_distance_codes; i++) {
+            dynamic_bits += static_cast<std::uint64_t>(distances[i]) * distance_lengths[i];
+            fixed_bits += static_cast<std::uint64_t>(distances[i]) * 5;
+        }
+        auto stored_blocks = std::max<std::uint64_t>((end - begin + 65534) / 65535, 1);
+        std::uint64_t stored_bits = (end - begin) * 8 + stored_blocks * 40;
+
+        auto& writer = *this->m_writer;
+        if (stored_bits < std::min(dynamic_bits, fixed_bits)) {
+            this->write_stored(begin, end, last);
+        } else if (fixed_bits <= dynamic_bits) {
+            std::array<std::uint8_t, deflate_fixed_litlen_codes> fixed_litlen {};
+            for (int i = 0; i < deflate_fixed_litlen_codes; i++) {
+                fixed_litlen[static_cast<std::size_t>(i)] = static_cast<std::uint8_t>(fixed_litlen_length(i));
+            }
+            std::array<std::uint8_t, deflate_distance_codes> fixed_distance {};
+            fixed_distance.fill(5);
+            writer.put(last ? 1 : 0, 1);
+            writer.put(1, 2);
+            this->write_symbols(fixed_litlen.data(), deflate_fixed_litlen_codes, fixed_distance.data());
+        } else {
+            writer.put(last ? 1 : 0, 1);
+            writer.put(2, 2);
+            writer.put(static_cast<std::uint32_t>(litlen_count - 257), 5);
+            writer.put(static_cast<std::uint32_t>(distance_count - 1), 5);
+            writer.put(static_cast<std::uint32_t>(length_count - 4), 4);
+            for (int i = 0; i < length_count; i++) {
+                writer.put(length_lengths[deflate_length_order[i]], 3);
+            }
+            std::array<std::uint16_t, deflate_length_codes> length_codes {};
+            huffman_codes(length_lengths.data(), deflate_length_codes, length_codes.data());
+            for (auto entry : runs) {
+                static constexpr int repeat_bits[3] = { 2, 3, 7 };
+                int symbol = entry & 0xFF;
+                writer.put(length_codes[symbol], length_lengths[symbol]);
+                if (symbol >= 16) {
+                    writer.put(entry >> 8, repeat_bits[symbol - 16]);
+                }
+            }
+            this->write_symbols(litlen_lengths, deflate_litlen_codes, distance_lengths);
+        }
+        this->reset_block();
+    }
+
+    static int fixed_litlen_length(int symbol) noexcept
+    {
+        if (symbol < 144) {
+            return 8;
+        }
+        if (symbol < 256) {
+            return 9;
+        }
+        return symbol < 280 ? 7 : 8;
+    }
+
+    /// Writes the symbols of the block and its end with the code lengths of
+    /// `litlen_count` literal/length symbols, 288 for the fixed code.
+    void write_symbols(const std::uint8_t* litlen_lengths, int litlen_count, const std::uint8_t* distance_lengths)
+    {
+        const auto& tables = deflate_tables;
+        std::array<std::uint16_t, deflate_fixed_litlen_codes> litlen_codes {};
+        std::array<std::uint16_t, deflate_distance_codes> distance_codes {};
+        huffman_codes(litlen_lengths, litlen_count, litlen_codes.data());
+        huffman_codes(distance_lengths, deflate_distance_codes, distance_codes.data());
+
+        auto& writer = *this->m_writer;
+        for (auto symbol : this->m_symbols) {
+            if (symbol < 256) {
+                writer.put(litlen_codes[symbol], litlen_lengths[symbol]);
+                continue;
+            }
+            int length = static_cast<int>(symbol & 0xFFFF);
+            int distance = static_cast<int>(symbol >> 16);
+            int length_code = tables.length_code[length];
+            writer.put(litlen_codes[257 + length_code], litlen_lengths[257 + length_code]);
+            writer.put(static_cast<std::uint32_t>(length - tables.length_base[length_code]), tables.length_extra[length_code]);
+            int distance_code = tables.distance_code_of(distance);
+            writer.put(distance_codes[distance_code], distance_lengths[distance_code]);
+            writer.put(static_cast<std::uint32_t>(distance - tables.distance_base[distance_code]),
+                tables.distance_extra[distance_code]);
+        }
+        writer.put(litlen_codes[256], litlen_lengths[256]);
+    }
+
+    void write_stored(std::size_t begin, std::size_t end, bool last)
+    {
+        auto& writer = *this->m_writer;
+        do {
+            auto length = std::min<std::size_t>(end - begin, 65535);
+            bool final = last && begin + length == end;
+            writer.put(final ? 1 : 0, 1);
+            writer.put(0, 2);
+            writer.align();
+            writer.put(static_cast<std::uint32_t>(length), 16);
+            writer.put(static_cast<std::uint32_t>(~length & 0xFFFF), 16);
+            for (std::size_t i = 0; i < length; i++) {
+                writer.put(this->m_data[begin + i], 8);
+            }
+            begin += length;
+        } while (begin < end);
+        this->reset_block();
+    }
+
+    DeflateLevel m_level;
+    bool m_stored;
+    const unsigned char* m_data { nullptr };
+    std::size_t m_size { 0 };
+    BitWriter* m_writer { nullptr };
+    std::size_t m_block_start { 0 };
+    std::size_t m_covered { 0 };
+    std::vector<std::int32_t> m_head {};
+    std::vector<std::int32_t> m_previous {};
+    /// Literals below 256, or matches as `distance << 16 | length`.
+    std::vector<std::uint32_t> m_symbols {};
+    std::array<std::uint32_t, deflate_litlen_codes> m_litlen_frequencies {};
+    std::array<std::uint32_t, deflate_distance_codes> m_distance_frequencies {};
+};
+
+inline void append_big_endian(std::vector<unsigned char>& out, std::uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        out.push_back(static_cast<unsigned char>(value >> shift));
+    }
+}
+
+inline void append_zlib_header(std::vector<unsigned char>& out, int level)
+{
+    unsigned header = 0x78 << 8;
+    if (level >= 7) {
+        header |= 3 << 6;
+    } else if (level >= 6) {
+        header |= 2 << 6;
+    } else if (level >= 2) {
+        header |= 1 << 6;
+    }
+    header += 31 - header % 31;
+    out.push_back(static_cast<unsigned char>(header >> 8));
+    out.push_back(static_cast<unsigned char>(header));
+}
+
+/// Canonical Huffman code of a deflate block, decoded with a direct lookup
+/// of codes up to `fast_bits` long and a search of the longer ones.
+struct InflateTable {
+    static constexpr int fast_bits = 9;
+
+    /// `length << 9 | symbol` of the codes starting with the index, or 0.
+    std::array<std::uint16_t, 1 << fast_bits> fast {};
+    std::array<std::uint16_t, 16> first_code {};
+    std::array<std::uint16_t, 16> first_symbol {};
+    /// End of the codes of every length, shifted to 16 bits.
+    std::array<std::uint32_t, 17> max_code {};
+    std::array<std::uint8_t, 288> size {};
+    std::array<std::uint16_t, 288> symbol {};
+
+    /// Builds the code from the code length of every symbol.
+    void build(const std::uint8_t* lengths, int count)
+    {
+        std::array<int, 17> sizes {};
+        for (int i = 0; i < count; i++) {
+            sizes[lengths[i]]++;
+        }
+        sizes[0] = 0;
+        this->fast.fill(0);
+        std::array<int, 16> next_code {};
+        int code = 0;
+        int index = 0;
+        for (int length = 1; length < 16; length++) {
+            if (sizes[length] > (1 << length)) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            next_code[length] = code;
+            this->first_code[length] = static_cast<std::uint16_t>(code);
+            this->first_symbol[length] = static_cast<std::uint16_t>(index);
+            code += sizes[length];
+            if (sizes[length] != 0 && code - 1 >= (1 << length)) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            this->max_code[length] = static_cast<std::uint32_t>(code) << (16 - length);
+            code <<= 1;
+            index += sizes[length];
+        }
+        this->max_code[16] = 0x10000;
+        for (int i = 0; i < count; i++) {
+            int length = lengths[i];
+            if (length == 0) {
+                continue;
+            }
+            int slot = next_code[length] - this->first_code[length] + this->first_symbol[length];
+            this->size[slot] = static_cast<std::uint8_t>(length);
+            this->symbol[slot] = static_cast<std::uint16_t>(i);
+            if (length <= fast_bits) {
+                int reversed = 0;
+                for (int bit = 0; bit < length; bit++) {
+                    reversed |= ((next_code[length] >> bit) & 1) << (length - 1 - bit);
+                }
+                for (; reversed < (1 << fast_bits); reversed += 1 << length) {
+                    this->fast[reversed] = static_cast<std::uint16_t>(length << 9 | i);
+                }
+            }
+            next_code[length]++;
+        }
+    }
+};
+
+/// Streaming decoder of a raw deflate stream.
+///
+/// Compressed bytes are pulled from a source callback in pieces of any
+/// size, and decompressed bytes are produced on demand by `read()`.
+class Inflater {
+public:
+    /// Provides the next piece of the compressed stream, returning false
+    /// once the stream is exhausted.
+    using Source = std::function<bool(const unsigned char*& data, std::size_t& size)>;
+
+    explicit Inflater(Source source)
+        : m_source { std::move(source) }
+    {
+        this->m_output.resize(4 * deflate_window);
+    }
+
+    /// Decompresses up to `size` bytes, returning fewer only at the end of the stream.
+    std::size_t read(unsigned char* out, std::size_t size)
+    {
+        this->produce(size);
+        auto count = std::min(size, this->m_written - this->m_read);
+        std::copy_n(this->m_output.data() + this->m_read, count, out);
+        this->m_read += count;
+        // Drops the history beyond the window.
+        if (this->m_read > 3 * deflate_window) {
+            auto drop = this->m_read - deflate_window;
+            std::copy(this->m_output.data() + drop, this->m_output.data() + this->m_written, this->m_output.data());
+            this->m_read -= drop;
+            this->m_written -= drop;
+        }
+        return count;
+    }
+
+    /// Returns whether the final block has been decoded and read.
+    bool finished() const noexcept
+    {
+        return this->m_final && this->m_block == Block::None && this->m_read == this->m_written;
+    }
+
+    /// Drops the bits up to the next byte boundary.
+    void align() noexcept
+    {
+        this->drop(this->m_bit_count & 7);
+    }
+
+    /// Reads a byte of the stream after the deflate data, once aligned.
+    int read_byte()
+    {
+        if (this->m_bit_count >= 8) {
+            auto value = static_cast<int>(this->m_bits & 0xFF);
+            this->drop(8);
+            return value;
+        }
+        if (this->m_input == this->m_input_end && !this->next_input()) {
+            throw std::runtime_error { "Truncated deflate stream." };
+        }
+        // Drops the bits of the following bytes that `refill()` may have loaded.
+        this->m_bits = 0;
+        return *this->m_input++;
+    }
+
+private:
+    enum class Block {
+        None,
+        Stored,
+        Huffman,
+    };
+
+    /// Decodes blocks until `size` bytes are available or the stream ends.
+    void produce(std::size_t size)
+    {
+        // Room for the requested bytes and the longest match overshooting them.
+        auto room = this->m_read + size + deflate_max_match;
+        if (this->m_output.size() < room) {
+            this->m_output.resize(std::max(room, 2 * this->m_output.size()));
+        }
+        while (this->m_written - this->m_read < size) {
+            if (this->m_block == Block::None) {
+                if (this->m_final) {
+                    return;
+                }
+                this->start_block();
+            } else if (this->m_block == Block::Stored) {
+                while (this->m_stored > 0 && this->m_written - this->m_read < size) {
+                    this->m_output[this->m_written++] = static_cast<unsigned char>(this->read_byte());
+                    this->m_stored--;
+                }
+                if (this->m_stored == 0) {
+                    this->m_block = Block::None;
+                }
+            } else {
+                this->decode_symbols(size);
+            }
+        }
+    }
+
+    void start_block()
+    {
+        this->refill();
+        this->m_final = this->take(1) != 0;
+        auto type = this->take(2);
+        if (type == 0) {
+            this->align();
+            unsigned length = static_cast<unsigned>(this->read_byte());
+            length |= static_cast<unsigned>(this->read_byte()) << 8;
+            unsigned complement = static_cast<unsigned>(this->read_byte());
+            complement |= static_cast<unsigned>(this->read_byte()) << 8;
+            if ((length ^ 0xFFFF) != complement) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            this->m_stored = length;
+            this->m_block = Block::Stored;
+        } else if (type == 1) {
+            std::array<std::uint8_t, 288> lengths {};
+            std::fill(lengths.begin(), lengths.begin() + 144, 8);
+            std::fill(lengths.begin() + 144, lengths.begin() + 256, 9);
+            std::fill(lengths.begin() + 256, lengths.begin() + 280, 7);
+            std::fill(lengths.begin() + 280, lengths.end(), 8);
+            this->m_literals.build(lengths.data(), 288);
+            std::array<std::uint8_t, 32> distances {};
+            distances.fill(5);
+            this->m_distances.build(distances.data(), 32);
+            this->m_block = Block::Huffman;
+        } else if (type == 2) {
+            this->read_dynamic_codes();
+            this->m_block = Block::Huffman;
+        } else {
+            throw std::runtime_error { "Corrupt deflate stream." };
+        }
+    }
+
+    void read_dynamic_codes()
+    {
+        this->refill();
+        int literal_count = static_cast<int>(this->take(5)) + 257;
+        int distance_count = static_cast<int>(this->take(5)) + 1;
+        int length_count = static_cast<int>(this->take(4)) + 4;
+        std::array<std::uint8_t, deflate_length_codes> length_lengths {};
+        for (int i = 0; i < length_count; i++) {
+            this->refill();
+            length_lengths[deflate_length_order[i]] = static_cast<std::uint8_t>(this->take(3));
+        }
+        InflateTable length_table {};
+        length_table.build(length_lengths.data(), deflate_length_codes);
+
+        std::array<std::uint8_t, 288 + 32> lengths {};
+        int count = 0;
+        while (count < literal_count + distance_count) {
+            this->refill();
+            int symbol = this->decode(length_table);
+            if (symbol < 16) {
+                lengths[count++] = static_cast<std::uint8_t>(symbol);
+                continue;
+            }
+            std::uint8_t value = 0;
+            int repeat = 0;
+            if (symbol == 16) {
+                if (count == 0) {
+                    throw std::runtime_error { "Corrupt deflate stream." };
+                }
+                value = lengths[count - 1];
+                repeat = 3 + static_cast<int>(this->take(2));
+            } else if (symbol == 17) {
+                repeat = 3 + static_cast<int>(this->take(3));
+            } else {
+                repeat = 11 + static_cast<int>(this->take(7));
+            }
+            if (count + repeat > literal_count + distance_count) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            std::fill_n(lengths.begin() + count, repeat, value);
+            count += repeat;
+        }
+        if (lengths[256] == 0) {
+            throw std::runtime_error { "Corrupt deflate stream." };
+        }
+        this->m_literals.build(lengths.data(), literal_count);
+        this->m_distances.build(lengths.data() + literal_count, distance_count);
+    }
+
+    void decode_symbols(std::size_t size)
+    {
+        const auto& tables = deflate_tables;
+        auto* output = this->m_output.data();
+        auto written = this->m_written;
+        auto wanted = this->m_read + size;
+        while (written < wanted) {
+            // A length, a distance and their extra bits take at most 48 bits.
+            this->refill();
+            int symbol = this->decode(this->m_literals);
+            if (symbol < 256) {
+                output[written++] = static_cast<unsigned char>(symbol);
+                continue;
+            }
+            if (symbol == 256) {
+                this->m_block = Block::None;
+                break;
+            }
+            symbol -= 257;
+            if (symbol >= 29) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            std::size_t length = tables.length_base[symbol] + this->take(tables.length_extra[symbol]);
+            int code = this->decode(this->m_distances);
+            if (code >= deflate_distance_codes) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            std::size_t distance = tables.distance_base[code] + this->take(tables.distance_extra[code]);
+            if (distance > written) {
+                throw std::runtime_error { "Corrupt deflate stream." };
+            }
+            const auto* from = output + written - distance;
+            auto* to = output + written;
+            if (distance >= length) {
+                std::copy_n(from, length, to);
+            } else {
+                // Overlapping copy, repeating the last `distance` bytes.
+                for (std::size_t i = 0; i < length; i++) {
+                    to[i] = from[i];
+                }
+            }
+            written += length;
+        }
+        this->m_written = written;
+    }
+
+    int decode(const InflateTable& table)
+    {
+        auto entry = table.fast[this->m_bits & ((1u << InflateTable::fast_bits) - 1)];
+        if (entry != 0) {
+            this->drop(entry >> 9);
+            return entry & 0x1FF;
+        }
+        std::uint32_t reversed = 0;
+        for (int bit = 0; bit < 16; bit++) {
+            reversed |= static_cast<std::uint32_t>((this->m_bits >> bit) & 1) << (15 - bit);
+        }
+        int length = InflateTable::fast_bits + 1;
+        while (reversed >= table.max_code[length]) {
+            length++;
+        }
+        if (length >= 16) {
+            throw std::runtime_error { "Corrupt deflate stream." };
+        }
+        int slot = static_cast<int>(reversed >> (16 - length)) - table.first_code[length] + table.first_symbol[length];
+        if (slot >= 288 || table.size[slot] != length) {
+            throw std::runtime_error { "Corrupt deflate stream." };
+        }
+        this->drop(length);
+        return table.symbol[slot];
+    }
+
+    /// Tops the bit buffer up to at least 56 bits, with zeros past the end
+    /// of the stream which `drop()` refuses to consume.
+    ///
+    /// The fast path loads 8 bytes at once but only counts the whole ones,
+    /// so the bits above `m_bit_count` may already hold the next bytes.
+    void refill()
+    {
+        if (this->m_input_end - this->m_input >= 8) {
+            std::uint64_t word = 0;
+            for (int i = 0; i < 8; i++) {
+                word |= static_cast<std::uint64_t>(this->m_input[i]) << (8 * i);
+            }
+            this->m_bits |= word << this->m_bit_count;
+            this->m_input += (63 - this->m_bit_count) >> 3;
+            this->m_bit_count |= 56;
+            return;
+        }
+        while (this->m_bit_count <= 56) {
+            if (this->m_input == this->m_input_end && !this->next_input()) {
+                this->m_padding += 8;
+                this->m_bit_count += 8;
+                continue;
+            }
+            this->m_bits |= static_cast<std::uint64_t>(*this->m_input++) << this->m_bit_count;
+            this->m_bit_count += 8;
+        }
+    }
+
+    std::uint32_t take(int count)
+    {
+        auto value = static_cast<std::uint32_t>(this->m_bits & ((std::uint64_t { 1 } << count) - 1));
+        this->drop(count);
+        return value;
+    }
+
+    void drop(int count)
+    {
+        if (this->m_bit_count - count < this->m_padding) {
+            throw std::runtime_error { "Truncated deflate stream." };
+        }
+        this->m_bits >>= count;
+        this->m_bit_count -= count;
+    }
+
+    bool next_input()
+    {
+        const unsigned char* data = nullptr;
+        std::size_t size = 0;
+        while (size == 0) {
+            if (!this->m_source(data, size)) {
+                return false;
+            }
+        }
+        this->m_input = data;
+        this->m_input_end = data + size;
+        return true;
+    }
+
+    Source m_source;
+    const unsigned char* m_input { nullptr };
+    const unsigned char* m_input_end { nullptr };
+    std::uint64_t m_bits { 0 };
+    int m_bit_count { 0 };
+    /// Number of zero bits appended to the buffer past the end of the stream.
+    int m_padding { 0 };
+
+    Block m_block { Block::None };
+    bool m_final { false };
+    std::size_t m_stored { 0 };
+    InflateTable m_literals {};
+    InflateTable m_distances {};
+
+    /// Decompressed bytes, with the history before `m_read` and the unread
+    /// bytes up to `m_written`.
+    std::vector<unsigned char> m_output {};
+    std::size_t m_read { 0 };
+    std::size_t m_written { 0 };
+};
+
+/// Reads and checks the two bytes of a zlib header.
+inline void read_zlib_header(Inflater& inflater)
+{
+    int method = inflater.read_byte();
+    int flags = inflater.read_byte();
+    if ((method & 0x0F) != 8 || (method >> 4) > 7 || (method << 8 | flags) % 31 != 0 || (flags & 0x20) != 0) {
+        throw std::runtime_error { "Invalid zlib header." };
+    }
+}
+
+} // namespace detail
+
+/// Returns the CRC-32 of bytes, as used by PNG and gzip.
+///
+/// @param data Checksummed bytes.
+/// @param size Number of bytes.
+/// @param crc CRC of the preceding bytes, to checksum data in pieces.
+inline std::uint32_t crc32(const unsigned char* data, std::size_t size, std::uint32_t crc = 0) noexcept
+{
+    const auto& table = detail::crc_tables.table;
+    crc = ~crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        std::uint32_t low = crc ^ (data[0] | data[1] << 8 | data[2] << 16 | static_cast<std::uint32_t>(data[3]) << 24);
+        crc = table[7][low & 0xFF] ^ table[6][(low >> 8) & 0xFF] ^ table[5][(low >> 16) & 0xFF] ^ table[4][low >> 24]
+            ^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+    }
+    for (; size > 0; size--, data++) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data) & 0xFF];
+    }
+    return ~crc;
+}
+
+/// Returns the Adler-32 checksum of bytes, as used by zlib.
+///
+/// @param data Checksummed bytes.
+/// @param size Number of bytes.
+/// @param adler Checksum of the preceding bytes, to checksum data in pieces.
+inline std::uint32_t adler32(const unsigned char* data, std::size_t size, std::uint32_t adler = 1) noexcept
+{
+    constexpr std::uint32_t modulo = 65521;
+    // Largest number of bytes summed before the sums may overflow.
+    constexpr std::size_t run = 5552;
+    std::uint32_t a = adler & 0xFFFF;
+    std::uint32_t b = adler >> 16;
+    while (size > 0) {
+        auto count = std::min(size, run);
+        size -= count;
+        for (; count > 0; count--) {
+            a += *data++;
+            b += a;
+        }
+        a %= modulo;
+        b %= modulo;
+    }
+    return b << 16 | a;
+}
+
+/// Compresses bytes into a zlib stream.
+///
+/// @param data Compressed bytes.
+/// @param size Number of bytes.
+/// @param level 0 for stored blocks, 1 fastest to 9 smallest.
+inline std::vector<unsigned char> zlib_compress(const unsigned char* data, std::size_t size, int level = 6)
+{
+    std::vector<unsigned char> out {};
+    out.reserve(size / 2 + 64);
+    detail::append_zlib_header(out, level);
+    detail::DeflateEncoder { level }.compress(data, 0, size, true, out);
+    detail::append_big_endian(out, adler32(data, size));
+    return out;
+}
+
+/// Compresses bytes into a zlib stream, with chunks compressed in parallel.
+///
+/// Every chunk matches against the 32 KiB before it, so the stream is only
+/// slightly larger than with `zlib_compress()`.
+///
+/// @param data Compressed bytes.
+/// @param size Number of bytes.
+/// @param level 0 for stored blocks, 1 fastest to 9 smallest.
+/// @param pool Pool compressing the chunks.
+/// @param chunk_size Number of bytes per chunk.
+inline std::vector<unsigned char> zlib_compress_parallel(const unsigned char* data, std::size_t size, int level = 6,
+    ThreadPool& pool = ThreadPool::global(), std::size_t chunk_size = std::size_t { 1 } << 18)
+{
+    chunk_size = std::max(chunk_size, detail::deflate_window);
+    auto chunk_count = std::max<std::size_t>((size + chunk_size - 1) / chunk_size, 1);
+    std::vector<std::vector<unsigned char>> chunks(chunk_count);
+    std::vector<std::uint32_t> checksums(chunk_count);
+    pool.parallel_for(chunk_count, 1, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            auto start = i * chunk_size;
+            auto stop = std::min(start + chunk_size, size);
+            auto dictionary = std::min(start, detail::deflate_window);
+            chunks[i].reserve((stop - start) / 2 + 64);
+            detail::DeflateEncoder { level }.compress(
+                data + start - dictionary, dictionary, stop - start + dictionary, i + 1 == chunk_count, chunks[i]);
+            checksums[i] = adler32(data + start, stop - start);
+        }
+    });
+
+    std::size_t total = 6;
+    for (const auto& chunk : chunks) {
+        total += chunk.size();
+    }
+    std::vector<unsigned char> out {};
+    out.reserve(total);
+    detail::append_zlib_header(out, level);
+    // Combines the checksums of the chunks, as zlib's adler32_combine.
+    constexpr std::uint32_t modulo = 65521;
+    std::uint32_t adler = 1;
+    for (std::size_t i = 0; i < chunk_count; i++) {
+        out.insert(out.end(), chunks[i].begin(), chunks[i].end());
+        auto length = std::min(chunk_size, size - i * chunk_size);
+        auto remainder = static_cast<std::uint32_t>(length % modulo);
+        std::uint32_t a = adler & 0xFFFF;
+        std::uint32_t b = static_cast<std::uint32_t>((static_cast<std::uint64_t>(remainder) * a) % modulo);
+        a += (checksums[i] & 0xFFFF) + modulo - 1;
+        b += (adler >> 16) + (checksums[i] >> 16) + modulo - remainder;
+        a = a >= modulo ? a - modulo : a;
+        a = a >= modulo ? a - modulo : a;
+        b = b >= 2 * modulo ? b - 2 * modulo : b;
+        b = b >= modulo ? b - modulo : b;
+        adler = b << 16 | a;
+    }
+    detail::append_big_endian(out, adler);
+    return out;
+}
+
+/// Decompresses a whole zlib stream and checks its checksum.
+///
+/// @param data Compressed bytes.
+/// @param size Number of bytes.
+inline std::vector<unsigned char> zlib_decompress(const unsigned char* data, std::size_t size)
+{
+    bool provided = false;
+    detail::Inflater inflater { [&](const unsigned char*& piece, std::size_t& piece_size) {
+        if (provided) {
+            return false;
+        }
+        provided = true;
+        piece = data;
+        piece_size = size;
+        return true;
+    } };
+    detail::read_zlib_header(inflater);
+    std::vector<unsigned char> out {};
+    out.reserve(size * 2);
+    constexpr std::size_t chunk = std::size_t { 1 } << 18;
+    for (;;) {
+        auto start = out.size();
+        out.resize(start + chunk);
+        auto count = inflater.read(out.data() + start, chunk);
+        out.resize(start + count);
+        if (count < chunk) {
+            break;
+        }
+    }
+    inflater.align();
+    std::uint32_t expected = 0;
+    for (int i = 0; i < 4; i++) {
+        expected = expected << 8 | static_cast<std::uint32_t>(inflater.read_byte());
+    }
+    if (adler32(out.data(), out.size()) != expected) {
+        throw std::runtime_error { "Corrupt zlib stream, the checksum does not match." };
+    }
+    return out;
+}
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+// Exact Euclidean distance transforms and signed distance fields.
+//
+// Distances are computed with the separable algorithm of Meijster et al.:
+// a pass along the columns finds the nearest feature of every pixel within
+// its column, running over whole rows so that it vectorizes across columns,
+// then a pass along every row takes the lower envelope of the parabolas
+// centered on each pixel of the row. Both passes are linear in the number
+// of pixels, whatever the distances.
+
+/// Options of the generation of distance fields from masks.
+struct DistanceFieldOptions {
+    /// Channel holding the mask, or -1 for the alpha channel of images with
+    /// one, and the first channel otherwise.
+    int channel { -1 };
+    /// Mask values above the threshold are inside the shape.
+    unsigned char threshold { 127 };
+    /// Distance in pixels of the field mapped to the full range of 8-bit
+    /// fields, on either side of the edge.
+    float spread { 8.0f };
+    /// Factor by which the mask is larger than the field, e.g. 4 for glyphs
+    /// rasterized at four times the resolution of their distance field.
+    int supersample { 1 };
+};
+
+namespace detail {
+
+/// Returns the channel of a mask holding the shape.
+inline int mask_channel(ConstImageView mask, const DistanceFieldOptions& options)
+{
+    if (options.channel >= mask.channels()) {
+        throw std::runtime_error { "The mask has no such channel." };
+    }
+    if (options.channel >= 0) {
+        return options.channel;
+    }
+    return mask.channels() == 2 || mask.channels() == 4 ? mask.channels() - 1 : 0;
+}
+
+/// Computes the distance of every pixel to the nearest feature within its
+/// column, in both directions, for a band of columns.
+///
+/// Rows are processed one after the other over the whole band, so the
+/// inner loops are independent across columns and vectorized.
+///
+/// @param mask Source mask.
+/// @param channel Channel holding the shape.
+/// @param threshold Mask values above it are inside the shape.
+/// @param inside Whether the features are the inside pixels, or the outside ones.
+/// @param begin First column of the band.
+/// @param end End of the band.
+/// @param columns Destination of the distances, `width` values per row.
+inline void edt_columns(ConstImageView mask, int channel, unsigned char threshold, bool inside, int begin, int end,
+    std::int32_t* columns)
+{
+    auto width = static_cast<std::size_t>(mask.width());
+    auto channels = static_cast<std::size_t>(mask.channels());
+    auto count = static_cast<std::size_t>(end - begin);
+    auto infinity = static_cast<std::int32_t>(mask.width() + mask.height());
+    std::int32_t* previous = nullptr;
+    for (int y = 0; y < mask.height(); y++) {
+        const auto* src = mask.row(y) + static_cast<std::size_t>(begin) * channels + static_cast<std::size_t>(channel);
+        auto* row = columns + static_cast<std::size_t>(y) * width + static_cast<std::size_t>(begin);
+        for (std::size_t x = 0; x < count; x++) {
+            bool feature = (src[x * channels] > threshold) == inside;
+            std::int32_t above = previous != nullptr ? previous[x] + 1 : infinity;
+            row[x] = feature ? 0 : std::min(above, infinity);
+        }
+        previous = row;
+    }
+    for (int y = mask.height() - 2; y >= 0; y--) {
+        auto* row = columns + static_cast<std::size_t>(y) * width + static_cast<std::size_t>(begin);
+        const auto* below = row + width;
+        for (std::size_t x = 0; x < count; x++) {
+            row[x] = std::min(row[x], below[x] + 1);
+        }
+    }
+}
+
+/// Squared distances of a row to the nearest feature, from the column distances.
+///
+/// @param g Column distance of every pixel of the row.
+/// @param width Number of pixels of the row.
+/// @param sites Scratch of `width` values, the centers of the envelope.
+/// @param starts Scratch of `width` values, where each center starts to be the nearest.
+/// @param out Destination of the squared distances.
+inline void edt_row(const std::int32_t* g, int width, int* sites, int* starts, std::int64_t* out) noexcept
+{
+    auto square = [](std::int64_t value) { return value * value; };
+    auto distance = [&](int x, int site) { return square(x - site) + square(g[site]); };
+    // First column from which `u` is nearer than `i`, with `i < u`.
+    auto separation = [&](int i, int u) {
+        std::int64_t numerator = square(u) - square(i) + square(g[u]) - square(g[i]);
+        std::int64_t denominator = 2 * static_cast<std::int64_t>(u - i);
+        return numerator >= 0 ? numerator / denominator : -((-numerator + denominator - 1) / denominator);
+    };
+
+    int q = 0;
+    sites[0] = 0;
+    starts[0] = 0;
+    for (int u = 1; u < width; u++) {
+        while (q >= 0 && distance(starts[q], sites[q]) > distance(starts[q], u)) {
+            q--;
+        }
+        if (q < 0) {
+            q = 0;
+            sites[0] = u;
+        } else {
+            auto start = 1 + separation(sites[q], u);
+            if (start < width) {
+                q++;
+                sites[q] = u;
+                starts[q] = static_cast<int>(start);
+            }
+        }
+    }
+    for (int u = width - 1; u >= 0; u--) {
+        out[u] = distance(u, sites[q]);
+        if (u == starts[q]) {
+            q--;
+        }
+    }
+}
+
+/// Computes the squared distance of every pixel to the nearest feature.
+///
+/// @param mask Source mask.
+/// @param channel Channel holding the shape.
+/// @param threshold Mask values above it are inside the shape.
+/// @param inside Whether the features are the inside pixels, or the outside ones.
+/// @param pool Pool processing the bands of columns and the rows.
+/// @param visit Called as `visit(y, squared)` with the squared distances of
+/// every row, from the thread that computed them.
+template <typename F>
+void squared_distances(
+    ConstImageView mask, int channel, unsigned char threshold, bool inside, ThreadPool& pool, F&& visit)
+{
+    int width = mask.width();
+    int height = mask.height();
+    std::vector<std::int32_t> columns(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    constexpr int band = 256;
+    auto bands = static_cast<std::size_t>((width + band - 1) / band);
+    pool.parallel_for(bands, 1, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            int left = static_cast<int>(i) * band;
+            edt_columns(mask, channel, threshold, inside, left, std::min(left + band, width), columns.data());
+        }
+    });
+
+    pool.parallel_for(static_cast<std::size_t>(height), 16, [&](std::size_t begin, std::size_t end) {
+        std::vector<int> sites(static_cast<std::size_t>(width));
+        std::vector<int> starts(static_cast<std::size_t>(width));
+        std::vector<std::int64_t> squared(static_cast<std::size_t>(width));
+        for (auto y = begin; y < end; y++) {
+            edt_row(columns.data() + y * static_cast<std::size_t>(width), width, sites.data(), starts.data(),
+                squared.data());
+            visit(static_cast<int>(y), squared.data());
+        }
+    });
+}
+
+} // namespace detail
+
+/// Computes the exact Euclidean distance of every pixel to the nearest
+/// pixel inside the shape of a mask, 0 inside the shape.
+///
+/// Pixels are infinitely far from an empty shape, then getting a distance
+/// larger than the diagonal of the image.
+///
+/// @param mask Pixels whose values above `options.threshold` are inside the shape.
+/// @param options Channel and threshold of the mask.
+/// @param pool Pool processing the columns and rows.
+inline ImageR32F distance_transform(
+    ConstImageView mask, const DistanceFieldOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    int channel = detail::mask_channel(mask, options);
+    ImageR32F result { mask.width(), mask.height() };
+    detail::squared_distances(mask, channel, options.threshold, true, pool, [&](int y, const std::int64_t* squared) {
+        auto* out = result.pixel(0, y);
+        for (int x = 0; x < mask.width(); x++) {
+            out[x] = static_cast<float>(std::sqrt(static_cast<double>(squared[x])));
+        }
+    });
+    return result;
+}
+
+/// Computes the signed distance field of the shape of a mask.
+///
+/// Distances are measured to the edge between inside and outside pixels,
+/// half a pixel away from their centers, in pixels of the field: positive
+/// inside the shape and negative outside. With supersampling, every pixel
+/// of the field averages a block of `supersample` squared mask pixels.
+///
+/// @param mask Pixels whose values above `options.threshold` are inside the shape.
+/// @param options Channel and threshold of the mask, and supersampling factor.
+/// @param pool Pool processing the columns and rows.
+inline ImageR32F signed_distance_field(
+    ConstImageView mask, const DistanceFieldOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    int channel = detail::mask_channel(mask, options);
+    int factor = options.supersample;
+    if (factor < 1) {
+        throw std::runtime_error { "Invalid supersampling factor." };
+    }
+    int width = mask.width();
+    int height = mask.height();
+    ImageR32F full { width, height };
+    // Distance to the outside for the inside pixels, then to the inside for
+    // the others, each pass leaving the pixels of the other set untouched.
+    for (bool inside : { false, true }) {
+        detail::squared_distances(mask, channel, options.threshold, inside, pool, [&](int y, const std::int64_t* squared) {
+            auto* out = full.pixel(0, y);
+            for (int x = 0; x < width; x++) {
+                if (squared[x] != 0) {
+                    auto distance = static_cast<float>(std::sqrt(static_cast<double>(squared[x]))) - 0.5f;
+                    out[x] = inside ? -distance : distance;
+                }
+            }
+        });
+    }
+    if (factor == 1) {
+        return full;
+    }
+
+    ImageR32F result { (width + factor - 1) / factor, (height + factor - 1) / factor };
+    pool.parallel_for(static_cast<std::size_t>(result.height()), 4, [&](std::size_t begin, std::size_t end) {
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            int top = y * factor;
+            int bottom = std::min(top + factor, height);
+            auto* out = result.pixel(0, y);
+            for (int x = 0; x < result.width(); x++) {
+                int left = x * factor;
+                int right = std::min(left + factor, width);
+                float sum = 0.0f;
+                for (int row = top; row < bottom; row++) {
+                    const auto* in = full.pixel(0, row);
+                    for (int column = left; column < right; column++) {
+                        sum += in[column];
+                    }
+                }
+                out[x] = sum / static_cast<float>((bottom - top) * (right - left) * factor);
+            }
+        }
+    });
+    return result;
+}
+
+/// Computes the signed distance field of a mask as 8-bit values.
+///
+/// The edge maps to 128, inside values are larger, and the field saturates
+/// `options.spread` pixels away from the edge on either side, as expected
+/// by the usual SDF text and decal shaders.
+///
+/// @param mask Pixels whose values above `options.threshold` are inside the shape.
+/// @param options Channel and threshold of the mask, supersampling factor and spread.
+/// @param pool Pool processing the columns and rows.
+inline ImageR8 signed_distance_field_unorm8(
+    ConstImageView mask, const DistanceFieldOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    if (!(options.spread > 0.0f)) {
+        throw std::runtime_error { "The spread of a distance field must be positive." };
+    }
+    auto field = signed_distance_field(mask, options, pool);
+    ImageR8 result { field.width(), field.height() };
+    float scale = 127.0f / options.spread;
+    pool.parallel_for(static_cast<std::size_t>(field.height()), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            const auto* in = field.pixel(0, static_cast<int>(y));
+            auto* out = result.pixel(0, static_cast<int>(y));
+            for (int x = 0; x < field.width(); x++) {
+                float value = std::clamp(128.0f + in[x] * scale, 0.0f, 255.0f);
+                out[x] = static_cast<unsigned char>(value + 0.5f);
+            }
+        }
+    });
+    return result;
+}
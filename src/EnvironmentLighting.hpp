@@ -0,0 +1,734 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "MappedFile.hpp"
+#include "Mipmap.hpp"
+#include "ThreadPool.hpp"
+
+// Image based lighting precomputed on the CPU from equirectangular HDR
+// environment maps: a radiance cube map, the diffuse irradiance as
+// spherical harmonics and the GGX prefiltered specular levels of the split
+// sum approximation.
+//
+// Directions follow OpenGL: +Y is up and the center of the environment map
+// looks toward -Z. Cube map faces are in the order of the targets from
+// `GL_TEXTURE_CUBE_MAP_POSITIVE_X` to `GL_TEXTURE_CUBE_MAP_NEGATIVE_Z`, their
+// first row at `t = 0`, as glTexImage2D expects them.
+
+/// Options of the precomputation of image based lighting.
+struct EnvironmentOptions {
+    /// Size in texels of the faces of the radiance cube map.
+    int cube_size { 512 };
+    /// Size in texels of the faces of the first specular level.
+    int specular_size { 256 };
+    /// Number of specular levels, each half the size of the previous one,
+    /// with roughnesses evenly spaced from 0 to 1.
+    int specular_levels { 6 };
+    /// Number of GGX importance samples per texel of the specular levels.
+    int sample_count { 256 };
+};
+
+/// Cube map with RGB float faces.
+struct CubeMap {
+    /// The six faces, from +X to -Z.
+    std::vector<ImageRGB32F> faces {};
+
+    /// Returns the size in texels of the faces.
+    int size() const noexcept
+    {
+        return this->faces.empty() ? 0 : this->faces.front().width();
+    }
+};
+
+/// Irradiance as third order real spherical harmonics.
+struct SphericalHarmonics {
+    /// RGB coefficients of the nine basis functions, by band and then from
+    /// order `-l` to `l`. The cosine lobe is already applied, so evaluating
+    /// them gives the irradiance, to be multiplied by `albedo / pi`.
+    std::array<std::array<float, 3>, 9> coefficients {};
+
+    /// Returns the irradiance received by a surface.
+    ///
+    /// @param x,y,z Unit normal of the surface.
+    std::array<float, 3> irradiance(float x, float y, float z) const noexcept
+    {
+        const float basis[9] = { 0.282095f, 0.488603f * y, 0.488603f * z, 0.488603f * x, 1.092548f * x * y,
+            1.092548f * y * z, 0.315392f * (3.0f * z * z - 1.0f), 1.092548f * x * z, 0.546274f * (x * x - y * y) };
+        std::array<float, 3> result {};
+        for (std::size_t i = 0; i < 9; i++) {
+            for (std::size_t c = 0; c < 3; c++) {
+                result[c] += this->coefficients[i][c] * basis[i];
+            }
+        }
+        return result;
+    }
+};
+
+/// Precomputed image based lighting of an environment.
+struct EnvironmentLighting {
+    /// Radiance of the environment.
+    CubeMap radiance {};
+    /// Diffuse irradiance.
+    SphericalHarmonics irradiance {};
+    /// Radiance prefiltered with the GGX distribution, level `i` for a
+    /// roughness of `i / (levels - 1)`, each level half the size of the previous one.
+    std::vector<CubeMap> specular {};
+};
+
+namespace detail {
+
+inline constexpr float environment_pi = 3.14159265358979f;
+
+struct Direction {
+    float x;
+    float y;
+    float z;
+};
+
+inline Direction normalize(Direction d) noexcept
+{
+    float scale = 1.0f / std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+    return { d.x * scale, d.y * scale, d.z * scale };
+}
+
+inline Direction cross(Direction a, Direction b) noexcept
+{
+    return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+/// Direction through a point of a cube map face, not normalized.
+///
+/// @param face Index of the face, from +X to -Z.
+/// @param s,t Coordinates on the face in `[-1, 1]`.
+inline Direction cube_face_direction(int face, float s, float t) noexcept
+{
+    switch (face) {
+    case 0:
+        return { 1.0f, -t, -s };
+    case 1:
+        return { -1.0f, -t, s };
+    case 2:
+        return { s, 1.0f, t };
+    case 3:
+        return { s, -1.0f, -t };
+    case 4:
+        return { s, -t, 1.0f };
+    default:
+        return { -s, -t, -1.0f };
+    }
+}
+
+/// Direction through the center of a texel of a cube map face, normalized.
+inline Direction cube_texel_direction(int face, int x, int y, int size) noexcept
+{
+    float scale = 2.0f / static_cast<float>(size);
+    return normalize(cube_face_direction(
+        face, (static_cast<float>(x) + 0.5f) * scale - 1.0f, (static_cast<float>(y) + 0.5f) * scale - 1.0f));
+}
+
+/// Finds the face of a cube map a direction points to, and the texture
+/// coordinates in `[0, 1]` on that face, as OpenGL does.
+inline int cube_face_coordinates(Direction d, float& s, float& t) noexcept
+{
+    float ax = std::abs(d.x);
+    float ay = std::abs(d.y);
+    float az = std::abs(d.z);
+    int face = 0;
+    float major = 0.0f;
+    float sc = 0.0f;
+    float tc = 0.0f;
+    if (ax >= ay && ax >= az) {
+        face = d.x > 0.0f ? 0 : 1;
+        major = ax;
+        sc = d.x > 0.0f ? -d.z : d.z;
+        tc = -d.y;
+    } else if (ay >= az) {
+        face = d.y > 0.0f ? 2 : 3;
+        major = ay;
+        sc = d.x;
+        tc = d.y > 0.0f ? d.z : -d.z;
+    } else {
+        face = d.z > 0.0f ? 4 : 5;
+        major = az;
+        sc = d.z > 0.0f ? d.x : -d.x;
+        tc = -d.y;
+    }
+    s = 0.5f * (sc / major + 1.0f);
+    t = 0.5f * (tc / major + 1.0f);
+    return face;
+}
+
+/// Bilinearly samples the RGB value of an equirectangular image in a direction.
+inline void sample_equirect(ConstImageViewF image, Direction d, float* rgb) noexcept
+{
+    int width = image.width();
+    int height = image.height();
+    float u = 0.5f + std::atan2(d.x, -d.z) * (0.5f / environment_pi);
+    float v = std::acos(std::clamp(d.y, -1.0f, 1.0f)) / environment_pi;
+    float x = u * static_cast<float>(width) - 0.5f;
+    float y = v * static_cast<float>(height) - 0.5f;
+    float fx = std::floor(x);
+    float fy = std::floor(y);
+    float wx = x - fx;
+    float wy = y - fy;
+    int x0 = (static_cast<int>(fx) % width + width) % width;
+    int x1 = x0 + 1 == width ? 0 : x0 + 1;
+    int y0 = std::clamp(static_cast<int>(fy), 0, height - 1);
+    int y1 = std::clamp(static_cast<int>(fy) + 1, 0, height - 1);
+
+    auto channels = static_cast<std::size_t>(image.channels());
+    const float* top = image.row(y0);
+    const float* bottom = image.row(y1);
+    for (std::size_t c = 0; c < 3; c++) {
+        // Single channel images are grey, and the alpha of two channel ones is ignored.
+        std::size_t channel = channels >= 3 ? c : 0;
+        float a = top[static_cast<std::size_t>(x0) * channels + channel];
+        float b = top[static_cast<std::size_t>(x1) * channels + channel];
+        float e = bottom[static_cast<std::size_t>(x0) * channels + channel];
+        float f = bottom[static_cast<std::size_t>(x1) * channels + channel];
+        rgb[c] = (a + (b - a) * wx) * (1.0f - wy) + (e + (f - e) * wx) * wy;
+    }
+}
+
+/// Bilinearly samples a cube map face, clamping at its edges.
+inline void sample_cube_face(const ImageRGB32F& face, float s, float t, float* rgb) noexcept
+{
+    int size = face.width();
+    float x = std::clamp(s * static_cast<float>(size) - 0.5f, 0.0f, static_cast<float>(size - 1));
+    float y = std::clamp(t * static_cast<float>(size) - 0.5f, 0.0f, static_cast<float>(size - 1));
+    int x0 = static_cast<int>(x);
+    int y0 = static_cast<int>(y);
+    int x1 = std::min(x0 + 1, size - 1);
+    int y1 = std::min(y0 + 1, size - 1);
+    float wx = x - static_cast<float>(x0);
+    float wy = y - static_cast<float>(y0);
+    const float* a = face.pixel(x0, y0);
+    const float* b = face.pixel(x1, y0);
+    const float* e = face.pixel(x0, y1);
+    const float* f = face.pixel(x1, y1);
+    for (int c = 0; c < 3; c++) {
+        rgb[c] = (a[c] + (b[c] - a[c]) * wx) * (1.0f - wy) + (e[c] + (f[c] - e[c]) * wx) * wy;
+    }
+}
+
+/// Trilinearly samples a mip chain of cube maps in a direction.
+inline void sample_cube_chain(const std::vector<CubeMap>& chain, Direction d, float lod, float* rgb) noexcept
+{
+    float s = 0.0f;
+    float t = 0.0f;
+    auto face = static_cast<std::size_t>(cube_face_coordinates(d, s, t));
+    lod = std::clamp(lod, 0.0f, static_cast<float>(chain.size() - 1));
+    auto level = static_cast<std::size_t>(lod);
+    float weight = lod - static_cast<float>(level);
+    sample_cube_face(chain[level].faces[face], s, t, rgb);
+    if (weight > 0.0f && level + 1 < chain.size()) {
+        float next[3];
+        sample_cube_face(chain[level + 1].faces[face], s, t, next);
+        for (int c = 0; c < 3; c++) {
+            rgb[c] += (next[c] - rgb[c]) * weight;
+        }
+    }
+}
+
+/// Runs a function on every row of every face of a cube map.
+///
+/// @param size Size of the faces.
+/// @param grain Minimal number of rows per task.
+/// @param body Called as `body(face, y)`.
+template <typename F>
+void for_each_cube_row(int size, std::size_t grain, ThreadPool& pool, F&& body)
+{
+    auto rows = static_cast<std::size_t>(size);
+    pool.parallel_for(6 * rows, grain, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            body(static_cast<int>(i / rows), static_cast<int>(i % rows));
+        }
+    });
+}
+
+inline CubeMap make_cube_map(int size)
+{
+    CubeMap cube {};
+    for (int face = 0; face < 6; face++) {
+        cube.faces.emplace_back(size, size);
+    }
+    return cube;
+}
+
+/// Builds the mip chain of a cube map, averaging 2x2 texels of every face.
+inline std::vector<CubeMap> cube_mip_chain(const CubeMap& base, ThreadPool& pool)
+{
+    std::vector<CubeMap> chain {};
+    chain.push_back(make_cube_map(base.size()));
+    for (std::size_t face = 0; face < 6; face++) {
+        copy_pixels<float>(base.faces[face], chain.front().faces[face]);
+    }
+    while (chain.back().size() > 1) {
+        const auto& source = chain.back();
+        int source_size = source.size();
+        auto level = make_cube_map(source_size / 2);
+        for_each_cube_row(level.size(), 8, pool, [&](int face, int y) {
+            const auto& in = source.faces[static_cast<std::size_t>(face)];
+            auto& out = level.faces[static_cast<std::size_t>(face)];
+            const float* top = in.pixel(0, 2 * y);
+            const float* bottom = in.pixel(0, std::min(2 * y + 1, source_size - 1));
+            float* dst = out.pixel(0, y);
+            for (int x = 0; x < level.size(); x++) {
+                auto left = static_cast<std::size_t>(2 * x) * 3;
+                auto right = static_cast<std::size_t>(std::min(2 * x + 1, source_size - 1)) * 3;
+                for (std::size_t c = 0; c < 3; c++) {
+                    dst[static_cast<std::size_t>(x) * 3 + c]
+                        = 0.25f * (top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c]);
+                }
+            }
+        });
+        chain.push_back(std::move(level));
+    }
+    return chain;
+}
+
+/// Importance sample of the GGX distribution around the normal `+Z`.
+struct GgxSample {
+    /// Direction of the sampled light.
+    Direction light;
+    /// Cosine between the normal and the light.
+    float weight;
+    /// Level of the radiance mip chain covering the solid angle of the sample.
+    float lod;
+};
+
+inline float radical_inverse(std::uint32_t bits) noexcept
+{
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return static_cast<float>(bits) * 2.3283064365386963e-10f;
+}
+
+/// Draws the GGX samples shared by every texel of a specular level.
+///
+/// The view direction is the normal, as in the split sum approximation, so
+/// the samples only differ between texels by the rotation to their normal.
+/// Each sample reads the radiance at the level whose texels cover its solid
+/// angle, which keeps a few hundred samples free of noise.
+///
+/// @param roughness Perceptual roughness, squared into the GGX alpha.
+/// @param count Number of samples drawn, those below the horizon being dropped.
+/// @param cube_size Size of the base level of the radiance mip chain.
+inline std::vector<GgxSample> ggx_samples(float roughness, int count, int cube_size)
+{
+    float alpha = roughness * roughness;
+    float alpha2 = alpha * alpha;
+    float texel_solid_angle = 4.0f * environment_pi / (6.0f * static_cast<float>(cube_size) * static_cast<float>(cube_size));
+    std::vector<GgxSample> samples {};
+    for (int i = 0; i < count; i++) {
+        float phi = 2.0f * environment_pi * (static_cast<float>(i) + 0.5f) / static_cast<float>(count);
+        float xi = radical_inverse(static_cast<std::uint32_t>(i));
+        float cos_theta = std::sqrt((1.0f - xi) / (1.0f + (alpha2 - 1.0f) * xi));
+        float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+        // The light is the view reflected about the half vector.
+        float n_dot_l = 2.0f * cos_theta * cos_theta - 1.0f;
+        if (n_dot_l <= 0.0f) {
+            continue;
+        }
+        Direction light { 2.0f * cos_theta * sin_theta * std::cos(phi), 2.0f * cos_theta * sin_theta * std::sin(phi),
+            n_dot_l };
+        // With the view along the normal, the density of the light is D / 4.
+        float denominator = cos_theta * cos_theta * (alpha2 - 1.0f) + 1.0f;
+        float pdf = alpha2 / (environment_pi * denominator * denominator) / 4.0f;
+        float sample_solid_angle = 1.0f / (static_cast<float>(count) * pdf);
+        float lod = 0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f;
+        samples.push_back({ light, n_dot_l, std::max(lod, 0.0f) });
+    }
+    return samples;
+}
+
+/// Computes a level of the specular cube map from the radiance mip chain.
+inline CubeMap prefilter_specular_level(
+    const std::vector<CubeMap>& chain, float roughness, int size, int sample_count, ThreadPool& pool)
+{
+    auto level = make_cube_map(size);
+    int cube_size = chain.front().size();
+    if (roughness <= 0.0f) {
+        // A mirror reflects the radiance, resampled to the level size.
+        float lod = std::max(std::log2(static_cast<float>(cube_size) / static_cast<float>(size)), 0.0f);
+        for_each_cube_row(size, 4, pool, [&](int face, int y) {
+            float* out = level.faces[static_cast<std::size_t>(face)].pixel(0, y);
+            for (int x = 0; x < size; x++) {
+                sample_cube_chain(chain, cube_texel_direction(face, x, y, size), lod, out + 3 * x);
+            }
+        });
+        return level;
+    }
+
+    auto samples = ggx_samples(roughness, sample_count, cube_size);
+    float total_weight = 0.0f;
+    for (const auto& sample : samples) {
+        total_weight += sample.weight;
+    }
+    for_each_cube_row(size, 1, pool, [&](int face, int y) {
+        float* out = level.faces[static_cast<std::size_t>(face)].pixel(0, y);
+        for (int x = 0; x < size; x++) {
+            auto normal = cube_texel_direction(face, x, y, size);
+            Direction up = std::abs(normal.z) < 0.999f ? Direction { 0.0f, 0.0f, 1.0f } : Direction { 1.0f, 0.0f, 0.0f };
+            auto tangent = normalize(cross(up, normal));
+            auto bitangent = cross(normal, tangent);
+            float sum[3] = {};
+            for (const auto& sample : samples) {
+                const auto& l = sample.light;
+                Direction light { tangent.x * l.x + bitangent.x * l.y + normal.x * l.z,
+                    tangent.y * l.x + bitangent.y * l.y + normal.y * l.z,
+                    tangent.z * l.x + bitangent.z * l.y + normal.z * l.z };
+                float rgb[3];
+                sample_cube_chain(chain, light, sample.lod, rgb);
+                for (int c = 0; c < 3; c++) {
+                    sum[c] += rgb[c] * sample.weight;
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                out[3 * x + c] = sum[c] / total_weight;
+            }
+        }
+    });
+    return level;
+}
+
+} // namespace detail
+
+/// Resamples an equirectangular environment map to a cube map.
+///
+/// Every texel averages a grid of bilinear samples, as many as needed to
+/// cover the pixels of the environment map falling into it.
+///
+/// @param equirect Environment map, RGB or grey in its first channel.
+/// @param size Size in texels of the faces.
+/// @param pool Pool processing the rows of the faces.
+inline CubeMap equirect_to_cube_map(ConstImageViewF equirect, int size, ThreadPool& pool = ThreadPool::global())
+{
+    if (size < 1 || equirect.width() < 1 || equirect.height() < 1) {
+        throw std::runtime_error { "Invalid cube map or environment map size." };
+    }
+    int taps = std::max((equirect.width() + 4 * size - 1) / (4 * size), 1);
+    float scale = 2.0f / static_cast<float>(size);
+    float tap_scale = 1.0f / static_cast<float>(taps);
+    float tap_weight = 1.0f / static_cast<float>(taps * taps);
+    auto cube = detail::make_cube_map(size);
+    detail::for_each_cube_row(size, 4, pool, [&](int face, int y) {
+        float* out = cube.faces[static_cast<std::size_t>(face)].pixel(0, y);
+        for (int x = 0; x < size; x++) {
+            float sum[3] = {};
+            for (int j = 0; j < taps; j++) {
+                float t = (static_cast<float>(y) + (static_cast<float>(j) + 0.5f) * tap_scale) * scale - 1.0f;
+                for (int i = 0; i < taps; i++) {
+                    float s = (static_cast<float>(x) + (static_cast<float>(i) + 0.5f) * tap_scale) * scale - 1.0f;
+                    float rgb[3];
+                    detail::sample_equirect(equirect, detail::normalize(detail::cube_face_direction(face, s, t)), rgb);
+                    for (int c = 0; c < 3; c++) {
+                        sum[c] += rgb[c];
+                    }
+                }
+            }
+            for (int c = 0; c < 3; c++) {
+                out[3 * x + c] = sum[c] * tap_weight;
+            }
+        }
+    });
+    return cube;
+}
+
+/// Projects the irradiance of an equirectangular environment map onto
+/// third order spherical harmonics.
+///
+/// Every pixel is weighted by its solid angle. Rows are summed in double
+/// precision on the pool and then in order, so the result does not depend
+/// on the number of threads.
+///
+/// @param equirect Environment map, RGB or grey in its first channel.
+/// @param pool Pool processing the rows.
+inline SphericalHarmonics irradiance_sh(ConstImageViewF equirect, ThreadPool& pool = ThreadPool::global())
+{
+    int width = equirect.width();
+    int height = equirect.height();
+    auto channels = static_cast<std::size_t>(equirect.channels());
+    std::vector<float> sin_phi(static_cast<std::size_t>(width));
+    std::vector<float> cos_phi(static_cast<std::size_t>(width));
+    for (int x = 0; x < width; x++) {
+        double phi = 2.0 * detail::environment_pi * ((x + 0.5) / width - 0.5);
+        sin_phi[static_cast<std::size_t>(x)] = static_cast<float>(std::sin(phi));
+        cos_phi[static_cast<std::size_t>(x)] = static_cast<float>(std::cos(phi));
+    }
+
+    std::vector<double> rows(static_cast<std::size_t>(height) * 27);
+    pool.parallel_for(static_cast<std::size_t>(height), 8, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            double theta = detail::environment_pi * (static_cast<double>(y) + 0.5) / height;
+            auto sin_theta = static_cast<float>(std::sin(theta));
+            auto cos_theta = static_cast<float>(std::cos(theta));
+            const float* in = equirect.row(static_cast<int>(y));
+            float sum[27] = {};
+            for (int x = 0; x < width; x++) {
+                float dx = sin_theta * sin_phi[static_cast<std::size_t>(x)];
+                float dy = cos_theta;
+                float dz = -sin_theta * cos_phi[static_cast<std::size_t>(x)];
+                const float basis[9] = { 0.282095f, 0.488603f * dy, 0.488603f * dz, 0.488603f * dx,
+                    1.092548f * dx * dy, 1.092548f * dy * dz, 0.315392f * (3.0f * dz * dz - 1.0f), 1.092548f * dx * dz,
+                    0.546274f * (dx * dx - dy * dy) };
+                const float* pixel = in + static_cast<std::size_t>(x) * channels;
+                for (std::size_t c = 0; c < 3; c++) {
+                    float value = pixel[channels >= 3 ? c : 0];
+                    for (std::size_t i = 0; i < 9; i++) {
+                        sum[i * 3 + c] += basis[i] * value;
+                    }
+                }
+            }
+            double solid_angle = (2.0 * detail::environment_pi / width) * (detail::environment_pi / height) * std::sin(theta);
+            for (std::size_t i = 0; i < 27; i++) {
+                rows[y * 27 + i] = sum[i] * solid_angle;
+            }
+        }
+    });
+
+    // Convolution with the clamped cosine lobe, per band.
+    const double lobe[3] = { detail::environment_pi, 2.0 * detail::environment_pi / 3.0, detail::environment_pi / 4.0 };
+    SphericalHarmonics sh {};
+    for (std::size_t i = 0; i < 9; i++) {
+        double band = lobe[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+        for (std::size_t c = 0; c < 3; c++) {
+            double sum = 0.0;
+            for (std::size_t y = 0; y < static_cast<std::size_t>(height); y++) {
+                sum += rows[y * 27 + i * 3 + c];
+            }
+            sh.coefficients[i][c] = static_cast<float>(sum * band);
+        }
+    }
+    return sh;
+}
+
+/// Prefilters a radiance cube map with the GGX distribution, by importance
+/// sampling, for the split sum approximation of specular lighting.
+///
+/// @param radiance Radiance cube map.
+/// @param options Size and number of levels, and number of samples per texel.
+/// @param pool Pool processing the rows of the faces.
+/// @return One cube map per roughness level, each half the size of the previous one.
+inline std::vector<CubeMap> prefilter_specular(
+    const CubeMap& radiance, const EnvironmentOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    if (options.specular_size < 1 || options.specular_levels < 1 || options.sample_count < 1
+        || options.specular_levels > mip_level_count(options.specular_size, options.specular_size)) {
+        throw std::runtime_error { "Invalid specular level options." };
+    }
+    auto chain = detail::cube_mip_chain(radiance, pool);
+    std::vector<CubeMap> levels {};
+    for (int i = 0; i < options.specular_levels; i++) {
+        float roughness = options.specular_levels > 1 ? static_cast<float>(i) / static_cast<float>(options.specular_levels - 1) : 0.0f;
+        levels.push_back(detail::prefilter_specular_level(
+            chain, roughness, mip_level_size(options.specular_size, i), options.sample_count, pool));
+    }
+    return levels;
+}
+
+/// Precomputes the image based lighting of an equirectangular environment map.
+///
+/// @param equirect HDR environment map, RGB or grey in its first channel.
+/// @param options Sizes and sampling of the results.
+/// @param pool Pool processing the faces, by rows.
+inline EnvironmentLighting bake_environment(
+    ConstImageViewF equirect, const EnvironmentOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    EnvironmentLighting lighting {};
+    lighting.radiance = equirect_to_cube_map(equirect, options.cube_size, pool);
+    lighting.irradiance = irradiance_sh(equirect, pool);
+    lighting.specular = prefilter_specular(lighting.radiance, options, pool);
+    return lighting;
+}
+
+// Environment lighting file.
+//
+// A little endian file made of an `EnvironmentFileHeader`, the 27 floats of
+// the irradiance and the tightly packed RGB float faces of the radiance cube
+// map and of every specular level.
+
+inline constexpr char environment_file_magic[4] = { 'C', 'G', 'I', 'B' };
+inline constexpr std::uint32_t environment_file_version = 1;
+
+/// Header at the start of an environment lighting file.
+struct EnvironmentFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t cube_size;
+    std::uint32_t specular_size;
+    std::uint32_t specular_levels;
+    std::uint32_t sample_count;
+    std::uint32_t reserved[2];
+};
+
+static_assert(sizeof(EnvironmentFileHeader) == 32, "Unexpected padding in the environment file header.");
+
+/// Returns the path of the cached lighting of an environment map, next to it.
+inline std::filesystem::path environment_cache_path(const std::filesystem::path& source)
+{
+    auto path = source;
+    path += ".ibl";
+    return path;
+}
+
+/// Writes precomputed lighting to a file.
+///
+/// @param file_name Absolute path of the written file.
+/// @param lighting Lighting baked with `options`.
+/// @param options Options the lighting was baked with.
+inline void write_environment_file(
+    const std::filesystem::path& file_name, const EnvironmentLighting& lighting, const EnvironmentOptions& options)
+{
+    EnvironmentFileHeader header {};
+    std::memcpy(header.magic, environment_file_magic, sizeof(environment_file_magic));
+    header.version = environment_file_version;
+    header.cube_size = static_cast<std::uint32_t>(lighting.radiance.size());
+    header.specular_size = static_cast<std::uint32_t>(lighting.specular.empty() ? 0 : lighting.specular.front().size());
+    header.specular_levels = static_cast<std::uint32_t>(lighting.specular.size());
+    header.sample_count = static_cast<std::uint32_t>(options.sample_count);
+
+    // Written next to the destination and renamed, so readers never see a partial file.
+    auto temporary = file_name;
+    temporary += ".tmp";
+    try {
+        std::ofstream file { temporary, std::ios::binary | std::ios::trunc };
+        if (!file) {
+            throw std::runtime_error { "Could not create environment file: " + file_name.string() };
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(lighting.irradiance.coefficients.data()),
+            sizeof(lighting.irradiance.coefficients));
+        auto write_cube = [&](const CubeMap& cube) {
+            for (const auto& face : cube.faces) {
+                for (int y = 0; y < face.height(); y++) {
+                    file.write(reinterpret_cast<const char*>(face.pixel(0, y)),
+                        static_cast<std::streamsize>(static_cast<std::size_t>(face.width()) * 3 * sizeof(float)));
+                }
+            }
+        };
+        write_cube(lighting.radiance);
+        for (const auto& level : lighting.specular) {
+            write_cube(level);
+        }
+        file.close();
+        if (!file) {
+            throw std::runtime_error { "Could not write environment file: " + file_name.string() };
+        }
+        std::filesystem::rename(temporary, file_name);
+    } catch (...) {
+        std::error_code error {};
+        std::filesystem::remove(temporary, error);
+        throw;
+    }
+}
+
+/// Reads precomputed lighting from a file.
+///
+/// @param file_name Absolute path to the file.
+/// @param options Options the lighting must have been baked with.
+/// @return The lighting, or nothing if it was baked with other options.
+inline std::optional<EnvironmentLighting> read_environment_file(
+    const std::filesystem::path& file_name, const EnvironmentOptions& options)
+{
+    MappedFile file { file_name };
+    EnvironmentFileHeader header {};
+    if (file.size() < sizeof(header)) {
+        throw std::runtime_error { "Truncated header. Environment file: " + file_name.string() };
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, environment_file_magic, sizeof(environment_file_magic)) != 0
+        || header.version != environment_file_version) {
+        throw std::runtime_error { "Not a supported environment file: " + file_name.string() };
+    }
+    if (header.cube_size != static_cast<std::uint32_t>(options.cube_size)
+        || header.specular_size != static_cast<std::uint32_t>(options.specular_size)
+        || header.specular_levels != static_cast<std::uint32_t>(options.specular_levels)
+        || header.sample_count != static_cast<std::uint32_t>(options.sample_count)) {
+        return std::nullopt;
+    }
+
+    std::size_t texels = 6 * static_cast<std::size_t>(options.cube_size) * static_cast<std::size_t>(options.cube_size);
+    for (int i = 0; i < options.specular_levels; i++) {
+        auto size = static_cast<std::size_t>(mip_level_size(options.specular_size, i));
+        texels += 6 * size * size;
+    }
+    EnvironmentLighting lighting {};
+    if (file.size() != sizeof(header) + sizeof(lighting.irradiance.coefficients) + texels * 3 * sizeof(float)) {
+        throw std::runtime_error { "Truncated environment file: " + file_name.string() };
+    }
+
+    const unsigned char* position = file.data() + sizeof(header);
+    std::memcpy(lighting.irradiance.coefficients.data(), position, sizeof(lighting.irradiance.coefficients));
+    position += sizeof(lighting.irradiance.coefficients);
+    auto read_cube = [&](int size) {
+        auto cube = detail::make_cube_map(size);
+        auto row_size = static_cast<std::size_t>(size) * 3 * sizeof(float);
+        for (auto& face : cube.faces) {
+            for (int y = 0; y < size; y++) {
+                std::memcpy(face.pixel(0, y), position, row_size);
+                position += row_size;
+            }
+        }
+        return cube;
+    };
+    lighting.radiance = read_cube(options.cube_size);
+    for (int i = 0; i < options.specular_levels; i++) {
+        lighting.specular.push_back(read_cube(mip_level_size(options.specular_size, i)));
+    }
+    return lighting;
+}
+
+/// Loads the lighting of an environment map, baking it unless the file
+/// cached next to the environment map is newer and has the same options.
+///
+/// A cache that cannot be written, e.g. in a read-only directory, only
+/// costs baking again the next time.
+///
+/// @param source Absolute path to the HDR environment map.
+/// @param options Sizes and sampling of the results.
+/// @param pool Pool processing the faces, by rows.
+inline EnvironmentLighting load_environment(
+    const std::filesystem::path& source, const EnvironmentOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    auto cache = environment_cache_path(source);
+    std::error_code error {};
+    auto cached_time = std::filesystem::last_write_time(cache, error);
+    if (!error && cached_time >= std::filesystem::last_write_time(source)) {
+        try {
+            if (auto lighting = read_environment_file(cache, options)) {
+                return std::move(*lighting);
+            }
+        } catch (const std::exception&) {
+            // A corrupt cache is baked again.
+        }
+    }
+
+    auto lighting = bake_environment(ImageF { source, ImageLoadMode::MemoryMapped }, options, pool);
+    try {
+        write_environment_file(cache, lighting, options);
+    } catch (const std::exception&) {
+        // The lighting is still valid without its cache.
+    }
+    return lighting;
+}
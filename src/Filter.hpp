@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/// Reconstruction filters used when resampling images.
+enum class Filter {
+    /// Average of the covered pixels. Fast, but aliases.
+    Box,
+    /// Linear interpolation (tent).
+    Triangle,
+    /// Sinc windowed by a Kaiser window, good default for mipmaps.
+    Kaiser,
+    /// Sinc windowed by a three lobe sinc, sharpest of the filters.
+    Lanczos3,
+};
+
+/// Returns the radius of a filter in units of destination pixels.
+inline double filter_support(Filter filter) noexcept
+{
+    switch (filter) {
+    case Filter::Box:
+        return 0.5;
+    case Filter::Triangle:
+        return 1.0;
+    case Filter::Kaiser:
+        return 3.0;
+    case Filter::Lanczos3:
+        return 3.0;
+    }
+    return 0.5;
+}
+
+/// Evaluates a filter at a distance from its center.
+///
+/// @param filter Evaluated filter.
+/// @param x Distance in units of destination pixels.
+inline double filter_evaluate(Filter filter, double x) noexcept
+{
+    constexpr double pi = 3.14159265358979323846;
+
+    auto sinc = [&](double v) {
+        if (std::abs(v) < 1e-8) {
+            return 1.0;
+        }
+        return std::sin(pi * v) / (pi * v);
+    };
+    // Modified Bessel function of the first kind of order zero.
+    auto bessel_i0 = [](double v) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; k++) {
+            double factor = v / (2.0 * k);
+            term *= factor * factor;
+            sum += term;
+            if (term < sum * 1e-12) {
+                break;
+            }
+        }
+        return sum;
+    };
+
+    x = std::abs(x);
+    switch (filter) {
+    case Filter::Box:
+        return x <= 0.5 ? 1.0 : 0.0;
+    case Filter::Triangle:
+        return x < 1.0 ? 1.0 - x : 0.0;
+    case Filter::Kaiser: {
+        constexpr double width = 3.0;
+        constexpr double alpha = 4.0;
+        if (x >= width) {
+            return 0.0;
+        }
+        double t = x / width;
+        return sinc(x) * bessel_i0(alpha * std::sqrt(1.0 - t * t)) / bessel_i0(alpha);
+    }
+    case Filter::Lanczos3:
+        return x < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+/// Precomputed weights of a one-dimensional resampling pass.
+///
+/// Every destination pixel `i` is the weighted sum of the source pixels
+/// `first[i] .. first[i] + taps - 1`, with the weights stored at
+/// `weights[i * taps]`. Source indices are clamped to the edge, so `first`
+/// is always in range and the last taps of a pixel may have zero weight.
+struct FilterWeights {
+    int taps { 0 };
+    std::vector<int> first;
+    std::vector<float> weights;
+
+    /// Computes the weights of resampling `src_size` pixels to `dst_size` pixels.
+    ///
+    /// When minifying, the filter is stretched by the scale factor to avoid aliasing.
+    ///
+    /// @param filter Reconstruction filter.
+    /// @param src_size Number of source pixels.
+    /// @param dst_size Number of destination pixels.
+    FilterWeights(Filter filter, int src_size, int dst_size)
+    {
+        double scale = static_cast<double>(src_size) / dst_size;
+        double stretch = std::max(scale, 1.0);
+        double support = filter_support(filter) * stretch;
+        this->taps = std::min(static_cast<int>(std::ceil(support * 2.0)) + 1, src_size);
+        this->first.resize(static_cast<std::size_t>(dst_size));
+        this->weights.assign(static_cast<std::size_t>(dst_size) * static_cast<std::size_t>(this->taps), 0.0f);
+
+        std::vector<double> raw(static_cast<std::size_t>(this->taps));
+        for (int i = 0; i < dst_size; i++) {
+            double center = (i + 0.5) * scale;
+            int begin = static_cast<int>(std::ceil(center - support - 0.5));
+            int end = static_cast<int>(std::floor(center + support - 0.5));
+            int first = std::clamp(begin, 0, src_size - this->taps);
+
+            std::fill(raw.begin(), raw.end(), 0.0);
+            double sum = 0.0;
+            for (int j = begin; j <= end; j++) {
+                double weight = filter_evaluate(filter, (j + 0.5 - center) / stretch);
+                if (weight == 0.0) {
+                    continue;
+                }
+                int tap = std::clamp(j, 0, src_size - 1) - first;
+                if (tap < 0 || tap >= this->taps) {
+                    continue;
+                }
+                raw[static_cast<std::size_t>(tap)] += weight;
+                sum += weight;
+            }
+            if (sum == 0.0) {
+                // The filter fell between two samples, use the nearest one.
+                int nearest = std::clamp(static_cast<int>(center) - first, 0, this->taps - 1);
+                raw[static_cast<std::size_t>(nearest)] = 1.0;
+                sum = 1.0;
+            }
+
+            this->first[static_cast<std::size_t>(i)] = first;
+            auto* out = &this->weights[static_cast<std::size_t>(i) * static_cast<std::size_t>(this->taps)];
+            for (int t = 0; t < this->taps; t++) {
+                out[t] = static_cast<float>(raw[static_cast<std::size_t>(t)] / sum);
+            }
+        }
+    }
+};
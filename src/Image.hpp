@@ -1,81 +1,305 @@
 #pragma once
 #include <stb_image.h>
 
-#include <cstring>
+#include <algorithm>
+#include <climits>
+#include <cstddef>
 #include <filesystem>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
+#include "MappedFile.hpp"
 #include "Resources.hpp"
 
+/// Function releasing the pixel buffer owned by an image.
+using ImageDeleter = void (*)(void*);
+
+/// How the contents of an image file are read before decoding.
+enum class ImageLoadMode {
+    /// Read through buffered stdio.
+    Stdio,
+    /// Map the file into memory and decode straight from the mapping.
+    MemoryMapped,
+};
+
+/// Channel count of images whose number of channels is only known at runtime.
+inline constexpr int DynamicChannels = 0;
+
+/// Alignment in bytes of the pixels allocated by images, one cache line.
+inline constexpr std::size_t ImageAlignment = 64;
+
+/// How the rows of a newly allocated image are laid out.
+struct ImageAllocation {
+    /// Alignment in bytes of the start of every row, a power of two.
+    /// Rows are padded to a multiple of it, which lets vector kernels use
+    /// aligned loads on every row. `0` packs the rows tightly.
+    std::size_t row_alignment { 0 };
+
+    /// Rows starting on a cache line.
+    static constexpr ImageAllocation cache_aligned() noexcept
+    {
+        return { ImageAlignment };
+    }
+};
+
+/// Properties of an image file, read from its header.
+struct ImageInfo {
+    /// Width in pixel.
+    int width;
+    /// Height in pixel.
+    int height;
+    /// Number of channels stored in the file.
+    int channels;
+    /// Bits per channel stored in the file: 8, 16, or 32 for floating point HDR files.
+    int bit_depth;
+    /// Whether the file holds high dynamic range pixels.
+    bool hdr;
+};
+
+namespace detail {
+
+/// Reads bytes of memory through stb_image callbacks.
+///
+/// Unlike the `_from_memory` functions, whose length is an `int`, buffers
+/// of any size can be read. stb_image only pulls the bytes it needs.
+struct MemoryReader {
+    const unsigned char* data;
+    std::size_t size;
+    std::size_t position;
+
+    static int read(void* user, char* data, int size)
+    {
+        auto* reader = static_cast<MemoryReader*>(user);
+        auto count = std::min(static_cast<std::size_t>(size), reader->size - reader->position);
+        std::copy_n(reader->data + reader->position, count, reinterpret_cast<unsigned char*>(data));
+        reader->position += count;
+        return static_cast<int>(count);
+    }
+
+    static void skip(void* user, int count)
+    {
+        auto* reader = static_cast<MemoryReader*>(user);
+        if (count < 0) {
+            auto back = static_cast<std::size_t>(-static_cast<long long>(count));
+            reader->position -= std::min(back, reader->position);
+        } else {
+            reader->position += std::min(static_cast<std::size_t>(count), reader->size - reader->position);
+        }
+    }
+
+    static int eof(void* user)
+    {
+        auto* reader = static_cast<MemoryReader*>(user);
+        return reader->position >= reader->size ? 1 : 0;
+    }
+
+    static constexpr stbi_io_callbacks callbacks { read, skip, eof };
+};
+
+} // namespace detail
+
 /// Wrapper over an image in memory.
-class Image {
+///
+/// Pixels are stored row by row with interleaved channels, with rows
+/// `stride()` elements apart. The channel type is one of `unsigned char`,
+/// `unsigned short` or `float`, matching the formats stb_image decodes to.
+/// If `Channels` is fixed at compile time, files are converted to that
+/// number of channels while loading.
+///
+/// @tparam T Type of a single channel.
+/// @tparam Channels Number of channels, or `DynamicChannels`.
+template <typename T, int Channels = DynamicChannels>
+class BasicImage {
+    static_assert(std::is_same_v<T, unsigned char> || std::is_same_v<T, unsigned short> || std::is_same_v<T, float>,
+        "The channel type must be one of unsigned char, unsigned short or float.");
+    static_assert(Channels >= 0 && Channels <= 4, "The image must have between 1 and 4 channels.");
+
 public:
+    using value_type = T;
+
+    /// Number of channels, or `DynamicChannels` if only known at runtime.
+    static constexpr int static_channels = Channels;
+
     /// Creates a new empty image.
     ///
+    /// The pixels are aligned to `ImageAlignment` bytes.
+    ///
     /// @param width Width in pixel.
     /// @param height Height in pixel.
     /// @param channels Number of channels.
-    Image(int width, int height, int channels)
-        : m_data { nullptr }
+    /// @param allocation Layout of the rows.
+    BasicImage(int width, int height, int channels, ImageAllocation allocation = {})
+        : m_data { nullptr, delete_aligned }
         , m_width { width }
         , m_height { height }
         , m_channels { channels }
+        , m_stride { 0 }
     {
-        if (width <= 0) {
-            throw std::runtime_error { "Invalid image width." };
-        }
-        if (height <= 0) {
-            throw std::runtime_error { "Invalid image height." };
+        validate_dimensions(width, height, channels);
+        auto alignment = allocation.row_alignment;
+        if (alignment > ImageAlignment || (alignment & (alignment - 1)) != 0) {
+            throw std::runtime_error { "Invalid image row alignment." };
         }
-        if (channels < 1 || channels > 4) {
-            throw std::runtime_error { "The image must have between 1 and 4 channels." };
+
+        std::size_t row_bytes = static_cast<std::size_t>(width) * static_cast<std::size_t>(channels) * sizeof(T);
+        if (alignment > 1) {
+            row_bytes = (row_bytes + alignment - 1) & ~(alignment - 1);
         }
+        this->m_stride = row_bytes / sizeof(T);
+        auto elements = this->m_stride * static_cast<std::size_t>(height);
+        auto* data = static_cast<T*>(::operator new[](elements * sizeof(T), std::align_val_t { ImageAlignment }));
+        std::fill_n(data, elements, T {});
+        this->m_data.reset(data);
+    }
 
-        std::size_t width_sz = static_cast<std::size_t>(width);
-        std::size_t height_sz = static_cast<std::size_t>(height);
-        std::size_t channels_sz = static_cast<std::size_t>(channels);
-        auto elements = width_sz * height_sz * channels_sz;
-        this->m_data = std::make_unique<unsigned char[]>(elements);
+    /// Creates a new empty image with a compile-time number of channels.
+    ///
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    /// @param allocation Layout of the rows.
+    template <int C = Channels, std::enable_if_t<C != DynamicChannels, int> = 0>
+    BasicImage(int width, int height, ImageAllocation allocation = {})
+        : BasicImage { width, height, Channels, allocation }
+    {
     }
 
-    /// Loads an image from the resource directory.
+    /// Takes ownership of an existing pixel buffer.
     ///
-    /// @param file_name Absolute path to the image file.
-    Image(std::filesystem::path file_name)
+    /// The buffer is released with `deleter` once the image is destroyed,
+    /// or immediately if the dimensions are invalid.
+    ///
+    /// @param data Pixel buffer of `stride * height` elements.
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    /// @param channels Number of channels.
+    /// @param deleter Function releasing `data`.
+    /// @param stride Number of elements between the starts of two rows,
+    /// or `0` for tightly packed rows.
+    BasicImage(T* data, int width, int height, int channels, ImageDeleter deleter, std::size_t stride = 0)
+        : m_data { data, deleter }
+        , m_width { width }
+        , m_height { height }
+        , m_channels { channels }
+        , m_stride { stride }
     {
-        auto file_path_str = file_name.string();
-        auto data = stbi_load(file_path_str.c_str(), &this->m_width, &this->m_height, &this->m_channels, 0);
         if (data == nullptr) {
-            throw std::runtime_error { "Could not load image at path: " + file_path_str };
+            throw std::runtime_error { "Invalid image data." };
+        }
+        validate_dimensions(width, height, channels);
+        auto row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(channels);
+        if (stride == 0) {
+            this->m_stride = row_size;
+        } else if (stride < row_size) {
+            throw std::runtime_error { "Invalid image stride." };
         }
+    }
 
-        try {
-            std::size_t width = static_cast<std::size_t>(this->m_width);
-            std::size_t height = static_cast<std::size_t>(this->m_height);
-            std::size_t channels = static_cast<std::size_t>(this->m_channels);
-            auto elements = width * height * channels;
+    /// Loads an image from the resource directory.
+    ///
+    /// The pixels decoded by stb_image are adopted without copying.
+    /// 8-bit files loaded into 16-bit or float images are rescaled. stb_image
+    /// linearizes 8 and 16-bit files loaded into float images with a plain
+    /// 2.2 gamma (`stbi_ldr_to_hdr_gamma()`), not the sRGB transfer function.
+    ///
+    /// @param file_name Absolute path to the image file.
+    /// @param mode How the file is read.
+    BasicImage(std::filesystem::path file_name, ImageLoadMode mode = ImageLoadMode::Stdio)
+        : BasicImage { decode(file_name, mode) }
+    {
+    }
 
-            this->m_data = std::make_unique<unsigned char[]>(elements);
-            std::memcpy(this->m_data.get(), data, elements);
-            stbi_image_free(data);
-        } catch (std::exception& e) {
-            stbi_image_free(data);
+    /// Adopts the pixels of an image whose channel count is only known at runtime.
+    ///
+    /// @param other Image with exactly `Channels` channels. Left empty.
+    template <int C = Channels, std::enable_if_t<C != DynamicChannels, int> = 0>
+    explicit BasicImage(BasicImage<T, DynamicChannels>&& other)
+        : m_data { adopt(other) }
+        , m_width { other.m_width }
+        , m_height { other.m_height }
+        , m_channels { other.m_channels }
+        , m_stride { other.m_stride }
+    {
+    }
+
+    /// Adopts the pixels of an image with a compile-time number of channels.
+    ///
+    /// @param other Image to adopt. Left empty.
+    template <int C, int D = Channels, std::enable_if_t<D == DynamicChannels && C != DynamicChannels, int> = 0>
+    BasicImage(BasicImage<T, C>&& other)
+        : m_data { std::move(other.m_data) }
+        , m_width { other.m_width }
+        , m_height { other.m_height }
+        , m_channels { other.m_channels }
+        , m_stride { other.m_stride }
+    {
+    }
+
+    /// Reads the properties of an image file without decoding its pixels.
+    ///
+    /// Only the header of the file is read, which is much faster than
+    /// loading the image when only its dimensions are needed. Files of any
+    /// size can be probed, including those too large to be decoded.
+    ///
+    /// @param file_name Absolute path to the image file.
+    static ImageInfo probe(const std::filesystem::path& file_name)
+    {
+        MappedFile file { file_name };
+        if (file.size() == 0) {
+            throw std::runtime_error { "Could not read image information at path: " + file_name.string() };
         }
+        const auto* callbacks = &detail::MemoryReader::callbacks;
+        ImageInfo info {};
+        detail::MemoryReader reader { file.data(), file.size(), 0 };
+        if (stbi_info_from_callbacks(callbacks, &reader, &info.width, &info.height, &info.channels) == 0) {
+            throw std::runtime_error { "Could not read image information at path: " + file_name.string() };
+        }
+        reader = { file.data(), file.size(), 0 };
+        info.hdr = stbi_is_hdr_from_callbacks(callbacks, &reader) != 0;
+        if (info.hdr) {
+            info.bit_depth = 32;
+        } else {
+            reader = { file.data(), file.size(), 0 };
+            info.bit_depth = stbi_is_16_bit_from_callbacks(callbacks, &reader) != 0 ? 16 : 8;
+        }
+        return info;
     }
 
     /// Returns the data of the image.
-    unsigned char* data() noexcept
+    T* data() noexcept
     {
         return this->m_data.get();
     }
 
     /// Returns the data of the image.
-    const unsigned char* data() const noexcept
+    const T* data() const noexcept
     {
         return this->m_data.get();
     }
 
+    /// Returns the first channel of a pixel.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    T* pixel(int x, int y) noexcept
+    {
+        return this->data() + this->offset(x, y);
+    }
+
+    /// Returns the first channel of a pixel.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    const T* pixel(int x, int y) const noexcept
+    {
+        return this->data() + this->offset(x, y);
+    }
+
     /// Returns the width of the image.
     int width() const noexcept
     {
@@ -91,12 +315,293 @@ public:
     /// Returns the number of channels contained in the image.
     int channels() const noexcept
     {
-        return this->m_channels;
+        if constexpr (Channels != DynamicChannels) {
+            return Channels;
+        } else {
+            return this->m_channels;
+        }
+    }
+
+    /// Returns the number of elements between the starts of two rows.
+    std::size_t stride() const noexcept
+    {
+        return this->m_stride;
+    }
+
+    /// Returns whether the rows follow each other without padding.
+    bool contiguous() const noexcept
+    {
+        return this->m_stride == static_cast<std::size_t>(this->m_width) * static_cast<std::size_t>(this->channels());
+    }
+
+    /// Returns the number of elements of the pixel buffer, including the padding of the rows.
+    std::size_t size() const noexcept
+    {
+        return this->m_stride * static_cast<std::size_t>(this->m_height);
     }
 
 private:
-    std::unique_ptr<unsigned char[]> m_data;
+    template <typename, int>
+    friend class BasicImage;
+
+    /// Pixels decoded by stb_image, before being adopted by an image.
+    struct Decoded {
+        T* data;
+        int width;
+        int height;
+        int channels;
+    };
+
+    BasicImage(Decoded decoded)
+        : BasicImage { decoded.data, decoded.width, decoded.height, decoded.channels, stbi_image_free }
+    {
+    }
+
+    static Decoded decode(const std::filesystem::path& file_name, ImageLoadMode mode)
+    {
+        auto file_path_str = file_name.string();
+        Decoded decoded {};
+        switch (mode) {
+        case ImageLoadMode::Stdio:
+            decoded.data = load_file(file_path_str.c_str(), &decoded.width, &decoded.height, &decoded.channels);
+            break;
+        case ImageLoadMode::MemoryMapped: {
+            MappedFile file { file_name };
+            if (file.size() > static_cast<std::size_t>(INT_MAX)) {
+                throw std::runtime_error { "Image file is too large to be decoded: " + file_path_str };
+            }
+            decoded.data = load_memory(file.data(), static_cast<int>(file.size()),
+                &decoded.width, &decoded.height, &decoded.channels);
+            break;
+        }
+        }
+        if (decoded.data == nullptr) {
+            throw std::runtime_error { "Could not load image at path: " + file_path_str };
+        }
+        if constexpr (Channels != DynamicChannels) {
+            // stb_image reports the channels of the file, not of the converted pixels.
+            decoded.channels = Channels;
+        }
+        return decoded;
+    }
+
+    /// Takes the pixels of a dynamic image, if its channel count matches.
+    static std::unique_ptr<T[], ImageDeleter> adopt(BasicImage<T, DynamicChannels>& other)
+    {
+        validate_dimensions(other.m_width, other.m_height, other.m_channels);
+        return std::move(other.m_data);
+    }
+
+    static T* load_file(const char* file_name, int* width, int* height, int* channels)
+    {
+        if constexpr (std::is_same_v<T, unsigned char>) {
+            return stbi_load(file_name, width, height, channels, Channels);
+        } else if constexpr (std::is_same_v<T, unsigned short>) {
+            return stbi_load_16(file_name, width, height, channels, Channels);
+        } else {
+            return stbi_loadf(file_name, width, height, channels, Channels);
+        }
+    }
+
+    static T* load_memory(const unsigned char* buffer, int length, int* width, int* height, int* channels)
+    {
+        if constexpr (std::is_same_v<T, unsigned char>) {
+            return stbi_load_from_memory(buffer, length, width, height, channels, Channels);
+        } else if constexpr (std::is_same_v<T, unsigned short>) {
+            return stbi_load_16_from_memory(buffer, length, width, height, channels, Channels);
+        } else {
+            return stbi_loadf_from_memory(buffer, length, width, height, channels, Channels);
+        }
+    }
+
+    static void validate_dimensions(int width, int height, int channels)
+    {
+        if (width <= 0) {
+            throw std::runtime_error { "Invalid image width." };
+        }
+        if (height <= 0) {
+            throw std::runtime_error { "Invalid image height." };
+        }
+        if (channels < 1 || channels > 4) {
+            throw std::runtime_error { "The image must have between 1 and 4 channels." };
+        }
+        if (Channels != DynamicChannels && channels != Channels) {
+            throw std::runtime_error { "The number of channels does not match the image type." };
+        }
+    }
+
+    static void delete_aligned(void* data)
+    {
+        ::operator delete[](data, std::align_val_t { ImageAlignment });
+    }
+
+    std::size_t offset(int x, int y) const noexcept
+    {
+        return static_cast<std::size_t>(y) * this->m_stride
+            + static_cast<std::size_t>(x) * static_cast<std::size_t>(this->channels());
+    }
+
+    std::unique_ptr<T[], ImageDeleter> m_data;
     int m_width;
     int m_height;
     int m_channels;
+    std::size_t m_stride;
+};
+
+/// Returns whether a file holds high dynamic range pixels, e.g. a Radiance
+/// `.hdr` file, which keeps its full range when loaded into a float image.
+///
+/// @param file_name Absolute path to the image file.
+inline bool is_hdr_file(const std::filesystem::path& file_name)
+{
+    return stbi_is_hdr(file_name.string().c_str()) != 0;
+}
+
+/// Handle to an image file, decoded the first time its pixels are accessed.
+///
+/// The header of the file is read on construction, so the dimensions are
+/// known without decoding. The pixels may be requested from several threads
+/// at once, the file is decoded a single time.
+///
+/// @tparam T Type of a single channel.
+/// @tparam Channels Number of channels, or `DynamicChannels`.
+template <typename T, int Channels = DynamicChannels>
+class BasicLazyImage {
+public:
+    using value_type = T;
+
+    /// Number of channels, or `DynamicChannels` if only known at runtime.
+    static constexpr int static_channels = Channels;
+
+    /// Reads the header of an image file.
+    ///
+    /// @param file_name Absolute path to the image file.
+    /// @param mode How the file is read once decoded.
+    BasicLazyImage(std::filesystem::path file_name, ImageLoadMode mode = ImageLoadMode::Stdio)
+        : m_file_name { std::move(file_name) }
+        , m_info { BasicImage<T, Channels>::probe(m_file_name) }
+        , m_mode { mode }
+        , m_state { std::make_unique<State>() }
+    {
+    }
+
+    /// Returns the path of the image file.
+    const std::filesystem::path& path() const noexcept
+    {
+        return this->m_file_name;
+    }
+
+    /// Returns the properties of the image file.
+    const ImageInfo& info() const noexcept
+    {
+        return this->m_info;
+    }
+
+    /// Returns the width of the image.
+    int width() const noexcept
+    {
+        return this->m_info.width;
+    }
+
+    /// Returns the height of the image.
+    int height() const noexcept
+    {
+        return this->m_info.height;
+    }
+
+    /// Returns the number of channels of the decoded image.
+    int channels() const noexcept
+    {
+        if constexpr (Channels != DynamicChannels) {
+            return Channels;
+        } else {
+            return this->m_info.channels;
+        }
+    }
+
+    /// Returns whether the pixels have already been decoded.
+    bool decoded() const noexcept
+    {
+        return this->m_state->image.load(std::memory_order_acquire) != nullptr;
+    }
+
+    /// Returns the decoded image, decoding the file on the first call.
+    BasicImage<T, Channels>& image()
+    {
+        return *this->decode();
+    }
+
+    /// Returns the decoded image, decoding the file on the first call.
+    const BasicImage<T, Channels>& image() const
+    {
+        return *this->decode();
+    }
+
+    /// Returns the data of the image, decoding the file on the first call.
+    T* data()
+    {
+        return this->decode()->data();
+    }
+
+    /// Returns the data of the image, decoding the file on the first call.
+    const T* data() const
+    {
+        return this->decode()->data();
+    }
+
+private:
+    /// Decoded image, kept apart for the handle to stay movable.
+    struct State {
+        std::mutex mutex {};
+        std::optional<BasicImage<T, Channels>> storage {};
+        std::atomic<BasicImage<T, Channels>*> image { nullptr };
+    };
+
+    BasicImage<T, Channels>* decode() const
+    {
+        auto* image = this->m_state->image.load(std::memory_order_acquire);
+        if (image == nullptr) {
+            std::lock_guard<std::mutex> lock { this->m_state->mutex };
+            image = this->m_state->image.load(std::memory_order_relaxed);
+            if (image == nullptr) {
+                image = &this->m_state->storage.emplace(this->m_file_name, this->m_mode);
+                this->m_state->image.store(image, std::memory_order_release);
+            }
+        }
+        return image;
+    }
+
+    std::filesystem::path m_file_name;
+    ImageInfo m_info;
+    ImageLoadMode m_mode;
+    std::unique_ptr<State> m_state;
 };
+
+/// 8-bit image with a runtime number of channels.
+using Image = BasicImage<unsigned char>;
+/// 16-bit image with a runtime number of channels.
+using Image16 = BasicImage<unsigned short>;
+/// Floating point image with a runtime number of channels.
+using ImageF = BasicImage<float>;
+
+using ImageR8 = BasicImage<unsigned char, 1>;
+using ImageRG8 = BasicImage<unsigned char, 2>;
+using ImageRGB8 = BasicImage<unsigned char, 3>;
+using ImageRGBA8 = BasicImage<unsigned char, 4>;
+
+using ImageR16 = BasicImage<unsigned short, 1>;
+using ImageRG16 = BasicImage<unsigned short, 2>;
+using ImageRGB16 = BasicImage<unsigned short, 3>;
+using ImageRGBA16 = BasicImage<unsigned short, 4>;
+
+using ImageR32F = BasicImage<float, 1>;
+using ImageRG32F = BasicImage<float, 2>;
+using ImageRGB32F = BasicImage<float, 3>;
+using ImageRGBA32F = BasicImage<float, 4>;
+
+/// Lazily decoded 8-bit image with a runtime number of channels.
+using LazyImage = BasicLazyImage<unsigned char>;
+/// Lazily decoded 16-bit image with a runtime number of channels.
+using LazyImage16 = BasicLazyImage<unsigned short>;
+/// Lazily decoded floating point image with a runtime number of channels.
+using LazyImageF = BasicLazyImage<float>;
@@ -0,0 +1,822 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+
+// Pixel format conversion kernels.
+//
+// The kernels work on tightly packed pixel spans and select the widest
+// instruction set supported by the CPU at runtime. The `Image` overloads
+// allocate the converted image and run the matching kernel over it.
+
+namespace detail {
+
+/// Lookup tables for the sRGB transfer function.
+struct SrgbTables {
+    /// Number of intervals of the linear to sRGB table.
+    static constexpr int linear_steps = 4096;
+
+    std::array<float, 256> to_linear;
+    std::array<std::uint8_t, linear_steps + 1> to_srgb;
+
+    SrgbTables()
+    {
+        for (int i = 0; i < 256; i++) {
+            double srgb = i / 255.0;
+            double linear = srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+            this->to_linear[i] = static_cast<float>(linear);
+        }
+        for (int i = 0; i <= linear_steps; i++) {
+            double linear = i / static_cast<double>(linear_steps);
+            double srgb = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            this->to_srgb[i] = static_cast<std::uint8_t>(std::lround(srgb * 255.0));
+        }
+    }
+
+    static const SrgbTables& get()
+    {
+        static const SrgbTables tables {};
+        return tables;
+    }
+};
+
+inline std::uint8_t unorm8_from_float(float value) noexcept
+{
+    // Written so that NaN maps to zero.
+    value = value > 0.0f ? value : 0.0f;
+    value = value < 1.0f ? value : 1.0f;
+    return static_cast<std::uint8_t>(value * 255.0f + 0.5f);
+}
+
+inline std::uint16_t unorm16_from_float(float value) noexcept
+{
+    value = value > 0.0f ? value : 0.0f;
+    value = value < 1.0f ? value : 1.0f;
+    return static_cast<std::uint16_t>(value * 65535.0f + 0.5f);
+}
+
+inline std::uint8_t unorm8_from_unorm16(std::uint16_t value) noexcept
+{
+    // round(value / 257)
+    std::uint32_t rounded = static_cast<std::uint32_t>(value) + 128u;
+    return static_cast<std::uint8_t>((rounded - (rounded >> 8)) >> 8);
+}
+
+inline int linear_to_srgb_index(float value) noexcept
+{
+    value = value > 0.0f ? value : 0.0f;
+    value = value < 1.0f ? value : 1.0f;
+    return static_cast<int>(value * SrgbTables::linear_steps + 0.5f);
+}
+
+#if SIMD_X86
+
+// The AVX2 kernels are compiled with FMA, which would let the compiler fuse
+// the scale and the rounding offset and round differently from the scalar
+// helpers above: contraction is turned off for the kernels.
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+SIMD_TARGET_AVX2 inline std::size_t rgb_to_rgba_avx2(
+    const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels, std::uint8_t alpha) noexcept
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+        0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alpha_mask = _mm256_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(alpha) << 24));
+    std::size_t i = 0;
+    // Each lane loads 16 bytes of which only 12 are used, so stay clear of the end.
+    for (; i + 11 <= pixels; i += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 3 + 12));
+        __m256i rgb = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        __m256i rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha_mask);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), rgba);
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t rgba_to_rgb_avx2(
+    const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels) noexcept
+{
+    const __m256i shuffle = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    const __m256i pack = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    std::size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        __m256i rgb = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(rgba, shuffle), pack);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 3), _mm256_castsi256_si128(rgb));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i * 3 + 16), _mm256_extracti128_si256(rgb, 1));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t swap_red_blue_avx2(
+    const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels) noexcept
+{
+    const __m256i shuffle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+        2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    std::size_t i = 0;
+    for (; i + 8 <= pixels; i += 8) {
+        __m256i rgba = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), _mm256_shuffle_epi8(rgba, shuffle));
+    }
+    return i;
+}
+
+inline std::size_t swap_red_blue_sse2(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels) noexcept
+{
+    const __m128i green_alpha = _mm_set1_epi32(static_cast<int>(0xFF00FF00u));
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    std::size_t i = 0;
+    for (; i + 4 <= pixels; i += 4) {
+        __m128i rgba = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        __m128i red = _mm_and_si128(rgba, low_byte);
+        __m128i blue = _mm_and_si128(_mm_srli_epi32(rgba, 16), low_byte);
+        __m128i bgra = _mm_or_si128(_mm_and_si128(rgba, green_alpha), _mm_or_si128(_mm_slli_epi32(red, 16), blue));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), bgra);
+    }
+    return i;
+}
+
+inline std::size_t gray_to_rgba_sse2(
+    const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels, std::uint8_t alpha) noexcept
+{
+    const __m128i color_mask = _mm_set1_epi32(0x00FFFFFF);
+    const __m128i alpha_mask = _mm_set1_epi32(static_cast<int>(static_cast<std::uint32_t>(alpha) << 24));
+    std::size_t i = 0;
+    for (; i + 16 <= pixels; i += 16) {
+        __m128i gray = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i pairs_lo = _mm_unpacklo_epi8(gray, gray);
+        __m128i pairs_hi = _mm_unpackhi_epi8(gray, gray);
+        __m128i quads[4] = {
+            _mm_unpacklo_epi16(pairs_lo, pairs_lo),
+            _mm_unpackhi_epi16(pairs_lo, pairs_lo),
+            _mm_unpacklo_epi16(pairs_hi, pairs_hi),
+            _mm_unpackhi_epi16(pairs_hi, pairs_hi),
+        };
+        for (int j = 0; j < 4; j++) {
+            __m128i rgba = _mm_or_si128(_mm_and_si128(quads[j], color_mask), alpha_mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i + 4 * j) * 4), rgba);
+        }
+    }
+    return i;
+}
+
+inline std::size_t unorm8_to_unorm16_sse2(const std::uint8_t* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        // Interleaving a byte with itself multiplies it by 257.
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(bytes, bytes));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(bytes, bytes));
+    }
+    return i;
+}
+
+inline std::size_t unorm16_to_unorm8_sse2(const std::uint16_t* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    const __m128i half = _mm_set1_epi16(128);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i words[2] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)),
+        };
+        for (auto& word : words) {
+            // Saturating the bias keeps the rounding exact for the topmost values.
+            __m128i rounded = _mm_adds_epu16(word, half);
+            word = _mm_srli_epi16(_mm_sub_epi16(rounded, _mm_srli_epi16(rounded, 8)), 8);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words[0], words[1]));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t unorm8_to_float_avx2(const std::uint8_t* src, float* dst, std::size_t count) noexcept
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256i lo = _mm256_cvtepu8_epi32(bytes);
+        __m256i hi = _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    return i;
+}
+
+inline std::size_t unorm8_to_float_sse2(const std::uint8_t* src, float* dst, std::size_t count) noexcept
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i words_lo = _mm_unpacklo_epi8(bytes, zero);
+        __m128i words_hi = _mm_unpackhi_epi8(bytes, zero);
+        __m128i dwords[4] = {
+            _mm_unpacklo_epi16(words_lo, zero),
+            _mm_unpackhi_epi16(words_lo, zero),
+            _mm_unpacklo_epi16(words_hi, zero),
+            _mm_unpackhi_epi16(words_hi, zero),
+        };
+        for (int j = 0; j < 4; j++) {
+            _mm_storeu_ps(dst + i + 4 * j, _mm_mul_ps(_mm_cvtepi32_ps(dwords[j]), scale));
+        }
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t srgb_to_linear_avx2(
+    const std::uint8_t* src, float* dst, std::size_t count, const float* table) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_i32gather_ps(table, index, 4));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t float_to_unorm8_avx2(const float* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(255.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // max(x, 0) returns the second operand for NaN. Rounds like the
+        // scalar conversion: the product, plus a half, truncated.
+        __m256 lo = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+        __m256 hi = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), zero), one);
+        __m256i lo_i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(lo, scale), half));
+        __m256i hi_i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(hi, scale), half));
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo_i, hi_i), 0xD8);
+        __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), bytes);
+    }
+    return i;
+}
+
+inline std::size_t float_to_unorm8_sse2(const float* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i dwords[4];
+        for (int j = 0; j < 4; j++) {
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * j), zero), one);
+            dwords[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+        }
+        __m128i words_lo = _mm_packs_epi32(dwords[0], dwords[1]);
+        __m128i words_hi = _mm_packs_epi32(dwords[2], dwords[3]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words_lo, words_hi));
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t unorm16_to_float_avx2(const std::uint16_t* src, float* dst, std::size_t count) noexcept
+{
+    const __m256 scale = _mm256_set1_ps(1.0f / 65535.0f);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        __m256i hi = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(lo), scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(_mm256_cvtepi32_ps(hi), scale));
+    }
+    return i;
+}
+
+inline std::size_t unorm16_to_float_sse2(const std::uint16_t* src, float* dst, std::size_t count) noexcept
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 65535.0f);
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i words_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i words_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        __m128i dwords[4] = {
+            _mm_unpacklo_epi16(words_lo, zero),
+            _mm_unpackhi_epi16(words_lo, zero),
+            _mm_unpacklo_epi16(words_hi, zero),
+            _mm_unpackhi_epi16(words_hi, zero),
+        };
+        for (int j = 0; j < 4; j++) {
+            _mm_storeu_ps(dst + i + 4 * j, _mm_mul_ps(_mm_cvtepi32_ps(dwords[j]), scale));
+        }
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t float_to_unorm16_avx2(const float* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(65535.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        // Rounds like the scalar conversion: the product, plus a half, truncated.
+        __m256 lo = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+        __m256 hi = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i + 8), zero), one);
+        __m256i lo_i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(lo, scale), half));
+        __m256i hi_i = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(hi, scale), half));
+        __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo_i, hi_i), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), words);
+    }
+    return i;
+}
+
+inline std::size_t float_to_unorm16_sse2(const float* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(65535.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i bias = _mm_set1_epi32(32768);
+    const __m128i sign = _mm_set1_epi16(static_cast<short>(0x8000));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i dwords[2];
+        for (int j = 0; j < 2; j++) {
+            __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i + 4 * j), zero), one);
+            dwords[j] = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half));
+            // SSE2 only packs signed words: shift the values to their range
+            // and flip the sign bit back afterwards.
+            dwords[j] = _mm_sub_epi32(dwords[j], bias);
+        }
+        __m128i words = _mm_xor_si128(_mm_packs_epi32(dwords[0], dwords[1]), sign);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), words);
+    }
+    return i;
+}
+
+inline std::size_t linear_to_srgb_sse2(const float* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    const auto& table = SrgbTables::get().to_srgb;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(static_cast<float>(SrgbTables::linear_steps));
+    const __m128 half = _mm_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        // Rounds like `linear_to_srgb_index()`.
+        __m128 value = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(src + i), zero), one);
+        alignas(16) std::int32_t index[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, scale), half)));
+        dst[i + 0] = table[index[0]];
+        dst[i + 1] = table[index[1]];
+        dst[i + 2] = table[index[2]];
+        dst[i + 3] = table[index[3]];
+    }
+    return i;
+}
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif
+
+/// Returns whether the last channel of a pixel with `channels` channels is alpha.
+constexpr bool has_alpha(int channels) noexcept
+{
+    return channels == 2 || channels == 4;
+}
+
+} // namespace detail
+
+/// Expands RGB pixels to RGBA.
+///
+/// @param src Packed RGB pixels.
+/// @param dst Destination of the packed RGBA pixels.
+/// @param pixels Number of pixels.
+/// @param alpha Value of the added alpha channel.
+inline void rgb_to_rgba(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels, std::uint8_t alpha = 255) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::rgb_to_rgba_avx2(src, dst, pixels, alpha);
+    }
+#endif
+    for (; i < pixels; i++) {
+        dst[i * 4 + 0] = src[i * 3 + 0];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + 2];
+        dst[i * 4 + 3] = alpha;
+    }
+}
+
+/// Drops the alpha channel of RGBA pixels.
+///
+/// @param src Packed RGBA pixels.
+/// @param dst Destination of the packed RGB pixels.
+/// @param pixels Number of pixels.
+inline void rgba_to_rgb(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::rgba_to_rgb_avx2(src, dst, pixels);
+    }
+#endif
+    for (; i < pixels; i++) {
+        dst[i * 3 + 0] = src[i * 4 + 0];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + 2];
+    }
+}
+
+/// Swaps the red and blue channels of four channel pixels, turning RGBA into BGRA and back.
+///
+/// @param src Packed four channel pixels.
+/// @param dst Destination of the swizzled pixels, may be equal to `src`.
+/// @param pixels Number of pixels.
+inline void swap_red_blue(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::swap_red_blue_avx2(src, dst, pixels);
+    } else {
+        i = detail::swap_red_blue_sse2(src, dst, pixels);
+    }
+#endif
+    for (; i < pixels; i++) {
+        std::uint8_t red = src[i * 4 + 0];
+        dst[i * 4 + 0] = src[i * 4 + 2];
+        dst[i * 4 + 1] = src[i * 4 + 1];
+        dst[i * 4 + 2] = red;
+        dst[i * 4 + 3] = src[i * 4 + 3];
+    }
+}
+
+/// Expands gray pixels to RGBA.
+///
+/// @param src Gray pixels.
+/// @param dst Destination of the packed RGBA pixels.
+/// @param pixels Number of pixels.
+/// @param alpha Value of the added alpha channel.
+inline void gray_to_rgba(const std::uint8_t* src, std::uint8_t* dst, std::size_t pixels, std::uint8_t alpha = 255) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    i = detail::gray_to_rgba_sse2(src, dst, pixels, alpha);
+#endif
+    for (; i < pixels; i++) {
+        dst[i * 4 + 0] = src[i];
+        dst[i * 4 + 1] = src[i];
+        dst[i * 4 + 2] = src[i];
+        dst[i * 4 + 3] = alpha;
+    }
+}
+
+/// Converts 8-bit to 16-bit values, mapping 255 to 65535.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void unorm8_to_unorm16(const std::uint8_t* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    i = detail::unorm8_to_unorm16_sse2(src, dst, count);
+#endif
+    for (; i < count; i++) {
+        dst[i] = static_cast<std::uint16_t>(src[i] * 257);
+    }
+}
+
+/// Converts 16-bit to 8-bit values with rounding.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void unorm16_to_unorm8(const std::uint16_t* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    i = detail::unorm16_to_unorm8_sse2(src, dst, count);
+#endif
+    for (; i < count; i++) {
+        dst[i] = detail::unorm8_from_unorm16(src[i]);
+    }
+}
+
+/// Converts 8-bit values to floats in `[0, 1]`.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void unorm8_to_float(const std::uint8_t* src, float* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::unorm8_to_float_avx2(src, dst, count);
+    } else {
+        i = detail::unorm8_to_float_sse2(src, dst, count);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = src[i] * (1.0f / 255.0f);
+    }
+}
+
+/// Converts floats to 8-bit values, clamping to `[0, 1]`.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void float_to_unorm8(const float* src, std::uint8_t* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::float_to_unorm8_avx2(src, dst, count);
+    } else {
+        i = detail::float_to_unorm8_sse2(src, dst, count);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = detail::unorm8_from_float(src[i]);
+    }
+}
+
+/// Converts 16-bit values to floats in `[0, 1]`.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void unorm16_to_float(const std::uint16_t* src, float* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::unorm16_to_float_avx2(src, dst, count);
+    } else {
+        i = detail::unorm16_to_float_sse2(src, dst, count);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = src[i] * (1.0f / 65535.0f);
+    }
+}
+
+/// Converts floats to 16-bit values, clamping to `[0, 1]`.
+///
+/// @param src Source values.
+/// @param dst Destination values.
+/// @param count Number of values.
+inline void float_to_unorm16(const float* src, std::uint16_t* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::float_to_unorm16_avx2(src, dst, count);
+    } else {
+        i = detail::float_to_unorm16_sse2(src, dst, count);
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = detail::unorm16_from_float(src[i]);
+    }
+}
+
+/// Decodes sRGB encoded 8-bit pixels to linear floats.
+///
+/// The alpha channel of two and four channel pixels is only rescaled.
+///
+/// @param src Packed sRGB pixels.
+/// @param dst Destination of the linear pixels.
+/// @param pixels Number of pixels.
+/// @param channels Number of channels per pixel.
+inline void srgb_to_linear(const std::uint8_t* src, float* dst, std::size_t pixels, int channels) noexcept
+{
+    const auto& table = detail::SrgbTables::get().to_linear;
+    auto count = pixels * static_cast<std::size_t>(channels);
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = detail::srgb_to_linear_avx2(src, dst, count, table.data());
+    }
+#endif
+    for (; i < count; i++) {
+        dst[i] = table[src[i]];
+    }
+    if (detail::has_alpha(channels)) {
+        for (i = static_cast<std::size_t>(channels) - 1; i < count; i += static_cast<std::size_t>(channels)) {
+            dst[i] = src[i] * (1.0f / 255.0f);
+        }
+    }
+}
+
+/// Encodes linear float pixels to sRGB 8-bit pixels, clamping to `[0, 1]`.
+///
+/// The result is within one step of the exact encoding. The alpha channel
+/// of two and four channel pixels is only rescaled.
+///
+/// @param src Packed linear pixels.
+/// @param dst Destination of the sRGB pixels.
+/// @param pixels Number of pixels.
+/// @param channels Number of channels per pixel.
+inline void linear_to_srgb(const float* src, std::uint8_t* dst, std::size_t pixels, int channels) noexcept
+{
+    const auto& table = detail::SrgbTables::get().to_srgb;
+    auto count = pixels * static_cast<std::size_t>(channels);
+    std::size_t i = 0;
+#if SIMD_X86
+    i = detail::linear_to_srgb_sse2(src, dst, count);
+#endif
+    for (; i < count; i++) {
+        dst[i] = table[detail::linear_to_srgb_index(src[i])];
+    }
+    if (detail::has_alpha(channels)) {
+        for (i = static_cast<std::size_t>(channels) - 1; i < count; i += static_cast<std::size_t>(channels)) {
+            dst[i] = detail::unorm8_from_float(src[i]);
+        }
+    }
+}
+
+/// Returns a copy of an image with a different number of channels.
+///
+/// Follows the rules of stb_image: gray is replicated into the color
+/// channels, color is reduced to gray with integer luma weights, and a
+/// missing alpha channel is opaque.
+///
+/// @param image Source pixels, e.g. an image or a rectangle of one.
+/// @param channels Number of channels of the result.
+inline Image convert_channels(ConstImageView image, int channels)
+{
+    Image result { image.width(), image.height(), channels };
+    auto pixels = static_cast<std::size_t>(image.width());
+    int from = image.channels();
+    for (int y = 0; y < image.height(); y++) {
+        const auto* src = image.row(y);
+        auto* dst = result.pixel(0, y);
+        if (from == channels) {
+            std::copy(src, src + image.row_size(), dst);
+        } else if (from == 3 && channels == 4) {
+            rgb_to_rgba(src, dst, pixels);
+        } else if (from == 4 && channels == 3) {
+            rgba_to_rgb(src, dst, pixels);
+        } else if (from == 1 && channels == 4) {
+            gray_to_rgba(src, dst, pixels);
+        } else {
+            for (std::size_t i = 0; i < pixels; i++) {
+                const auto* in = src + i * static_cast<std::size_t>(from);
+                auto* out = dst + i * static_cast<std::size_t>(channels);
+                std::uint8_t gray = from >= 3 ? static_cast<std::uint8_t>((in[0] * 77 + in[1] * 150 + in[2] * 29) >> 8) : in[0];
+                std::uint8_t alpha = detail::has_alpha(from) ? in[from - 1] : 255;
+                switch (channels) {
+                case 1:
+                    out[0] = gray;
+                    break;
+                case 2:
+                    out[0] = gray;
+                    out[1] = alpha;
+                    break;
+                case 3:
+                case 4:
+                    for (int c = 0; c < 3; c++) {
+                        out[c] = from >= 3 ? in[c] : gray;
+                    }
+                    if (channels == 4) {
+                        out[3] = alpha;
+                    }
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    }
+    return result;
+}
+
+namespace detail {
+
+/// Applies a span kernel to every row of an image, as rows may be padded.
+///
+/// @param kernel Called with the source row, the destination row and the number of pixels.
+template <typename D, typename S, int C, typename F>
+BasicImage<D, C> convert_rows(const BasicImage<S, C>& image, F&& kernel)
+{
+    BasicImage<D, C> result { image.width(), image.height(), image.channels() };
+    auto pixels = static_cast<std::size_t>(image.width());
+    for (int y = 0; y < image.height(); y++) {
+        kernel(image.pixel(0, y), result.pixel(0, y), pixels);
+    }
+    return result;
+}
+
+} // namespace detail
+
+/// Returns a copy of a four channel image with red and blue swapped.
+///
+/// @param image Source image in RGBA or BGRA order.
+template <int C>
+BasicImage<unsigned char, C> swap_red_blue(const BasicImage<unsigned char, C>& image)
+{
+    if (image.channels() != 4) {
+        throw std::runtime_error { "Swapping red and blue requires a four channel image." };
+    }
+    return detail::convert_rows<unsigned char>(
+        image, [](const auto* src, auto* dst, std::size_t pixels) { swap_red_blue(src, dst, pixels); });
+}
+
+/// Returns a 16-bit copy of an 8-bit image.
+template <int C>
+BasicImage<unsigned short, C> to_unorm16(const BasicImage<unsigned char, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<unsigned short>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { unorm8_to_unorm16(src, dst, pixels * channels); });
+}
+
+/// Returns a 16-bit copy of a float image, clamping to `[0, 1]`.
+template <int C>
+BasicImage<unsigned short, C> to_unorm16(const BasicImage<float, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<unsigned short>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { float_to_unorm16(src, dst, pixels * channels); });
+}
+
+/// Returns an 8-bit copy of a 16-bit image.
+template <int C>
+BasicImage<unsigned char, C> to_unorm8(const BasicImage<unsigned short, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<unsigned char>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { unorm16_to_unorm8(src, dst, pixels * channels); });
+}
+
+/// Returns an 8-bit copy of a float image, clamping to `[0, 1]`.
+template <int C>
+BasicImage<unsigned char, C> to_unorm8(const BasicImage<float, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<unsigned char>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { float_to_unorm8(src, dst, pixels * channels); });
+}
+
+/// Returns a float copy of an 8-bit image, without changing its encoding.
+template <int C>
+BasicImage<float, C> to_float(const BasicImage<unsigned char, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<float>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { unorm8_to_float(src, dst, pixels * channels); });
+}
+
+/// Returns a float copy of a 16-bit image, without changing its encoding.
+template <int C>
+BasicImage<float, C> to_float(const BasicImage<unsigned short, C>& image)
+{
+    auto channels = static_cast<std::size_t>(image.channels());
+    return detail::convert_rows<float>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { unorm16_to_float(src, dst, pixels * channels); });
+}
+
+/// Decodes an sRGB encoded 8-bit image to linear floats.
+template <int C>
+BasicImage<float, C> srgb_to_linear(const BasicImage<unsigned char, C>& image)
+{
+    int channels = image.channels();
+    return detail::convert_rows<float>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { srgb_to_linear(src, dst, pixels, channels); });
+}
+
+/// Encodes a linear float image to sRGB 8-bit.
+template <int C>
+BasicImage<unsigned char, C> linear_to_srgb(const BasicImage<float, C>& image)
+{
+    int channels = image.channels();
+    return detail::convert_rows<unsigned char>(
+        image, [&](const auto* src, auto* dst, std::size_t pixels) { linear_to_srgb(src, dst, pixels, channels); });
+}
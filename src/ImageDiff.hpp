@@ -0,0 +1,410 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+/// Settings of the comparison of two images.
+struct ImageDiffOptions {
+    /// Whether to compute the structural similarity, the most expensive metric.
+    bool ssim { true };
+    /// Whether to produce a heat map of the differences.
+    bool heatmap { false };
+    /// Multiplier of the differences shown by the heat map. A difference of
+    /// `255 / heatmap_gain` steps or more is shown at full intensity.
+    float heatmap_gain { 4.0f };
+};
+
+/// Differences between two images.
+struct ImageDifference {
+    /// Mean squared error over all channels, in 8-bit steps.
+    double mse { 0.0 };
+    /// Peak signal to noise ratio in decibels, infinite for identical images.
+    double psnr { std::numeric_limits<double>::infinity() };
+    /// Mean structural similarity of the luma over 8x8 windows, `1` for
+    /// identical images. Not a number if it was not computed.
+    double ssim { std::numeric_limits<double>::quiet_NaN() };
+    /// Largest difference of a channel, in 8-bit steps.
+    int max_difference { 0 };
+    /// Number of pixels with at least one differing channel.
+    std::size_t differing_pixels { 0 };
+    /// Largest channel difference of every pixel, on a black to yellow scale, if requested.
+    std::optional<ImageRGB8> heatmap {};
+};
+
+namespace detail {
+
+/// Colors of the heat map, from black through blue and red to light yellow.
+struct HeatmapColors {
+    std::array<std::array<std::uint8_t, 3>, 256> table {};
+
+    constexpr HeatmapColors()
+    {
+        constexpr int stops[5][3] = { { 0, 0, 0 }, { 48, 18, 160 }, { 220, 40, 40 }, { 255, 170, 0 }, { 255, 255, 200 } };
+        for (int i = 0; i < 256; i++) {
+            int segment = std::min(i / 64, 3);
+            int t = i - segment * 64;
+            int span = segment == 3 ? 63 : 64;
+            for (int c = 0; c < 3; c++) {
+                int from = stops[segment][c];
+                int to = stops[segment + 1][c];
+                this->table[i][c] = static_cast<std::uint8_t>(from + (to - from) * t / span);
+            }
+        }
+    }
+};
+
+inline constexpr HeatmapColors heatmap_colors {};
+
+/// Sums of squared differences and largest difference of two byte spans.
+struct ByteErrors {
+    std::uint64_t squared { 0 };
+    int max { 0 };
+};
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline std::size_t byte_errors_avx2(
+    const std::uint8_t* a, const std::uint8_t* b, std::size_t count, ByteErrors& errors) noexcept
+{
+    __m256i wide = _mm256_setzero_si256();
+    __m256i largest = _mm256_setzero_si256();
+    std::size_t i = 0;
+    while (i + 32 <= count) {
+        // The 32-bit sums hold 4096 iterations of two squares of 255 per lane.
+        auto end = std::min(count - 31, i + 32 * 4096);
+        __m256i sums = _mm256_setzero_si256();
+        for (; i < end; i += 32) {
+            __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+            __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+            largest = _mm256_max_epu8(largest, _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+            __m256i lo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_castsi256_si128(va)),
+                _mm256_cvtepu8_epi16(_mm256_castsi256_si128(vb)));
+            __m256i hi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm256_extracti128_si256(va, 1)),
+                _mm256_cvtepu8_epi16(_mm256_extracti128_si256(vb, 1)));
+            sums = _mm256_add_epi32(sums, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+        }
+        wide = _mm256_add_epi64(wide, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sums)));
+        wide = _mm256_add_epi64(wide, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sums, 1)));
+    }
+    alignas(32) std::uint64_t lanes[4];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), wide);
+    errors.squared += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    alignas(32) std::uint8_t maxima[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(maxima), largest);
+    for (auto value : maxima) {
+        errors.max = std::max<int>(errors.max, value);
+    }
+    return i;
+}
+
+/// Adds the sums of the luma of four rows of both images to every column.
+SIMD_TARGET_AVX2 inline std::size_t ssim_columns_avx2(const std::uint8_t* const* a, const std::uint8_t* const* b,
+    std::size_t width, std::int32_t* sums) noexcept
+{
+    std::size_t x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m256i sum_a = _mm256_setzero_si256();
+        __m256i sum_b = _mm256_setzero_si256();
+        __m256i sum_squares = _mm256_setzero_si256();
+        __m256i sum_products = _mm256_setzero_si256();
+        for (int row = 0; row < 4; row++) {
+            __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(a[row] + x)));
+            __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(b[row] + x)));
+            sum_a = _mm256_add_epi32(sum_a, va);
+            sum_b = _mm256_add_epi32(sum_b, vb);
+            sum_squares = _mm256_add_epi32(sum_squares, _mm256_add_epi32(_mm256_mullo_epi32(va, va), _mm256_mullo_epi32(vb, vb)));
+            sum_products = _mm256_add_epi32(sum_products, _mm256_mullo_epi32(va, vb));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + x), sum_a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + width + x), sum_b);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + 2 * width + x), sum_squares);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + 3 * width + x), sum_products);
+    }
+    return x;
+}
+#endif
+
+inline ByteErrors byte_errors(const std::uint8_t* a, const std::uint8_t* b, std::size_t count) noexcept
+{
+    ByteErrors errors {};
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = byte_errors_avx2(a, b, count, errors);
+    }
+#endif
+    for (; i < count; i++) {
+        int difference = a[i] - b[i];
+        errors.squared += static_cast<std::uint64_t>(difference * difference);
+        errors.max = std::max(errors.max, std::abs(difference));
+    }
+    return errors;
+}
+
+/// Sums of the luma of the pixels of a window of both images.
+struct SsimSums {
+    std::int64_t a { 0 };
+    std::int64_t b { 0 };
+    /// Sum of the squares of both images.
+    std::int64_t squares { 0 };
+    std::int64_t products { 0 };
+
+    SsimSums& operator+=(const SsimSums& other) noexcept
+    {
+        this->a += other.a;
+        this->b += other.b;
+        this->squares += other.squares;
+        this->products += other.products;
+        return *this;
+    }
+};
+
+/// Returns the structural similarity of a window of `n` pixels.
+inline double ssim_window(const SsimSums& sums, std::int64_t n) noexcept
+{
+    // Constants of Wang et al., scaled like the sums.
+    constexpr double c1 = (0.01 * 255) * (0.01 * 255);
+    constexpr double c2 = (0.03 * 255) * (0.03 * 255);
+    auto a = static_cast<double>(sums.a);
+    auto b = static_cast<double>(sums.b);
+    auto count = static_cast<double>(n);
+    auto variances = static_cast<double>(n * sums.squares - sums.a * sums.a - sums.b * sums.b);
+    auto covariance = static_cast<double>(n * sums.products - sums.a * sums.b);
+    double numerator = (2.0 * a * b + c1 * count * count) * (2.0 * covariance + c2 * count * (count - 1.0));
+    double denominator = (a * a + b * b + c1 * count * count) * (variances + c2 * count * (count - 1.0));
+    return numerator / denominator;
+}
+
+/// Converts a row to 8-bit luma with the integer weights of `convert_channels()`.
+inline void luma_row(const std::uint8_t* row, std::size_t width, int channels, std::uint8_t* luma) noexcept
+{
+    if (channels < 3) {
+        for (std::size_t x = 0; x < width; x++) {
+            luma[x] = row[x * static_cast<std::size_t>(channels)];
+        }
+        return;
+    }
+    for (std::size_t x = 0; x < width; x++) {
+        const std::uint8_t* pixel = row + x * static_cast<std::size_t>(channels);
+        luma[x] = static_cast<std::uint8_t>((pixel[0] * 77 + pixel[1] * 150 + pixel[2] * 29) >> 8);
+    }
+}
+
+/// Computes the sums of the 4x4 luma blocks of a strip of four rows.
+///
+/// @param blocks Destination of `width / 4` sums.
+inline void ssim_strip(ConstImageView a, ConstImageView b, int top, std::vector<std::uint8_t>& luma,
+    std::vector<std::int32_t>& columns, std::vector<SsimSums>& blocks) noexcept
+{
+    auto width = static_cast<std::size_t>(a.width());
+    const std::uint8_t* rows_a[4];
+    const std::uint8_t* rows_b[4];
+    for (int row = 0; row < 4; row++) {
+        std::uint8_t* luma_a = &luma[static_cast<std::size_t>(row) * width];
+        std::uint8_t* luma_b = &luma[static_cast<std::size_t>(row + 4) * width];
+        luma_row(a.row(top + row), width, a.channels(), luma_a);
+        luma_row(b.row(top + row), width, b.channels(), luma_b);
+        rows_a[row] = luma_a;
+        rows_b[row] = luma_b;
+    }
+
+    std::int32_t* sums = columns.data();
+    std::size_t x = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        x = ssim_columns_avx2(rows_a, rows_b, width, sums);
+    }
+#endif
+    for (; x < width; x++) {
+        std::int32_t sum_a = 0, sum_b = 0, squares = 0, products = 0;
+        for (int row = 0; row < 4; row++) {
+            std::int32_t va = rows_a[row][x];
+            std::int32_t vb = rows_b[row][x];
+            sum_a += va;
+            sum_b += vb;
+            squares += va * va + vb * vb;
+            products += va * vb;
+        }
+        sums[x] = sum_a;
+        sums[width + x] = sum_b;
+        sums[2 * width + x] = squares;
+        sums[3 * width + x] = products;
+    }
+
+    for (std::size_t block = 0; block < blocks.size(); block++) {
+        SsimSums sum {};
+        for (std::size_t column = 4 * block; column < 4 * block + 4; column++) {
+            sum.a += sums[column];
+            sum.b += sums[width + column];
+            sum.squares += sums[2 * width + column];
+            sum.products += sums[3 * width + column];
+        }
+        blocks[block] = sum;
+    }
+}
+
+/// Returns the mean structural similarity of the luma of two images of the same size.
+///
+/// Windows of 8x8 pixels are placed every 4 pixels, as in x264 and FFmpeg,
+/// so each window is the sum of four 4x4 blocks. Strips of blocks are
+/// processed in parallel.
+inline double mean_ssim(ConstImageView a, ConstImageView b, ThreadPool& pool)
+{
+    int width = a.width();
+    int height = a.height();
+    if (width < 8 || height < 8) {
+        // Too small for a window, the whole image is compared at once.
+        SsimSums sums {};
+        std::vector<std::uint8_t> luma_a(static_cast<std::size_t>(width));
+        std::vector<std::uint8_t> luma_b(static_cast<std::size_t>(width));
+        for (int y = 0; y < height; y++) {
+            luma_row(a.row(y), luma_a.size(), a.channels(), luma_a.data());
+            luma_row(b.row(y), luma_b.size(), b.channels(), luma_b.data());
+            for (std::size_t x = 0; x < luma_a.size(); x++) {
+                sums.a += luma_a[x];
+                sums.b += luma_b[x];
+                sums.squares += luma_a[x] * luma_a[x] + luma_b[x] * luma_b[x];
+                sums.products += luma_a[x] * luma_b[x];
+            }
+        }
+        return ssim_window(sums, static_cast<std::int64_t>(width) * height);
+    }
+
+    auto blocks_x = static_cast<std::size_t>(width / 4);
+    auto strips = static_cast<std::size_t>(height / 4);
+    // Sum of the windows below each strip but the first.
+    std::vector<double> strip_ssim(strips, 0.0);
+    pool.parallel_for(strips - 1, 8, [&](std::size_t begin, std::size_t end) {
+        auto row_size = static_cast<std::size_t>(width);
+        std::vector<std::uint8_t> luma(8 * row_size);
+        std::vector<std::int32_t> columns(4 * row_size);
+        std::vector<SsimSums> above(blocks_x);
+        std::vector<SsimSums> below(blocks_x);
+        ssim_strip(a, b, static_cast<int>(begin) * 4, luma, columns, above);
+        for (auto strip = begin + 1; strip <= end; strip++) {
+            ssim_strip(a, b, static_cast<int>(strip) * 4, luma, columns, below);
+            double sum = 0.0;
+            for (std::size_t x = 0; x + 1 < blocks_x; x++) {
+                SsimSums window = above[x];
+                window += above[x + 1];
+                window += below[x];
+                window += below[x + 1];
+                sum += ssim_window(window, 64);
+            }
+            strip_ssim[strip] = sum;
+            std::swap(above, below);
+        }
+    });
+
+    double total = 0.0;
+    for (auto sum : strip_ssim) {
+        total += sum;
+    }
+    return total / static_cast<double>((blocks_x - 1) * (strips - 1));
+}
+
+/// Finds the largest channel difference of every pixel of a row.
+template <int N>
+std::size_t pixel_differences(const std::uint8_t* a, const std::uint8_t* b, std::size_t width, float gain,
+    std::uint8_t* heatmap) noexcept
+{
+    std::size_t differing = 0;
+    for (std::size_t x = 0; x < width; x++) {
+        int largest = 0;
+        for (int c = 0; c < N; c++) {
+            largest = std::max(largest, std::abs(a[x * N + c] - b[x * N + c]));
+        }
+        differing += largest != 0 ? 1 : 0;
+        if (heatmap != nullptr) {
+            auto level = static_cast<int>(std::min(static_cast<float>(largest) * gain, 255.0f));
+            const auto& color = heatmap_colors.table[level];
+            std::copy(color.begin(), color.end(), heatmap + 3 * x);
+        }
+    }
+    return differing;
+}
+
+} // namespace detail
+
+/// Compares two 8-bit images of the same size and number of channels.
+///
+/// The squared errors and largest differences are summed with vector
+/// kernels over bands of rows processed in parallel, and the structural
+/// similarity is computed on the luma over strips processed in parallel.
+/// Partial results are summed in a fixed order, so the metrics do not
+/// depend on the number of threads.
+///
+/// @param reference Expected pixels, e.g. a golden capture.
+/// @param candidate Compared pixels.
+/// @param options Metrics to compute.
+/// @param pool Pool used to process the rows.
+inline ImageDifference compare_images(ConstImageView reference, ConstImageView candidate,
+    const ImageDiffOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    if (reference.width() != candidate.width() || reference.height() != candidate.height()
+        || reference.channels() != candidate.channels()) {
+        throw std::runtime_error { "The images must have the same size and number of channels." };
+    }
+    int height = reference.height();
+    auto width = static_cast<std::size_t>(reference.width());
+    auto rows = static_cast<std::size_t>(height);
+
+    ImageDifference result {};
+    if (options.heatmap) {
+        result.heatmap.emplace(reference.width(), height);
+    }
+
+    std::vector<detail::ByteErrors> row_errors(rows);
+    std::vector<std::size_t> row_differing(rows);
+    pool.parallel_for(rows, 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            const auto* a = reference.row(static_cast<int>(y));
+            const auto* b = candidate.row(static_cast<int>(y));
+            row_errors[y] = detail::byte_errors(a, b, reference.row_size());
+            auto* heatmap = options.heatmap ? result.heatmap->pixel(0, static_cast<int>(y)) : nullptr;
+            if (row_errors[y].max == 0 && heatmap == nullptr) {
+                continue;
+            }
+            switch (reference.channels()) {
+            case 1:
+                row_differing[y] = detail::pixel_differences<1>(a, b, width, options.heatmap_gain, heatmap);
+                break;
+            case 2:
+                row_differing[y] = detail::pixel_differences<2>(a, b, width, options.heatmap_gain, heatmap);
+                break;
+            case 3:
+                row_differing[y] = detail::pixel_differences<3>(a, b, width, options.heatmap_gain, heatmap);
+                break;
+            default:
+                row_differing[y] = detail::pixel_differences<4>(a, b, width, options.heatmap_gain, heatmap);
+                break;
+            }
+        }
+    });
+
+    std::uint64_t squared = 0;
+    for (std::size_t y = 0; y < rows; y++) {
+        squared += row_errors[y].squared;
+        result.max_difference = std::max(result.max_difference, row_errors[y].max);
+        result.differing_pixels += row_differing[y];
+    }
+    result.mse = static_cast<double>(squared) / static_cast<double>(reference.row_size() * rows);
+    if (squared != 0) {
+        result.psnr = 10.0 * std::log10(255.0 * 255.0 / result.mse);
+    }
+    if (options.ssim) {
+        result.ssim = squared == 0 ? 1.0 : detail::mean_ssim(reference, candidate, pool);
+    }
+    return result;
+}
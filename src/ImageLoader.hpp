@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "Resources.hpp"
+#include "ThreadPool.hpp"
+
+/// Handle to an image that is being decoded in the background.
+class ImageHandle {
+public:
+    /// Wraps the future of a pending image.
+    ///
+    /// @param name Name of the loaded resource.
+    /// @param image Future receiving the decoded image.
+    ImageHandle(std::string name, std::future<Image> image)
+        : m_name { std::move(name) }
+        , m_future { std::move(image) }
+    {
+    }
+
+    /// Returns the name of the loaded resource.
+    const std::string& name() const noexcept
+    {
+        return this->m_name;
+    }
+
+    /// Returns whether the image has finished decoding, without blocking.
+    ///
+    /// Also returns `true` if decoding failed, in which case `get` throws.
+    bool ready() const
+    {
+        if (this->m_image || !this->m_future.valid()) {
+            return true;
+        }
+        return this->m_future.wait_for(std::chrono::seconds { 0 }) == std::future_status::ready;
+    }
+
+    /// Returns the decoded image, blocking until it is available.
+    ///
+    /// Rethrows the error raised while decoding the image.
+    Image& get()
+    {
+        if (!this->m_image) {
+            if (!this->m_future.valid()) {
+                throw std::runtime_error { "The image could not be loaded: " + this->m_name };
+            }
+            this->m_image.emplace(this->m_future.get());
+        }
+        return *this->m_image;
+    }
+
+private:
+    std::string m_name;
+    std::future<Image> m_future;
+    std::optional<Image> m_image;
+};
+
+/// Decodes images from the resource directory on a thread pool.
+///
+/// ```
+/// void init(GLFWwindow* window)
+/// {
+///     this->m_textures = ImageLoader {}.load_all({ "albedo.png", "normal.png" });
+/// }
+///
+/// void draw(GLFWwindow* window)
+/// {
+///     for (auto& texture : this->m_textures) {
+///         if (texture.ready()) {
+///             upload(texture.get());
+///         }
+///     }
+/// }
+/// ```
+class ImageLoader {
+public:
+    /// Creates a new loader.
+    ///
+    /// @param pool Pool on which the images are decoded.
+    /// @param mode How the image files are read.
+    explicit ImageLoader(ThreadPool& pool = ThreadPool::global(), ImageLoadMode mode = ImageLoadMode::MemoryMapped)
+        : m_pool { &pool }
+        , m_mode { mode }
+    {
+    }
+
+    /// Starts decoding an image in the background.
+    ///
+    /// @param resource_name Name of the image relative to the resource directory.
+    ImageHandle load(const std::string& resource_name)
+    {
+        auto path = to_resource_path(resource_name);
+        auto mode = this->m_mode;
+        auto image = this->m_pool->submit([path = std::move(path), mode] { return Image { path, mode }; });
+        return ImageHandle { resource_name, std::move(image) };
+    }
+
+    /// Starts decoding multiple images in the background.
+    ///
+    /// The images are decoded in parallel, in the order they are given.
+    ///
+    /// @param resource_names Names of the images relative to the resource directory.
+    std::vector<ImageHandle> load_all(const std::vector<std::string>& resource_names)
+    {
+        std::vector<ImageHandle> handles {};
+        handles.reserve(resource_names.size());
+        for (const auto& resource_name : resource_names) {
+            handles.push_back(this->load(resource_name));
+        }
+        return handles;
+    }
+
+private:
+    ThreadPool* m_pool;
+    ImageLoadMode m_mode;
+};
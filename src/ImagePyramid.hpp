@@ -0,0 +1,244 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageResize.hpp"
+#include "ThreadPool.hpp"
+
+// Gaussian and Laplacian pyramids of Burt and Adelson.
+//
+// Every level of a Gaussian pyramid filters the previous one with the
+// 5-tap binomial kernel `[1 4 6 4 1] / 16` and keeps its even pixels, so
+// a level of size `n` is followed by one of size `(n + 1) / 2`. Levels are
+// float images holding the values as stored, 8 and 16-bit values mapped to
+// `[0, 1]`, without any color space conversion. Edges are clamped.
+
+/// Returns the number of levels of a pyramid going down to a single pixel.
+inline int pyramid_level_count(int width, int height) noexcept
+{
+    int levels = 1;
+    while (width > 1 || height > 1) {
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+        levels++;
+    }
+    return levels;
+}
+
+namespace detail {
+
+inline int pyramid_levels(int width, int height, int levels)
+{
+    int count = pyramid_level_count(width, height);
+    if (levels < 0) {
+        throw std::runtime_error { "The number of pyramid levels must not be negative." };
+    }
+    return levels == 0 ? count : std::min(levels, count);
+}
+
+/// Computes every row of the expansion of a level to a size, passing them
+/// to `visit(y, row)` from the thread that computed them.
+///
+/// Expanding interpolates the level back with the kernel of the reduction,
+/// which works out to `[1 6 1] / 8` on the even pixels and `[1 1] / 2` on
+/// the odd ones, along both axes.
+template <int C, typename F>
+void pyramid_expand_rows(const BasicImage<float, C>& level, int width, int height, ThreadPool& pool, F&& visit)
+{
+    if (width > 2 * level.width() || height > 2 * level.height()) {
+        throw std::runtime_error { "A pyramid level expands to at most twice its size." };
+    }
+    auto channels_sz = static_cast<std::size_t>(level.channels());
+    int level_width = level.width();
+    auto level_row = static_cast<std::size_t>(level_width) * channels_sz;
+    auto row_size = static_cast<std::size_t>(width) * channels_sz;
+
+    pool.parallel_for(static_cast<std::size_t>(height), 16, [&](std::size_t begin, std::size_t end) {
+        // Vertically interpolated row, with one copy of the edge pixels on both sides.
+        std::vector<float> line(level_row + 2 * channels_sz);
+        std::vector<float> out(row_size);
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            int m = y / 2;
+            float* inside = line.data() + channels_sz;
+            auto source = [&](int row) { return level.pixel(0, std::clamp(row, 0, level.height() - 1)); };
+            if (y % 2 == 0) {
+                const float* rows[3] = { source(m - 1), source(m), source(m + 1) };
+                static constexpr float weights[3] = { 0.125f, 0.75f, 0.125f };
+                resample_column(rows, weights, 3, inside, level_row);
+            } else {
+                const float* rows[2] = { source(m), source(m + 1) };
+                static constexpr float weights[2] = { 0.5f, 0.5f };
+                resample_column(rows, weights, 2, inside, level_row);
+            }
+            std::copy_n(inside, channels_sz, line.data());
+            std::copy_n(inside + level_row - channels_sz, channels_sz, inside + level_row);
+
+            for (int x = 0; x < width; x++) {
+                const float* center = inside + static_cast<std::size_t>(x / 2) * channels_sz;
+                float* pixel = out.data() + static_cast<std::size_t>(x) * channels_sz;
+                if (x % 2 == 0) {
+                    for (std::size_t c = 0; c < channels_sz; c++) {
+                        pixel[c] = 0.125f * (center[c - channels_sz] + center[c + channels_sz]) + 0.75f * center[c];
+                    }
+                } else {
+                    for (std::size_t c = 0; c < channels_sz; c++) {
+                        pixel[c] = 0.5f * (center[c] + center[c + channels_sz]);
+                    }
+                }
+            }
+            visit(y, out.data());
+        }
+    });
+}
+
+} // namespace detail
+
+/// Filters a pyramid level with the binomial kernel and halves its size.
+///
+/// @param level Level of a pyramid.
+/// @param pool Pool processing the rows.
+template <int C>
+BasicImage<float, C> pyramid_reduce(const BasicImage<float, C>& level, ThreadPool& pool = ThreadPool::global())
+{
+    int width = level.width();
+    int height = level.height();
+    int channels = level.channels();
+    auto channels_sz = static_cast<std::size_t>(channels);
+    auto row_size = static_cast<std::size_t>(width) * channels_sz;
+    BasicImage<float, C> result { (width + 1) / 2, (height + 1) / 2, channels };
+
+    pool.parallel_for(static_cast<std::size_t>(result.height()), 8, [&](std::size_t begin, std::size_t end) {
+        // Vertically filtered row, with two copies of the edge pixels on both sides.
+        std::vector<float> line(row_size + 4 * channels_sz);
+        static constexpr float weights[5] = { 0.0625f, 0.25f, 0.375f, 0.25f, 0.0625f };
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            const float* rows[5];
+            for (int t = 0; t < 5; t++) {
+                rows[t] = level.pixel(0, std::clamp(2 * y - 2 + t, 0, height - 1));
+            }
+            float* inside = line.data() + 2 * channels_sz;
+            detail::resample_column(rows, weights, 5, inside, row_size);
+            for (std::size_t i = 0; i < 2 * channels_sz; i++) {
+                line[i] = inside[i % channels_sz];
+                inside[row_size + i] = inside[row_size - channels_sz + i % channels_sz];
+            }
+
+            float* out = result.pixel(0, y);
+            for (int x = 0; x < result.width(); x++) {
+                const float* center = inside + static_cast<std::size_t>(2 * x) * channels_sz;
+                for (std::size_t c = 0; c < channels_sz; c++) {
+                    out[static_cast<std::size_t>(x) * channels_sz + c] = weights[0] * center[c - 2 * channels_sz]
+                        + weights[1] * center[c - channels_sz] + weights[2] * center[c]
+                        + weights[3] * center[c + channels_sz] + weights[4] * center[c + 2 * channels_sz];
+                }
+            }
+        }
+    });
+    return result;
+}
+
+/// Interpolates a pyramid level back to the size of the level below it.
+///
+/// @param level Level of a pyramid.
+/// @param width,height Size of the level below.
+/// @param pool Pool processing the rows.
+template <int C>
+BasicImage<float, C> pyramid_expand(
+    const BasicImage<float, C>& level, int width, int height, ThreadPool& pool = ThreadPool::global())
+{
+    BasicImage<float, C> result { width, height, level.channels() };
+    auto row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(level.channels());
+    detail::pyramid_expand_rows(level, width, height, pool,
+        [&](int y, const float* row) { std::copy_n(row, row_size, result.pixel(0, y)); });
+    return result;
+}
+
+/// Builds the Gaussian pyramid of an image.
+///
+/// @param image Source image.
+/// @param levels Number of levels including the image itself, or `0` to go
+/// down to a single pixel.
+/// @param pool Pool processing the rows of every level.
+template <typename T, int C>
+std::vector<BasicImage<float, C>> gaussian_pyramid(
+    const BasicImage<T, C>& image, int levels = 0, ThreadPool& pool = ThreadPool::global())
+{
+    levels = detail::pyramid_levels(image.width(), image.height(), levels);
+    std::vector<BasicImage<float, C>> pyramid {};
+    pyramid.emplace_back(image.width(), image.height(), image.channels());
+    auto& base = pyramid.front();
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            detail::resample_load_row(image.pixel(0, y), base.pixel(0, y), static_cast<std::size_t>(image.width()),
+                image.channels(), false, false);
+        }
+    });
+    for (int i = 1; i < levels; i++) {
+        pyramid.push_back(pyramid_reduce(pyramid.back(), pool));
+    }
+    return pyramid;
+}
+
+/// Builds the Laplacian pyramid of an image.
+///
+/// Every level but the last holds the difference between the Gaussian level
+/// and the expansion of the next one, the detail lost by reducing it. The
+/// last level is the smallest Gaussian level.
+///
+/// @param image Source image.
+/// @param levels Number of levels, or `0` to go down to a single pixel.
+/// @param pool Pool processing the rows of every level.
+template <typename T, int C>
+std::vector<BasicImage<float, C>> laplacian_pyramid(
+    const BasicImage<T, C>& image, int levels = 0, ThreadPool& pool = ThreadPool::global())
+{
+    auto pyramid = gaussian_pyramid(image, levels, pool);
+    for (std::size_t i = 0; i + 1 < pyramid.size(); i++) {
+        auto& level = pyramid[i];
+        auto row_size = static_cast<std::size_t>(level.width()) * static_cast<std::size_t>(level.channels());
+        detail::pyramid_expand_rows(pyramid[i + 1], level.width(), level.height(), pool, [&](int y, const float* row) {
+            float* out = level.pixel(0, y);
+            for (std::size_t j = 0; j < row_size; j++) {
+                out[j] -= row[j];
+            }
+        });
+    }
+    return pyramid;
+}
+
+/// Rebuilds an image from its Laplacian pyramid, adding every level to the
+/// expansion of the levels above it.
+///
+/// @param pyramid Laplacian pyramid, possibly edited, e.g. blended.
+/// @param pool Pool processing the rows of every level.
+/// @return Image the size of the first level, in floats.
+template <int C>
+BasicImage<float, C> collapse_laplacian_pyramid(
+    const std::vector<BasicImage<float, C>>& pyramid, ThreadPool& pool = ThreadPool::global())
+{
+    if (pyramid.empty()) {
+        throw std::runtime_error { "Collapsing an empty pyramid." };
+    }
+    const auto& top = pyramid.back();
+    BasicImage<float, C> result { top.width(), top.height(), top.channels() };
+    copy_pixels<float>(top, result);
+    for (auto i = pyramid.size() - 1; i-- > 0;) {
+        const auto& level = pyramid[i];
+        BasicImage<float, C> next { level.width(), level.height(), level.channels() };
+        auto row_size = static_cast<std::size_t>(level.width()) * static_cast<std::size_t>(level.channels());
+        detail::pyramid_expand_rows(result, level.width(), level.height(), pool, [&](int y, const float* row) {
+            const float* detail = level.pixel(0, y);
+            float* out = next.pixel(0, y);
+            for (std::size_t j = 0; j < row_size; j++) {
+                out[j] = row[j] + detail[j];
+            }
+        });
+        result = std::move(next);
+    }
+    return result;
+}
@@ -0,0 +1,430 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Filter.hpp"
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+/// Options of image resizing.
+struct ResizeOptions {
+    /// Reconstruction filter.
+    Filter filter { Filter::Lanczos3 };
+    /// Whether the color channels of 8-bit images are sRGB encoded.
+    /// Filtering then happens in linear space.
+    bool srgb { true };
+    /// Whether the colors are weighted by alpha while filtering, which keeps
+    /// the color of transparent pixels from bleeding into visible ones.
+    bool alpha_weighted { true };
+};
+
+namespace detail {
+
+/// Number of floats processed by one iteration of the horizontal kernel,
+/// a multiple of every channel count and of the AVX2 register width.
+inline constexpr int resample_chunk = 24;
+
+/// Weights of a horizontal resampling pass, expanded for interleaved channels.
+///
+/// The weights of destination pixel `x` start at `expanded[x * stride]`, with
+/// the weight of tap `t` repeated for each channel and zero padding up to a
+/// multiple of `resample_chunk`. The kernels then compute a plain dot product
+/// between the weights and the source pixels starting at `first[x]`.
+struct ResampleKernel {
+    FilterWeights weights;
+    int channels;
+    int stride;
+    std::vector<float> expanded;
+
+    ResampleKernel(Filter filter, int src_size, int dst_size, int channels)
+        : weights { filter, src_size, dst_size }
+        , channels { channels }
+        , stride { (weights.taps * channels + resample_chunk - 1) / resample_chunk * resample_chunk }
+    {
+        this->expanded.assign(static_cast<std::size_t>(dst_size) * static_cast<std::size_t>(this->stride), 0.0f);
+        for (std::size_t x = 0; x < static_cast<std::size_t>(dst_size); x++) {
+            const float* w = &this->weights.weights[x * this->weights.taps];
+            float* out = &this->expanded[x * this->stride];
+            for (int t = 0; t < this->weights.taps; t++) {
+                for (int c = 0; c < channels; c++) {
+                    out[t * channels + c] = w[t];
+                }
+            }
+        }
+    }
+};
+
+template <int N>
+void resample_row_scalar(const float* src, float* dst, const FilterWeights& weights, int dst_width) noexcept
+{
+    for (int x = 0; x < dst_width; x++) {
+        const float* in = src + static_cast<std::size_t>(weights.first[x]) * N;
+        const float* w = &weights.weights[static_cast<std::size_t>(x) * weights.taps];
+        float sum[N] = {};
+        for (int t = 0; t < weights.taps; t++) {
+            for (int c = 0; c < N; c++) {
+                sum[c] += w[t] * in[t * N + c];
+            }
+        }
+        for (int c = 0; c < N; c++) {
+            dst[x * N + c] = sum[c];
+        }
+    }
+}
+
+#if SIMD_X86
+template <int N>
+SIMD_TARGET_AVX2 void resample_row_avx2(const float* src, float* dst, const ResampleKernel& kernel, int dst_width) noexcept
+{
+    const int length = kernel.weights.taps * N;
+    const int full = length / resample_chunk * resample_chunk;
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    for (int x = 0; x < dst_width; x++) {
+        const float* in = src + static_cast<std::size_t>(kernel.weights.first[x]) * N;
+        const float* w = &kernel.expanded[static_cast<std::size_t>(x) * kernel.stride];
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        int i = 0;
+        for (; i < full; i += resample_chunk) {
+            sum0 = _mm256_fmadd_ps(_mm256_loadu_ps(in + i), _mm256_loadu_ps(w + i), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(in + i + 8), _mm256_loadu_ps(w + i + 8), sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(in + i + 16), _mm256_loadu_ps(w + i + 16), sum2);
+        }
+        if (i < length) {
+            // Masked loads never touch the memory past the last tap.
+            __m256i remaining = _mm256_set1_epi32(length - i);
+            __m256i mask0 = _mm256_cmpgt_epi32(remaining, lanes);
+            __m256i mask1 = _mm256_cmpgt_epi32(remaining, _mm256_add_epi32(lanes, _mm256_set1_epi32(8)));
+            __m256i mask2 = _mm256_cmpgt_epi32(remaining, _mm256_add_epi32(lanes, _mm256_set1_epi32(16)));
+            sum0 = _mm256_fmadd_ps(_mm256_maskload_ps(in + i, mask0), _mm256_loadu_ps(w + i), sum0);
+            sum1 = _mm256_fmadd_ps(_mm256_maskload_ps(in + i + 8, mask1), _mm256_loadu_ps(w + i + 8), sum1);
+            sum2 = _mm256_fmadd_ps(_mm256_maskload_ps(in + i + 16, mask2), _mm256_loadu_ps(w + i + 16), sum2);
+        }
+
+        float* out = dst + static_cast<std::size_t>(x) * N;
+        if constexpr (N == 3) {
+            // Lane `k` of the chunk holds channel `k % 3`, which differs between the registers.
+            alignas(32) float lane[resample_chunk];
+            _mm256_store_ps(lane, sum0);
+            _mm256_store_ps(lane + 8, sum1);
+            _mm256_store_ps(lane + 16, sum2);
+            float sum[3] = {};
+            for (int k = 0; k < resample_chunk; k++) {
+                sum[k % 3] += lane[k];
+            }
+            out[0] = sum[0];
+            out[1] = sum[1];
+            out[2] = sum[2];
+        } else {
+            __m256 total = _mm256_add_ps(_mm256_add_ps(sum0, sum1), sum2);
+            __m128 half = _mm_add_ps(_mm256_castps256_ps128(total), _mm256_extractf128_ps(total, 1));
+            if constexpr (N == 4) {
+                _mm_storeu_ps(out, half);
+            } else {
+                alignas(16) float lane[4];
+                _mm_store_ps(lane, half);
+                if constexpr (N == 2) {
+                    out[0] = lane[0] + lane[2];
+                    out[1] = lane[1] + lane[3];
+                } else {
+                    out[0] = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+                }
+            }
+        }
+    }
+}
+
+SIMD_TARGET_AVX2 inline std::size_t resample_column_avx2(
+    const float* const* rows, const float* weights, int taps, float* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        __m256 sum0 = _mm256_setzero_ps();
+        __m256 sum1 = _mm256_setzero_ps();
+        __m256 sum2 = _mm256_setzero_ps();
+        __m256 sum3 = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            __m256 w = _mm256_set1_ps(weights[t]);
+            const float* in = rows[t] + i;
+            sum0 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in), sum0);
+            sum1 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + 8), sum1);
+            sum2 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + 16), sum2);
+            sum3 = _mm256_fmadd_ps(w, _mm256_loadu_ps(in + 24), sum3);
+        }
+        _mm256_storeu_ps(dst + i, sum0);
+        _mm256_storeu_ps(dst + i + 8, sum1);
+        _mm256_storeu_ps(dst + i + 16, sum2);
+        _mm256_storeu_ps(dst + i + 24, sum3);
+    }
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_setzero_ps();
+        for (int t = 0; t < taps; t++) {
+            sum = _mm256_fmadd_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i), sum);
+        }
+        _mm256_storeu_ps(dst + i, sum);
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t premultiply_rgba_avx2(float* pixels, std::size_t count) noexcept
+{
+    std::size_t x = 0;
+    for (; x + 2 <= count; x += 2) {
+        __m256 value = _mm256_loadu_ps(pixels + x * 4);
+        __m256 alpha = _mm256_permute_ps(value, 0xFF);
+        _mm256_storeu_ps(pixels + x * 4, _mm256_blend_ps(_mm256_mul_ps(value, alpha), value, 0x88));
+    }
+    return x;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t unpremultiply_rgba_avx2(float* pixels, std::size_t count) noexcept
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    std::size_t x = 0;
+    for (; x + 2 <= count; x += 2) {
+        __m256 value = _mm256_loadu_ps(pixels + x * 4);
+        __m256 alpha = _mm256_permute_ps(value, 0xFF);
+        __m256 scale = _mm256_and_ps(_mm256_div_ps(one, alpha), _mm256_cmp_ps(alpha, zero, _CMP_GT_OQ));
+        _mm256_storeu_ps(pixels + x * 4, _mm256_blend_ps(_mm256_mul_ps(value, scale), value, 0x88));
+    }
+    return x;
+}
+#endif
+
+/// Resamples one row of interleaved float pixels horizontally.
+///
+/// @param src Source row of `kernel.channels` channels.
+/// @param dst Destination row of `dst_width` pixels.
+inline void resample_row(const float* src, float* dst, const ResampleKernel& kernel, int dst_width) noexcept
+{
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        switch (kernel.channels) {
+        case 1:
+            return resample_row_avx2<1>(src, dst, kernel, dst_width);
+        case 2:
+            return resample_row_avx2<2>(src, dst, kernel, dst_width);
+        case 3:
+            return resample_row_avx2<3>(src, dst, kernel, dst_width);
+        default:
+            return resample_row_avx2<4>(src, dst, kernel, dst_width);
+        }
+    }
+#endif
+    switch (kernel.channels) {
+    case 1:
+        return resample_row_scalar<1>(src, dst, kernel.weights, dst_width);
+    case 2:
+        return resample_row_scalar<2>(src, dst, kernel.weights, dst_width);
+    case 3:
+        return resample_row_scalar<3>(src, dst, kernel.weights, dst_width);
+    default:
+        return resample_row_scalar<4>(src, dst, kernel.weights, dst_width);
+    }
+}
+
+/// Computes one row of a vertical resampling pass as the weighted sum of rows.
+///
+/// @param rows Source rows, one per tap.
+/// @param weights Weight of each source row.
+/// @param taps Number of source rows.
+/// @param dst Destination row.
+/// @param count Number of floats per row.
+inline void resample_column(
+    const float* const* rows, const float* weights, int taps, float* dst, std::size_t count) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = resample_column_avx2(rows, weights, taps, dst, count);
+    }
+#endif
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int t = 0; t < taps; t++) {
+            sum += weights[t] * rows[t][i];
+        }
+        dst[i] = sum;
+    }
+}
+
+/// Converts a row of pixels to linear, optionally alpha weighted, floats.
+template <typename T>
+void resample_load_row(const T* src, float* dst, std::size_t width, int channels, bool srgb, bool weighted) noexcept
+{
+    auto count = width * static_cast<std::size_t>(channels);
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        if (srgb) {
+            srgb_to_linear(src, dst, width, channels);
+        } else {
+            unorm8_to_float(src, dst, count);
+        }
+    } else if constexpr (std::is_same_v<T, unsigned short>) {
+        unorm16_to_float(src, dst, count);
+    } else {
+        std::copy(src, src + count, dst);
+    }
+
+    if (weighted) {
+        std::size_t x = 0;
+#if SIMD_X86
+        if (channels == 4 && simd_level() >= SimdLevel::AVX2) {
+            x = premultiply_rgba_avx2(dst, width);
+        }
+#endif
+        for (; x < width; x++) {
+            float* pixel = dst + x * channels;
+            float alpha = pixel[channels - 1];
+            for (int c = 0; c < channels - 1; c++) {
+                pixel[c] *= alpha;
+            }
+        }
+    }
+}
+
+/// Converts a row of linear floats back to pixels, undoing the alpha weighting.
+///
+/// @param row Filtered row, modified in place.
+template <typename T>
+void resample_store_row(float* row, T* dst, std::size_t width, int channels, bool srgb, bool weighted) noexcept
+{
+    auto count = width * static_cast<std::size_t>(channels);
+    if (weighted) {
+        std::size_t x = 0;
+#if SIMD_X86
+        if (channels == 4 && simd_level() >= SimdLevel::AVX2) {
+            x = unpremultiply_rgba_avx2(row, width);
+        }
+#endif
+        for (; x < width; x++) {
+            float* pixel = row + x * channels;
+            float alpha = pixel[channels - 1];
+            float scale = alpha > 0.0f ? 1.0f / alpha : 0.0f;
+            for (int c = 0; c < channels - 1; c++) {
+                pixel[c] *= scale;
+            }
+        }
+    }
+
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        if (srgb) {
+            linear_to_srgb(row, dst, width, channels);
+        } else {
+            float_to_unorm8(row, dst, count);
+        }
+    } else if constexpr (std::is_same_v<T, unsigned short>) {
+        float_to_unorm16(row, dst, count);
+    } else {
+        std::copy(row, row + count, dst);
+    }
+}
+
+} // namespace detail
+
+/// Resizes the pixels of a view into another view of any size.
+///
+/// The image is filtered horizontally, then vertically, with weights
+/// precomputed once per axis. Bands of destination rows are processed in
+/// parallel on the pool, each converting and filtering only the source rows
+/// it needs, so no full-size float copy of the image is ever made.
+///
+/// @param src Source pixels.
+/// @param dst Destination pixels, e.g. a rectangle of an atlas, with the
+/// same number of channels as `src`. Must not overlap `src`.
+/// @param options Filter settings.
+/// @param pool Pool used to process the rows.
+template <typename T>
+void resize_image(typename BasicImageView<T>::const_view src, BasicImageView<T> dst, const ResizeOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    int channels = src.channels();
+    if (dst.channels() != channels) {
+        throw std::runtime_error { "The images must have the same number of channels." };
+    }
+    if (dst.width() == src.width() && dst.height() == src.height()) {
+        copy_pixels(src, dst);
+        return;
+    }
+
+    int width = dst.width();
+    detail::ResampleKernel horizontal { options.filter, src.width(), width, channels };
+    FilterWeights vertical { options.filter, src.height(), dst.height() };
+    bool srgb = options.srgb && std::is_same_v<T, unsigned char>;
+    bool weighted = options.alpha_weighted && detail::has_alpha(channels);
+    auto src_width = static_cast<std::size_t>(src.width());
+    auto dst_width = static_cast<std::size_t>(width);
+    auto row_size = dst.row_size();
+
+    // Large bands keep the source rows shared by neighbouring bands, which
+    // are filtered twice, a small fraction of the work.
+    pool.parallel_for(static_cast<std::size_t>(dst.height()), 64, [&](std::size_t begin, std::size_t end) {
+        int first_row = vertical.first[begin];
+        int last_row = vertical.first[end - 1] + vertical.taps;
+        std::vector<float> line(src.row_size());
+        std::vector<float> filtered(static_cast<std::size_t>(last_row - first_row) * row_size);
+        for (int y = first_row; y < last_row; y++) {
+            detail::resample_load_row(src.row(y), line.data(), src_width, channels, srgb, weighted);
+            detail::resample_row(line.data(), &filtered[(y - first_row) * row_size], horizontal, width);
+        }
+
+        std::vector<const float*> rows(static_cast<std::size_t>(vertical.taps));
+        std::vector<float> out(row_size);
+        for (auto y = begin; y < end; y++) {
+            for (int t = 0; t < vertical.taps; t++) {
+                rows[t] = &filtered[(vertical.first[y] + t - first_row) * row_size];
+            }
+            detail::resample_column(rows.data(), &vertical.weights[y * vertical.taps], vertical.taps, out.data(), row_size);
+            detail::resample_store_row(out.data(), dst.row(static_cast<int>(y)), dst_width, channels, srgb, weighted);
+        }
+    });
+}
+
+/// Resizes an image to an arbitrary size.
+///
+/// @param image Source image.
+/// @param width Width of the resized image.
+/// @param height Height of the resized image.
+/// @param options Filter settings.
+/// @param pool Pool used to process the rows.
+template <typename T, int C>
+BasicImage<T, C> resize_image(const BasicImage<T, C>& image, int width, int height, const ResizeOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    BasicImage<T, C> result { width, height, image.channels() };
+    resize_image<T>(image, result, options, pool);
+    return result;
+}
+
+/// Resizes an image to fit within a size, keeping its aspect ratio.
+///
+/// Images that already fit are copied unchanged.
+///
+/// @param image Source image.
+/// @param max_width Maximum width of the resized image.
+/// @param max_height Maximum height of the resized image.
+/// @param options Filter settings.
+/// @param pool Pool used to process the rows.
+template <typename T, int C>
+BasicImage<T, C> resize_to_fit(const BasicImage<T, C>& image, int max_width, int max_height,
+    const ResizeOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    if (max_width <= 0 || max_height <= 0) {
+        throw std::runtime_error { "Invalid maximum image size." };
+    }
+    double scale = std::min({ 1.0, static_cast<double>(max_width) / image.width(),
+        static_cast<double>(max_height) / image.height() });
+    int width = std::clamp(static_cast<int>(std::lround(image.width() * scale)), 1, max_width);
+    int height = std::clamp(static_cast<int>(std::lround(image.height() * scale)), 1, max_height);
+    return resize_image(image, width, height, options, pool);
+}
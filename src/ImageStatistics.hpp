@@ -0,0 +1,536 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+// Statistics of the pixels of an image, gathered in a single pass.
+//
+// Every band of rows fills its own histograms and sums, merged into the
+// result once the band is done, so threads never share a counter. The
+// channels of 8-bit images are only counted into histograms, from which
+// the extrema, moments and alpha coverage are derived exactly. Values are
+// reported as stored, 8 and 16-bit values mapped to `[0, 1]`.
+
+/// Options of the statistics of an image.
+struct ImageStatisticsOptions {
+    /// Number of bins of the histograms of float images. The histograms of
+    /// 8 and 16-bit images have 256 bins, one per 8-bit value.
+    int bins { 256 };
+    /// Range of the channel histograms of float images. Values outside the
+    /// range are counted in the first or the last bin.
+    float histogram_min { 0.0f };
+    float histogram_max { 1.0f };
+    /// Range in stops of the luminance histogram of float images, whose bins
+    /// are spaced logarithmically, as auto exposure expects.
+    float luminance_min_stops { -16.0f };
+    float luminance_max_stops { 16.0f };
+    /// Alpha from which a pixel counts as covered, as with alpha testing.
+    float alpha_cutoff { 0.5f };
+};
+
+/// Histogram of values over a range split into bins of equal size.
+struct Histogram {
+    /// Lower edge of the first bin.
+    double min { 0.0 };
+    /// Upper edge of the last bin.
+    double max { 1.0 };
+    /// Whether the bins cover the base 2 logarithm of the values.
+    bool logarithmic { false };
+    /// Number of values in every bin.
+    std::vector<std::uint64_t> counts {};
+
+    /// Returns the number of values counted.
+    std::uint64_t total() const noexcept
+    {
+        std::uint64_t total = 0;
+        for (auto count : this->counts) {
+            total += count;
+        }
+        return total;
+    }
+
+    /// Returns the value below which a fraction of the values lie, spreading
+    /// the values of every bin evenly over it, or NaN for an empty histogram.
+    ///
+    /// @param fraction Fraction of the values, e.g. 0.5 for the median.
+    double percentile(double fraction) const noexcept
+    {
+        auto total = this->total();
+        if (total == 0) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        double target = std::clamp(fraction, 0.0, 1.0) * static_cast<double>(total);
+        double width = (this->max - this->min) / static_cast<double>(this->counts.size());
+        double below = 0.0;
+        double position = static_cast<double>(this->counts.size());
+        for (std::size_t i = 0; i < this->counts.size(); i++) {
+            auto count = static_cast<double>(this->counts[i]);
+            if (count > 0.0 && below + count >= target) {
+                position = static_cast<double>(i) + (target - below) / count;
+                break;
+            }
+            below += count;
+        }
+        double value = this->min + position * width;
+        return this->logarithmic ? std::exp2(value) : value;
+    }
+};
+
+/// Statistics of one channel of an image.
+struct ChannelStatistics {
+    /// Smallest and largest finite values.
+    double min { 0.0 };
+    double max { 0.0 };
+    /// Mean and variance of the finite values.
+    double mean { 0.0 };
+    double variance { 0.0 };
+    /// Number of NaN and infinite values, only found in float images.
+    std::uint64_t non_finite { 0 };
+    /// Histogram of the finite values.
+    Histogram histogram {};
+};
+
+/// Coverage of the alpha channel of an image.
+struct AlphaCoverage {
+    /// Whether every pixel is fully opaque, always the case without alpha.
+    bool opaque { true };
+    /// Whether every pixel is either fully opaque or fully transparent.
+    bool binary { true };
+    /// Fraction of the pixels whose alpha reaches the cutoff.
+    double coverage { 1.0 };
+};
+
+/// Statistics of an image, as returned by `image_statistics()`.
+struct ImageStatistics {
+    /// Number of pixels.
+    std::uint64_t pixels { 0 };
+    /// Statistics of every channel.
+    std::vector<ChannelStatistics> channels {};
+    /// Histogram of the luminance: the integer luma of `convert_channels()`
+    /// for 8 and 16-bit images, the Rec. 709 luminance in stops for float
+    /// images. Gray images use their gray channel.
+    Histogram luminance {};
+    /// Coverage of the alpha channel of images with two or four channels.
+    AlphaCoverage alpha {};
+};
+
+namespace detail {
+
+/// Histograms and sums of a band of rows.
+///
+/// Values are counted per lane, every lane taking the elements of a row of
+/// the same index modulo the number of lanes: the channels of RGBA pixels
+/// land in different lanes, and the consecutive values of gray pixels do
+/// not increment the same counter one after the other.
+struct StatisticsPartial {
+    int lanes;
+    int bins;
+    std::vector<std::uint64_t> counts;
+    std::vector<std::uint64_t> luminance;
+    std::vector<double> min;
+    std::vector<double> max;
+    std::vector<double> sum;
+    std::vector<double> squares;
+    std::vector<std::uint64_t> non_finite;
+    std::uint64_t transparent { 0 };
+    std::uint64_t opaque { 0 };
+    std::uint64_t covered { 0 };
+
+    StatisticsPartial(int lane_count, int bin_count, int luminance_bins)
+        : lanes { lane_count }
+        , bins { bin_count }
+        , counts(static_cast<std::size_t>(lane_count) * static_cast<std::size_t>(bin_count))
+        , luminance(static_cast<std::size_t>(luminance_bins))
+        , min(static_cast<std::size_t>(lane_count), std::numeric_limits<double>::infinity())
+        , max(static_cast<std::size_t>(lane_count), -std::numeric_limits<double>::infinity())
+        , sum(static_cast<std::size_t>(lane_count))
+        , squares(static_cast<std::size_t>(lane_count))
+        , non_finite(static_cast<std::size_t>(lane_count))
+    {
+    }
+
+    std::uint64_t* lane_counts(int lane) noexcept
+    {
+        return this->counts.data() + static_cast<std::size_t>(lane) * static_cast<std::size_t>(this->bins);
+    }
+
+    /// Adds the values of another band.
+    void merge(const StatisticsPartial& other) noexcept
+    {
+        for (std::size_t i = 0; i < this->counts.size(); i++) {
+            this->counts[i] += other.counts[i];
+        }
+        for (std::size_t i = 0; i < this->luminance.size(); i++) {
+            this->luminance[i] += other.luminance[i];
+        }
+        for (std::size_t i = 0; i < this->min.size(); i++) {
+            this->min[i] = std::min(this->min[i], other.min[i]);
+            this->max[i] = std::max(this->max[i], other.max[i]);
+            this->sum[i] += other.sum[i];
+            this->squares[i] += other.squares[i];
+            this->non_finite[i] += other.non_finite[i];
+        }
+        this->transparent += other.transparent;
+        this->opaque += other.opaque;
+        this->covered += other.covered;
+    }
+};
+
+/// Returns the number of lanes of the statistics of pixels with a number of
+/// channels, a multiple of it so that every lane holds a single channel.
+constexpr int statistics_lanes(int channels) noexcept
+{
+    return channels == 3 ? 3 : 4;
+}
+
+/// Returns the 8-bit luma of a pixel with the integer weights of `convert_channels()`.
+template <typename T>
+unsigned statistics_luma(const T* pixel) noexcept
+{
+    auto luma = 77u * pixel[0] + 150u * pixel[1] + 29u * pixel[2];
+    return std::is_same_v<T, unsigned char> ? luma >> 8 : luma >> 16;
+}
+
+/// Passes a group of values to the callbacks of `statistics_walk()`, one
+/// lane after the other.
+template <int C, typename T, typename V, typename P, std::size_t... Lanes>
+void statistics_group(const T* row, V& value, P& pixel, std::index_sequence<Lanes...>)
+{
+    // Copied first since the counters written by the callbacks could alias
+    // bytes of the row, which would be read again after every write.
+    const T values[] = { row[Lanes]... };
+    (value(Lanes, values[Lanes]), ...);
+    for (std::size_t first = 0; first < sizeof...(Lanes); first += C) {
+        pixel(values + first);
+    }
+}
+
+/// Walks the values of a row of pixels with `C` channels, calling
+/// `value(lane, value)` for every value and `pixel(pixel)` for every pixel.
+///
+/// The number of channels is known at compile time so that the lanes of a
+/// group of values are unrolled and the callbacks inlined.
+template <int C, typename T, typename V, typename P>
+void statistics_walk(const T* row, std::size_t count, V&& value, P&& pixel)
+{
+    constexpr auto lanes = static_cast<std::size_t>(statistics_lanes(C));
+    std::size_t i = 0;
+    for (; i + lanes <= count; i += lanes) {
+        statistics_group<C>(row + i, value, pixel, std::make_index_sequence<lanes> {});
+    }
+    for (; i < count; i++) {
+        value(i % lanes, row[i]);
+        if (i % C == 0) {
+            pixel(row + i);
+        }
+    }
+}
+
+/// Counts the values of a row of an 8-bit image.
+template <int C>
+void statistics_row(
+    const unsigned char* row, std::size_t count, const ImageStatisticsOptions&, StatisticsPartial& partial) noexcept
+{
+    constexpr int lanes = statistics_lanes(C);
+    std::uint64_t* counts[lanes];
+    for (int lane = 0; lane < lanes; lane++) {
+        counts[lane] = partial.lane_counts(lane);
+    }
+    std::uint64_t* luminance = partial.luminance.data();
+    statistics_walk<C>(
+        row, count, [&](std::size_t lane, unsigned char value) { counts[lane][value]++; },
+        [&](const unsigned char* pixel) {
+            if constexpr (C >= 3) {
+                luminance[statistics_luma(pixel)]++;
+            }
+        });
+}
+
+/// Counts and sums the values of a row of a 16-bit image.
+template <int C>
+void statistics_row(const unsigned short* row, std::size_t count, const ImageStatisticsOptions& options,
+    StatisticsPartial& partial) noexcept
+{
+    constexpr int lanes = statistics_lanes(C);
+    std::uint64_t* counts[lanes];
+    // The sums of a row fit in 64 bits, and are exact until added to the band.
+    std::uint64_t sum[lanes] = {};
+    std::uint64_t squares[lanes] = {};
+    unsigned min[lanes];
+    unsigned max[lanes] = {};
+    for (int lane = 0; lane < lanes; lane++) {
+        counts[lane] = partial.lane_counts(lane);
+        min[lane] = 0xffff;
+    }
+    std::uint64_t* luminance = partial.luminance.data();
+    auto cutoff = static_cast<unsigned>(std::ceil(std::clamp(options.alpha_cutoff, 0.0f, 1.0f) * 65535.0f));
+    statistics_walk<C>(
+        row, count,
+        [&](std::size_t lane, unsigned value) {
+            counts[lane][value >> 8]++;
+            sum[lane] += value;
+            squares[lane] += static_cast<std::uint64_t>(value) * value;
+            min[lane] = std::min(min[lane], value);
+            max[lane] = std::max(max[lane], value);
+        },
+        [&](const unsigned short* pixel) {
+            if constexpr (C >= 3) {
+                luminance[statistics_luma(pixel)]++;
+            }
+            if constexpr (C == 2 || C == 4) {
+                partial.transparent += pixel[C - 1] == 0;
+                partial.opaque += pixel[C - 1] == 0xffff;
+                partial.covered += pixel[C - 1] >= cutoff;
+            }
+        });
+    for (std::size_t lane = 0; lane < std::min(static_cast<std::size_t>(lanes), count); lane++) {
+        partial.sum[lane] += static_cast<double>(sum[lane]) / 65535.0;
+        partial.squares[lane] += static_cast<double>(squares[lane]) / (65535.0 * 65535.0);
+        partial.min[lane] = std::min(partial.min[lane], min[lane] / 65535.0);
+        partial.max[lane] = std::max(partial.max[lane], max[lane] / 65535.0);
+    }
+}
+
+/// Counts and sums the values of a row of a float image.
+template <int C>
+void statistics_row(
+    const float* row, std::size_t count, const ImageStatisticsOptions& options, StatisticsPartial& partial) noexcept
+{
+    constexpr int lanes = statistics_lanes(C);
+    std::uint64_t* counts[lanes];
+    double sum[lanes] = {};
+    double squares[lanes] = {};
+    float min[lanes];
+    float max[lanes];
+    for (int lane = 0; lane < lanes; lane++) {
+        counts[lane] = partial.lane_counts(lane);
+        min[lane] = std::numeric_limits<float>::infinity();
+        max[lane] = -std::numeric_limits<float>::infinity();
+    }
+    float last_bin = static_cast<float>(partial.bins - 1);
+    float offset = options.histogram_min;
+    float scale = static_cast<float>(partial.bins) / (options.histogram_max - options.histogram_min);
+    std::uint64_t* luminance = partial.luminance.data();
+    float last_stop_bin = static_cast<float>(partial.luminance.size() - 1);
+    float stops = options.luminance_min_stops;
+    float stop_scale = static_cast<float>(partial.luminance.size())
+        / (options.luminance_max_stops - options.luminance_min_stops);
+    statistics_walk<C>(
+        row, count,
+        [&](std::size_t lane, float value) {
+            if (!std::isfinite(value)) {
+                partial.non_finite[lane]++;
+                return;
+            }
+            float position = std::clamp((value - offset) * scale, 0.0f, last_bin);
+            counts[lane][static_cast<std::size_t>(position)]++;
+            sum[lane] += value;
+            squares[lane] += static_cast<double>(value) * value;
+            min[lane] = std::min(min[lane], value);
+            max[lane] = std::max(max[lane], value);
+        },
+        [&](const float* pixel) {
+            float value = C >= 3 ? 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2] : pixel[0];
+            if (!std::isnan(value)) {
+                // Black and negative values fall into the first bin.
+                float position = value > 0.0f ? (std::log2(value) - stops) * stop_scale : 0.0f;
+                luminance[static_cast<std::size_t>(std::clamp(position, 0.0f, last_stop_bin))]++;
+            }
+            if constexpr (C == 2 || C == 4) {
+                partial.transparent += pixel[C - 1] <= 0.0f;
+                partial.opaque += pixel[C - 1] >= 1.0f;
+                partial.covered += pixel[C - 1] >= options.alpha_cutoff;
+            }
+        });
+    for (std::size_t lane = 0; lane < std::min(static_cast<std::size_t>(lanes), count); lane++) {
+        partial.sum[lane] += sum[lane];
+        partial.squares[lane] += squares[lane];
+        partial.min[lane] = std::min(partial.min[lane], static_cast<double>(min[lane]));
+        partial.max[lane] = std::max(partial.max[lane], static_cast<double>(max[lane]));
+    }
+}
+
+/// Counts the values of a row, for the number of channels of the image.
+template <typename T>
+void statistics_row(
+    const T* row, int width, int channels, const ImageStatisticsOptions& options, StatisticsPartial& partial) noexcept
+{
+    auto count = static_cast<std::size_t>(width) * static_cast<std::size_t>(channels);
+    switch (channels) {
+    case 1:
+        statistics_row<1>(row, count, options, partial);
+        break;
+    case 2:
+        statistics_row<2>(row, count, options, partial);
+        break;
+    case 3:
+        statistics_row<3>(row, count, options, partial);
+        break;
+    default:
+        statistics_row<4>(row, count, options, partial);
+        break;
+    }
+}
+
+/// Derives the extrema, sums and alpha coverage of 8-bit images from their histograms.
+inline void statistics_from_counts(
+    StatisticsPartial& partial, int channels, const ImageStatisticsOptions& options) noexcept
+{
+    for (int lane = 0; lane < partial.lanes; lane++) {
+        const std::uint64_t* counts = partial.lane_counts(lane);
+        std::uint64_t sum = 0;
+        std::uint64_t squares = 0;
+        for (std::uint64_t value = 0; value < 256; value++) {
+            sum += counts[value] * value;
+            squares += counts[value] * value * value;
+            if (counts[value] != 0) {
+                partial.min[lane] = std::min(partial.min[lane], static_cast<double>(value) / 255.0);
+                partial.max[lane] = static_cast<double>(value) / 255.0;
+            }
+        }
+        partial.sum[lane] = static_cast<double>(sum) / 255.0;
+        partial.squares[lane] = static_cast<double>(squares) / (255.0 * 255.0);
+
+        if ((channels == 2 || channels == 4) && lane % channels == channels - 1) {
+            auto cutoff = static_cast<int>(std::ceil(std::clamp(options.alpha_cutoff, 0.0f, 1.0f) * 255.0f));
+            partial.transparent += counts[0];
+            partial.opaque += counts[255];
+            for (int value = cutoff; value < 256; value++) {
+                partial.covered += counts[value];
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+/// Computes the statistics of every channel of an image, the histogram of
+/// its luminance and the coverage of its alpha channel in a single pass.
+///
+/// Images of a few hundred pixels on a side are processed in a single band:
+/// to gather the statistics of many such images, run one call per image on
+/// the pool instead, each with a pool of no helper threads.
+///
+/// @param image Source pixels, e.g. an image or a rectangle of one.
+/// @param options Histogram ranges of float images and alpha cutoff.
+/// @param pool Pool processing bands of rows.
+template <typename T>
+ImageStatistics image_statistics(
+    BasicImageView<const T> image, const ImageStatisticsOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    constexpr bool is_float = std::is_same_v<T, float>;
+    if constexpr (is_float) {
+        if (options.bins < 1) {
+            throw std::runtime_error { "A histogram needs at least one bin." };
+        }
+        if (!(options.histogram_max > options.histogram_min)
+            || !(options.luminance_max_stops > options.luminance_min_stops)) {
+            throw std::runtime_error { "The ranges of the histograms must not be empty." };
+        }
+    }
+    int channels = image.channels();
+    int width = image.width();
+    int lanes = detail::statistics_lanes(channels);
+    int bins = is_float ? options.bins : 256;
+    detail::StatisticsPartial total { lanes, bins, bins };
+    std::mutex mutex {};
+
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 64, [&](std::size_t begin, std::size_t end) {
+        detail::StatisticsPartial partial { lanes, bins, bins };
+        for (auto y = begin; y < end; y++) {
+            detail::statistics_row(image.row(static_cast<int>(y)), width, channels, options, partial);
+        }
+        std::lock_guard<std::mutex> lock { mutex };
+        total.merge(partial);
+    });
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        detail::statistics_from_counts(total, channels, options);
+    }
+
+    ImageStatistics result {};
+    result.pixels = static_cast<std::uint64_t>(width) * static_cast<std::uint64_t>(image.height());
+    for (int c = 0; c < channels; c++) {
+        ChannelStatistics channel {};
+        channel.histogram.counts.assign(static_cast<std::size_t>(bins), 0);
+        if constexpr (is_float) {
+            channel.histogram.min = options.histogram_min;
+            channel.histogram.max = options.histogram_max;
+        } else if constexpr (std::is_same_v<T, unsigned char>) {
+            // Every bin is centered on its 8-bit value.
+            channel.histogram.min = -0.5 / 255.0;
+            channel.histogram.max = 255.5 / 255.0;
+        } else {
+            channel.histogram.max = 65536.0 / 65535.0;
+        }
+        channel.min = std::numeric_limits<double>::infinity();
+        channel.max = -std::numeric_limits<double>::infinity();
+        double sum = 0.0;
+        double squares = 0.0;
+        for (int lane = c; lane < lanes; lane += channels) {
+            const std::uint64_t* counts = total.lane_counts(lane);
+            for (std::size_t i = 0; i < channel.histogram.counts.size(); i++) {
+                channel.histogram.counts[i] += counts[i];
+            }
+            channel.min = std::min(channel.min, total.min[static_cast<std::size_t>(lane)]);
+            channel.max = std::max(channel.max, total.max[static_cast<std::size_t>(lane)]);
+            sum += total.sum[static_cast<std::size_t>(lane)];
+            squares += total.squares[static_cast<std::size_t>(lane)];
+            channel.non_finite += total.non_finite[static_cast<std::size_t>(lane)];
+        }
+        auto finite = static_cast<double>(result.pixels - channel.non_finite);
+        if (finite > 0.0) {
+            channel.mean = sum / finite;
+            channel.variance = std::max(squares / finite - channel.mean * channel.mean, 0.0);
+        } else {
+            channel.min = 0.0;
+            channel.max = 0.0;
+        }
+        result.channels.push_back(std::move(channel));
+    }
+
+    if (is_float || channels >= 3) {
+        result.luminance.counts = std::move(total.luminance);
+        if constexpr (is_float) {
+            result.luminance.min = options.luminance_min_stops;
+            result.luminance.max = options.luminance_max_stops;
+            result.luminance.logarithmic = true;
+        } else {
+            result.luminance.min = result.channels.front().histogram.min;
+            result.luminance.max = result.channels.front().histogram.max;
+        }
+    } else {
+        result.luminance = result.channels.front().histogram;
+    }
+
+    if (channels == 2 || channels == 4) {
+        auto pixels = static_cast<double>(result.pixels);
+        result.alpha.opaque = total.opaque == result.pixels;
+        result.alpha.binary = total.opaque + total.transparent == result.pixels;
+        result.alpha.coverage = static_cast<double>(total.covered) / pixels;
+    }
+    return result;
+}
+
+/// Computes the statistics of an image in a single pass.
+///
+/// @param image Source image.
+/// @param options Histogram ranges of float images and alpha cutoff.
+/// @param pool Pool processing bands of rows.
+template <typename T, int C>
+ImageStatistics image_statistics(
+    const BasicImage<T, C>& image, const ImageStatisticsOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return image_statistics(BasicImageView<const T> { image }, options, pool);
+}
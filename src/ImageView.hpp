@@ -0,0 +1,220 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Image.hpp"
+
+/// Non-owning view of pixels, e.g. an image or a rectangle of an image.
+///
+/// Rows are `stride` elements apart, so a view may address part of a wider
+/// buffer without copying. Views are cheap to copy and pass by value; they
+/// must not outlive the pixels they point to.
+///
+/// @tparam T Type of a single channel, `const` qualified for read-only views.
+template <typename T>
+class BasicImageView {
+    using Value = std::remove_const_t<T>;
+    static_assert(std::is_same_v<Value, unsigned char> || std::is_same_v<Value, unsigned short>
+            || std::is_same_v<Value, float>,
+        "The channel type must be one of unsigned char, unsigned short or float.");
+
+public:
+    using value_type = Value;
+    /// Read-only view of the same pixels.
+    using const_view = BasicImageView<const Value>;
+
+    /// Creates a view over existing pixels.
+    ///
+    /// @param data First channel of the top left pixel.
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    /// @param channels Number of channels.
+    /// @param stride Number of elements between the starts of two rows.
+    BasicImageView(T* data, int width, int height, int channels, std::size_t stride)
+        : m_data { data }
+        , m_width { width }
+        , m_height { height }
+        , m_channels { channels }
+        , m_stride { stride }
+    {
+        if (data == nullptr) {
+            throw std::runtime_error { "Invalid image data." };
+        }
+        if (width <= 0) {
+            throw std::runtime_error { "Invalid image width." };
+        }
+        if (height <= 0) {
+            throw std::runtime_error { "Invalid image height." };
+        }
+        if (channels < 1 || channels > 4) {
+            throw std::runtime_error { "The image must have between 1 and 4 channels." };
+        }
+        if (stride < static_cast<std::size_t>(width) * static_cast<std::size_t>(channels)) {
+            throw std::runtime_error { "Invalid image stride." };
+        }
+    }
+
+    /// Creates a view over tightly packed pixels.
+    ///
+    /// @param data First channel of the top left pixel.
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    /// @param channels Number of channels.
+    BasicImageView(T* data, int width, int height, int channels)
+        : BasicImageView { data, width, height, channels,
+            static_cast<std::size_t>(width) * static_cast<std::size_t>(channels) }
+    {
+    }
+
+    /// Creates a view over a whole image.
+    template <int C, typename U = T, std::enable_if_t<!std::is_const_v<U>, int> = 0>
+    BasicImageView(BasicImage<Value, C>& image)
+        : BasicImageView { image.data(), image.width(), image.height(), image.channels(), image.stride() }
+    {
+    }
+
+    /// Creates a read-only view over a whole image.
+    template <int C, typename U = T, std::enable_if_t<std::is_const_v<U>, int> = 0>
+    BasicImageView(const BasicImage<Value, C>& image)
+        : BasicImageView { image.data(), image.width(), image.height(), image.channels(), image.stride() }
+    {
+    }
+
+    /// Converts a view to a read-only view.
+    template <typename U = T, std::enable_if_t<std::is_const_v<U>, int> = 0>
+    BasicImageView(const BasicImageView<Value>& other) noexcept
+        : m_data { other.data() }
+        , m_width { other.width() }
+        , m_height { other.height() }
+        , m_channels { other.channels() }
+        , m_stride { other.stride() }
+    {
+    }
+
+    /// Returns the first channel of the top left pixel.
+    T* data() const noexcept
+    {
+        return this->m_data;
+    }
+
+    /// Returns the first channel of a row.
+    ///
+    /// @param y Row index.
+    T* row(int y) const noexcept
+    {
+        return this->m_data + static_cast<std::size_t>(y) * this->m_stride;
+    }
+
+    /// Returns the first channel of a pixel.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    T* pixel(int x, int y) const noexcept
+    {
+        return this->row(y) + static_cast<std::size_t>(x) * static_cast<std::size_t>(this->m_channels);
+    }
+
+    /// Returns the width of the view.
+    int width() const noexcept
+    {
+        return this->m_width;
+    }
+
+    /// Returns the height of the view.
+    int height() const noexcept
+    {
+        return this->m_height;
+    }
+
+    /// Returns the number of channels of each pixel.
+    int channels() const noexcept
+    {
+        return this->m_channels;
+    }
+
+    /// Returns the number of elements between the starts of two rows.
+    std::size_t stride() const noexcept
+    {
+        return this->m_stride;
+    }
+
+    /// Returns the number of elements of a row, without padding.
+    std::size_t row_size() const noexcept
+    {
+        return static_cast<std::size_t>(this->m_width) * static_cast<std::size_t>(this->m_channels);
+    }
+
+    /// Returns whether the rows follow each other without gaps.
+    bool contiguous() const noexcept
+    {
+        return this->m_stride == this->row_size();
+    }
+
+    /// Returns a view of a rectangle of this view.
+    ///
+    /// @param x Left column of the rectangle.
+    /// @param y Top row of the rectangle.
+    /// @param width Width of the rectangle.
+    /// @param height Height of the rectangle.
+    BasicImageView subview(int x, int y, int width, int height) const
+    {
+        if (x < 0 || y < 0 || width <= 0 || height <= 0 || width > this->m_width - x || height > this->m_height - y) {
+            throw std::runtime_error { "The rectangle is outside of the image." };
+        }
+        return { this->pixel(x, y), width, height, this->m_channels, this->m_stride };
+    }
+
+private:
+    T* m_data;
+    int m_width;
+    int m_height;
+    int m_channels;
+    std::size_t m_stride;
+};
+
+/// Copies the pixels of a view into another view of the same size.
+///
+/// @param src Source pixels.
+/// @param dst Destination pixels, which must not overlap `src`.
+template <typename T>
+void copy_pixels(typename BasicImageView<T>::const_view src, BasicImageView<T> dst)
+{
+    if (src.width() != dst.width() || src.height() != dst.height() || src.channels() != dst.channels()) {
+        throw std::runtime_error { "The images must have the same size and number of channels." };
+    }
+    if (src.contiguous() && dst.contiguous()) {
+        std::copy(src.data(), src.data() + src.row_size() * static_cast<std::size_t>(src.height()), dst.data());
+        return;
+    }
+    for (int y = 0; y < src.height(); y++) {
+        std::copy(src.row(y), src.row(y) + src.row_size(), dst.row(y));
+    }
+}
+
+/// Copies the pixels of a view into a new image.
+///
+/// @param view Source pixels.
+template <typename T>
+BasicImage<std::remove_const_t<T>> to_image(BasicImageView<T> view)
+{
+    using Value = std::remove_const_t<T>;
+    BasicImage<Value> image { view.width(), view.height(), view.channels() };
+    copy_pixels<Value>(view, BasicImageView<Value> { image });
+    return image;
+}
+
+/// 8-bit view with a runtime number of channels.
+using ImageView = BasicImageView<unsigned char>;
+/// Read-only 8-bit view with a runtime number of channels.
+using ConstImageView = BasicImageView<const unsigned char>;
+/// 16-bit view with a runtime number of channels.
+using ImageView16 = BasicImageView<unsigned short>;
+/// Read-only 16-bit view with a runtime number of channels.
+using ConstImageView16 = BasicImageView<const unsigned short>;
+/// Floating point view with a runtime number of channels.
+using ImageViewF = BasicImageView<float>;
+/// Read-only floating point view with a runtime number of channels.
+using ConstImageViewF = BasicImageView<const float>;
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Deflate.hpp"
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+/// File formats written by `write_image()`.
+enum class ImageFileFormat {
+    /// PNG, lossless with deflate compression.
+    Png,
+    /// Quite OK Image format, lossless and several times faster to encode than PNG.
+    Qoi,
+    /// Rows of pixels as stored in memory, without header.
+    Raw,
+};
+
+/// Settings of the image writers.
+struct ImageWriteOptions {
+    /// File format, deduced from the extension of the path if empty.
+    std::optional<ImageFileFormat> format {};
+    /// Deflate level of PNG files, from 0 (stored) to 9 (smallest).
+    int compression_level { 6 };
+    /// Whether PNG files are filtered and compressed in chunks on several
+    /// threads of the pool. Files are slightly larger. Disable it when
+    /// writing many images at once, which already keeps the pool busy.
+    bool parallel_deflate { true };
+    /// Whether to write the rows bottom to top, e.g. for pixels read back from OpenGL.
+    bool flip_vertically { false };
+};
+
+namespace detail {
+
+/// Returns the source row written at a position of the file.
+template <typename T>
+const T* written_row(BasicImageView<const T> pixels, int y, bool flip) noexcept
+{
+    return pixels.row(flip ? pixels.height() - 1 - y : y);
+}
+
+inline void append_png_chunk(std::vector<unsigned char>& out, const char* type, const unsigned char* data, std::size_t size)
+{
+    if (size > 0x7FFFFFFFu) {
+        throw std::runtime_error { "The PNG chunk is too large." };
+    }
+    append_big_endian(out, static_cast<std::uint32_t>(size));
+    auto start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    append_big_endian(out, crc32(out.data() + start, size + 4));
+}
+
+inline int paeth_predictor(int left, int up, int up_left) noexcept
+{
+    int estimate = left + up - up_left;
+    int distance_left = std::abs(estimate - left);
+    int distance_up = std::abs(estimate - up);
+    int distance_up_left = std::abs(estimate - up_left);
+    if (distance_left <= distance_up && distance_left <= distance_up_left) {
+        return left;
+    }
+    return distance_up <= distance_up_left ? up : up_left;
+}
+
+/// Filters a row of bytes with the PNG filter giving the smallest sum of
+/// absolute differences, the heuristic recommended by the specification.
+///
+/// @param row Bytes of the row.
+/// @param previous Bytes of the previous row, zeros for the first row.
+/// @param size Number of bytes per row.
+/// @param bpp Number of bytes per pixel.
+/// @param out Destination of the filter type followed by the filtered bytes.
+/// @param scratch Space for the candidate rows, `5 * size` bytes.
+inline void png_filter_row(const unsigned char* row, const unsigned char* previous, std::size_t size, std::size_t bpp,
+    unsigned char* out, unsigned char* scratch) noexcept
+{
+    unsigned char* candidates[5];
+    for (std::size_t filter = 0; filter < 5; filter++) {
+        candidates[filter] = scratch + filter * size;
+    }
+    for (std::size_t i = 0; i < size; i++) {
+        int left = i >= bpp ? row[i - bpp] : 0;
+        int up = previous[i];
+        int up_left = i >= bpp ? previous[i - bpp] : 0;
+        candidates[0][i] = row[i];
+        candidates[1][i] = static_cast<unsigned char>(row[i] - left);
+        candidates[2][i] = static_cast<unsigned char>(row[i] - up);
+        candidates[3][i] = static_cast<unsigned char>(row[i] - ((left + up) >> 1));
+        candidates[4][i] = static_cast<unsigned char>(row[i] - paeth_predictor(left, up, up_left));
+    }
+
+    std::size_t best = 0;
+    std::uint64_t best_sum = UINT64_MAX;
+    for (std::size_t filter = 0; filter < 5; filter++) {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < size; i++) {
+            sum += static_cast<std::uint64_t>(std::abs(static_cast<signed char>(candidates[filter][i])));
+        }
+        if (sum < best_sum) {
+            best = filter;
+            best_sum = sum;
+        }
+    }
+    out[0] = static_cast<unsigned char>(best);
+    std::copy(candidates[best], candidates[best] + size, out + 1);
+}
+
+/// Copies a row to bytes in PNG order, big endian for 16-bit channels.
+template <typename T>
+void png_row_bytes(const T* row, std::size_t count, unsigned char* out) noexcept
+{
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        std::copy(row, row + count, out);
+    } else {
+        for (std::size_t i = 0; i < count; i++) {
+            out[2 * i] = static_cast<unsigned char>(row[i] >> 8);
+            out[2 * i + 1] = static_cast<unsigned char>(row[i]);
+        }
+    }
+}
+
+template <typename T>
+std::vector<unsigned char> encode_png(BasicImageView<const T> pixels, const ImageWriteOptions& options, ThreadPool& pool)
+{
+    static constexpr unsigned char color_types[] = { 0, 4, 2, 6 };
+    int width = pixels.width();
+    int height = pixels.height();
+    auto bpp = static_cast<std::size_t>(pixels.channels()) * sizeof(T);
+    auto row_bytes = static_cast<std::size_t>(width) * bpp;
+    auto filtered_row = row_bytes + 1;
+    bool flip = options.flip_vertically;
+
+    // Rows are filtered independently of each other, one band per task.
+    std::vector<unsigned char> filtered(filtered_row * static_cast<std::size_t>(height));
+    auto filter_rows = [&](std::size_t begin, std::size_t end) {
+        std::vector<unsigned char> row(row_bytes);
+        std::vector<unsigned char> previous(row_bytes, 0);
+        std::vector<unsigned char> scratch(5 * row_bytes);
+        if (begin > 0) {
+            png_row_bytes(written_row(pixels, static_cast<int>(begin) - 1, flip), pixels.row_size(), previous.data());
+        }
+        for (auto y = begin; y < end; y++) {
+            png_row_bytes(written_row(pixels, static_cast<int>(y), flip), pixels.row_size(), row.data());
+            if (options.compression_level <= 0) {
+                filtered[y * filtered_row] = 0;
+                std::copy(row.begin(), row.end(), filtered.begin() + static_cast<std::ptrdiff_t>(y * filtered_row + 1));
+            } else {
+                png_filter_row(row.data(), previous.data(), row_bytes, bpp, &filtered[y * filtered_row], scratch.data());
+            }
+            std::swap(row, previous);
+        }
+    };
+
+    std::vector<unsigned char> compressed {};
+    if (options.parallel_deflate) {
+        pool.parallel_for(static_cast<std::size_t>(height), 32, filter_rows);
+        compressed = zlib_compress_parallel(filtered.data(), filtered.size(), options.compression_level, pool);
+    } else {
+        filter_rows(0, static_cast<std::size_t>(height));
+        compressed = zlib_compress(filtered.data(), filtered.size(), options.compression_level);
+    }
+
+    std::vector<unsigned char> out {};
+    out.reserve(compressed.size() + 64);
+    static constexpr unsigned char signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.insert(out.end(), std::begin(signature), std::end(signature));
+    std::vector<unsigned char> header {};
+    append_big_endian(header, static_cast<std::uint32_t>(width));
+    append_big_endian(header, static_cast<std::uint32_t>(height));
+    header.push_back(static_cast<unsigned char>(8 * sizeof(T)));
+    header.push_back(color_types[pixels.channels() - 1]);
+    header.insert(header.end(), { 0, 0, 0 });
+    append_png_chunk(out, "IHDR", header.data(), header.size());
+    append_png_chunk(out, "IDAT", compressed.data(), compressed.size());
+    append_png_chunk(out, "IEND", nullptr, 0);
+    return out;
+}
+
+inline std::vector<unsigned char> encode_qoi(ConstImageView pixels, const ImageWriteOptions& options)
+{
+    int channels = pixels.channels();
+    if (channels != 3 && channels != 4) {
+        throw std::runtime_error { "QOI files require an RGB or RGBA image." };
+    }
+    constexpr unsigned char op_index = 0x00;
+    constexpr unsigned char op_diff = 0x40;
+    constexpr unsigned char op_luma = 0x80;
+    constexpr unsigned char op_run = 0xC0;
+    constexpr unsigned char op_rgb = 0xFE;
+    constexpr unsigned char op_rgba = 0xFF;
+
+    std::vector<unsigned char> out {};
+    // Worst case of one RGBA operation per pixel.
+    out.reserve(14 + static_cast<std::size_t>(pixels.width()) * static_cast<std::size_t>(pixels.height()) * 5 + 8);
+    out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+    append_big_endian(out, static_cast<std::uint32_t>(pixels.width()));
+    append_big_endian(out, static_cast<std::uint32_t>(pixels.height()));
+    out.push_back(static_cast<unsigned char>(channels));
+    out.push_back(0);
+
+    std::array<std::array<unsigned char, 4>, 64> index {};
+    std::array<unsigned char, 4> previous { 0, 0, 0, 255 };
+    int run = 0;
+    for (int y = 0; y < pixels.height(); y++) {
+        const unsigned char* row = written_row(pixels, y, options.flip_vertically);
+        for (int x = 0; x < pixels.width(); x++) {
+            const unsigned char* in = row + static_cast<std::size_t>(x) * static_cast<std::size_t>(channels);
+            std::array<unsigned char, 4> pixel { in[0], in[1], in[2], static_cast<unsigned char>(channels == 4 ? in[3] : 255) };
+            if (pixel == previous) {
+                if (++run == 62) {
+                    out.push_back(static_cast<unsigned char>(op_run | (run - 1)));
+                    run = 0;
+                }
+                continue;
+            }
+            if (run > 0) {
+                out.push_back(static_cast<unsigned char>(op_run | (run - 1)));
+                run = 0;
+            }
+
+            int hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+            if (index[hash] == pixel) {
+                out.push_back(static_cast<unsigned char>(op_index | hash));
+            } else if (pixel[3] == previous[3]) {
+                index[hash] = pixel;
+                auto dr = static_cast<signed char>(pixel[0] - previous[0]);
+                auto dg = static_cast<signed char>(pixel[1] - previous[1]);
+                auto db = static_cast<signed char>(pixel[2] - previous[2]);
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    out.push_back(static_cast<unsigned char>(op_diff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    out.push_back(static_cast<unsigned char>(op_luma | (dg + 32)));
+                    out.push_back(static_cast<unsigned char>((dr_dg + 8) << 4 | (db_dg + 8)));
+                } else {
+                    out.insert(out.end(), { op_rgb, pixel[0], pixel[1], pixel[2] });
+                }
+            } else {
+                index[hash] = pixel;
+                out.insert(out.end(), { op_rgba, pixel[0], pixel[1], pixel[2], pixel[3] });
+            }
+            previous = pixel;
+        }
+    }
+    if (run > 0) {
+        out.push_back(static_cast<unsigned char>(op_run | (run - 1)));
+    }
+    out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+    return out;
+}
+
+template <typename T>
+std::vector<unsigned char> encode_raw(BasicImageView<const T> pixels, const ImageWriteOptions& options)
+{
+    auto row_bytes = pixels.row_size() * sizeof(T);
+    std::vector<unsigned char> out(row_bytes * static_cast<std::size_t>(pixels.height()));
+    for (int y = 0; y < pixels.height(); y++) {
+        const auto* row = reinterpret_cast<const unsigned char*>(written_row(pixels, y, options.flip_vertically));
+        std::copy(row, row + row_bytes, out.begin() + static_cast<std::ptrdiff_t>(static_cast<std::size_t>(y) * row_bytes));
+    }
+    return out;
+}
+
+template <typename T>
+std::vector<unsigned char> encode_image(
+    BasicImageView<const T> pixels, ImageFileFormat format, const ImageWriteOptions& options, ThreadPool& pool)
+{
+    switch (format) {
+    case ImageFileFormat::Png:
+        return encode_png(pixels, options, pool);
+    case ImageFileFormat::Qoi:
+        if constexpr (std::is_same_v<T, unsigned char>) {
+            return encode_qoi(pixels, options);
+        } else {
+            throw std::runtime_error { "QOI files require an 8-bit image." };
+        }
+    case ImageFileFormat::Raw:
+        return encode_raw(pixels, options);
+    }
+    throw std::runtime_error { "Unknown image file format." };
+}
+
+inline ImageFileFormat image_file_format(const std::filesystem::path& file_name, const ImageWriteOptions& options)
+{
+    if (options.format) {
+        return *options.format;
+    }
+    auto extension = file_name.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](char c) { return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); });
+    if (extension == ".png") {
+        return ImageFileFormat::Png;
+    }
+    if (extension == ".qoi") {
+        return ImageFileFormat::Qoi;
+    }
+    if (extension == ".raw" || extension == ".bin") {
+        return ImageFileFormat::Raw;
+    }
+    throw std::runtime_error { "Unknown image file extension: " + file_name.string() };
+}
+
+template <typename T>
+void write_image(BasicImageView<const T> pixels, const std::filesystem::path& file_name, const ImageWriteOptions& options,
+    ThreadPool& pool)
+{
+    auto bytes = encode_image(pixels, image_file_format(file_name, options), options, pool);
+    std::ofstream file { file_name, std::ios::binary | std::ios::trunc };
+    if (!file) {
+        throw std::runtime_error { "Could not create image file: " + file_name.string() };
+    }
+    file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    if (!file) {
+        throw std::runtime_error { "Could not write image file: " + file_name.string() };
+    }
+}
+
+} // namespace detail
+
+/// Encodes 8-bit pixels into the bytes of an image file.
+///
+/// @param pixels Encoded pixels, e.g. an image or a rectangle of one.
+/// @param format File format.
+/// @param options Encoder settings. The format of the options is ignored.
+/// @param pool Pool used by the parallel PNG encoder.
+inline std::vector<unsigned char> encode_image(ConstImageView pixels, ImageFileFormat format,
+    const ImageWriteOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return detail::encode_image(pixels, format, options, pool);
+}
+
+/// Encodes 16-bit pixels into the bytes of a PNG or raw file.
+///
+/// @param pixels Encoded pixels, e.g. an image or a rectangle of one.
+/// @param format File format, PNG or raw.
+/// @param options Encoder settings. The format of the options is ignored.
+/// @param pool Pool used by the parallel PNG encoder.
+inline std::vector<unsigned char> encode_image(ConstImageView16 pixels, ImageFileFormat format,
+    const ImageWriteOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return detail::encode_image(pixels, format, options, pool);
+}
+
+/// Encodes 8-bit pixels and writes them to a file, blocking until done.
+///
+/// @param pixels Written pixels, e.g. an image or a rectangle of one.
+/// @param file_name Path of the file.
+/// @param options Encoder settings.
+/// @param pool Pool used by the parallel PNG encoder.
+inline void write_image(ConstImageView pixels, const std::filesystem::path& file_name, const ImageWriteOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    detail::write_image(pixels, file_name, options, pool);
+}
+
+/// Encodes 16-bit pixels and writes them to a PNG or raw file, blocking until done.
+///
+/// @param pixels Written pixels, e.g. an image or a rectangle of one.
+/// @param file_name Path of the file.
+/// @param options Encoder settings.
+/// @param pool Pool used by the parallel PNG encoder.
+inline void write_image(ConstImageView16 pixels, const std::filesystem::path& file_name,
+    const ImageWriteOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    detail::write_image(pixels, file_name, options, pool);
+}
+
+/// Encodes and writes images on a thread pool, so that the caller only pays
+/// for handing over or copying the pixels.
+///
+/// ```
+/// void draw(GLFWwindow* window)
+/// {
+///     // ...
+///     if (this->m_capture) {
+///         ImageWriteOptions options {};
+///         options.flip_vertically = true;
+///         auto frame = read_framebuffer(0, 0, this->m_width, this->m_height);
+///         this->m_saved.push_back(this->m_writer.write(std::move(frame), "frame.png", options));
+///     }
+/// }
+/// ```
+class ImageWriter {
+public:
+    /// Creates a new writer.
+    ///
+    /// @param pool Pool on which the images are encoded.
+    explicit ImageWriter(ThreadPool& pool = ThreadPool::global())
+        : m_pool { &pool }
+    {
+    }
+
+    /// Starts writing an image in the background, taking over its pixels.
+    ///
+    /// @param image Written image.
+    /// @param file_name Path of the file.
+    /// @param options Encoder settings.
+    /// @return Future becoming ready once the file is written, or receiving the error.
+    template <typename T, int C>
+    std::future<void> write(BasicImage<T, C>&& image, std::filesystem::path file_name, const ImageWriteOptions& options = {})
+    {
+        static_assert(!std::is_same_v<T, float>, "Float images must be converted before being written.");
+        auto* pool = this->m_pool;
+        return pool->submit([image = std::move(image), file_name = std::move(file_name), options, pool] {
+            detail::write_image<T>(image, file_name, options, *pool);
+        });
+    }
+
+    /// Copies 8-bit pixels and starts writing them in the background.
+    ///
+    /// @param pixels Written pixels, e.g. an image or a rectangle of one.
+    /// @param file_name Path of the file.
+    /// @param options Encoder settings.
+    /// @return Future becoming ready once the file is written, or receiving the error.
+    std::future<void> write(ConstImageView pixels, std::filesystem::path file_name, const ImageWriteOptions& options = {})
+    {
+        return this->write(to_image(pixels), std::move(file_name), options);
+    }
+
+    /// Copies 16-bit pixels and starts writing them in the background.
+    ///
+    /// @param pixels Written pixels, e.g. an image or a rectangle of one.
+    /// @param file_name Path of the file.
+    /// @param options Encoder settings.
+    /// @return Future becoming ready once the file is written, or receiving the error.
+    std::future<void> write(ConstImageView16 pixels, std::filesystem::path file_name, const ImageWriteOptions& options = {})
+    {
+        return this->write(to_image(pixels), std::move(file_name), options);
+    }
+
+private:
+    ThreadPool* m_pool;
+};
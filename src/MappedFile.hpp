@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Read-only view of a file mapped into memory.
+class MappedFile {
+public:
+    /// Maps a whole file into memory.
+    ///
+    /// @param file_name Absolute path to the file.
+    explicit MappedFile(const std::filesystem::path& file_name)
+    {
+#ifdef _WIN32
+        HANDLE file = CreateFileW(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error { "Could not open file at path: " + file_name.string() };
+        }
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+            CloseHandle(file);
+            throw std::runtime_error { "Could not query the size of file at path: " + file_name.string() };
+        }
+        this->m_size = static_cast<std::size_t>(size.QuadPart);
+
+        if (this->m_size != 0) {
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (mapping == nullptr) {
+                throw std::runtime_error { "Could not map file at path: " + file_name.string() };
+            }
+
+            void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+            if (data == nullptr) {
+                throw std::runtime_error { "Could not map file at path: " + file_name.string() };
+            }
+            this->m_data = static_cast<const unsigned char*>(data);
+        } else {
+            CloseHandle(file);
+        }
+#else
+        int file = open(file_name.c_str(), O_RDONLY);
+        if (file == -1) {
+            throw std::runtime_error { "Could not open file at path: " + file_name.string() };
+        }
+
+        struct stat stats;
+        if (fstat(file, &stats) == -1) {
+            close(file);
+            throw std::runtime_error { "Could not query the size of file at path: " + file_name.string() };
+        }
+        this->m_size = static_cast<std::size_t>(stats.st_size);
+
+        if (this->m_size != 0) {
+            void* data = mmap(nullptr, this->m_size, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+            if (data == MAP_FAILED) {
+                throw std::runtime_error { "Could not map file at path: " + file_name.string() };
+            }
+            // The decoders read the file front to back exactly once.
+            madvise(data, this->m_size, MADV_SEQUENTIAL);
+            this->m_data = static_cast<const unsigned char*>(data);
+        } else {
+            close(file);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : m_data { other.m_data }
+        , m_size { other.m_size }
+    {
+        other.m_data = nullptr;
+        other.m_size = 0;
+    }
+
+    MappedFile& operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            this->unmap();
+            this->m_data = other.m_data;
+            this->m_size = other.m_size;
+            other.m_data = nullptr;
+            other.m_size = 0;
+        }
+        return *this;
+    }
+
+    ~MappedFile()
+    {
+        this->unmap();
+    }
+
+    /// Returns the contents of the file.
+    ///
+    /// Empty files return a null pointer.
+    const unsigned char* data() const noexcept
+    {
+        return this->m_data;
+    }
+
+    /// Returns the size of the file in bytes.
+    std::size_t size() const noexcept
+    {
+        return this->m_size;
+    }
+
+private:
+    void unmap() noexcept
+    {
+        if (this->m_data == nullptr) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(this->m_data);
+#else
+        munmap(const_cast<unsigned char*>(this->m_data), this->m_size);
+#endif
+        this->m_data = nullptr;
+    }
+
+    const unsigned char* m_data { nullptr };
+    std::size_t m_size { 0 };
+};
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Filter.hpp"
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageResize.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+/// Options of the mip chain generation.
+struct MipmapOptions {
+    /// Filter used to compute each level from the previous one.
+    Filter filter { Filter::Kaiser };
+    /// Whether the color channels of 8-bit images are sRGB encoded.
+    /// Filtering then happens in linear space.
+    bool srgb { true };
+    /// Whether the colors are weighted by alpha while filtering, which keeps
+    /// the color of transparent pixels from bleeding into visible ones.
+    bool alpha_weighted { true };
+    /// Maximum number of levels including the base level, or `0` for a full chain.
+    int max_levels { 0 };
+};
+
+/// Returns the number of levels of a full mip chain for an image size.
+inline int mip_level_count(int width, int height) noexcept
+{
+    int levels = 1;
+    int size = std::max(width, height);
+    while (size > 1) {
+        size /= 2;
+        levels++;
+    }
+    return levels;
+}
+
+/// Returns the size of a mip level along one axis.
+inline int mip_level_size(int size, int level) noexcept
+{
+    return std::max(size >> level, 1);
+}
+
+namespace detail {
+
+/// Linear, optionally alpha weighted, float copy of a mip level.
+using MipWorkImage = BasicImage<float>;
+
+template <typename T, int C>
+void mip_to_work(const BasicImage<T, C>& image, MipWorkImage& work, const MipmapOptions& options, ThreadPool& pool)
+{
+    auto width = static_cast<std::size_t>(image.width());
+    auto channels = image.channels();
+    bool weighted = options.alpha_weighted && has_alpha(channels);
+
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            resample_load_row(image.pixel(0, static_cast<int>(y)), work.pixel(0, static_cast<int>(y)), width, channels,
+                options.srgb, weighted);
+        }
+    });
+}
+
+template <typename T, int C>
+void mip_from_work(const MipWorkImage& work, BasicImage<T, C>& image, const MipmapOptions& options, ThreadPool& pool)
+{
+    auto width = static_cast<std::size_t>(image.width());
+    auto channels = image.channels();
+    bool weighted = options.alpha_weighted && has_alpha(channels);
+
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 16, [&](std::size_t begin, std::size_t end) {
+        std::vector<float> row(width * channels);
+        for (auto y = begin; y < end; y++) {
+            const float* src = work.pixel(0, static_cast<int>(y));
+            std::copy(src, src + row.size(), row.begin());
+            resample_store_row(row.data(), image.pixel(0, static_cast<int>(y)), width, channels, options.srgb, weighted);
+        }
+    });
+}
+
+/// Computes the next level of a linear mip chain with two separable passes.
+inline void mip_downsample(const MipWorkImage& src, MipWorkImage& dst, Filter filter, ThreadPool& pool)
+{
+    int channels = src.channels();
+    ResampleKernel horizontal { filter, src.width(), dst.width(), channels };
+    FilterWeights vertical { filter, src.height(), dst.height() };
+    MipWorkImage temp { dst.width(), src.height(), channels };
+
+    pool.parallel_for(static_cast<std::size_t>(src.height()), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            resample_row(src.pixel(0, static_cast<int>(y)), temp.pixel(0, static_cast<int>(y)), horizontal, dst.width());
+        }
+    });
+
+    auto row_size = static_cast<std::size_t>(dst.width()) * static_cast<std::size_t>(channels);
+    pool.parallel_for(static_cast<std::size_t>(dst.height()), 16, [&](std::size_t begin, std::size_t end) {
+        std::vector<const float*> rows(static_cast<std::size_t>(vertical.taps));
+        for (auto y = begin; y < end; y++) {
+            for (int t = 0; t < vertical.taps; t++) {
+                rows[t] = temp.pixel(0, vertical.first[y] + t);
+            }
+            resample_column(rows.data(), &vertical.weights[y * vertical.taps], vertical.taps,
+                dst.pixel(0, static_cast<int>(y)), row_size);
+        }
+    });
+}
+
+} // namespace detail
+
+/// Generates the mip chain of an image on the CPU.
+///
+/// Every level is filtered from the linear, full precision previous level,
+/// halving each axis with rounding down, so images need not be a power of
+/// two in size. Rows are processed in parallel on the pool.
+///
+/// @param image Base level, moved into the first element of the chain.
+/// @param options Filter settings.
+/// @param pool Pool used to process the rows.
+/// @return All levels, starting with the base level.
+template <typename T, int C>
+std::vector<BasicImage<T, C>> build_mip_chain(
+    BasicImage<T, C>&& image, const MipmapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    int width = image.width();
+    int height = image.height();
+    int channels = image.channels();
+    int levels = mip_level_count(width, height);
+    if (options.max_levels > 0) {
+        levels = std::min(levels, options.max_levels);
+    }
+
+    std::vector<BasicImage<T, C>> chain {};
+    chain.reserve(static_cast<std::size_t>(levels));
+    chain.push_back(std::move(image));
+    if (levels == 1) {
+        return chain;
+    }
+
+    detail::MipWorkImage previous { width, height, channels };
+    detail::mip_to_work(chain.front(), previous, options, pool);
+    for (int level = 1; level < levels; level++) {
+        detail::MipWorkImage next { mip_level_size(width, level), mip_level_size(height, level), channels };
+        detail::mip_downsample(previous, next, options.filter, pool);
+
+        BasicImage<T, C> result { next.width(), next.height(), channels };
+        detail::mip_from_work(next, result, options, pool);
+        chain.push_back(std::move(result));
+        previous = std::move(next);
+    }
+    return chain;
+}
+
+/// Generates the mip chain of an image on the CPU.
+///
+/// @param image Base level, copied into the first element of the chain.
+/// @param options Filter settings.
+/// @param pool Pool used to process the rows.
+/// @return All levels, starting with the base level.
+template <typename T, int C>
+std::vector<BasicImage<T, C>> build_mip_chain(
+    const BasicImage<T, C>& image, const MipmapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    BasicImage<T, C> base { image.width(), image.height(), image.channels() };
+    copy_pixels<T>(image, base);
+    return build_mip_chain(std::move(base), options, pool);
+}
@@ -0,0 +1,1111 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+// Batch procedural noise: Perlin, simplex and Worley noise in 2D and 3D,
+// with fBm and ridged octaves, written straight into images and volumes.
+//
+// The kernels are written once over lane types, evaluating 1, 4 (SSE2) or
+// 8 (AVX2) samples per instruction. Lattice gradients and feature points
+// come from an integer hash of the cell and the seed rather than from a
+// permutation table, so the vector paths need no gathers. The AVX2 path is
+// compiled without FMA and every path performs the same operations in the
+// same order, so all instruction sets give the same values bit for bit,
+// whatever the number of threads.
+
+/// Kinds of noise.
+enum class NoiseType {
+    /// Ken Perlin's improved gradient noise.
+    Perlin,
+    /// Gradient noise on a simplex grid, cheaper in 3D and without axis aligned artifacts.
+    Simplex,
+    /// Distance to the nearest of random feature points, one per cell, as
+    /// cellular patterns; `-1` on the points.
+    Worley,
+};
+
+/// Ways of summing octaves of noise.
+enum class NoiseFractal {
+    /// A single octave.
+    None,
+    /// Fractional Brownian motion, the sum of octaves of decreasing amplitude.
+    Fbm,
+    /// Sum of inverted, squared absolute octaves, giving sharp ridges.
+    Ridged,
+};
+
+/// Options of the generation of noise.
+struct NoiseOptions {
+    NoiseType type { NoiseType::Simplex };
+    NoiseFractal fractal { NoiseFractal::Fbm };
+    /// Seed of the lattice, different seeds giving uncorrelated noise.
+    std::uint32_t seed { 0 };
+    /// Frequency of the first octave, in cycles per pixel or voxel.
+    float frequency { 1.0f / 64.0f };
+    /// Position in noise space of the first pixel or voxel.
+    std::array<float, 3> offset {};
+    /// Number of octaves of the fractals.
+    int octaves { 5 };
+    /// Frequency ratio between two octaves.
+    float lacunarity { 2.0f };
+    /// Amplitude ratio between two octaves.
+    float gain { 0.5f };
+};
+
+// The AVX2 kernels leave FMA out, which would round differently from the
+// other paths. Entry points are flattened so that the generic kernels and
+// the AVX2 lane operations are inlined into them.
+
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define NOISE_TARGET_AVX2 __attribute__((target("avx2")))
+#define NOISE_FLATTEN __attribute__((flatten))
+#else
+#define NOISE_TARGET_AVX2
+#define NOISE_FLATTEN
+#endif
+
+namespace detail {
+
+// Compilers may still fuse a multiply and an add into an FMA when the
+// target allows it, e.g. with `-march=native`, in some paths only:
+// contraction is turned off for the lanes and the kernels, up to
+// `noise_row()`.
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Scalar lanes.
+
+struct NoiseF1 {
+    float v;
+    explicit NoiseF1(float value) noexcept
+        : v { value }
+    {
+    }
+};
+
+struct NoiseI1 {
+    std::uint32_t v;
+    explicit NoiseI1(std::uint32_t value) noexcept
+        : v { value }
+    {
+    }
+};
+
+struct NoiseM1 {
+    bool v;
+};
+
+inline NoiseF1 operator+(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return NoiseF1 { a.v + b.v };
+}
+
+inline NoiseF1 operator-(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return NoiseF1 { a.v - b.v };
+}
+
+inline NoiseF1 operator*(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return NoiseF1 { a.v * b.v };
+}
+
+inline NoiseF1 operator-(NoiseF1 a) noexcept
+{
+    return NoiseF1 { -a.v };
+}
+
+inline NoiseM1 operator>(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return { a.v > b.v };
+}
+
+inline NoiseM1 operator>=(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return { a.v >= b.v };
+}
+
+inline NoiseI1 operator+(NoiseI1 a, NoiseI1 b) noexcept
+{
+    return NoiseI1 { a.v + b.v };
+}
+
+inline NoiseI1 operator*(NoiseI1 a, NoiseI1 b) noexcept
+{
+    return NoiseI1 { a.v * b.v };
+}
+
+inline NoiseI1 operator^(NoiseI1 a, NoiseI1 b) noexcept
+{
+    return NoiseI1 { a.v ^ b.v };
+}
+
+inline NoiseI1 operator&(NoiseI1 a, NoiseI1 b) noexcept
+{
+    return NoiseI1 { a.v & b.v };
+}
+
+inline NoiseI1 operator>>(NoiseI1 a, int bits) noexcept
+{
+    return NoiseI1 { a.v >> bits };
+}
+
+inline NoiseM1 operator==(NoiseI1 a, NoiseI1 b) noexcept
+{
+    return { a.v == b.v };
+}
+
+inline NoiseM1 operator&(NoiseM1 a, NoiseM1 b) noexcept
+{
+    return { a.v && b.v };
+}
+
+inline NoiseM1 operator|(NoiseM1 a, NoiseM1 b) noexcept
+{
+    return { a.v || b.v };
+}
+
+inline NoiseM1 operator!(NoiseM1 a) noexcept
+{
+    return { !a.v };
+}
+
+inline NoiseF1 minimum(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return NoiseF1 { b.v < a.v ? b.v : a.v };
+}
+
+inline NoiseF1 maximum(NoiseF1 a, NoiseF1 b) noexcept
+{
+    return NoiseF1 { b.v > a.v ? b.v : a.v };
+}
+
+inline NoiseF1 absolute(NoiseF1 a) noexcept
+{
+    return NoiseF1 { std::abs(a.v) };
+}
+
+inline NoiseF1 square_root(NoiseF1 a) noexcept
+{
+    return NoiseF1 { std::sqrt(a.v) };
+}
+
+inline NoiseF1 select(NoiseM1 mask, NoiseF1 a, NoiseF1 b) noexcept
+{
+    return mask.v ? a : b;
+}
+
+inline NoiseI1 select(NoiseM1 mask, NoiseI1 a, NoiseI1 b) noexcept
+{
+    return mask.v ? a : b;
+}
+
+inline NoiseM1 nonzero(NoiseI1 a) noexcept
+{
+    return { a.v != 0 };
+}
+
+inline NoiseF1 to_float(NoiseI1 a) noexcept
+{
+    return NoiseF1 { static_cast<float>(static_cast<std::int32_t>(a.v)) };
+}
+
+inline NoiseI1 floor_to_int(NoiseF1 a) noexcept
+{
+    auto truncated = static_cast<std::int32_t>(a.v);
+    truncated -= static_cast<float>(truncated) > a.v ? 1 : 0;
+    return NoiseI1 { static_cast<std::uint32_t>(truncated) };
+}
+
+struct NoiseLanes1 {
+    using F = NoiseF1;
+    using I = NoiseI1;
+    static constexpr std::size_t size = 1;
+    static F load(const float* src) noexcept
+    {
+        return F { *src };
+    }
+    static void store(float* dst, F value) noexcept
+    {
+        *dst = value.v;
+    }
+};
+
+#if SIMD_X86
+
+// SSE2 lanes.
+
+struct NoiseF4 {
+    __m128 v;
+    explicit NoiseF4(__m128 value) noexcept
+        : v { value }
+    {
+    }
+    explicit NoiseF4(float value) noexcept
+        : v { _mm_set1_ps(value) }
+    {
+    }
+};
+
+struct NoiseI4 {
+    __m128i v;
+    explicit NoiseI4(__m128i value) noexcept
+        : v { value }
+    {
+    }
+    explicit NoiseI4(std::uint32_t value) noexcept
+        : v { _mm_set1_epi32(static_cast<int>(value)) }
+    {
+    }
+};
+
+struct NoiseM4 {
+    __m128 v;
+};
+
+inline NoiseF4 operator+(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_add_ps(a.v, b.v) };
+}
+
+inline NoiseF4 operator-(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_sub_ps(a.v, b.v) };
+}
+
+inline NoiseF4 operator*(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_mul_ps(a.v, b.v) };
+}
+
+inline NoiseF4 operator-(NoiseF4 a) noexcept
+{
+    return NoiseF4 { _mm_xor_ps(a.v, _mm_set1_ps(-0.0f)) };
+}
+
+inline NoiseM4 operator>(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return { _mm_cmpgt_ps(a.v, b.v) };
+}
+
+inline NoiseM4 operator>=(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return { _mm_cmpge_ps(a.v, b.v) };
+}
+
+inline NoiseI4 operator+(NoiseI4 a, NoiseI4 b) noexcept
+{
+    return NoiseI4 { _mm_add_epi32(a.v, b.v) };
+}
+
+inline NoiseI4 operator^(NoiseI4 a, NoiseI4 b) noexcept
+{
+    return NoiseI4 { _mm_xor_si128(a.v, b.v) };
+}
+
+inline NoiseI4 operator&(NoiseI4 a, NoiseI4 b) noexcept
+{
+    return NoiseI4 { _mm_and_si128(a.v, b.v) };
+}
+
+inline NoiseI4 operator>>(NoiseI4 a, int bits) noexcept
+{
+    return NoiseI4 { _mm_srli_epi32(a.v, bits) };
+}
+
+inline NoiseM4 operator&(NoiseM4 a, NoiseM4 b) noexcept
+{
+    return { _mm_and_ps(a.v, b.v) };
+}
+
+inline NoiseM4 operator|(NoiseM4 a, NoiseM4 b) noexcept
+{
+    return { _mm_or_ps(a.v, b.v) };
+}
+
+inline NoiseM4 operator!(NoiseM4 a) noexcept
+{
+    return { _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_set1_epi32(-1))) };
+}
+
+inline NoiseF4 minimum(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_min_ps(a.v, b.v) };
+}
+
+inline NoiseF4 maximum(NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_max_ps(a.v, b.v) };
+}
+
+inline NoiseF4 absolute(NoiseF4 a) noexcept
+{
+    return NoiseF4 { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) };
+}
+
+inline NoiseF4 square_root(NoiseF4 a) noexcept
+{
+    return NoiseF4 { _mm_sqrt_ps(a.v) };
+}
+
+inline NoiseF4 to_float(NoiseI4 a) noexcept
+{
+    return NoiseF4 { _mm_cvtepi32_ps(a.v) };
+}
+
+inline NoiseI4 operator*(NoiseI4 a, NoiseI4 b) noexcept
+{
+    // SSE2 only multiplies the even lanes, so the odd ones are shifted down.
+    __m128i even = _mm_mul_epu32(a.v, b.v);
+    __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a.v, 32), _mm_srli_epi64(b.v, 32));
+    return NoiseI4 { _mm_unpacklo_epi32(
+        _mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0))) };
+}
+
+inline NoiseM4 operator==(NoiseI4 a, NoiseI4 b) noexcept
+{
+    return { _mm_castsi128_ps(_mm_cmpeq_epi32(a.v, b.v)) };
+}
+
+inline NoiseF4 select(NoiseM4 mask, NoiseF4 a, NoiseF4 b) noexcept
+{
+    return NoiseF4 { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+
+inline NoiseI4 select(NoiseM4 mask, NoiseI4 a, NoiseI4 b) noexcept
+{
+    __m128i bits = _mm_castps_si128(mask.v);
+    return NoiseI4 { _mm_or_si128(_mm_and_si128(bits, a.v), _mm_andnot_si128(bits, b.v)) };
+}
+
+inline NoiseM4 nonzero(NoiseI4 a) noexcept
+{
+    return !(a == NoiseI4 { 0u });
+}
+
+inline NoiseI4 floor_to_int(NoiseF4 a) noexcept
+{
+    __m128i truncated = _mm_cvttps_epi32(a.v);
+    __m128 above = _mm_cmpgt_ps(_mm_cvtepi32_ps(truncated), a.v);
+    return NoiseI4 { _mm_add_epi32(truncated, _mm_castps_si128(above)) };
+}
+
+struct NoiseLanes4 {
+    using F = NoiseF4;
+    using I = NoiseI4;
+    static constexpr std::size_t size = 4;
+    static F load(const float* src) noexcept
+    {
+        return F { _mm_loadu_ps(src) };
+    }
+    static void store(float* dst, F value) noexcept
+    {
+        _mm_storeu_ps(dst, value.v);
+    }
+};
+
+// AVX2 lanes.
+//
+// The generic kernels are compiled without AVX2 and call the AVX2 lane
+// operations, which disagree with them on how to pass 32-byte vectors in
+// registers unless everything is inlined, as it is not at -O0. Copies go
+// through user-provided constructors so that the lanes are always passed
+// and returned through memory instead.
+
+struct NoiseF8 {
+    __m256 v;
+    NOISE_TARGET_AVX2 explicit NoiseF8(__m256 value) noexcept
+        : v { value }
+    {
+    }
+    NOISE_TARGET_AVX2 explicit NoiseF8(float value) noexcept
+        : v { _mm256_set1_ps(value) }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseF8(const NoiseF8& other) noexcept
+        : v { other.v }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseF8& operator=(const NoiseF8& other) noexcept
+    {
+        this->v = other.v;
+        return *this;
+    }
+};
+
+struct NoiseI8 {
+    __m256i v;
+    NOISE_TARGET_AVX2 explicit NoiseI8(__m256i value) noexcept
+        : v { value }
+    {
+    }
+    NOISE_TARGET_AVX2 explicit NoiseI8(std::uint32_t value) noexcept
+        : v { _mm256_set1_epi32(static_cast<int>(value)) }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseI8(const NoiseI8& other) noexcept
+        : v { other.v }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseI8& operator=(const NoiseI8& other) noexcept
+    {
+        this->v = other.v;
+        return *this;
+    }
+};
+
+struct NoiseM8 {
+    __m256 v;
+    NOISE_TARGET_AVX2 explicit NoiseM8(__m256 value) noexcept
+        : v { value }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseM8(const NoiseM8& other) noexcept
+        : v { other.v }
+    {
+    }
+    NOISE_TARGET_AVX2 NoiseM8& operator=(const NoiseM8& other) noexcept
+    {
+        this->v = other.v;
+        return *this;
+    }
+};
+
+NOISE_TARGET_AVX2 inline NoiseF8 operator+(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_add_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 operator-(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_sub_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 operator*(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_mul_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 operator-(NoiseF8 a) noexcept
+{
+    return NoiseF8 { _mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator>(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseM8 { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator>=(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseM8 { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 operator+(NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseI8 { _mm256_add_epi32(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 operator*(NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseI8 { _mm256_mullo_epi32(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 operator^(NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseI8 { _mm256_xor_si256(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 operator&(NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseI8 { _mm256_and_si256(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 operator>>(NoiseI8 a, int bits) noexcept
+{
+    return NoiseI8 { _mm256_srli_epi32(a.v, bits) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator==(NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseM8 { _mm256_castsi256_ps(_mm256_cmpeq_epi32(a.v, b.v)) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator&(NoiseM8 a, NoiseM8 b) noexcept
+{
+    return NoiseM8 { _mm256_and_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator|(NoiseM8 a, NoiseM8 b) noexcept
+{
+    return NoiseM8 { _mm256_or_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 operator!(NoiseM8 a) noexcept
+{
+    return NoiseM8 { _mm256_xor_ps(a.v, _mm256_castsi256_ps(_mm256_set1_epi32(-1))) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 minimum(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_min_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 maximum(NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_max_ps(a.v, b.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 absolute(NoiseF8 a) noexcept
+{
+    return NoiseF8 { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 square_root(NoiseF8 a) noexcept
+{
+    return NoiseF8 { _mm256_sqrt_ps(a.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 to_float(NoiseI8 a) noexcept
+{
+    return NoiseF8 { _mm256_cvtepi32_ps(a.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseF8 select(NoiseM8 mask, NoiseF8 a, NoiseF8 b) noexcept
+{
+    return NoiseF8 { _mm256_blendv_ps(b.v, a.v, mask.v) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseM8 nonzero(NoiseI8 a) noexcept
+{
+    return !(a == NoiseI8 { 0u });
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 select(NoiseM8 mask, NoiseI8 a, NoiseI8 b) noexcept
+{
+    return NoiseI8 { _mm256_castps_si256(
+        _mm256_blendv_ps(_mm256_castsi256_ps(b.v), _mm256_castsi256_ps(a.v), mask.v)) };
+}
+
+NOISE_TARGET_AVX2 inline NoiseI8 floor_to_int(NoiseF8 a) noexcept
+{
+    __m256i truncated = _mm256_cvttps_epi32(a.v);
+    __m256 above = _mm256_cmp_ps(_mm256_cvtepi32_ps(truncated), a.v, _CMP_GT_OQ);
+    return NoiseI8 { _mm256_add_epi32(truncated, _mm256_castps_si256(above)) };
+}
+
+struct NoiseLanes8 {
+    using F = NoiseF8;
+    using I = NoiseI8;
+    static constexpr std::size_t size = 8;
+    NOISE_TARGET_AVX2 static F load(const float* src) noexcept
+    {
+        return F { _mm256_loadu_ps(src) };
+    }
+    NOISE_TARGET_AVX2 static void store(float* dst, F value) noexcept
+    {
+        _mm256_storeu_ps(dst, value.v);
+    }
+};
+
+#endif
+
+// Kernels, generic over the lanes. Arguments are passed by reference since
+// the generic functions are not compiled for AVX2 until they are inlined.
+
+template <typename I>
+I noise_hash(const I& x, const I& y, const I& z, const I& seed)
+{
+    I h = seed ^ (x * I { 0x8da6b343u }) ^ (y * I { 0xd8163841u }) ^ (z * I { 0xcb1ab31fu });
+    h = h ^ (h >> 16);
+    h = h * I { 0x7feb352du };
+    h = h ^ (h >> 15);
+    h = h * I { 0x846ca68bu };
+    return h ^ (h >> 16);
+}
+
+template <typename I>
+I noise_hash(const I& x, const I& y, const I& seed)
+{
+    I h = seed ^ (x * I { 0x8da6b343u }) ^ (y * I { 0xd8163841u });
+    h = h ^ (h >> 16);
+    h = h * I { 0x7feb352du };
+    h = h ^ (h >> 15);
+    h = h * I { 0x846ca68bu };
+    return h ^ (h >> 16);
+}
+
+/// Dot product with one of the 8 gradients `(±1, ±1)`, `(±1, 0)` and `(0, ±1)`.
+template <typename F, typename I>
+F noise_gradient(const I& hash, const F& x, const F& y)
+{
+    F a = select(nonzero(hash & I { 1u }), -x, x);
+    F b = select(nonzero(hash & I { 2u }), -y, y);
+    F axis = select(nonzero(hash & I { 1u }), y, x);
+    return select(nonzero(hash & I { 4u }), select(nonzero(hash & I { 2u }), -axis, axis), a + b);
+}
+
+/// Dot product with one of the 12 gradients toward the edges of a cube, as
+/// in Perlin's improved noise.
+template <typename F, typename I>
+F noise_gradient(const I& hash, const F& x, const F& y, const F& z)
+{
+    I h = hash & I { 15u };
+    F u = select(nonzero(h & I { 8u }), y, x);
+    auto xz = (h & I { 13u }) == I { 12u };
+    F v = select(nonzero(h & I { 12u }), select(xz, x, z), y);
+    return select(nonzero(h & I { 1u }), -u, u) + select(nonzero(h & I { 2u }), -v, v);
+}
+
+template <typename F>
+F noise_fade(const F& t)
+{
+    return t * t * t * (t * (t * F { 6.0f } - F { 15.0f }) + F { 10.0f });
+}
+
+template <typename F>
+F noise_lerp(const F& a, const F& b, const F& t)
+{
+    return a + t * (b - a);
+}
+
+template <typename L>
+typename L::F perlin_noise(const typename L::F& x, const typename L::F& y, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    I ix = floor_to_int(x);
+    I iy = floor_to_int(y);
+    F fx = x - to_float(ix);
+    F fy = y - to_float(iy);
+    I jx = ix + I { 1u };
+    I jy = iy + I { 1u };
+    F gx = fx - F { 1.0f };
+    F gy = fy - F { 1.0f };
+    F n00 = noise_gradient(noise_hash(ix, iy, seed), fx, fy);
+    F n10 = noise_gradient(noise_hash(jx, iy, seed), gx, fy);
+    F n01 = noise_gradient(noise_hash(ix, jy, seed), fx, gy);
+    F n11 = noise_gradient(noise_hash(jx, jy, seed), gx, gy);
+    F u = noise_fade(fx);
+    return noise_lerp(noise_lerp(n00, n10, u), noise_lerp(n01, n11, u), noise_fade(fy));
+}
+
+template <typename L>
+typename L::F perlin_noise(
+    const typename L::F& x, const typename L::F& y, const typename L::F& z, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    I ix = floor_to_int(x);
+    I iy = floor_to_int(y);
+    I iz = floor_to_int(z);
+    F fx = x - to_float(ix);
+    F fy = y - to_float(iy);
+    F fz = z - to_float(iz);
+    I jx = ix + I { 1u };
+    I jy = iy + I { 1u };
+    I jz = iz + I { 1u };
+    F gx = fx - F { 1.0f };
+    F gy = fy - F { 1.0f };
+    F gz = fz - F { 1.0f };
+    F u = noise_fade(fx);
+    F v = noise_fade(fy);
+    F near = noise_lerp(noise_lerp(noise_gradient(noise_hash(ix, iy, iz, seed), fx, fy, fz),
+                            noise_gradient(noise_hash(jx, iy, iz, seed), gx, fy, fz), u),
+        noise_lerp(noise_gradient(noise_hash(ix, jy, iz, seed), fx, gy, fz),
+            noise_gradient(noise_hash(jx, jy, iz, seed), gx, gy, fz), u),
+        v);
+    F far = noise_lerp(noise_lerp(noise_gradient(noise_hash(ix, iy, jz, seed), fx, fy, gz),
+                           noise_gradient(noise_hash(jx, iy, jz, seed), gx, fy, gz), u),
+        noise_lerp(noise_gradient(noise_hash(ix, jy, jz, seed), fx, gy, gz),
+            noise_gradient(noise_hash(jx, jy, jz, seed), gx, gy, gz), u),
+        v);
+    return noise_lerp(near, far, noise_fade(fz));
+}
+
+template <typename L>
+typename L::F simplex_noise(const typename L::F& x, const typename L::F& y, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    // Skews the plane so that the simplices become half squares.
+    const F skew { 0.366025403784f };
+    const F unskew { 0.211324865405f };
+    F s = (x + y) * skew;
+    I i = floor_to_int(x + s);
+    I j = floor_to_int(y + s);
+    F t = to_float(i + j) * unskew;
+    F x0 = x - (to_float(i) - t);
+    F y0 = y - (to_float(j) - t);
+
+    // The middle corner is one step along the larger coordinate.
+    auto lower = x0 > y0;
+    F i1 = select(lower, F { 1.0f }, F { 0.0f });
+    F j1 = select(lower, F { 0.0f }, F { 1.0f });
+    F x1 = x0 - i1 + unskew;
+    F y1 = y0 - j1 + unskew;
+    F x2 = x0 - F { 1.0f } + unskew + unskew;
+    F y2 = y0 - F { 1.0f } + unskew + unskew;
+    I h0 = noise_hash(i, j, seed);
+    I h1 = noise_hash(i + select(lower, I { 1u }, I { 0u }), j + select(lower, I { 0u }, I { 1u }), seed);
+    I h2 = noise_hash(i + I { 1u }, j + I { 1u }, seed);
+
+    auto corner = [](const F& cx, const F& cy, const I& hash) {
+        F falloff = maximum(F { 0.5f } - cx * cx - cy * cy, F { 0.0f });
+        falloff = falloff * falloff;
+        return falloff * falloff * noise_gradient(hash, cx, cy);
+    };
+    return (corner(x0, y0, h0) + corner(x1, y1, h1) + corner(x2, y2, h2)) * F { 70.0f };
+}
+
+template <typename L>
+typename L::F simplex_noise(
+    const typename L::F& x, const typename L::F& y, const typename L::F& z, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    const F skew { 1.0f / 3.0f };
+    const F unskew { 1.0f / 6.0f };
+    F s = (x + y + z) * skew;
+    I i = floor_to_int(x + s);
+    I j = floor_to_int(y + s);
+    I k = floor_to_int(z + s);
+    F t = to_float(i + j + k) * unskew;
+    F x0 = x - (to_float(i) - t);
+    F y0 = y - (to_float(j) - t);
+    F z0 = z - (to_float(k) - t);
+
+    // The two middle corners step along the coordinates from the largest.
+    auto x_ge_y = x0 >= y0;
+    auto y_ge_z = y0 >= z0;
+    auto x_ge_z = x0 >= z0;
+    auto i1 = x_ge_y & x_ge_z;
+    auto j1 = (!x_ge_y) & y_ge_z;
+    auto k1 = (!x_ge_z) & (!y_ge_z);
+    auto i2 = x_ge_y | x_ge_z;
+    auto j2 = (!x_ge_y) | y_ge_z;
+    auto k2 = !(x_ge_z & y_ge_z);
+    const F one { 1.0f };
+    const F zero { 0.0f };
+    const I step { 1u };
+    const I stay { 0u };
+
+    auto corner = [](const F& cx, const F& cy, const F& cz, const I& hash) {
+        F falloff = maximum(F { 0.6f } - cx * cx - cy * cy - cz * cz, F { 0.0f });
+        falloff = falloff * falloff;
+        return falloff * falloff * noise_gradient(hash, cx, cy, cz);
+    };
+    F n = corner(x0, y0, z0, noise_hash(i, j, k, seed));
+    n = n
+        + corner(x0 - select(i1, one, zero) + unskew, y0 - select(j1, one, zero) + unskew,
+            z0 - select(k1, one, zero) + unskew,
+            noise_hash(i + select(i1, step, stay), j + select(j1, step, stay), k + select(k1, step, stay), seed));
+    n = n
+        + corner(x0 - select(i2, one, zero) + unskew + unskew, y0 - select(j2, one, zero) + unskew + unskew,
+            z0 - select(k2, one, zero) + unskew + unskew,
+            noise_hash(i + select(i2, step, stay), j + select(j2, step, stay), k + select(k2, step, stay), seed));
+    F half { 0.5f };
+    n = n + corner(x0 - half, y0 - half, z0 - half, noise_hash(i + step, j + step, k + step, seed));
+    return n * F { 32.0f };
+}
+
+template <typename L>
+typename L::F worley_noise(const typename L::F& x, const typename L::F& y, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    I ix = floor_to_int(x);
+    I iy = floor_to_int(y);
+    F fx = x - to_float(ix);
+    F fy = y - to_float(iy);
+    F nearest { 8.0f };
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            I hash = noise_hash(
+                ix + I { static_cast<std::uint32_t>(dx) }, iy + I { static_cast<std::uint32_t>(dy) }, seed);
+            F px = F { static_cast<float>(dx) } + to_float(hash & I { 0xffffu }) * F { 1.0f / 65536.0f } - fx;
+            F py = F { static_cast<float>(dy) } + to_float(hash >> 16) * F { 1.0f / 65536.0f } - fy;
+            nearest = minimum(nearest, px * px + py * py);
+        }
+    }
+    return square_root(nearest) * F { 2.0f } - F { 1.0f };
+}
+
+template <typename L>
+typename L::F worley_noise(
+    const typename L::F& x, const typename L::F& y, const typename L::F& z, const typename L::I& seed)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    I ix = floor_to_int(x);
+    I iy = floor_to_int(y);
+    I iz = floor_to_int(z);
+    F fx = x - to_float(ix);
+    F fy = y - to_float(iy);
+    F fz = z - to_float(iz);
+    const F scale { 1.0f / 1024.0f };
+    const I mask { 1023u };
+    F nearest { 8.0f };
+    for (int dz = -1; dz <= 1; dz++) {
+        for (int dy = -1; dy <= 1; dy++) {
+            for (int dx = -1; dx <= 1; dx++) {
+                I hash = noise_hash(ix + I { static_cast<std::uint32_t>(dx) }, iy + I { static_cast<std::uint32_t>(dy) },
+                    iz + I { static_cast<std::uint32_t>(dz) }, seed);
+                F px = F { static_cast<float>(dx) } + to_float(hash & mask) * scale - fx;
+                F py = F { static_cast<float>(dy) } + to_float((hash >> 10) & mask) * scale - fy;
+                F pz = F { static_cast<float>(dz) } + to_float((hash >> 20) & mask) * scale - fz;
+                nearest = minimum(nearest, px * px + py * py + pz * pz);
+            }
+        }
+    }
+    return square_root(nearest) * F { 2.0f } - F { 1.0f };
+}
+
+template <typename L>
+typename L::F noise_sample(NoiseType type, bool volume, const typename L::F& x, const typename L::F& y,
+    const typename L::F& z, const typename L::I& seed)
+{
+    switch (type) {
+    case NoiseType::Perlin:
+        return volume ? perlin_noise<L>(x, y, z, seed) : perlin_noise<L>(x, y, seed);
+    case NoiseType::Simplex:
+        return volume ? simplex_noise<L>(x, y, z, seed) : simplex_noise<L>(x, y, seed);
+    default:
+        return volume ? worley_noise<L>(x, y, z, seed) : worley_noise<L>(x, y, seed);
+    }
+}
+
+/// Scalar settings of a row of noise, shared by every lane.
+struct NoiseRow {
+    /// Coordinate of every sample along the row, before the octave scaling.
+    const float* x;
+    float y;
+    float z;
+    /// Number of samples, a multiple of 8.
+    std::size_t count;
+    /// Whether the noise is 3D.
+    bool volume;
+    std::uint32_t seed;
+};
+
+template <typename L>
+void noise_row_lanes(const NoiseRow& row, const NoiseOptions& options, float* out)
+{
+    using F = typename L::F;
+    using I = typename L::I;
+    int octaves = options.fractal == NoiseFractal::None ? 1 : options.octaves;
+    float total = 0.0f;
+    float amplitude = 1.0f;
+    for (int octave = 0; octave < octaves; octave++) {
+        total += amplitude;
+        amplitude *= options.gain;
+    }
+    float normalization = 1.0f / total;
+    bool ridged = options.fractal == NoiseFractal::Ridged;
+
+    for (std::size_t i = 0; i < row.count; i += L::size) {
+        F x = L::load(row.x + i);
+        F sum { 0.0f };
+        float frequency = 1.0f;
+        amplitude = 1.0f;
+        for (int octave = 0; octave < octaves; octave++) {
+            I seed { row.seed + static_cast<std::uint32_t>(octave) * 0x85ebca6bu };
+            F n = noise_sample<L>(
+                options.type, row.volume, x * F { frequency }, F { row.y * frequency }, F { row.z * frequency }, seed);
+            if (ridged) {
+                n = F { 1.0f } - absolute(n);
+                n = n * n;
+            }
+            sum = sum + n * F { amplitude };
+            frequency *= options.lacunarity;
+            amplitude *= options.gain;
+        }
+        sum = sum * F { normalization };
+        if (ridged) {
+            sum = sum * F { 2.0f } - F { 1.0f };
+        }
+        L::store(out + i, sum);
+    }
+}
+
+inline void noise_row_scalar(const NoiseRow& row, const NoiseOptions& options, float* out)
+{
+    noise_row_lanes<NoiseLanes1>(row, options, out);
+}
+
+#if SIMD_X86
+inline void noise_row_sse2(const NoiseRow& row, const NoiseOptions& options, float* out)
+{
+    noise_row_lanes<NoiseLanes4>(row, options, out);
+}
+
+NOISE_TARGET_AVX2 NOISE_FLATTEN inline void noise_row_avx2(const NoiseRow& row, const NoiseOptions& options, float* out)
+{
+    noise_row_lanes<NoiseLanes8>(row, options, out);
+}
+#endif
+
+/// Computes a row of noise with the best instruction set.
+inline void noise_row(const NoiseRow& row, const NoiseOptions& options, float* out)
+{
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        noise_row_avx2(row, options, out);
+    } else {
+        noise_row_sse2(row, options, out);
+    }
+#else
+    noise_row_scalar(row, options, out);
+#endif
+}
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+inline void validate_noise_options(const NoiseOptions& options)
+{
+    if (options.octaves < 1 || options.octaves > 32 || !(options.gain > 0.0f)) {
+        throw std::runtime_error { "Invalid noise octaves." };
+    }
+}
+
+/// Returns the sample coordinates along a row, padded to a multiple of 8.
+inline std::vector<float> noise_coordinates(int count, float frequency, float offset)
+{
+    std::vector<float> coordinates((static_cast<std::size_t>(count) + 7) / 8 * 8);
+    for (std::size_t i = 0; i < coordinates.size(); i++) {
+        coordinates[i] = static_cast<float>(i) * frequency + offset;
+    }
+    return coordinates;
+}
+
+} // namespace detail
+
+/// Fills an image with 2D noise.
+///
+/// Float images get the noise values, roughly within `[-1, 1]`. 8 and
+/// 16-bit images get them remapped to `[0, 1]`, clamped. Every channel
+/// is seeded differently from the others.
+///
+/// @param image Destination pixels.
+/// @param options Kind of noise, frequency and octaves.
+/// @param pool Pool processing the rows.
+template <typename T>
+void fill_noise(BasicImageView<T> image, const NoiseOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    detail::validate_noise_options(options);
+    int width = image.width();
+    auto channels = static_cast<std::size_t>(image.channels());
+    auto xs = detail::noise_coordinates(width, options.frequency, options.offset[0]);
+
+    pool.parallel_for(static_cast<std::size_t>(image.height()), 8, [&](std::size_t begin, std::size_t end) {
+        std::vector<float> noise(xs.size());
+        std::vector<float> pixels(static_cast<std::size_t>(width) * channels);
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            float row_y = static_cast<float>(y) * options.frequency + options.offset[1];
+            for (std::size_t c = 0; c < channels; c++) {
+                auto seed = options.seed + static_cast<std::uint32_t>(c) * 0x9e3779b9u;
+                detail::noise_row({ xs.data(), row_y, options.offset[2], xs.size(), false, seed }, options, noise.data());
+                for (std::size_t x = 0; x < static_cast<std::size_t>(width); x++) {
+                    pixels[x * channels + c] = noise[x];
+                }
+            }
+
+            if constexpr (std::is_same_v<T, float>) {
+                std::copy(pixels.begin(), pixels.end(), image.row(y));
+            } else {
+                for (auto& value : pixels) {
+                    value = 0.5f + 0.5f * value;
+                }
+                if constexpr (std::is_same_v<T, unsigned char>) {
+                    float_to_unorm8(pixels.data(), image.row(y), pixels.size());
+                } else {
+                    float_to_unorm16(pixels.data(), image.row(y), pixels.size());
+                }
+            }
+        }
+    });
+}
+
+/// Fills an image with 2D noise.
+///
+/// @param image Destination image.
+/// @param options Kind of noise, frequency and octaves.
+/// @param pool Pool processing the rows.
+template <typename T, int C>
+void fill_noise(BasicImage<T, C>& image, const NoiseOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    fill_noise(BasicImageView<T> { image }, options, pool);
+}
+
+/// Returns a single channel float image of 2D noise, e.g. a heightmap.
+///
+/// @param width,height Size of the image.
+/// @param options Kind of noise, frequency and octaves.
+/// @param pool Pool processing the rows.
+inline ImageR32F noise_image(
+    int width, int height, const NoiseOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    ImageR32F image { width, height };
+    fill_noise(image, options, pool);
+    return image;
+}
+
+/// Fills a volume with 3D noise.
+///
+/// @param grid Destination of `width * height * depth` values, x varying
+/// fastest and z slowest.
+/// @param width,height,depth Size of the volume in voxels.
+/// @param options Kind of noise, frequency and octaves.
+/// @param pool Pool processing the rows of every slice.
+inline void fill_noise_volume(float* grid, int width, int height, int depth, const NoiseOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    detail::validate_noise_options(options);
+    auto xs = detail::noise_coordinates(width, options.frequency, options.offset[0]);
+    auto rows = static_cast<std::size_t>(height);
+    pool.parallel_for(rows * static_cast<std::size_t>(depth), 8, [&](std::size_t begin, std::size_t end) {
+        std::vector<float> noise(xs.size());
+        for (auto i = begin; i < end; i++) {
+            float y = static_cast<float>(i % rows) * options.frequency + options.offset[1];
+            float z = static_cast<float>(i / rows) * options.frequency + options.offset[2];
+            detail::noise_row({ xs.data(), y, z, xs.size(), true, options.seed }, options, noise.data());
+            std::copy_n(noise.data(), width, grid + i * static_cast<std::size_t>(width));
+        }
+    });
+}
+
+/// Returns a volume of 3D noise, x varying fastest and z slowest.
+///
+/// @param width,height,depth Size of the volume in voxels.
+/// @param options Kind of noise, frequency and octaves.
+/// @param pool Pool processing the rows of every slice.
+inline std::vector<float> noise_volume(
+    int width, int height, int depth, const NoiseOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    std::vector<float> grid(static_cast<std::size_t>(width) * static_cast<std::size_t>(height)
+        * static_cast<std::size_t>(depth));
+    fill_noise_volume(grid.data(), width, height, depth, options, pool);
+    return grid;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define SIMD_X86 0
+#endif
+
+// Marks functions compiled for AVX2 regardless of the flags of the translation
+// unit. Such functions may only be called after checking `simd_level()`.
+#if SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+/// Instruction sets usable by the vectorized kernels.
+enum class SimdLevel {
+    /// Plain C++.
+    Scalar = 0,
+    /// SSE2, always available on x86-64.
+    SSE2 = 1,
+    /// AVX2 and FMA.
+    AVX2 = 2,
+};
+
+/// Returns the best instruction set supported by the running CPU.
+inline SimdLevel simd_level() noexcept
+{
+#if SIMD_X86
+    static const SimdLevel level = [] {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return SimdLevel::SSE2;
+        }
+        __cpuid(info, 1);
+        bool fma = (info[2] & (1 << 12)) != 0;
+        bool os_avx = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        __cpuidex(info, 7, 0);
+        bool avx2 = (info[1] & (1 << 5)) != 0;
+        return avx2 && fma && os_avx ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#else
+        __builtin_cpu_init();
+        bool avx2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+        return avx2 ? SimdLevel::AVX2 : SimdLevel::SSE2;
+#endif
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
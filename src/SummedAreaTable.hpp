@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+// Summed-area tables, answering the sum of any rectangle of an image with
+// four reads, whatever its size.
+//
+// The table is one row and one column larger than the image, the first ones
+// being zero, so that entry `(x, y)` holds the sum of the pixels above and to
+// the left of pixel `(x, y)`. It is built in two parallel passes: prefix sums
+// along every row, then running sums down bands of columns, which vectorize
+// across the columns.
+
+/// Summed-area table of an image.
+///
+/// Integer tables wrap around on overflow. Since the sum of a rectangle is
+/// computed with modular arithmetic too, it stays exact as long as the sum
+/// itself fits, whatever the size of the image: 32-bit tables are exact for
+/// rectangles of up to 2^24 8-bit pixels.
+///
+/// @tparam T Type of the accumulators, `std::uint32_t` or `std::uint64_t`
+/// for 8 and 16-bit images, `double` for float images.
+template <typename T>
+class BasicSummedAreaTable {
+public:
+    static_assert(std::is_same_v<T, std::uint32_t> || std::is_same_v<T, std::uint64_t> || std::is_same_v<T, double>,
+        "Summed-area tables accumulate in 32 or 64-bit integers, or doubles.");
+
+    /// Builds the table of an image.
+    ///
+    /// @param image Source pixels, summed as stored.
+    /// @param squared Whether the table sums the squares of the values, e.g.
+    /// to get the variance of regions along with a table of the values.
+    /// @param pool Pool processing the rows and then bands of columns.
+    template <typename V>
+    explicit BasicSummedAreaTable(
+        BasicImageView<const V> image, bool squared = false, ThreadPool& pool = ThreadPool::global())
+        : m_width { image.width() }
+        , m_height { image.height() }
+        , m_channels { image.channels() }
+        , m_stride { (static_cast<std::size_t>(image.width()) + 1) * static_cast<std::size_t>(image.channels()) }
+        , m_table(this->m_stride * (static_cast<std::size_t>(image.height()) + 1), T {})
+    {
+        static_assert(std::is_integral_v<V> == std::is_integral_v<T>,
+            "Float images are summed in doubles, and integer images in integers.");
+        auto channels = static_cast<std::size_t>(this->m_channels);
+        auto width = static_cast<std::size_t>(this->m_width);
+
+        pool.parallel_for(static_cast<std::size_t>(this->m_height), 16, [&](std::size_t begin, std::size_t end) {
+            std::vector<T> running(channels);
+            for (auto y = begin; y < end; y++) {
+                const V* in = image.row(static_cast<int>(y));
+                T* out = this->m_table.data() + (y + 1) * this->m_stride + channels;
+                std::fill(running.begin(), running.end(), T {});
+                for (std::size_t x = 0; x < width; x++) {
+                    for (std::size_t c = 0; c < channels; c++) {
+                        auto value = static_cast<T>(in[x * channels + c]);
+                        running[c] += squared ? value * value : value;
+                        out[x * channels + c] = running[c];
+                    }
+                }
+            }
+        });
+
+        // Bands of a few kilobytes per row, so that every task streams
+        // through the rows with the band in the L1 cache.
+        constexpr std::size_t band = 1024;
+        auto bands = (this->m_stride + band - 1) / band;
+        pool.parallel_for(bands, 1, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; i++) {
+                auto first = i * band;
+                auto count = std::min(band, this->m_stride - first);
+                for (int y = 2; y <= this->m_height; y++) {
+                    T* row = this->m_table.data() + static_cast<std::size_t>(y) * this->m_stride + first;
+                    const T* above = row - this->m_stride;
+                    for (std::size_t x = 0; x < count; x++) {
+                        row[x] += above[x];
+                    }
+                }
+            }
+        });
+    }
+
+    /// Builds the table of an image.
+    ///
+    /// @param image Source pixels, summed as stored.
+    /// @param squared Whether the table sums the squares of the values.
+    /// @param pool Pool processing the rows and then bands of columns.
+    template <typename V, int C>
+    explicit BasicSummedAreaTable(
+        const BasicImage<V, C>& image, bool squared = false, ThreadPool& pool = ThreadPool::global())
+        : BasicSummedAreaTable(BasicImageView<const V> { image }, squared, pool)
+    {
+    }
+
+    /// Returns the width of the image.
+    int width() const noexcept
+    {
+        return this->m_width;
+    }
+
+    /// Returns the height of the image.
+    int height() const noexcept
+    {
+        return this->m_height;
+    }
+
+    /// Returns the number of channels of the image.
+    int channels() const noexcept
+    {
+        return this->m_channels;
+    }
+
+    /// Returns a row of the table, `(width + 1) * channels` sums of the
+    /// pixels above and to the left of each column.
+    ///
+    /// @param y Row of the table, from 0 to `height`.
+    const T* row(int y) const noexcept
+    {
+        return this->m_table.data() + static_cast<std::size_t>(y) * this->m_stride;
+    }
+
+    /// Returns the sum of a channel over a rectangle, clipped to the image.
+    ///
+    /// @param x0,y0 Top left corner of the rectangle.
+    /// @param x1,y1 Bottom right corner of the rectangle, excluded.
+    /// @param channel Summed channel.
+    T sum(int x0, int y0, int x1, int y1, int channel) const noexcept
+    {
+        x0 = std::clamp(x0, 0, this->m_width);
+        x1 = std::clamp(x1, 0, this->m_width);
+        y0 = std::clamp(y0, 0, this->m_height);
+        y1 = std::clamp(y1, 0, this->m_height);
+        if (x1 <= x0 || y1 <= y0) {
+            return T {};
+        }
+        auto channels = static_cast<std::size_t>(this->m_channels);
+        auto left = static_cast<std::size_t>(x0) * channels + static_cast<std::size_t>(channel);
+        auto right = static_cast<std::size_t>(x1) * channels + static_cast<std::size_t>(channel);
+        const T* top = this->row(y0);
+        const T* bottom = this->row(y1);
+        return bottom[right] - bottom[left] - top[right] + top[left];
+    }
+
+    /// Returns the mean of a channel over a rectangle clipped to the image,
+    /// or 0 if the clipped rectangle is empty.
+    ///
+    /// @param x0,y0 Top left corner of the rectangle.
+    /// @param x1,y1 Bottom right corner of the rectangle, excluded.
+    /// @param channel Averaged channel.
+    double mean(int x0, int y0, int x1, int y1, int channel) const noexcept
+    {
+        auto area = static_cast<double>(std::max(std::min(x1, this->m_width) - std::max(x0, 0), 0))
+            * static_cast<double>(std::max(std::min(y1, this->m_height) - std::max(y0, 0), 0));
+        return area > 0.0 ? static_cast<double>(this->sum(x0, y0, x1, y1, channel)) / area : 0.0;
+    }
+
+    /// Returns the mean of a channel over a square window centered on a
+    /// pixel, clipped to the image, as a box filter would.
+    ///
+    /// @param x,y Center of the window.
+    /// @param radius Number of pixels on each side of the center.
+    /// @param channel Averaged channel.
+    double box_mean(int x, int y, int radius, int channel) const noexcept
+    {
+        return this->mean(x - radius, y - radius, x + radius + 1, y + radius + 1, channel);
+    }
+
+private:
+    int m_width;
+    int m_height;
+    int m_channels;
+    std::size_t m_stride;
+    std::vector<T> m_table;
+};
+
+/// Table of 8-bit images.
+using SummedAreaTable = BasicSummedAreaTable<std::uint32_t>;
+/// Table of 16-bit images, or of the squares of 8-bit images.
+using SummedAreaTable64 = BasicSummedAreaTable<std::uint64_t>;
+/// Table of float images.
+using SummedAreaTableF = BasicSummedAreaTable<double>;
@@ -0,0 +1,685 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageResize.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+// Texture maps derived from heightmaps: tangent-space normals, curvature and
+// horizon-based ambient occlusion.
+//
+// Heights are read from one channel, 8 and 16-bit values mapped to `[0, 1]`,
+// and scaled to pixels so that slopes are measured in the plane of the map.
+// Every band of rows converts them into a window of float rows padded on
+// every side, by clamping or wrapping the edges, so that the kernels run
+// over whole rows without any bounds checks, eight pixels at a time with AVX2.
+
+/// Derivative filter of the normal and curvature maps.
+enum class GradientOperator {
+    /// `[1 2 1]` smoothing across the derivative.
+    Sobel,
+    /// `[3 10 3]` smoothing across the derivative, closer to rotation invariant.
+    Scharr,
+};
+
+/// Options of the maps derived from a heightmap.
+struct TerrainMapOptions {
+    /// Channel holding the heights.
+    int channel { 0 };
+    /// Height in pixels of the full range of the heightmap, e.g. 100 for a
+    /// terrain of 1 meter pixels rising up to 100 meters.
+    float height_scale { 32.0f };
+    /// Whether the heightmap tiles, the pixels past an edge being those of
+    /// the opposite edge, or the edge pixels are repeated.
+    bool wrap { false };
+    /// Derivative filter of the normal and curvature maps.
+    GradientOperator gradient { GradientOperator::Scharr };
+    /// Whether the green channel of normals points down, as expected by
+    /// Direct3D, rather than up as expected by OpenGL.
+    bool flip_green { false };
+    /// Factor of the mean curvature, in inverse pixels, added to the 0.5 of
+    /// flat areas: convex areas are brighter, concave ones darker.
+    float curvature_scale { 16.0f };
+    /// Number of directions along which the horizon of every pixel is found.
+    int occlusion_directions { 16 };
+    /// Number of heights read along every direction.
+    int occlusion_steps { 12 };
+    /// Distance in pixels up to which the horizon is searched.
+    float occlusion_radius { 32.0f };
+    /// Fraction of the occlusion applied, 0 leaving the whole map white.
+    float occlusion_strength { 1.0f };
+};
+
+/// Maps baked from a heightmap by `bake_terrain_maps()`.
+struct TerrainMaps {
+    /// Tangent-space normals encoded as `0.5 + 0.5 * n`, alpha set to 255.
+    ImageRGBA8 normals;
+    /// Mean curvature around 128.
+    ImageR8 curvature;
+    /// Ambient occlusion, 255 where the sky is entirely visible.
+    ImageR8 occlusion;
+};
+
+namespace detail {
+
+/// Maps a coordinate past the edges of a range of `size` values back into it.
+inline int terrain_coordinate(int i, int size, bool wrap) noexcept
+{
+    if (wrap) {
+        return (i % size + size) % size;
+    }
+    return std::clamp(i, 0, size - 1);
+}
+
+/// Window of rows of a heightmap, scaled to pixels and padded on every side.
+///
+/// A band of rows keeps the `2 * padding + 1` rows around the current one in
+/// a ring, loading every row as the band moves down, so that the heights
+/// are converted next to where they are read, while they are in the cache.
+template <typename T>
+class TerrainRows {
+public:
+    /// Creates an empty window.
+    ///
+    /// @param heights Heightmap.
+    /// @param options Channel, scale and edges of the heights.
+    /// @param padding Number of rows and columns read on each side of a pixel.
+    TerrainRows(BasicImageView<const T> heights, const TerrainMapOptions& options, int padding)
+        : m_heights { heights }
+        , m_options { options }
+        , m_padding { padding }
+        , m_stride { static_cast<std::size_t>(heights.width() + 2 * padding) }
+        , m_values(this->m_stride * static_cast<std::size_t>(2 * padding + 1))
+        , m_line(static_cast<std::size_t>(heights.width()) * static_cast<std::size_t>(heights.channels()))
+    {
+    }
+
+    /// Loads a row into the window, replacing the row `2 * padding + 1` above it.
+    ///
+    /// @param y Row of the heightmap, from `-padding` to `height + padding - 1`.
+    void load(int y)
+    {
+        int width = this->m_heights.width();
+        auto channels = static_cast<std::size_t>(this->m_heights.channels());
+        auto channel = static_cast<std::size_t>(this->m_options.channel);
+        int source = terrain_coordinate(y, this->m_heights.height(), this->m_options.wrap);
+        resample_load_row(this->m_heights.row(source), this->m_line.data(), static_cast<std::size_t>(width),
+            this->m_heights.channels(), false, false);
+        float* out = this->m_values.data() + this->offset(y);
+        for (std::size_t x = 0; x < static_cast<std::size_t>(width); x++) {
+            out[x] = this->m_line[x * channels + channel] * this->m_options.height_scale;
+        }
+        for (int x = 1; x <= this->m_padding; x++) {
+            out[-x] = out[terrain_coordinate(-x, width, this->m_options.wrap)];
+            out[width - 1 + x] = out[terrain_coordinate(width - 1 + x, width, this->m_options.wrap)];
+        }
+    }
+
+    /// Returns the first height of a row of the window.
+    ///
+    /// @param y Row loaded at most `2 * padding` rows before the last one.
+    const float* row(int y) const noexcept
+    {
+        return this->m_values.data() + this->offset(y);
+    }
+
+private:
+    /// Returns the index of the first height of a row in the ring.
+    std::size_t offset(int y) const noexcept
+    {
+        int rows = 2 * this->m_padding + 1;
+        auto slot = static_cast<std::size_t>((y % rows + rows) % rows);
+        return slot * this->m_stride + static_cast<std::size_t>(this->m_padding);
+    }
+
+    BasicImageView<const T> m_heights;
+    const TerrainMapOptions& m_options;
+    int m_padding;
+    std::size_t m_stride;
+    std::vector<float> m_values;
+    std::vector<float> m_line;
+};
+
+/// Weights of the rows across a derivative, summing to 1.
+struct TerrainGradient {
+    float side;
+    float middle;
+};
+
+inline TerrainGradient terrain_gradient(GradientOperator gradient) noexcept
+{
+    if (gradient == GradientOperator::Sobel) {
+        return { 0.25f, 0.5f };
+    }
+    return { 3.0f / 16.0f, 10.0f / 16.0f };
+}
+
+/// Samples of the horizon search, grouped by direction.
+struct TerrainOcclusionKernel {
+    /// Offsets of the samples from the center pixel, in columns and rows.
+    std::vector<std::pair<int, int>> offsets;
+    std::vector<float> inverse_distances;
+    /// First sample of every direction, followed by the number of samples.
+    std::vector<std::size_t> directions;
+    /// Largest offset along either axis, at least the one pixel read by the gradients.
+    int reach;
+};
+
+/// Builds the samples of the horizon search.
+///
+/// Samples lie on whole pixels, so that the heights of eight neighbouring
+/// centers are read with a single load, and get denser near the center,
+/// where the horizon changes the most.
+inline TerrainOcclusionKernel terrain_occlusion_kernel(const TerrainMapOptions& options)
+{
+    constexpr double two_pi = 6.283185307179586;
+    int steps = options.occlusion_steps;
+    double radius = options.occlusion_radius;
+    TerrainOcclusionKernel kernel { {}, {}, { 0 }, 1 };
+    for (int d = 0; d < options.occlusion_directions; d++) {
+        double angle = two_pi * (d + 0.5) / options.occlusion_directions;
+        std::pair<int, int> previous { 0, 0 };
+        for (int s = 0; s < steps; s++) {
+            double t = steps == 1 ? 1.0 : static_cast<double>(s) / (steps - 1);
+            double distance = 1.0 + (radius - 1.0) * t * t;
+            std::pair<int, int> offset { static_cast<int>(std::lround(std::cos(angle) * distance)),
+                static_cast<int>(std::lround(std::sin(angle) * distance)) };
+            if (offset == std::pair<int, int> { 0, 0 } || offset == previous) {
+                continue;
+            }
+            previous = offset;
+            auto [x, y] = offset;
+            kernel.offsets.push_back(offset);
+            kernel.inverse_distances.push_back(static_cast<float>(1.0 / std::sqrt(static_cast<double>(x * x + y * y))));
+            kernel.reach = std::max({ kernel.reach, std::abs(x), std::abs(y) });
+        }
+        kernel.directions.push_back(kernel.offsets.size());
+    }
+    return kernel;
+}
+
+// The AVX2 kernels evaluate the same expressions as the scalar code, in the
+// same order, and round to 8 bits the same way, so that both give the same
+// maps. Their target includes FMA: contraction is turned off for the kernels.
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline __m256 terrain_difference_avx2(const float* a, const float* b) noexcept
+{
+    return _mm256_sub_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b));
+}
+
+/// Weighs three rows or columns across a derivative.
+SIMD_TARGET_AVX2 inline __m256 terrain_across_avx2(
+    __m256 side, __m256 middle, __m256 outer0, __m256 inner, __m256 outer1) noexcept
+{
+    return _mm256_add_ps(_mm256_mul_ps(side, _mm256_add_ps(outer0, outer1)), _mm256_mul_ps(middle, inner));
+}
+
+/// Second difference of three consecutive values.
+SIMD_TARGET_AVX2 inline __m256 terrain_second_avx2(__m256 before, __m256 at, __m256 after) noexcept
+{
+    return _mm256_sub_ps(_mm256_add_ps(before, after), _mm256_mul_ps(_mm256_set1_ps(2.0f), at));
+}
+
+/// Converts values to 8-bit codes in 32-bit lanes, like `unorm8_from_float()`.
+SIMD_TARGET_AVX2 inline __m256i terrain_unorm8_avx2(__m256 value) noexcept
+{
+    // max(x, 0) returns the second operand for NaN.
+    value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+    return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+SIMD_TARGET_AVX2 inline std::size_t terrain_normals_avx2(const float* above, const float* center, const float* below,
+    TerrainGradient weights, float green, std::uint8_t* out, std::size_t count) noexcept
+{
+    const __m256 side = _mm256_set1_ps(weights.side);
+    const __m256 middle = _mm256_set1_ps(weights.middle);
+    const __m256 sign = _mm256_set1_ps(green);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000u));
+    std::size_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        const float* a = above + x;
+        const float* c = center + x;
+        const float* b = below + x;
+        __m256 dx = _mm256_mul_ps(half,
+            terrain_across_avx2(side, middle, terrain_difference_avx2(a + 1, a - 1),
+                terrain_difference_avx2(c + 1, c - 1), terrain_difference_avx2(b + 1, b - 1)));
+        __m256 dy = _mm256_mul_ps(half,
+            terrain_across_avx2(side, middle, terrain_difference_avx2(b - 1, a - 1), terrain_difference_avx2(b, a),
+                terrain_difference_avx2(b + 1, a + 1)));
+
+        __m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), one));
+        __m256 scale = _mm256_div_ps(half, length);
+        __m256i red = terrain_unorm8_avx2(_mm256_sub_ps(half, _mm256_mul_ps(dx, scale)));
+        __m256i green_up = terrain_unorm8_avx2(_mm256_add_ps(half, _mm256_mul_ps(_mm256_mul_ps(sign, dy), scale)));
+        __m256i blue = terrain_unorm8_avx2(_mm256_add_ps(half, scale));
+        __m256i rgba = _mm256_or_si256(_mm256_or_si256(red, _mm256_slli_epi32(green_up, 8)),
+            _mm256_or_si256(_mm256_slli_epi32(blue, 16), alpha));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * x), rgba);
+    }
+    return x;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t terrain_curvature_avx2(const float* above, const float* center, const float* below,
+    TerrainGradient weights, float bias, float factor, float* out, std::size_t count) noexcept
+{
+    const __m256 side = _mm256_set1_ps(weights.side);
+    const __m256 middle = _mm256_set1_ps(weights.middle);
+    const __m256 half = _mm256_set1_ps(0.5f);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    const __m256 two = _mm256_set1_ps(2.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 offset = _mm256_set1_ps(bias);
+    const __m256 scale = _mm256_set1_ps(0.5f * factor);
+    std::size_t x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256 a[3] = { _mm256_loadu_ps(above + x - 1), _mm256_loadu_ps(above + x), _mm256_loadu_ps(above + x + 1) };
+        __m256 c[3] = { _mm256_loadu_ps(center + x - 1), _mm256_loadu_ps(center + x), _mm256_loadu_ps(center + x + 1) };
+        __m256 b[3] = { _mm256_loadu_ps(below + x - 1), _mm256_loadu_ps(below + x), _mm256_loadu_ps(below + x + 1) };
+        __m256 hx = _mm256_mul_ps(half,
+            terrain_across_avx2(side, middle, _mm256_sub_ps(a[2], a[0]), _mm256_sub_ps(c[2], c[0]),
+                _mm256_sub_ps(b[2], b[0])));
+        __m256 hy = _mm256_mul_ps(half,
+            terrain_across_avx2(side, middle, _mm256_sub_ps(b[0], a[0]), _mm256_sub_ps(b[1], a[1]),
+                _mm256_sub_ps(b[2], a[2])));
+        __m256 hxx = terrain_across_avx2(side, middle, terrain_second_avx2(a[0], a[1], a[2]),
+            terrain_second_avx2(c[0], c[1], c[2]), terrain_second_avx2(b[0], b[1], b[2]));
+        __m256 hyy = terrain_across_avx2(side, middle, terrain_second_avx2(a[0], c[0], b[0]),
+            terrain_second_avx2(a[1], c[1], b[1]), terrain_second_avx2(a[2], c[2], b[2]));
+        __m256 hxy = _mm256_mul_ps(quarter, _mm256_sub_ps(_mm256_sub_ps(b[2], b[0]), _mm256_sub_ps(a[2], a[0])));
+
+        __m256 hx2 = _mm256_mul_ps(hx, hx);
+        __m256 hy2 = _mm256_mul_ps(hy, hy);
+        __m256 numerator = _mm256_add_ps(
+            _mm256_mul_ps(_mm256_add_ps(one, hy2), hxx), _mm256_mul_ps(_mm256_add_ps(one, hx2), hyy));
+        numerator = _mm256_sub_ps(numerator, _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(two, hx), hy), hxy));
+        __m256 g = _mm256_add_ps(_mm256_add_ps(one, hx2), hy2);
+        __m256 denominator = _mm256_mul_ps(g, _mm256_sqrt_ps(g));
+        _mm256_storeu_ps(out + x, _mm256_sub_ps(offset, _mm256_div_ps(_mm256_mul_ps(scale, numerator), denominator)));
+    }
+    return x;
+}
+
+/// Returns the horizons of sixteen pixels along one direction.
+///
+/// Reading the sample pointers and distances once for two vectors of
+/// pixels halves the loads that are not heights.
+SIMD_TARGET_AVX2 inline void terrain_horizons_avx2(const __m256 height[2], const float* const* samples,
+    const float* inverse_distances, std::size_t begin, std::size_t end, std::size_t x, __m256 horizon[2]) noexcept
+{
+    horizon[0] = _mm256_setzero_ps();
+    horizon[1] = _mm256_setzero_ps();
+    for (auto s = begin; s < end; s++) {
+        const float* sample = samples[s] + x;
+        __m256 inverse_distance = _mm256_set1_ps(inverse_distances[s]);
+        __m256 rise0 = _mm256_sub_ps(_mm256_loadu_ps(sample), height[0]);
+        __m256 rise1 = _mm256_sub_ps(_mm256_loadu_ps(sample + 8), height[1]);
+        horizon[0] = _mm256_max_ps(horizon[0], _mm256_mul_ps(rise0, inverse_distance));
+        horizon[1] = _mm256_max_ps(horizon[1], _mm256_mul_ps(rise1, inverse_distance));
+    }
+}
+
+SIMD_TARGET_AVX2 inline std::size_t terrain_occlusion_avx2(const float* center, const float* const* samples,
+    const TerrainOcclusionKernel& kernel, float strength, float* out, std::size_t count) noexcept
+{
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(strength / static_cast<float>(kernel.directions.size() - 1));
+    const float* inverse_distances = kernel.inverse_distances.data();
+    std::size_t x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m256 height[2] = { _mm256_loadu_ps(center + x), _mm256_loadu_ps(center + x + 8) };
+        __m256 occlusion[2] = { _mm256_setzero_ps(), _mm256_setzero_ps() };
+        for (std::size_t d = 0; d + 1 < kernel.directions.size(); d++) {
+            __m256 horizon[2];
+            terrain_horizons_avx2(
+                height, samples, inverse_distances, kernel.directions[d], kernel.directions[d + 1], x, horizon);
+            for (int i = 0; i < 2; i++) {
+                __m256 squared = _mm256_mul_ps(horizon[i], horizon[i]);
+                occlusion[i] = _mm256_add_ps(occlusion[i], _mm256_div_ps(squared, _mm256_add_ps(one, squared)));
+            }
+        }
+        _mm256_storeu_ps(out + x, _mm256_sub_ps(one, _mm256_mul_ps(occlusion[0], scale)));
+        _mm256_storeu_ps(out + x + 8, _mm256_sub_ps(one, _mm256_mul_ps(occlusion[1], scale)));
+    }
+    return x;
+}
+#endif
+
+/// Encodes the normals of the pixels from `begin` to `count` of a row.
+inline void terrain_normals_scalar(const float* above, const float* center, const float* below, TerrainGradient weights,
+    float green, std::uint8_t* out, std::size_t begin, std::size_t count) noexcept
+{
+    auto across = [&](float outer0, float inner, float outer1) {
+        return weights.side * (outer0 + outer1) + weights.middle * inner;
+    };
+    for (auto x = begin; x < count; x++) {
+        const float* a = above + x;
+        const float* c = center + x;
+        const float* b = below + x;
+        float dx = 0.5f * across(a[1] - a[-1], c[1] - c[-1], b[1] - b[-1]);
+        float dy = 0.5f * across(b[-1] - a[-1], b[0] - a[0], b[1] - a[1]);
+        float scale = 0.5f / std::sqrt(dx * dx + dy * dy + 1.0f);
+        std::uint8_t* pixel = out + 4 * x;
+        pixel[0] = unorm8_from_float(0.5f - dx * scale);
+        pixel[1] = unorm8_from_float(0.5f + green * dy * scale);
+        pixel[2] = unorm8_from_float(0.5f + scale);
+        pixel[3] = 255;
+    }
+}
+
+/// Encodes the normals of a row as RGBA8 pixels.
+///
+/// @param above,center,below Heights of the row and of its neighbours.
+/// @param weights Weights of the rows across the derivatives.
+/// @param green 1 for normals whose green channel points up, -1 for down.
+/// @param out Destination of the pixels.
+/// @param count Number of pixels.
+inline void terrain_normals(const float* above, const float* center, const float* below, TerrainGradient weights,
+    float green, std::uint8_t* out, std::size_t count) noexcept
+{
+    std::size_t x = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        x = terrain_normals_avx2(above, center, below, weights, green, out, count);
+    }
+#endif
+    terrain_normals_scalar(above, center, below, weights, green, out, x, count);
+}
+
+/// Computes the mean curvature of the pixels from `begin` to `count` of a row.
+inline void terrain_curvature_scalar(const float* above, const float* center, const float* below,
+    TerrainGradient weights, float bias, float factor, float* out, std::size_t begin, std::size_t count) noexcept
+{
+    auto across = [&](float outer0, float inner, float outer1) {
+        return weights.side * (outer0 + outer1) + weights.middle * inner;
+    };
+    auto second = [](float before, float at, float after) { return before + after - 2.0f * at; };
+    for (auto x = begin; x < count; x++) {
+        const float* a = above + x;
+        const float* c = center + x;
+        const float* b = below + x;
+        float hx = 0.5f * across(a[1] - a[-1], c[1] - c[-1], b[1] - b[-1]);
+        float hy = 0.5f * across(b[-1] - a[-1], b[0] - a[0], b[1] - a[1]);
+        float hxx = across(second(a[-1], a[0], a[1]), second(c[-1], c[0], c[1]), second(b[-1], b[0], b[1]));
+        float hyy = across(second(a[-1], c[-1], b[-1]), second(a[0], c[0], b[0]), second(a[1], c[1], b[1]));
+        float hxy = 0.25f * ((b[1] - b[-1]) - (a[1] - a[-1]));
+        float numerator = (1.0f + hy * hy) * hxx + (1.0f + hx * hx) * hyy - 2.0f * hx * hy * hxy;
+        float g = 1.0f + hx * hx + hy * hy;
+        out[x] = bias - 0.5f * factor * numerator / (g * std::sqrt(g));
+    }
+}
+
+/// Computes the mean curvature of a row, mapped to `bias + factor * curvature`.
+///
+/// The curvature is positive where the surface is convex, e.g. on ridges.
+inline void terrain_curvature(const float* above, const float* center, const float* below, TerrainGradient weights,
+    float bias, float factor, float* out, std::size_t count) noexcept
+{
+    std::size_t x = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        x = terrain_curvature_avx2(above, center, below, weights, bias, factor, out, count);
+    }
+#endif
+    terrain_curvature_scalar(above, center, below, weights, bias, factor, out, x, count);
+}
+
+/// Computes the ambient occlusion of the pixels from `begin` to `count` of a row.
+inline void terrain_occlusion_scalar(const float* center, const float* const* samples,
+    const TerrainOcclusionKernel& kernel, float strength, float* out, std::size_t begin, std::size_t count) noexcept
+{
+    float scale = strength / static_cast<float>(kernel.directions.size() - 1);
+    for (auto x = begin; x < count; x++) {
+        float occlusion = 0.0f;
+        for (std::size_t d = 0; d + 1 < kernel.directions.size(); d++) {
+            float horizon = 0.0f;
+            for (auto s = kernel.directions[d]; s < kernel.directions[d + 1]; s++) {
+                horizon = std::max(horizon, (samples[s][x] - center[x]) * kernel.inverse_distances[s]);
+            }
+            float squared = horizon * horizon;
+            occlusion += squared / (1.0f + squared);
+        }
+        out[x] = 1.0f - occlusion * scale;
+    }
+}
+
+/// Computes the ambient occlusion of a row.
+///
+/// Along every direction, the horizon is the steepest slope up to a sample.
+/// A surface facing up sees the cosine-weighted fraction `cos^2` of the sky
+/// above a horizon at an elevation angle, the occlusion of the direction
+/// being `tan^2 / (1 + tan^2)` of its slope, averaged over the directions.
+///
+/// @param center Heights of the row.
+/// @param samples Heights of every sample of the kernel for the first pixel.
+/// @param kernel Samples of the horizon search.
+/// @param strength Fraction of the occlusion applied.
+/// @param out Destination of the visibility of every pixel.
+/// @param count Number of pixels.
+inline void terrain_occlusion(const float* center, const float* const* samples, const TerrainOcclusionKernel& kernel,
+    float strength, float* out, std::size_t count) noexcept
+{
+    std::size_t x = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        x = terrain_occlusion_avx2(center, samples, kernel, strength, out, count);
+    }
+#endif
+    terrain_occlusion_scalar(center, samples, kernel, strength, out, x, count);
+}
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+inline void validate_terrain_options(int channels, const TerrainMapOptions& options, bool occlusion)
+{
+    if (options.channel < 0 || options.channel >= channels) {
+        throw std::runtime_error { "The heightmap has no such channel." };
+    }
+    if (!std::isfinite(options.height_scale) || !std::isfinite(options.curvature_scale)) {
+        throw std::runtime_error { "The height and curvature scales must be finite." };
+    }
+    if (occlusion) {
+        if (options.occlusion_directions < 1 || options.occlusion_steps < 1) {
+            throw std::runtime_error { "The occlusion needs at least one direction and one step." };
+        }
+        if (!(options.occlusion_radius >= 1.0f && options.occlusion_radius <= 4096.0f)) {
+            throw std::runtime_error { "The occlusion radius must be between 1 and 4096 pixels." };
+        }
+    }
+}
+
+/// Bakes the requested maps of a heightmap, in a single pass over bands of rows.
+template <typename T>
+void bake_terrain(BasicImageView<const T> heights, const TerrainMapOptions& options, ThreadPool& pool,
+    ImageRGBA8* normals, ImageR8* curvature, ImageR8* occlusion)
+{
+    validate_terrain_options(heights.channels(), options, occlusion != nullptr);
+    TerrainOcclusionKernel kernel { {}, {}, {}, 1 };
+    if (occlusion != nullptr) {
+        kernel = terrain_occlusion_kernel(options);
+    }
+    int padding = kernel.reach;
+    auto weights = terrain_gradient(options.gradient);
+    float green = options.flip_green ? -1.0f : 1.0f;
+    auto count = static_cast<std::size_t>(heights.width());
+
+    // Every band loads the rows around it once more, so bands are kept
+    // several times taller than the window of rows.
+    auto grain = static_cast<std::size_t>(std::max(8, 4 * padding));
+    pool.parallel_for(static_cast<std::size_t>(heights.height()), grain, [&](std::size_t begin, std::size_t end) {
+        TerrainRows<T> rows { heights, options, padding };
+        std::vector<float> line(count);
+        std::vector<const float*> samples(kernel.offsets.size());
+        for (int y = static_cast<int>(begin) - padding; y < static_cast<int>(begin) + padding; y++) {
+            rows.load(y);
+        }
+        for (auto y = static_cast<int>(begin); y < static_cast<int>(end); y++) {
+            rows.load(y + padding);
+            const float* above = rows.row(y - 1);
+            const float* center = rows.row(y);
+            const float* below = rows.row(y + 1);
+            if (normals != nullptr) {
+                terrain_normals(above, center, below, weights, green, normals->pixel(0, y), count);
+            }
+            if (curvature != nullptr) {
+                terrain_curvature(above, center, below, weights, 0.5f, options.curvature_scale, line.data(), count);
+                float_to_unorm8(line.data(), curvature->pixel(0, y), count);
+            }
+            if (occlusion != nullptr) {
+                for (std::size_t s = 0; s < samples.size(); s++) {
+                    samples[s] = rows.row(y + kernel.offsets[s].second) + kernel.offsets[s].first;
+                }
+                terrain_occlusion(center, samples.data(), kernel, options.occlusion_strength, line.data(), count);
+                float_to_unorm8(line.data(), occlusion->pixel(0, y), count);
+            }
+        }
+    });
+}
+
+} // namespace detail
+
+/// Bakes the tangent-space normal map of a heightmap.
+///
+/// Normals are `(-dh/dx, dh/dy, 1)` normalized, with `x` to the right and
+/// `y` down the rows of the map, so that green points up the image unless
+/// `options.flip_green` is set.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height scale, edges and derivative filter.
+/// @param pool Pool processing the rows.
+template <typename T>
+ImageRGBA8 normal_map(
+    BasicImageView<const T> heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    ImageRGBA8 result { heights.width(), heights.height() };
+    detail::bake_terrain(heights, options, pool, &result, nullptr, nullptr);
+    return result;
+}
+
+/// Bakes the tangent-space normal map of a heightmap.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height scale, edges and derivative filter.
+/// @param pool Pool processing the rows.
+template <typename T, int C>
+ImageRGBA8 normal_map(
+    const BasicImage<T, C>& heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return normal_map(BasicImageView<const T> { heights }, options, pool);
+}
+
+/// Bakes the mean curvature of a heightmap: convex areas such as ridges
+/// and crests are brighter, concave ones such as valleys and creases darker.
+///
+/// Every pixel encodes `0.5 - 0.5 * curvature_scale * n / g^1.5` to 8 bits,
+/// 128 on flat areas, where `n = (1 + hy^2) hxx + (1 + hx^2) hyy - 2 hx hy hxy`
+/// and `g = 1 + hx^2 + hy^2` from the derivatives of the heights in pixels:
+/// `0.5` plus `curvature_scale` times the mean curvature, counted positive
+/// on convex areas.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height and curvature scales, edges and derivative filter.
+/// @param pool Pool processing the rows.
+template <typename T>
+ImageR8 curvature_map(
+    BasicImageView<const T> heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    ImageR8 result { heights.width(), heights.height() };
+    detail::bake_terrain(heights, options, pool, nullptr, &result, nullptr);
+    return result;
+}
+
+/// Bakes the mean curvature of a heightmap.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height and curvature scales, edges and derivative filter.
+/// @param pool Pool processing the rows.
+template <typename T, int C>
+ImageR8 curvature_map(
+    const BasicImage<T, C>& heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return curvature_map(BasicImageView<const T> { heights }, options, pool);
+}
+
+/// Bakes the horizon-based ambient occlusion of a heightmap.
+///
+/// The horizon of every pixel is searched along `options.occlusion_directions`
+/// directions up to `options.occlusion_radius` pixels, and the map holds
+/// the cosine-weighted fraction of the sky seen above these horizons.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height scale, edges and horizon search.
+/// @param pool Pool processing the rows.
+template <typename T>
+ImageR8 ambient_occlusion_map(
+    BasicImageView<const T> heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    ImageR8 result { heights.width(), heights.height() };
+    detail::bake_terrain(heights, options, pool, nullptr, nullptr, &result);
+    return result;
+}
+
+/// Bakes the horizon-based ambient occlusion of a heightmap.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Height scale, edges and horizon search.
+/// @param pool Pool processing the rows.
+template <typename T, int C>
+ImageR8 ambient_occlusion_map(
+    const BasicImage<T, C>& heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return ambient_occlusion_map(BasicImageView<const T> { heights }, options, pool);
+}
+
+/// Bakes the normal, curvature and ambient occlusion maps of a heightmap at
+/// once, converting the heights a single time and computing every map of a
+/// row while its heights are in the cache.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Options of all the maps.
+/// @param pool Pool processing the rows.
+template <typename T>
+TerrainMaps bake_terrain_maps(
+    BasicImageView<const T> heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    TerrainMaps maps { ImageRGBA8 { heights.width(), heights.height() }, ImageR8 { heights.width(), heights.height() },
+        ImageR8 { heights.width(), heights.height() } };
+    detail::bake_terrain(heights, options, pool, &maps.normals, &maps.curvature, &maps.occlusion);
+    return maps;
+}
+
+/// Bakes the normal, curvature and ambient occlusion maps of a heightmap at once.
+///
+/// @param heights Heightmap, of which `options.channel` is read.
+/// @param options Options of all the maps.
+/// @param pool Pool processing the rows.
+template <typename T, int C>
+TerrainMaps bake_terrain_maps(
+    const BasicImage<T, C>& heights, const TerrainMapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    return bake_terrain_maps(BasicImageView<const T> { heights }, options, pool);
+}
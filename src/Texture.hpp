@@ -0,0 +1,257 @@
+#pragma once
+// GLAD
+#include <glad/gl.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "TextureCompression.hpp"
+#include "TextureContainer.hpp"
+
+// Formats of EXT_texture_compression_s3tc, EXT_texture_sRGB and
+// ARB_texture_compression_bptc, which are not part of OpenGL 4.1.
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+/// OpenGL formats matching the pixels of an image.
+struct TextureFormat {
+    GLint internal_format;
+    GLenum format;
+    GLenum type;
+};
+
+/// Returns the OpenGL formats used to upload an image.
+///
+/// @param channels Number of channels of the image.
+/// @param srgb Whether the color channels of 8-bit images are sRGB encoded.
+template <typename T>
+TextureFormat texture_format(int channels, bool srgb)
+{
+    static constexpr GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    if (channels < 1 || channels > 4) {
+        throw std::runtime_error { "The image must have between 1 and 4 channels." };
+    }
+    GLenum format = formats[channels - 1];
+
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        static constexpr GLint internal_formats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+        GLint internal_format = internal_formats[channels - 1];
+        if (srgb && channels == 3) {
+            internal_format = GL_SRGB8;
+        } else if (srgb && channels == 4) {
+            internal_format = GL_SRGB8_ALPHA8;
+        }
+        return { internal_format, format, GL_UNSIGNED_BYTE };
+    } else if constexpr (std::is_same_v<T, unsigned short>) {
+        static constexpr GLint internal_formats[] = { GL_R16, GL_RG16, GL_RGB16, GL_RGBA16 };
+        return { internal_formats[channels - 1], format, GL_UNSIGNED_SHORT };
+    } else {
+        static constexpr GLint internal_formats[] = { GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+        return { internal_formats[channels - 1], format, GL_FLOAT };
+    }
+}
+
+/// Replaces a rectangle of a level of the texture bound to `target`.
+///
+/// Views with padded rows are uploaded in place through
+/// `GL_UNPACK_ROW_LENGTH`, so a rectangle of a larger image needs no copy.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param level Mip level to update.
+/// @param x Left column of the updated rectangle in the texture.
+/// @param y Top row of the updated rectangle in the texture.
+/// @param view Uploaded pixels.
+template <typename T>
+void upload_texture_region(GLenum target, GLint level, GLint x, GLint y, BasicImageView<T> view)
+{
+    auto format = texture_format<std::remove_const_t<T>>(view.channels(), false);
+    auto channels = static_cast<std::size_t>(view.channels());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (view.stride() % channels == 0) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(view.stride() / channels));
+        glTexSubImage2D(target, level, x, y, view.width(), view.height(), format.format, format.type, view.data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    } else {
+        for (int row = 0; row < view.height(); row++) {
+            glTexSubImage2D(target, level, x, y + row, view.width(), 1, format.format, format.type, view.row(row));
+        }
+    }
+}
+
+/// Uploads an image to a level of the texture bound to `target`.
+///
+/// The row pitch of padded images is passed through `GL_UNPACK_ROW_LENGTH`,
+/// so OpenGL reads tightly packed pixels without any repacking.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param level Mip level to fill.
+/// @param image Uploaded image.
+/// @param srgb Whether the color channels of 8-bit images are sRGB encoded.
+template <typename T, int C>
+void upload_texture_level(GLenum target, GLint level, const BasicImage<T, C>& image, bool srgb = false)
+{
+    auto format = texture_format<T>(image.channels(), srgb);
+    auto channels = static_cast<std::size_t>(image.channels());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (image.stride() % channels == 0) {
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(image.stride() / channels));
+        glTexImage2D(target, level, format.internal_format, image.width(), image.height(), 0, format.format,
+            format.type, image.data());
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    } else {
+        glTexImage2D(target, level, format.internal_format, image.width(), image.height(), 0, format.format,
+            format.type, nullptr);
+        upload_texture_region(target, level, 0, 0, BasicImageView<const T> { image });
+    }
+}
+
+/// Uploads a mip chain to the texture bound to `target`.
+///
+/// Limits the texture to the uploaded levels, so it is complete without
+/// calling `glGenerateMipmap`.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param levels Mip levels, starting with the base level.
+/// @param srgb Whether the color channels of 8-bit images are sRGB encoded.
+template <typename T, int C>
+void upload_mip_chain(GLenum target, const std::vector<BasicImage<T, C>>& levels, bool srgb = false)
+{
+    if (levels.empty()) {
+        throw std::runtime_error { "The mip chain must contain at least one level." };
+    }
+    for (std::size_t level = 0; level < levels.size(); level++) {
+        upload_texture_level(target, static_cast<GLint>(level), levels[level], srgb);
+    }
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1));
+}
+
+/// Returns the OpenGL internal format of a block compressed format.
+///
+/// @param format Block format.
+/// @param srgb Whether the color channels are sRGB encoded. Ignored by BC4 and BC5.
+inline GLenum texture_format(BlockFormat format, bool srgb) noexcept
+{
+    switch (format) {
+    case BlockFormat::BC1:
+        return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC4:
+        return GL_COMPRESSED_RED_RGTC1;
+    case BlockFormat::BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case BlockFormat::BC7:
+        return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_COMPRESSED_RGBA_BPTC_UNORM;
+}
+
+/// Uploads a block compressed image to a level of the texture bound to `target`.
+///
+/// BC1, BC3 and BC7 require the S3TC and BPTC extensions, which are
+/// available on desktop drivers but not part of OpenGL 4.1.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param level Mip level to fill.
+/// @param image Uploaded image.
+/// @param srgb Whether the color channels are sRGB encoded.
+inline void upload_texture_level(GLenum target, GLint level, const CompressedImage& image, bool srgb = false)
+{
+    glCompressedTexImage2D(target, level, texture_format(image.format, srgb), image.width, image.height, 0,
+        static_cast<GLsizei>(image.data.size()), image.data.data());
+}
+
+/// Uploads a block compressed mip chain to the texture bound to `target`.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param levels Mip levels, starting with the base level.
+/// @param srgb Whether the color channels are sRGB encoded.
+inline void upload_mip_chain(GLenum target, const std::vector<CompressedImage>& levels, bool srgb = false)
+{
+    if (levels.empty()) {
+        throw std::runtime_error { "The mip chain must contain at least one level." };
+    }
+    for (std::size_t level = 0; level < levels.size(); level++) {
+        upload_texture_level(target, static_cast<GLint>(level), levels[level], srgb);
+    }
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levels.size() - 1));
+}
+
+/// Uploads every level of a texture container to the texture bound to `target`.
+///
+/// The levels are read straight from the mapped file.
+///
+/// @param target Texture target, e.g. `GL_TEXTURE_2D`.
+/// @param file Mapped texture container.
+inline void upload_texture_file(GLenum target, const TextureFile& file)
+{
+    auto block_format = texture_file_block_format(file.format());
+    auto value = static_cast<std::uint32_t>(file.format());
+    int channels = static_cast<int>((value - 1) % 4 + 1);
+    TextureFormat format {};
+    if (!block_format) {
+        if (value <= 4) {
+            format = texture_format<unsigned char>(channels, file.srgb());
+        } else if (value <= 8) {
+            format = texture_format<unsigned short>(channels, file.srgb());
+        } else {
+            format = texture_format<float>(channels, file.srgb());
+        }
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < file.level_count(); i++) {
+        auto level = file.level(i);
+        auto width = static_cast<GLsizei>(level.width);
+        auto height = static_cast<GLsizei>(level.height);
+        if (block_format) {
+            glCompressedTexImage2D(target, i, texture_format(*block_format, file.srgb()), width, height, 0,
+                static_cast<GLsizei>(level.size), level.data);
+        } else {
+            glTexImage2D(target, i, format.internal_format, width, height, 0, format.format, format.type, level.data);
+        }
+    }
+    glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, file.level_count() - 1);
+}
+
+/// Reads back pixels of the current read framebuffer into an RGBA image.
+///
+/// Rows are returned bottom to top, as stored by OpenGL. Write them with
+/// `ImageWriteOptions::flip_vertically`, or flip them before use.
+///
+/// @param x Left column of the read rectangle.
+/// @param y Bottom row of the read rectangle.
+/// @param width Width of the read rectangle.
+/// @param height Height of the read rectangle.
+inline ImageRGBA8 read_framebuffer(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    ImageRGBA8 image { width, height };
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glPixelStorei(GL_PACK_ROW_LENGTH, 0);
+    glReadPixels(x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+    return image;
+}
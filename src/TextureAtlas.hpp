@@ -0,0 +1,237 @@
+#pragma once
+#include <stb_rect_pack.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+/// Options of the packing of images into atlases.
+struct AtlasOptions {
+    /// Maximal width of an atlas page in pixels.
+    int max_width { 4096 };
+    /// Maximal height of an atlas page in pixels.
+    int max_height { 4096 };
+    /// Pixels around every image repeating its edges, so bilinear
+    /// filtering at the border does not blend in the neighbours.
+    int gutter { 1 };
+    /// Cleared pixels between the gutters of two images.
+    int padding { 0 };
+    /// Multiple of the positions and sizes of the image slots in pixels,
+    /// 4 to keep every block of a BCn compressed atlas within one image.
+    int alignment { 1 };
+    /// Number of mip levels the atlas is filtered to. Slots are aligned to
+    /// `2^(mip_levels - 1)` pixels, so that no texel of those levels covers
+    /// two images; the gutter should be as wide to also avoid blending in
+    /// the padding.
+    int mip_levels { 1 };
+    /// Whether the pages are rounded up to a power of two in size, once
+    /// cropped to the packed images.
+    bool power_of_two { false };
+};
+
+/// Location of an image in an atlas.
+struct AtlasEntry {
+    /// Index of the page holding the image.
+    int page;
+    /// Left column of the image in the page, excluding its gutter.
+    int x;
+    /// Top row of the image in the page, excluding its gutter.
+    int y;
+    int width;
+    int height;
+    /// Texture coordinates of the corners of the image, with `v` growing
+    /// downward like the rows of the page.
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+};
+
+/// Pages of packed images and the location of every image.
+///
+/// @tparam T Type of a single channel.
+/// @tparam Channels Number of channels, or `DynamicChannels`.
+template <typename T, int Channels = DynamicChannels>
+struct BasicTextureAtlas {
+    std::vector<BasicImage<T, Channels>> pages {};
+    /// Location of every input image, in the order of the inputs.
+    std::vector<AtlasEntry> entries {};
+};
+
+namespace detail {
+
+/// Size of a page holding the packed rectangles.
+struct AtlasPageSize {
+    int width;
+    int height;
+};
+
+inline int round_up_to_power_of_two(int value) noexcept
+{
+    int result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+/// Places every image in a page, opening a new page whenever the previous
+/// ones are full, and returns the size of every page.
+inline std::vector<AtlasPageSize> pack_atlas(
+    const std::vector<AtlasPageSize>& sizes, const AtlasOptions& options, std::vector<AtlasEntry>& entries)
+{
+    int alignment = std::max(options.alignment, 1);
+    if (options.mip_levels > 1) {
+        alignment = std::max(alignment, 1 << std::min(options.mip_levels - 1, 15));
+    }
+    if (options.gutter < 0 || options.padding < 0 || options.max_width < alignment || options.max_height < alignment) {
+        throw std::runtime_error { "Invalid atlas options." };
+    }
+    auto slot = [&](int size) {
+        int padded = size + 2 * options.gutter + options.padding;
+        return (padded + alignment - 1) / alignment * alignment;
+    };
+
+    std::vector<stbrp_rect> pending(sizes.size());
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+        pending[i].id = static_cast<int>(i);
+        pending[i].w = slot(sizes[i].width);
+        pending[i].h = slot(sizes[i].height);
+        if (pending[i].w > options.max_width || pending[i].h > options.max_height) {
+            throw std::runtime_error { "An image is larger than an atlas page." };
+        }
+    }
+
+    // Enough nodes for the packer to place rectangles at any column, which
+    // keeps the positions multiples of the aligned sizes.
+    std::vector<stbrp_node> nodes(static_cast<std::size_t>(options.max_width));
+    std::vector<AtlasPageSize> pages {};
+    entries.resize(sizes.size());
+    while (!pending.empty()) {
+        stbrp_context context {};
+        stbrp_init_target(&context, options.max_width, options.max_height, nodes.data(), options.max_width);
+        stbrp_setup_heuristic(&context, STBRP_HEURISTIC_Skyline_BF_sortHeight);
+        stbrp_pack_rects(&context, pending.data(), static_cast<int>(pending.size()));
+
+        int page = static_cast<int>(pages.size());
+        AtlasPageSize used { alignment, alignment };
+        std::vector<stbrp_rect> remaining {};
+        for (const auto& rect : pending) {
+            if (!rect.was_packed) {
+                remaining.push_back(rect);
+                continue;
+            }
+            auto& entry = entries[static_cast<std::size_t>(rect.id)];
+            entry.page = page;
+            entry.x = rect.x + options.gutter;
+            entry.y = rect.y + options.gutter;
+            entry.width = sizes[static_cast<std::size_t>(rect.id)].width;
+            entry.height = sizes[static_cast<std::size_t>(rect.id)].height;
+            used.width = std::max(used.width, rect.x + rect.w);
+            used.height = std::max(used.height, rect.y + rect.h);
+        }
+        if (options.power_of_two) {
+            used.width = std::min(round_up_to_power_of_two(used.width), options.max_width);
+            used.height = std::min(round_up_to_power_of_two(used.height), options.max_height);
+        }
+        pages.push_back(used);
+        pending = std::move(remaining);
+    }
+
+    for (auto& entry : entries) {
+        const auto& page = pages[static_cast<std::size_t>(entry.page)];
+        entry.u0 = static_cast<float>(entry.x) / static_cast<float>(page.width);
+        entry.v0 = static_cast<float>(entry.y) / static_cast<float>(page.height);
+        entry.u1 = static_cast<float>(entry.x + entry.width) / static_cast<float>(page.width);
+        entry.v1 = static_cast<float>(entry.y + entry.height) / static_cast<float>(page.height);
+    }
+    return pages;
+}
+
+/// Copies an image into its page, repeating its edges over the gutter.
+template <typename T, int C>
+void blit_atlas_entry(BasicImageView<const T> image, const AtlasEntry& entry, int gutter, BasicImage<T, C>& page)
+{
+    auto channels = static_cast<std::size_t>(page.channels());
+    auto row_size = static_cast<std::size_t>(entry.width) * channels;
+    for (int y = -gutter; y < entry.height + gutter; y++) {
+        const T* src = image.row(std::clamp(y, 0, entry.height - 1));
+        T* dst = page.pixel(entry.x, entry.y + y);
+        std::copy_n(src, row_size, dst);
+        for (int x = 1; x <= gutter; x++) {
+            std::copy_n(src, channels, dst - static_cast<std::size_t>(x) * channels);
+            std::copy_n(src + row_size - channels, channels, dst + row_size + static_cast<std::size_t>(x - 1) * channels);
+        }
+    }
+}
+
+template <typename T, int C>
+BasicTextureAtlas<T, C> build_atlas(
+    const std::vector<BasicImageView<const T>>& images, int channels, const AtlasOptions& options, ThreadPool& pool)
+{
+    std::vector<AtlasPageSize> sizes {};
+    sizes.reserve(images.size());
+    for (const auto& image : images) {
+        if (image.channels() != channels) {
+            throw std::runtime_error { "The images of an atlas must have the same number of channels." };
+        }
+        sizes.push_back({ image.width(), image.height() });
+    }
+
+    BasicTextureAtlas<T, C> atlas {};
+    auto pages = pack_atlas(sizes, options, atlas.entries);
+    for (const auto& page : pages) {
+        atlas.pages.emplace_back(page.width, page.height, channels);
+    }
+    pool.parallel_for(images.size(), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto i = begin; i < end; i++) {
+            const auto& entry = atlas.entries[i];
+            blit_atlas_entry(images[i], entry, options.gutter, atlas.pages[static_cast<std::size_t>(entry.page)]);
+        }
+    });
+    return atlas;
+}
+
+} // namespace detail
+
+/// Packs images into as few atlas pages as possible.
+///
+/// Images are placed by the skyline packer of stb_rect_pack, largest first,
+/// opening a new page whenever an image no longer fits. Pages are cropped
+/// to the packed images, and copying the images runs on the pool.
+///
+/// @param images Images to pack, all with the same number of channels.
+/// @param options Page size, gutters and alignment of the images.
+/// @param pool Pool copying the images into the pages.
+/// @return Pages and location of every image, in the order of `images`.
+template <typename T>
+BasicTextureAtlas<T> build_atlas(const std::vector<BasicImageView<const T>>& images, const AtlasOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    int channels = images.empty() ? 1 : images.front().channels();
+    return detail::build_atlas<T, DynamicChannels>(images, channels, options, pool);
+}
+
+/// Packs images into as few atlas pages as possible.
+///
+/// @param images Images to pack, all with the same number of channels.
+/// @param options Page size, gutters and alignment of the images.
+/// @param pool Pool copying the images into the pages.
+/// @return Pages and location of every image, in the order of `images`.
+template <typename T, int C>
+BasicTextureAtlas<T, C> build_atlas(
+    const std::vector<BasicImage<T, C>>& images, const AtlasOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    std::vector<BasicImageView<const T>> views(images.begin(), images.end());
+    int channels = images.empty() ? (C != DynamicChannels ? C : 1) : images.front().channels();
+    return detail::build_atlas<T, C>(views, channels, options, pool);
+}
+
+/// 8-bit atlas with a runtime number of channels.
+using TextureAtlas = BasicTextureAtlas<unsigned char>;
@@ -0,0 +1,604 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageStatistics.hpp"
+#include "ImageView.hpp"
+#include "ThreadPool.hpp"
+
+/// Block compressed texture formats.
+enum class BlockFormat {
+    /// Opaque RGB, 4 bits per pixel.
+    BC1,
+    /// RGBA with interpolated alpha, 8 bits per pixel.
+    BC3,
+    /// Single channel, 4 bits per pixel.
+    BC4,
+    /// Two channels, 8 bits per pixel. Suited to normal maps.
+    BC5,
+    /// High quality RGBA, 8 bits per pixel.
+    BC7,
+};
+
+/// Returns the size in bytes of a 4x4 block of a format.
+inline std::size_t block_size(BlockFormat format) noexcept
+{
+    switch (format) {
+    case BlockFormat::BC1:
+    case BlockFormat::BC4:
+        return 8;
+    case BlockFormat::BC3:
+    case BlockFormat::BC5:
+    case BlockFormat::BC7:
+        return 16;
+    }
+    return 16;
+}
+
+/// Returns the size in bytes of an image compressed with a format.
+inline std::size_t compressed_size(BlockFormat format, int width, int height) noexcept
+{
+    auto blocks_x = static_cast<std::size_t>((width + 3) / 4);
+    auto blocks_y = static_cast<std::size_t>((height + 3) / 4);
+    return blocks_x * blocks_y * block_size(format);
+}
+
+/// Returns the smallest format keeping the channels of an 8-bit image, from
+/// its statistics: alpha is dropped when every pixel is opaque, and linear
+/// gray images keep a single channel.
+///
+/// @param statistics Statistics of the image.
+/// @param srgb Whether the image is sRGB encoded. BC4 has no sRGB variant,
+///             so opaque sRGB gray images are expanded to BC1 instead.
+inline BlockFormat choose_block_format(const ImageStatistics& statistics, bool srgb) noexcept
+{
+    bool gray = statistics.channels.size() <= 2;
+    if (statistics.alpha.opaque) {
+        return gray && !srgb ? BlockFormat::BC4 : BlockFormat::BC1;
+    }
+    return BlockFormat::BC7;
+}
+
+/// Image stored as rows of 4x4 blocks.
+struct CompressedImage {
+    BlockFormat format;
+    int width;
+    int height;
+    std::vector<unsigned char> data;
+};
+
+namespace detail {
+
+/// Pixels of a 4x4 block, expanded to RGBA in `[0, 255]`.
+struct ColorBlock {
+    float pixels[16][4];
+};
+
+/// Reads a block, clamping to the edges of the image.
+///
+/// @param raw Whether to copy the channels as they are, instead of
+///            expanding gray and gray-alpha pixels to RGBA.
+inline ColorBlock fetch_block(ConstImageView image, int block_x, int block_y, bool raw) noexcept
+{
+    ColorBlock block;
+    int channels = image.channels();
+    for (int i = 0; i < 16; i++) {
+        int x = std::min(block_x * 4 + i % 4, image.width() - 1);
+        int y = std::min(block_y * 4 + i / 4, image.height() - 1);
+        const unsigned char* pixel = image.pixel(x, y);
+        float* out = block.pixels[i];
+        if (raw) {
+            for (int c = 0; c < 4; c++) {
+                out[c] = c < channels ? pixel[c] : 0.0f;
+            }
+        } else if (channels >= 3) {
+            out[0] = pixel[0];
+            out[1] = pixel[1];
+            out[2] = pixel[2];
+            out[3] = channels == 4 ? pixel[3] : 255.0f;
+        } else {
+            out[0] = out[1] = out[2] = pixel[0];
+            out[3] = channels == 2 ? pixel[1] : 255.0f;
+        }
+    }
+    return block;
+}
+
+/// Returns the principal axis of the first `N` channels of a block.
+template <int N>
+void principal_axis(const ColorBlock& block, float (&mean)[N], float (&axis)[N]) noexcept
+{
+    float min[N];
+    float max[N];
+    for (int c = 0; c < N; c++) {
+        mean[c] = 0.0f;
+        min[c] = 255.0f;
+        max[c] = 0.0f;
+    }
+    for (const auto& pixel : block.pixels) {
+        for (int c = 0; c < N; c++) {
+            mean[c] += pixel[c];
+            min[c] = std::min(min[c], pixel[c]);
+            max[c] = std::max(max[c], pixel[c]);
+        }
+    }
+    for (int c = 0; c < N; c++) {
+        mean[c] /= 16.0f;
+    }
+
+    float covariance[N][N] = {};
+    for (const auto& pixel : block.pixels) {
+        float d[N];
+        for (int c = 0; c < N; c++) {
+            d[c] = pixel[c] - mean[c];
+        }
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) {
+                covariance[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    // Power iteration, seeded with the bounding box diagonal.
+    for (int c = 0; c < N; c++) {
+        axis[c] = max[c] - min[c];
+    }
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[N] = {};
+        for (int a = 0; a < N; a++) {
+            for (int b = 0; b < N; b++) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+        }
+        float length = 0.0f;
+        for (int c = 0; c < N; c++) {
+            length = std::max(length, std::abs(next[c]));
+        }
+        if (length < 1e-6f) {
+            break;
+        }
+        for (int c = 0; c < N; c++) {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+/// Returns the endpoints of the principal axis spanned by a block.
+template <int N>
+void fit_endpoints(const ColorBlock& block, float (&start)[N], float (&end)[N], float inset) noexcept
+{
+    float mean[N];
+    float axis[N];
+    principal_axis(block, mean, axis);
+
+    float length = 0.0f;
+    for (int c = 0; c < N; c++) {
+        length += axis[c] * axis[c];
+    }
+    float t_min = 0.0f;
+    float t_max = 0.0f;
+    if (length > 0.0f) {
+        t_min = 1e30f;
+        t_max = -1e30f;
+        for (const auto& pixel : block.pixels) {
+            float t = 0.0f;
+            for (int c = 0; c < N; c++) {
+                t += (pixel[c] - mean[c]) * axis[c];
+            }
+            t /= length;
+            t_min = std::min(t_min, t);
+            t_max = std::max(t_max, t);
+        }
+        float shrink = (t_max - t_min) * inset;
+        t_min += shrink;
+        t_max -= shrink;
+    }
+    for (int c = 0; c < N; c++) {
+        start[c] = std::clamp(mean[c] + t_min * axis[c], 0.0f, 255.0f);
+        end[c] = std::clamp(mean[c] + t_max * axis[c], 0.0f, 255.0f);
+    }
+}
+
+/// Refines two endpoints by least squares, given the interpolation weight of every pixel.
+template <int N>
+bool refine_endpoints(const ColorBlock& block, const float (&weights)[16], float (&start)[N], float (&end)[N]) noexcept
+{
+    float aa = 0.0f;
+    float ab = 0.0f;
+    float bb = 0.0f;
+    float ax[N] = {};
+    float bx[N] = {};
+    for (int i = 0; i < 16; i++) {
+        float b = weights[i];
+        float a = 1.0f - b;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for (int c = 0; c < N; c++) {
+            ax[c] += a * block.pixels[i][c];
+            bx[c] += b * block.pixels[i][c];
+        }
+    }
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f) {
+        return false;
+    }
+    float inverse = 1.0f / determinant;
+    for (int c = 0; c < N; c++) {
+        start[c] = std::clamp((ax[c] * bb - bx[c] * ab) * inverse, 0.0f, 255.0f);
+        end[c] = std::clamp((bx[c] * aa - ax[c] * ab) * inverse, 0.0f, 255.0f);
+    }
+    return true;
+}
+
+inline std::uint16_t pack_565(const float (&color)[3]) noexcept
+{
+    auto r = static_cast<std::uint16_t>(std::lround(color[0] * 31.0f / 255.0f));
+    auto g = static_cast<std::uint16_t>(std::lround(color[1] * 63.0f / 255.0f));
+    auto b = static_cast<std::uint16_t>(std::lround(color[2] * 31.0f / 255.0f));
+    return static_cast<std::uint16_t>((r << 11) | (g << 5) | b);
+}
+
+inline void unpack_565(std::uint16_t packed, float (&color)[3]) noexcept
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+    color[0] = static_cast<float>((r << 3) | (r >> 2));
+    color[1] = static_cast<float>((g << 2) | (g >> 4));
+    color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+/// Chooses the nearest palette entry for every pixel, returning the total squared error.
+template <int N, int Entries>
+float select_indices(const ColorBlock& block, const float (&palette)[Entries][N], int (&indices)[16]) noexcept
+{
+    float total = 0.0f;
+    for (int i = 0; i < 16; i++) {
+        float best = 1e30f;
+        for (int e = 0; e < Entries; e++) {
+            float error = 0.0f;
+            for (int c = 0; c < N; c++) {
+                float d = block.pixels[i][c] - palette[e][c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                indices[i] = e;
+            }
+        }
+        total += best;
+    }
+    return total;
+}
+
+struct Bc1Candidate {
+    std::uint16_t color0;
+    std::uint16_t color1;
+    int indices[16];
+    float error;
+};
+
+inline Bc1Candidate evaluate_bc1(const ColorBlock& block, std::uint16_t color0, std::uint16_t color1) noexcept
+{
+    if (color0 < color1) {
+        std::swap(color0, color1);
+    }
+    Bc1Candidate candidate { color0, color1, {}, 0.0f };
+    float palette[4][3];
+    unpack_565(color0, palette[0]);
+    unpack_565(color1, palette[1]);
+    for (int c = 0; c < 3; c++) {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+    // Equal endpoints select the three color mode, in which only index 0 is
+    // safe. All entries are equal then and the first one wins.
+    candidate.error = select_indices<3, 4>(block, palette, candidate.indices);
+    return candidate;
+}
+
+/// Encodes the color of a block in the four color mode of BC1.
+inline void encode_bc1(const ColorBlock& block, unsigned char* out) noexcept
+{
+    float start[3];
+    float end[3];
+    fit_endpoints<3>(block, start, end, 1.0f / 16.0f);
+    auto best = evaluate_bc1(block, pack_565(end), pack_565(start));
+
+    // The indices of the fitted endpoints give a better least squares fit.
+    static constexpr float index_weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float weights[16];
+    for (int i = 0; i < 16; i++) {
+        weights[i] = index_weights[best.indices[i]];
+    }
+    if (refine_endpoints<3>(block, weights, start, end)) {
+        auto refined = evaluate_bc1(block, pack_565(start), pack_565(end));
+        if (refined.error < best.error) {
+            best = refined;
+        }
+    }
+
+    std::uint32_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= static_cast<std::uint32_t>(best.indices[i]) << (2 * i);
+    }
+    out[0] = static_cast<unsigned char>(best.color0 & 0xFF);
+    out[1] = static_cast<unsigned char>(best.color0 >> 8);
+    out[2] = static_cast<unsigned char>(best.color1 & 0xFF);
+    out[3] = static_cast<unsigned char>(best.color1 >> 8);
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = static_cast<unsigned char>((bits >> (8 * i)) & 0xFF);
+    }
+}
+
+/// Encodes one channel of a block as a BC4 block, as used by BC3, BC4 and BC5.
+inline void encode_bc4(const ColorBlock& block, int channel, unsigned char* out) noexcept
+{
+    float values[16];
+    for (int i = 0; i < 16; i++) {
+        values[i] = block.pixels[i][channel];
+    }
+
+    auto evaluate = [&](const float (&palette)[8], int (&indices)[16]) {
+        float total = 0.0f;
+        for (int i = 0; i < 16; i++) {
+            float best = 1e30f;
+            for (int e = 0; e < 8; e++) {
+                float d = values[i] - palette[e];
+                if (d * d < best) {
+                    best = d * d;
+                    indices[i] = e;
+                }
+            }
+            total += best;
+        }
+        return total;
+    };
+
+    // Eight interpolated values between the extremes.
+    int max = static_cast<int>(*std::max_element(std::begin(values), std::end(values)));
+    int min = static_cast<int>(*std::min_element(std::begin(values), std::end(values)));
+    int a0 = max;
+    int a1 = min;
+    float palette[8] = { static_cast<float>(a0), static_cast<float>(a1) };
+    for (int i = 1; i < 7; i++) {
+        palette[i + 1] = static_cast<float>(((7 - i) * a0 + i * a1 + 3) / 7);
+    }
+    int indices[16];
+    float error = evaluate(palette, indices);
+
+    // Six interpolated values plus exact 0 and 255, better for blocks with extremes.
+    int inner_min = 255;
+    int inner_max = 0;
+    for (float value : values) {
+        int v = static_cast<int>(value);
+        if (v != 0 && v != 255) {
+            inner_min = std::min(inner_min, v);
+            inner_max = std::max(inner_max, v);
+        }
+    }
+    if (inner_min > inner_max) {
+        inner_min = inner_max = min;
+    }
+    if (min == 0 || max == 255) {
+        int b0 = inner_min;
+        int b1 = inner_max;
+        float six[8] = { static_cast<float>(b0), static_cast<float>(b1) };
+        for (int i = 1; i < 5; i++) {
+            six[i + 1] = static_cast<float>(((5 - i) * b0 + i * b1 + 2) / 5);
+        }
+        six[6] = 0.0f;
+        six[7] = 255.0f;
+        int six_indices[16];
+        float six_error = evaluate(six, six_indices);
+        if (six_error < error) {
+            a0 = b0;
+            a1 = b1;
+            error = six_error;
+            std::copy(std::begin(six_indices), std::end(six_indices), std::begin(indices));
+        }
+    }
+
+    std::uint64_t bits = 0;
+    for (int i = 0; i < 16; i++) {
+        bits |= static_cast<std::uint64_t>(indices[i]) << (3 * i);
+    }
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<unsigned char>((bits >> (8 * i)) & 0xFF);
+    }
+}
+
+/// Little endian bit stream filling a 128 bit block.
+class BlockWriter {
+public:
+    explicit BlockWriter(unsigned char* out) noexcept
+        : m_out { out }
+    {
+        std::memset(out, 0, 16);
+    }
+
+    void write(std::uint32_t value, int bits) noexcept
+    {
+        for (int i = 0; i < bits; i++) {
+            if ((value >> i) & 1u) {
+                this->m_out[this->m_position / 8] |= static_cast<unsigned char>(1u << (this->m_position % 8));
+            }
+            this->m_position++;
+        }
+    }
+
+private:
+    unsigned char* m_out;
+    int m_position { 0 };
+};
+
+/// Encodes a block in mode 6 of BC7: one RGBA subset with 7 bit endpoints,
+/// a p-bit per endpoint and 4 bit indices.
+inline void encode_bc7(const ColorBlock& block, unsigned char* out) noexcept
+{
+    static constexpr int index_weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+    struct Candidate {
+        int endpoints[2][4];
+        int p_bits[2];
+        int indices[16];
+        float error;
+    };
+
+    auto quantize = [](const float (&color)[4], int (&endpoint)[4], int& p_bit) {
+        float best = 1e30f;
+        for (int p = 0; p < 2; p++) {
+            int quantized[4];
+            float error = 0.0f;
+            for (int c = 0; c < 4; c++) {
+                quantized[c] = std::clamp(static_cast<int>(std::lround((color[c] - p) / 2.0f)), 0, 127);
+                float d = static_cast<float>((quantized[c] << 1) | p) - color[c];
+                error += d * d;
+            }
+            if (error < best) {
+                best = error;
+                p_bit = p;
+                std::copy(std::begin(quantized), std::end(quantized), std::begin(endpoint));
+            }
+        }
+    };
+
+    auto evaluate = [&](const float (&start)[4], const float (&end)[4]) {
+        Candidate candidate {};
+        quantize(start, candidate.endpoints[0], candidate.p_bits[0]);
+        quantize(end, candidate.endpoints[1], candidate.p_bits[1]);
+        float palette[16][4];
+        for (int c = 0; c < 4; c++) {
+            int e0 = (candidate.endpoints[0][c] << 1) | candidate.p_bits[0];
+            int e1 = (candidate.endpoints[1][c] << 1) | candidate.p_bits[1];
+            for (int i = 0; i < 16; i++) {
+                palette[i][c] = static_cast<float>(((64 - index_weights[i]) * e0 + index_weights[i] * e1 + 32) >> 6);
+            }
+        }
+        candidate.error = select_indices<4, 16>(block, palette, candidate.indices);
+        return candidate;
+    };
+
+    float start[4];
+    float end[4];
+    fit_endpoints<4>(block, start, end, 0.0f);
+    auto best = evaluate(start, end);
+
+    float weights[16];
+    for (int i = 0; i < 16; i++) {
+        weights[i] = index_weights[best.indices[i]] / 64.0f;
+    }
+    if (refine_endpoints<4>(block, weights, start, end)) {
+        auto refined = evaluate(start, end);
+        if (refined.error < best.error) {
+            best = refined;
+        }
+    }
+
+    // The most significant bit of the first index is implied to be zero.
+    if (best.indices[0] >= 8) {
+        std::swap(best.endpoints[0], best.endpoints[1]);
+        std::swap(best.p_bits[0], best.p_bits[1]);
+        for (int& index : best.indices) {
+            index = 15 - index;
+        }
+    }
+
+    BlockWriter writer { out };
+    writer.write(1u << 6, 7);
+    for (int c = 0; c < 4; c++) {
+        writer.write(static_cast<std::uint32_t>(best.endpoints[0][c]), 7);
+        writer.write(static_cast<std::uint32_t>(best.endpoints[1][c]), 7);
+    }
+    writer.write(static_cast<std::uint32_t>(best.p_bits[0]), 1);
+    writer.write(static_cast<std::uint32_t>(best.p_bits[1]), 1);
+    writer.write(static_cast<std::uint32_t>(best.indices[0]), 3);
+    for (int i = 1; i < 16; i++) {
+        writer.write(static_cast<std::uint32_t>(best.indices[i]), 4);
+    }
+}
+
+inline void encode_block(BlockFormat format, const ColorBlock& block, unsigned char* out) noexcept
+{
+    switch (format) {
+    case BlockFormat::BC1:
+        encode_bc1(block, out);
+        break;
+    case BlockFormat::BC3:
+        encode_bc4(block, 3, out);
+        encode_bc1(block, out + 8);
+        break;
+    case BlockFormat::BC4:
+        encode_bc4(block, 0, out);
+        break;
+    case BlockFormat::BC5:
+        encode_bc4(block, 0, out);
+        encode_bc4(block, 1, out + 8);
+        break;
+    case BlockFormat::BC7:
+        encode_bc7(block, out);
+        break;
+    }
+}
+
+} // namespace detail
+
+/// Compresses an 8-bit image into 4x4 blocks.
+///
+/// BC1, BC3 and BC7 expand gray images to RGB. BC4 encodes the first
+/// channel and BC5 the first two. BC1 ignores alpha. Rows of blocks are
+/// encoded in parallel on the pool.
+///
+/// @param image Compressed pixels, e.g. an image or a rectangle of one.
+/// @param format Block format.
+/// @param pool Pool used to encode the rows of blocks.
+inline CompressedImage compress_image(ConstImageView image, BlockFormat format, ThreadPool& pool = ThreadPool::global())
+{
+    if (format == BlockFormat::BC5 && image.channels() < 2) {
+        throw std::runtime_error { "BC5 compression requires an image with at least two channels." };
+    }
+
+    CompressedImage result { format, image.width(), image.height(), {} };
+    result.data.resize(compressed_size(format, image.width(), image.height()));
+
+    int blocks_x = (image.width() + 3) / 4;
+    int blocks_y = (image.height() + 3) / 4;
+    auto row_size = static_cast<std::size_t>(blocks_x) * block_size(format);
+    bool raw = format == BlockFormat::BC4 || format == BlockFormat::BC5;
+    pool.parallel_for(static_cast<std::size_t>(blocks_y), 1, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            unsigned char* out = result.data.data() + y * row_size;
+            for (int x = 0; x < blocks_x; x++) {
+                auto block = detail::fetch_block(image, x, static_cast<int>(y), raw);
+                detail::encode_block(format, block, out + static_cast<std::size_t>(x) * block_size(format));
+            }
+        }
+    });
+    return result;
+}
+
+/// Compresses every level of a mip chain.
+///
+/// @param levels Mip levels, starting with the base level.
+/// @param format Block format.
+/// @param pool Pool used to encode the rows of blocks.
+inline std::vector<CompressedImage> compress_mip_chain(
+    const std::vector<Image>& levels, BlockFormat format, ThreadPool& pool = ThreadPool::global())
+{
+    std::vector<CompressedImage> result {};
+    result.reserve(levels.size());
+    for (const auto& level : levels) {
+        result.push_back(compress_image(level, format, pool));
+    }
+    return result;
+}
@@ -0,0 +1,424 @@
+#pragma once
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "MappedFile.hpp"
+#include "Mipmap.hpp"
+#include "TextureCompression.hpp"
+#include "ThreadPool.hpp"
+
+// Precooked texture container.
+//
+// A little endian file made of a `TextureFileHeader`, one `TextureFileLevel`
+// per mip level and the level payloads. Each payload starts at a multiple of
+// `texture_file_alignment` and holds tightly packed rows, or rows of 4x4
+// blocks, exactly as OpenGL expects them.
+
+/// Pixel formats of a texture container.
+enum class TextureFileFormat : std::uint32_t {
+    R8 = 1,
+    RG8 = 2,
+    RGB8 = 3,
+    RGBA8 = 4,
+    R16 = 5,
+    RG16 = 6,
+    RGB16 = 7,
+    RGBA16 = 8,
+    R32F = 9,
+    RG32F = 10,
+    RGB32F = 11,
+    RGBA32F = 12,
+    BC1 = 32,
+    BC3 = 33,
+    BC4 = 34,
+    BC5 = 35,
+    BC7 = 36,
+};
+
+/// Flags of a texture container.
+enum TextureFileFlags : std::uint32_t {
+    /// The color channels are sRGB encoded.
+    TextureFileSrgb = 1u << 0,
+};
+
+inline constexpr char texture_file_magic[4] = { 'C', 'G', 'T', 'X' };
+inline constexpr std::uint32_t texture_file_version = 1;
+inline constexpr std::size_t texture_file_alignment = 64;
+
+/// Header at the start of a texture container.
+struct TextureFileHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t format;
+    std::uint32_t flags;
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t level_count;
+    std::uint32_t reserved;
+};
+
+/// Entry of the level table following the header.
+struct TextureFileLevel {
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint32_t width;
+    std::uint32_t height;
+};
+
+static_assert(sizeof(TextureFileHeader) == 32, "Unexpected padding in the texture file header.");
+static_assert(sizeof(TextureFileLevel) == 24, "Unexpected padding in the texture file level.");
+
+/// Returns the block format of a container format, if it is compressed.
+inline std::optional<BlockFormat> texture_file_block_format(TextureFileFormat format) noexcept
+{
+    switch (format) {
+    case TextureFileFormat::BC1:
+        return BlockFormat::BC1;
+    case TextureFileFormat::BC3:
+        return BlockFormat::BC3;
+    case TextureFileFormat::BC4:
+        return BlockFormat::BC4;
+    case TextureFileFormat::BC5:
+        return BlockFormat::BC5;
+    case TextureFileFormat::BC7:
+        return BlockFormat::BC7;
+    default:
+        return std::nullopt;
+    }
+}
+
+/// Returns the container format of a block format.
+inline TextureFileFormat texture_file_format(BlockFormat format) noexcept
+{
+    switch (format) {
+    case BlockFormat::BC1:
+        return TextureFileFormat::BC1;
+    case BlockFormat::BC3:
+        return TextureFileFormat::BC3;
+    case BlockFormat::BC4:
+        return TextureFileFormat::BC4;
+    case BlockFormat::BC5:
+        return TextureFileFormat::BC5;
+    case BlockFormat::BC7:
+        return TextureFileFormat::BC7;
+    }
+    return TextureFileFormat::BC7;
+}
+
+/// Returns the container format of uncompressed pixels.
+///
+/// @tparam T Type of a single channel.
+/// @param channels Number of channels.
+template <typename T>
+TextureFileFormat texture_file_format(int channels) noexcept
+{
+    std::uint32_t base = 0;
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        base = static_cast<std::uint32_t>(TextureFileFormat::R8);
+    } else if constexpr (std::is_same_v<T, unsigned short>) {
+        base = static_cast<std::uint32_t>(TextureFileFormat::R16);
+    } else {
+        base = static_cast<std::uint32_t>(TextureFileFormat::R32F);
+    }
+    return static_cast<TextureFileFormat>(base + static_cast<std::uint32_t>(channels) - 1);
+}
+
+/// Returns the size in bytes of a level of a container format.
+inline std::size_t texture_file_level_size(TextureFileFormat format, std::uint32_t width, std::uint32_t height)
+{
+    if (auto block_format = texture_file_block_format(format)) {
+        return compressed_size(*block_format, static_cast<int>(width), static_cast<int>(height));
+    }
+    auto value = static_cast<std::uint32_t>(format);
+    if (value < 1 || value > 12) {
+        throw std::runtime_error { "Unknown texture file format." };
+    }
+    std::size_t channels = (value - 1) % 4 + 1;
+    std::size_t channel_size = value <= 4 ? 1 : (value <= 8 ? 2 : 4);
+    return static_cast<std::size_t>(width) * height * channels * channel_size;
+}
+
+/// Level of a texture container, pointing into the mapped file.
+struct TextureFileView {
+    std::uint32_t width;
+    std::uint32_t height;
+    const unsigned char* data;
+    std::size_t size;
+};
+
+/// Texture container mapped into memory.
+///
+/// The levels are validated when opening and point straight into the
+/// mapping, so they can be handed to OpenGL without decoding or copying.
+class TextureFile {
+public:
+    /// Maps and validates a texture container.
+    ///
+    /// @param file_name Absolute path to the container.
+    explicit TextureFile(const std::filesystem::path& file_name)
+        : m_file { file_name }
+    {
+        auto error = [&](const char* reason) {
+            return std::runtime_error { std::string { reason } + " Texture file: " + file_name.string() };
+        };
+
+        if (this->m_file.size() < sizeof(TextureFileHeader)) {
+            throw error("Truncated header.");
+        }
+        std::memcpy(&this->m_header, this->m_file.data(), sizeof(TextureFileHeader));
+        if (std::memcmp(this->m_header.magic, texture_file_magic, sizeof(texture_file_magic)) != 0) {
+            throw error("Not a texture file.");
+        }
+        if (this->m_header.version != texture_file_version) {
+            throw error("Unsupported texture file version.");
+        }
+        if (this->m_header.level_count == 0 || this->m_header.level_count > 32) {
+            throw error("Invalid number of levels.");
+        }
+
+        auto table_end = sizeof(TextureFileHeader) + this->m_header.level_count * sizeof(TextureFileLevel);
+        if (this->m_file.size() < table_end) {
+            throw error("Truncated level table.");
+        }
+        this->m_levels.resize(this->m_header.level_count);
+        std::memcpy(this->m_levels.data(), this->m_file.data() + sizeof(TextureFileHeader),
+            this->m_levels.size() * sizeof(TextureFileLevel));
+
+        for (const auto& level : this->m_levels) {
+            auto expected = texture_file_level_size(this->format(), level.width, level.height);
+            if (level.width == 0 || level.height == 0 || level.size != expected) {
+                throw error("Invalid level size.");
+            }
+            if (level.offset % texture_file_alignment != 0 || level.offset < table_end
+                || level.offset > this->m_file.size() || level.size > this->m_file.size() - level.offset) {
+                throw error("Invalid level offset.");
+            }
+        }
+    }
+
+    /// Returns the pixel format of the levels.
+    TextureFileFormat format() const noexcept
+    {
+        return static_cast<TextureFileFormat>(this->m_header.format);
+    }
+
+    /// Returns whether the color channels are sRGB encoded.
+    bool srgb() const noexcept
+    {
+        return (this->m_header.flags & TextureFileSrgb) != 0;
+    }
+
+    /// Returns the width of the base level.
+    int width() const noexcept
+    {
+        return static_cast<int>(this->m_header.width);
+    }
+
+    /// Returns the height of the base level.
+    int height() const noexcept
+    {
+        return static_cast<int>(this->m_header.height);
+    }
+
+    /// Returns the number of mip levels.
+    int level_count() const noexcept
+    {
+        return static_cast<int>(this->m_levels.size());
+    }
+
+    /// Returns a mip level.
+    ///
+    /// @param index Index of the level, `0` being the base level.
+    TextureFileView level(int index) const
+    {
+        const auto& level = this->m_levels.at(static_cast<std::size_t>(index));
+        return { level.width, level.height, this->m_file.data() + level.offset, static_cast<std::size_t>(level.size) };
+    }
+
+private:
+    MappedFile m_file;
+    TextureFileHeader m_header {};
+    std::vector<TextureFileLevel> m_levels;
+};
+
+/// Writes levels to a texture container.
+///
+/// @param file_name Absolute path of the written container.
+/// @param format Pixel format of the levels.
+/// @param srgb Whether the color channels are sRGB encoded.
+/// @param levels Size and contents of every level, starting with the base level.
+inline void write_texture_file(const std::filesystem::path& file_name, TextureFileFormat format, bool srgb,
+    const std::vector<TextureFileView>& levels)
+{
+    if (levels.empty() || levels.size() > 32) {
+        throw std::runtime_error { "A texture file must have between 1 and 32 levels." };
+    }
+
+    TextureFileHeader header {};
+    std::memcpy(header.magic, texture_file_magic, sizeof(texture_file_magic));
+    header.version = texture_file_version;
+    header.format = static_cast<std::uint32_t>(format);
+    header.flags = srgb ? TextureFileSrgb : 0u;
+    header.width = levels.front().width;
+    header.height = levels.front().height;
+    header.level_count = static_cast<std::uint32_t>(levels.size());
+
+    auto align = [](std::uint64_t offset) {
+        return (offset + texture_file_alignment - 1) / texture_file_alignment * texture_file_alignment;
+    };
+    std::vector<TextureFileLevel> table {};
+    std::uint64_t offset = align(sizeof(TextureFileHeader) + levels.size() * sizeof(TextureFileLevel));
+    for (const auto& level : levels) {
+        if (level.size != texture_file_level_size(format, level.width, level.height)) {
+            throw std::runtime_error { "The level size does not match the texture file format." };
+        }
+        table.push_back({ offset, level.size, level.width, level.height });
+        offset = align(offset + level.size);
+    }
+
+    // Written next to the destination and renamed, so readers never see a partial file.
+    auto temporary = file_name;
+    temporary += ".tmp";
+    try {
+        std::ofstream file { temporary, std::ios::binary | std::ios::trunc };
+        if (!file) {
+            throw std::runtime_error { "Could not create texture file: " + file_name.string() };
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(TextureFileLevel)));
+
+        static constexpr char padding[texture_file_alignment] = {};
+        std::uint64_t position = sizeof(header) + table.size() * sizeof(TextureFileLevel);
+        for (std::size_t i = 0; i < levels.size(); i++) {
+            file.write(padding, static_cast<std::streamsize>(table[i].offset - position));
+            file.write(reinterpret_cast<const char*>(levels[i].data), static_cast<std::streamsize>(levels[i].size));
+            position = table[i].offset + table[i].size;
+        }
+        file.close();
+        if (!file) {
+            throw std::runtime_error { "Could not write texture file: " + file_name.string() };
+        }
+        std::filesystem::rename(temporary, file_name);
+    } catch (...) {
+        std::error_code error {};
+        std::filesystem::remove(temporary, error);
+        throw;
+    }
+}
+
+/// Options of the texture cooker.
+struct TextureCookOptions {
+    /// Whether to generate the full mip chain.
+    bool mipmaps { true };
+    /// Settings of the mip chain generation.
+    MipmapOptions mipmap_options {};
+    /// Block format of 8-bit images, or none to store raw pixels.
+    std::optional<BlockFormat> compression {};
+    /// Whether to choose the block format of 8-bit images from their
+    /// statistics with `choose_block_format()`, instead of `compression`.
+    bool choose_compression { false };
+};
+
+namespace detail {
+
+template <typename T>
+void cook_levels(BasicImage<T>&& image, const std::filesystem::path& destination, const TextureCookOptions& options,
+    ThreadPool& pool)
+{
+    auto mipmap_options = options.mipmap_options;
+    if (!options.mipmaps) {
+        mipmap_options.max_levels = 1;
+    }
+    auto compression = options.compression;
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        if (options.choose_compression) {
+            compression = choose_block_format(image_statistics(image, {}, pool), mipmap_options.srgb);
+        }
+    }
+    auto chain = build_mip_chain(std::move(image), mipmap_options, pool);
+    bool srgb = std::is_same_v<T, unsigned char> && mipmap_options.srgb;
+
+    if constexpr (std::is_same_v<T, unsigned char>) {
+        if (compression) {
+            auto compressed = compress_mip_chain(chain, *compression, pool);
+            std::vector<TextureFileView> levels {};
+            for (const auto& level : compressed) {
+                levels.push_back({ static_cast<std::uint32_t>(level.width), static_cast<std::uint32_t>(level.height),
+                    level.data.data(), level.data.size() });
+            }
+            write_texture_file(destination, texture_file_format(*compression), srgb, levels);
+            return;
+        }
+    }
+
+    std::vector<TextureFileView> levels {};
+    for (auto& level : chain) {
+        if (!level.contiguous()) {
+            // The container stores tightly packed rows.
+            BasicImage<T> packed { level.width(), level.height(), level.channels() };
+            copy_pixels<T>(level, packed);
+            level = std::move(packed);
+        }
+        levels.push_back({ static_cast<std::uint32_t>(level.width()), static_cast<std::uint32_t>(level.height()),
+            reinterpret_cast<const unsigned char*>(level.data()), level.size() * sizeof(T) });
+    }
+    write_texture_file(destination, texture_file_format<T>(chain.front().channels()), srgb, levels);
+}
+
+} // namespace detail
+
+/// Converts an image file readable by stb_image into a texture container.
+///
+/// HDR files are stored as floats and 16-bit files as 16-bit pixels.
+/// Compression only applies to 8-bit files.
+///
+/// @param source Absolute path to the image file.
+/// @param destination Absolute path of the written container.
+/// @param options Cooking settings.
+/// @param pool Pool used to generate and compress the levels.
+inline void cook_texture(const std::filesystem::path& source, const std::filesystem::path& destination,
+    const TextureCookOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    auto source_str = source.string();
+    if (stbi_is_hdr(source_str.c_str())) {
+        detail::cook_levels(ImageF { source, ImageLoadMode::MemoryMapped }, destination, options, pool);
+    } else if (stbi_is_16_bit(source_str.c_str())) {
+        detail::cook_levels(Image16 { source, ImageLoadMode::MemoryMapped }, destination, options, pool);
+    } else {
+        detail::cook_levels(Image { source, ImageLoadMode::MemoryMapped }, destination, options, pool);
+    }
+}
+
+/// Cooks a texture container unless it is newer than its source.
+///
+/// @param source Absolute path to the image file.
+/// @param destination Absolute path of the container.
+/// @param options Cooking settings.
+/// @param pool Pool used to generate and compress the levels.
+/// @return Whether the container was written.
+inline bool cook_texture_if_stale(const std::filesystem::path& source, const std::filesystem::path& destination,
+    const TextureCookOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    std::error_code error {};
+    auto cooked_time = std::filesystem::last_write_time(destination, error);
+    if (!error && cooked_time >= std::filesystem::last_write_time(source)) {
+        return false;
+    }
+    cook_texture(source, destination, options, pool);
+    return true;
+}
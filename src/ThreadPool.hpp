@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Fixed-size pool of worker threads executing submitted tasks in FIFO order.
+class ThreadPool {
+public:
+    /// Starts a new pool.
+    ///
+    /// @param thread_count Number of worker threads, at least one.
+    explicit ThreadPool(std::size_t thread_count = default_thread_count())
+    {
+        thread_count = std::max<std::size_t>(thread_count, 1);
+        this->m_workers.reserve(thread_count);
+        for (std::size_t i = 0; i < thread_count; i++) {
+            this->m_workers.emplace_back([this] { this->run(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Finishes all queued tasks and joins the workers.
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock { this->m_mutex };
+            this->m_stopping = true;
+        }
+        this->m_condition.notify_all();
+        for (auto& worker : this->m_workers) {
+            worker.join();
+        }
+    }
+
+    /// Returns the pool shared by the whole application.
+    static ThreadPool& global()
+    {
+        static ThreadPool pool {};
+        return pool;
+    }
+
+    /// Returns the number of threads used by default.
+    static std::size_t default_thread_count() noexcept
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    /// Returns the number of worker threads.
+    std::size_t size() const noexcept
+    {
+        return this->m_workers.size();
+    }
+
+    /// Queues a task for execution on one of the workers.
+    ///
+    /// @param task Callable without arguments.
+    /// @return Future receiving the result, or the exception thrown by the task.
+    template <typename F>
+    std::future<std::invoke_result_t<std::decay_t<F>>> submit(F&& task)
+    {
+        using Result = std::invoke_result_t<std::decay_t<F>>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        auto future = packaged->get_future();
+        this->enqueue([packaged] { (*packaged)(); });
+        return future;
+    }
+
+    /// Splits a range into bands and processes them in parallel.
+    ///
+    /// The calling thread works on the bands as well, so the call also makes
+    /// progress if all workers are busy, e.g. when called from within a task.
+    /// Returns once every band has been processed.
+    ///
+    /// @param count Number of elements in the range `[0, count)`.
+    /// @param grain Minimal number of elements per band.
+    /// @param body Callable invoked as `body(begin, end)` for each band.
+    template <typename F>
+    void parallel_for(std::size_t count, std::size_t grain, F&& body)
+    {
+        if (count == 0) {
+            return;
+        }
+        grain = std::max<std::size_t>(grain, 1);
+        auto max_bands = (count + grain - 1) / grain;
+        auto band_count = std::min(max_bands, (this->size() + 1) * 4);
+        if (band_count <= 1) {
+            body(std::size_t { 0 }, count);
+            return;
+        }
+
+        struct State {
+            std::function<void(std::size_t, std::size_t)> body;
+            std::size_t count;
+            std::size_t band_count;
+            std::atomic<std::size_t> next_band { 0 };
+            std::size_t finished_bands { 0 };
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable finished;
+
+            void work()
+            {
+                while (true) {
+                    auto band = this->next_band.fetch_add(1);
+                    if (band >= this->band_count) {
+                        return;
+                    }
+                    try {
+                        auto begin = band * this->count / this->band_count;
+                        auto end = (band + 1) * this->count / this->band_count;
+                        this->body(begin, end);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock { this->mutex };
+                        if (!this->error) {
+                            this->error = std::current_exception();
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock { this->mutex };
+                    if (++this->finished_bands == this->band_count) {
+                        this->finished.notify_all();
+                    }
+                }
+            }
+        };
+
+        auto state = std::make_shared<State>();
+        state->body = [&body](std::size_t begin, std::size_t end) { body(begin, end); };
+        state->count = count;
+        state->band_count = band_count;
+
+        auto helpers = std::min(band_count - 1, this->size());
+        for (std::size_t i = 0; i < helpers; i++) {
+            this->enqueue([state] { state->work(); });
+        }
+        state->work();
+
+        std::unique_lock<std::mutex> lock { state->mutex };
+        state->finished.wait(lock, [&] { return state->finished_bands == state->band_count; });
+        if (state->error) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+private:
+    void enqueue(std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock { this->m_mutex };
+            this->m_tasks.push(std::move(task));
+        }
+        this->m_condition.notify_one();
+    }
+
+    void run()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock { this->m_mutex };
+                this->m_condition.wait(lock, [this] { return this->m_stopping || !this->m_tasks.empty(); });
+                if (this->m_tasks.empty()) {
+                    return;
+                }
+                task = std::move(this->m_tasks.front());
+                this->m_tasks.pop();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::queue<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping { false };
+};
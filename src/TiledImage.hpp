@@ -0,0 +1,577 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+#include "Image.hpp"
+
+namespace detail {
+
+/// Number of bits of a coordinate within a tile.
+inline constexpr int tile_shift = 5;
+/// Width and height of a tile in pixels.
+inline constexpr int tile_size = 1 << tile_shift;
+/// Number of pixels of a tile.
+inline constexpr int tile_pixels = tile_size * tile_size;
+/// Alignment of the storage of tiled images, one page.
+inline constexpr std::size_t tile_alignment = 4096;
+
+/// Morton codes of the coordinates within a tile, with `x` in the even bits
+/// and `y` in the odd bits, so that `x_bits[x] | y_bits[y]` is the index of
+/// a pixel within its tile.
+struct MortonTables {
+    std::array<std::uint16_t, tile_size> x_bits {};
+    std::array<std::uint16_t, tile_size> y_bits {};
+    std::array<std::uint8_t, tile_pixels> x_of {};
+    std::array<std::uint8_t, tile_pixels> y_of {};
+
+    constexpr MortonTables()
+    {
+        for (int v = 0; v < tile_size; v++) {
+            std::uint16_t spread = 0;
+            for (int bit = 0; bit < tile_shift; bit++) {
+                spread |= static_cast<std::uint16_t>(((v >> bit) & 1) << (2 * bit));
+            }
+            this->x_bits[v] = spread;
+            this->y_bits[v] = static_cast<std::uint16_t>(spread << 1);
+        }
+        for (int y = 0; y < tile_size; y++) {
+            for (int x = 0; x < tile_size; x++) {
+                int index = this->x_bits[x] | this->y_bits[y];
+                this->x_of[index] = static_cast<std::uint8_t>(x);
+                this->y_of[index] = static_cast<std::uint8_t>(y);
+            }
+        }
+    }
+};
+
+inline constexpr MortonTables morton_tables {};
+
+} // namespace detail
+
+/// Image stored in square tiles, with the pixels of each tile in Morton order.
+///
+/// Neighbouring pixels stay close in memory along both axes, so passes that
+/// walk columns or small windows touch few cache lines and pages. The
+/// storage is aligned to 4 KiB pages: a tile of RGBA8 pixels fills exactly
+/// one page, larger pixels span whole pages and smaller ones share a page
+/// between several tiles. The edge tiles are padded, so the storage covers
+/// the image size rounded up to whole tiles.
+///
+/// Pixels are reached through `pixel()`, `sample()`, `for_each_pixel()`,
+/// `row()` and `tiles()`, which hide the layout.
+///
+/// @tparam T Type of a single channel.
+/// @tparam Channels Number of channels, or `DynamicChannels`.
+template <typename T, int Channels = DynamicChannels>
+class BasicTiledImage {
+    static_assert(std::is_same_v<T, unsigned char> || std::is_same_v<T, unsigned short> || std::is_same_v<T, float>,
+        "The channel type must be one of unsigned char, unsigned short or float.");
+    static_assert(Channels >= 0 && Channels <= 4, "The image must have between 1 and 4 channels.");
+
+public:
+    using value_type = T;
+
+    /// Number of channels, or `DynamicChannels` if only known at runtime.
+    static constexpr int static_channels = Channels;
+
+    /// Width and height of a tile in pixels.
+    static constexpr int tile_size = detail::tile_size;
+
+    /// Pair of iterators usable in range-based for loops.
+    template <typename Iterator>
+    class Range {
+    public:
+        Range(Iterator begin, Iterator end) noexcept
+            : m_begin { begin }
+            , m_end { end }
+        {
+        }
+
+        Iterator begin() const noexcept
+        {
+            return this->m_begin;
+        }
+
+        Iterator end() const noexcept
+        {
+            return this->m_end;
+        }
+
+    private:
+        Iterator m_begin;
+        Iterator m_end;
+    };
+
+    /// Iterator over the pixels of a row, from left to right.
+    ///
+    /// Dereferencing yields the first channel of the pixel.
+    ///
+    /// @tparam U Channel type, `const` for read-only access.
+    template <typename U>
+    class RowIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = U*;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = U*;
+
+        /// Creates an iterator on a pixel.
+        ///
+        /// @param tiles First channel of the first tile of the row of tiles.
+        /// @param channels Number of channels.
+        /// @param y Row of the pixels.
+        /// @param x Column of the pixel.
+        RowIterator(U* tiles, int channels, int y, int x) noexcept
+            : m_tiles { tiles }
+            , m_channels { static_cast<std::size_t>(channels) }
+            , m_y_bits { detail::morton_tables.y_bits[y & (tile_size - 1)] }
+            , m_x { x }
+        {
+        }
+
+        U* operator*() const noexcept
+        {
+            const auto& tables = detail::morton_tables;
+            auto tile = static_cast<std::size_t>(this->m_x >> detail::tile_shift);
+            auto index = tile * detail::tile_pixels + (tables.x_bits[this->m_x & (tile_size - 1)] | this->m_y_bits);
+            return this->m_tiles + index * this->m_channels;
+        }
+
+        RowIterator& operator++() noexcept
+        {
+            this->m_x++;
+            return *this;
+        }
+
+        RowIterator operator++(int) noexcept
+        {
+            RowIterator previous = *this;
+            this->m_x++;
+            return previous;
+        }
+
+        bool operator==(const RowIterator& other) const noexcept
+        {
+            return this->m_x == other.m_x;
+        }
+
+        bool operator!=(const RowIterator& other) const noexcept
+        {
+            return this->m_x != other.m_x;
+        }
+
+    private:
+        U* m_tiles;
+        std::size_t m_channels;
+        std::uint16_t m_y_bits;
+        int m_x;
+    };
+
+    /// Tile of the image, with its place in the image and its pixels.
+    ///
+    /// @tparam U Channel type, `const` for read-only access.
+    template <typename U>
+    struct Tile {
+        /// Column of the tile.
+        int tile_x;
+        /// Row of the tile.
+        int tile_y;
+        /// Column of the first pixel.
+        int left;
+        /// Row of the first pixel.
+        int top;
+        /// Number of columns within the image, less than `tile_size` for the right edge tiles.
+        int width;
+        /// Number of rows within the image, less than `tile_size` for the bottom edge tiles.
+        int height;
+        /// First channel of the pixels, in Morton order.
+        U* data;
+        /// Number of channels.
+        int channels;
+
+        /// Returns the first channel of a pixel of the tile.
+        ///
+        /// @param x Column of the pixel within the tile.
+        /// @param y Row of the pixel within the tile.
+        U* pixel(int x, int y) const noexcept
+        {
+            const auto& tables = detail::morton_tables;
+            auto index = static_cast<std::size_t>(tables.x_bits[x] | tables.y_bits[y]);
+            return this->data + index * static_cast<std::size_t>(this->channels);
+        }
+    };
+
+    /// Iterator over the tiles, in storage order.
+    ///
+    /// @tparam U Channel type, `const` for read-only access.
+    template <typename U>
+    class TileIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Tile<U>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Tile<U>;
+
+        /// Creates an iterator on a tile.
+        ///
+        /// @param image Image of the tiles.
+        /// @param index Index of the tile in storage order.
+        TileIterator(std::conditional_t<std::is_const_v<U>, const BasicTiledImage&, BasicTiledImage&> image, int index) noexcept
+            : m_image { &image }
+            , m_index { index }
+        {
+        }
+
+        Tile<U> operator*() const noexcept
+        {
+            int tile_x = this->m_index % this->m_image->m_tiles_x;
+            int tile_y = this->m_index / this->m_image->m_tiles_x;
+            int left = tile_x * tile_size;
+            int top = tile_y * tile_size;
+            return Tile<U> {
+                tile_x,
+                tile_y,
+                left,
+                top,
+                std::min(tile_size, this->m_image->m_width - left),
+                std::min(tile_size, this->m_image->m_height - top),
+                this->m_image->tile(tile_x, tile_y),
+                this->m_image->channels(),
+            };
+        }
+
+        TileIterator& operator++() noexcept
+        {
+            this->m_index++;
+            return *this;
+        }
+
+        TileIterator operator++(int) noexcept
+        {
+            TileIterator previous = *this;
+            this->m_index++;
+            return previous;
+        }
+
+        bool operator==(const TileIterator& other) const noexcept
+        {
+            return this->m_index == other.m_index;
+        }
+
+        bool operator!=(const TileIterator& other) const noexcept
+        {
+            return this->m_index != other.m_index;
+        }
+
+    private:
+        std::conditional_t<std::is_const_v<U>, const BasicTiledImage*, BasicTiledImage*> m_image;
+        int m_index;
+    };
+
+    /// Creates a new empty image.
+    ///
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    /// @param channels Number of channels.
+    BasicTiledImage(int width, int height, int channels)
+        : m_data { nullptr, delete_aligned }
+        , m_width { width }
+        , m_height { height }
+        , m_channels { channels }
+        , m_tiles_x { (width + tile_size - 1) / tile_size }
+        , m_tiles_y { (height + tile_size - 1) / tile_size }
+    {
+        if (width <= 0) {
+            throw std::runtime_error { "Invalid image width." };
+        }
+        if (height <= 0) {
+            throw std::runtime_error { "Invalid image height." };
+        }
+        if (channels < 1 || channels > 4) {
+            throw std::runtime_error { "The image must have between 1 and 4 channels." };
+        }
+        if (Channels != DynamicChannels && channels != Channels) {
+            throw std::runtime_error { "The number of channels does not match the image type." };
+        }
+
+        auto elements = this->size();
+        auto* data = static_cast<T*>(::operator new[](elements * sizeof(T), std::align_val_t { detail::tile_alignment }));
+        std::fill_n(data, elements, T {});
+        this->m_data.reset(data);
+    }
+
+    /// Creates a new empty image with a compile-time number of channels.
+    ///
+    /// @param width Width in pixel.
+    /// @param height Height in pixel.
+    template <int C = Channels, std::enable_if_t<C != DynamicChannels, int> = 0>
+    BasicTiledImage(int width, int height)
+        : BasicTiledImage { width, height, Channels }
+    {
+    }
+
+    /// Copies a row-major image into tiles.
+    ///
+    /// @param image Source image.
+    template <int C>
+    explicit BasicTiledImage(const BasicImage<T, C>& image)
+        : BasicTiledImage { image.width(), image.height(), image.channels() }
+    {
+        auto channels = static_cast<std::size_t>(this->channels());
+        this->for_each_pixel([&](int x, int y, T* pixel) {
+            std::copy(image.pixel(x, y), image.pixel(x, y) + channels, pixel);
+        });
+    }
+
+    /// Copies the pixels back into a row-major image.
+    BasicImage<T, Channels> to_image() const
+    {
+        BasicImage<T, Channels> image { this->m_width, this->m_height, this->channels() };
+        auto channels = static_cast<std::size_t>(this->channels());
+        this->for_each_pixel([&](int x, int y, const T* pixel) {
+            std::copy(pixel, pixel + channels, image.pixel(x, y));
+        });
+        return image;
+    }
+
+    /// Returns the first channel of a pixel.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    T* pixel(int x, int y) noexcept
+    {
+        return this->m_data.get() + this->offset(x, y);
+    }
+
+    /// Returns the first channel of a pixel.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    const T* pixel(int x, int y) const noexcept
+    {
+        return this->m_data.get() + this->offset(x, y);
+    }
+
+    /// Returns the first channel of a pixel, clamping the coordinates to the edges.
+    ///
+    /// @param x Column of the pixel.
+    /// @param y Row of the pixel.
+    const T* pixel_clamped(int x, int y) const noexcept
+    {
+        return this->pixel(std::clamp(x, 0, this->m_width - 1), std::clamp(y, 0, this->m_height - 1));
+    }
+
+    /// Samples the image with bilinear filtering, clamping to the edges.
+    ///
+    /// Pixel centers lie at half-integer coordinates.
+    ///
+    /// @param x Horizontal coordinate in pixels.
+    /// @param y Vertical coordinate in pixels.
+    /// @param result Destination of one value per channel.
+    void sample(float x, float y, float* result) const noexcept
+    {
+        float fx = x - 0.5f;
+        float fy = y - 0.5f;
+        float left = std::floor(fx);
+        float top = std::floor(fy);
+        float tx = fx - left;
+        float ty = fy - top;
+        int x0 = static_cast<int>(left);
+        int y0 = static_cast<int>(top);
+
+        const T* p00 = this->pixel_clamped(x0, y0);
+        const T* p10 = this->pixel_clamped(x0 + 1, y0);
+        const T* p01 = this->pixel_clamped(x0, y0 + 1);
+        const T* p11 = this->pixel_clamped(x0 + 1, y0 + 1);
+        for (int c = 0; c < this->channels(); c++) {
+            float top_value = static_cast<float>(p00[c]) + (static_cast<float>(p10[c]) - static_cast<float>(p00[c])) * tx;
+            float bottom_value = static_cast<float>(p01[c]) + (static_cast<float>(p11[c]) - static_cast<float>(p01[c])) * tx;
+            result[c] = top_value + (bottom_value - top_value) * ty;
+        }
+    }
+
+    /// Calls `function(x, y, pixel)` for every pixel, in storage order.
+    ///
+    /// @param function Called with the coordinates and the first channel of each pixel.
+    template <typename F>
+    void for_each_pixel(F&& function)
+    {
+        this->visit(*this, function);
+    }
+
+    /// Calls `function(x, y, pixel)` for every pixel, in storage order.
+    ///
+    /// @param function Called with the coordinates and the first channel of each pixel.
+    template <typename F>
+    void for_each_pixel(F&& function) const
+    {
+        this->visit(*this, function);
+    }
+
+    /// Returns the pixels of a row, from left to right.
+    ///
+    /// The pixels of a row are spread over a row of tiles: passes that do
+    /// not need a particular order are faster with `for_each_pixel()`.
+    ///
+    /// @param y Row of the pixels.
+    Range<RowIterator<T>> row(int y) noexcept
+    {
+        T* tiles = this->tile(0, y >> detail::tile_shift);
+        return { RowIterator<T> { tiles, this->channels(), y, 0 },
+            RowIterator<T> { tiles, this->channels(), y, this->m_width } };
+    }
+
+    /// Returns the pixels of a row, from left to right.
+    ///
+    /// @param y Row of the pixels.
+    Range<RowIterator<const T>> row(int y) const noexcept
+    {
+        const T* tiles = this->tile(0, y >> detail::tile_shift);
+        return { RowIterator<const T> { tiles, this->channels(), y, 0 },
+            RowIterator<const T> { tiles, this->channels(), y, this->m_width } };
+    }
+
+    /// Returns the tiles in storage order, row of tiles by row of tiles.
+    Range<TileIterator<T>> tiles() noexcept
+    {
+        return { TileIterator<T> { *this, 0 }, TileIterator<T> { *this, this->m_tiles_x * this->m_tiles_y } };
+    }
+
+    /// Returns the tiles in storage order, row of tiles by row of tiles.
+    Range<TileIterator<const T>> tiles() const noexcept
+    {
+        return { TileIterator<const T> { *this, 0 }, TileIterator<const T> { *this, this->m_tiles_x * this->m_tiles_y } };
+    }
+
+    /// Returns the first channel of the first pixel of a tile.
+    ///
+    /// @param tile_x Column of the tile.
+    /// @param tile_y Row of the tile.
+    T* tile(int tile_x, int tile_y) noexcept
+    {
+        return this->m_data.get() + this->tile_offset(tile_x, tile_y);
+    }
+
+    /// Returns the first channel of the first pixel of a tile.
+    ///
+    /// @param tile_x Column of the tile.
+    /// @param tile_y Row of the tile.
+    const T* tile(int tile_x, int tile_y) const noexcept
+    {
+        return this->m_data.get() + this->tile_offset(tile_x, tile_y);
+    }
+
+    /// Returns the width of the image.
+    int width() const noexcept
+    {
+        return this->m_width;
+    }
+
+    /// Returns the height of the image.
+    int height() const noexcept
+    {
+        return this->m_height;
+    }
+
+    /// Returns the number of channels contained in the image.
+    int channels() const noexcept
+    {
+        if constexpr (Channels != DynamicChannels) {
+            return Channels;
+        } else {
+            return this->m_channels;
+        }
+    }
+
+    /// Returns the number of tiles along the width.
+    int tiles_x() const noexcept
+    {
+        return this->m_tiles_x;
+    }
+
+    /// Returns the number of tiles along the height.
+    int tiles_y() const noexcept
+    {
+        return this->m_tiles_y;
+    }
+
+    /// Returns the number of elements of the storage, including the padding of the edge tiles.
+    std::size_t size() const noexcept
+    {
+        return static_cast<std::size_t>(this->m_tiles_x) * static_cast<std::size_t>(this->m_tiles_y)
+            * detail::tile_pixels * static_cast<std::size_t>(this->channels());
+    }
+
+private:
+    template <typename Self, typename F>
+    static void visit(Self& self, F& function)
+    {
+        const auto& tables = detail::morton_tables;
+        auto channels = static_cast<std::size_t>(self.channels());
+        for (int tile_y = 0; tile_y < self.m_tiles_y; tile_y++) {
+            for (int tile_x = 0; tile_x < self.m_tiles_x; tile_x++) {
+                auto* data = self.tile(tile_x, tile_y);
+                int left = tile_x * tile_size;
+                int top = tile_y * tile_size;
+                bool full = left + tile_size <= self.m_width && top + tile_size <= self.m_height;
+                for (int i = 0; i < detail::tile_pixels; i++) {
+                    int x = left + tables.x_of[i];
+                    int y = top + tables.y_of[i];
+                    if (full || (x < self.m_width && y < self.m_height)) {
+                        function(x, y, data + static_cast<std::size_t>(i) * channels);
+                    }
+                }
+            }
+        }
+    }
+
+    std::size_t tile_offset(int tile_x, int tile_y) const noexcept
+    {
+        auto tile = static_cast<std::size_t>(tile_y) * static_cast<std::size_t>(this->m_tiles_x)
+            + static_cast<std::size_t>(tile_x);
+        return tile * detail::tile_pixels * static_cast<std::size_t>(this->channels());
+    }
+
+    std::size_t offset(int x, int y) const noexcept
+    {
+        const auto& tables = detail::morton_tables;
+        constexpr int mask = tile_size - 1;
+        auto tile = static_cast<std::size_t>(y >> detail::tile_shift) * static_cast<std::size_t>(this->m_tiles_x)
+            + static_cast<std::size_t>(x >> detail::tile_shift);
+        auto index = tile * detail::tile_pixels + (tables.x_bits[x & mask] | tables.y_bits[y & mask]);
+        return index * static_cast<std::size_t>(this->channels());
+    }
+
+    static void delete_aligned(void* data)
+    {
+        ::operator delete[](data, std::align_val_t { detail::tile_alignment });
+    }
+
+    std::unique_ptr<T[], ImageDeleter> m_data;
+    int m_width;
+    int m_height;
+    int m_channels;
+    int m_tiles_x;
+    int m_tiles_y;
+};
+
+/// Tiled 8-bit image with a runtime number of channels.
+using TiledImage = BasicTiledImage<unsigned char>;
+/// Tiled 16-bit image with a runtime number of channels.
+using TiledImage16 = BasicTiledImage<unsigned short>;
+/// Tiled floating point image with a runtime number of channels.
+using TiledImageF = BasicTiledImage<float>;
+
+using TiledImageRGBA8 = BasicTiledImage<unsigned char, 4>;
+using TiledImageRGBA32F = BasicTiledImage<float, 4>;
@@ -0,0 +1,866 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "Deflate.hpp"
+#include "Image.hpp"
+#include "ImageView.hpp"
+#include "MappedFile.hpp"
+#include "Mipmap.hpp"
+#include "ThreadPool.hpp"
+
+// Out-of-core access to images larger than memory.
+//
+// The file is decoded once, row after row, into a temporary file of tiles
+// holding every level of a pyramid of halved images. Tiles are then read
+// back on demand and kept in memory up to a budget, evicting the least
+// recently used ones first.
+
+/// Options of a tiled image source.
+struct TileCacheOptions {
+    /// Width and height of a tile in pixels, a power of two from 16 to 4096.
+    int tile_size { 256 };
+    /// Bytes of tiles kept in memory. The least recently used tiles are
+    /// evicted beyond it, the last tile requested is always kept.
+    std::size_t memory_budget { std::size_t { 256 } << 20 };
+    /// Directory of the file of tiles, the temporary directory if empty.
+    std::filesystem::path cache_directory {};
+};
+
+namespace detail {
+
+/// Converts the channels of a row of pixels, following the rules of stb_image.
+template <typename T>
+void convert_row_channels(const T* src, int from, T* dst, int to, std::size_t pixels) noexcept
+{
+    if (from == to) {
+        std::copy_n(src, pixels * static_cast<std::size_t>(from), dst);
+        return;
+    }
+    constexpr T opaque = std::is_same_v<T, unsigned char> ? 0xFF : 0xFFFF;
+    for (std::size_t i = 0; i < pixels; i++) {
+        const T* in = src + i * static_cast<std::size_t>(from);
+        T* out = dst + i * static_cast<std::size_t>(to);
+        T gray = from >= 3 ? static_cast<T>((in[0] * 77 + in[1] * 150 + in[2] * 29) >> 8) : in[0];
+        T alpha = from == 2 || from == 4 ? in[from - 1] : opaque;
+        if (to <= 2) {
+            out[0] = gray;
+        } else {
+            for (int c = 0; c < 3; c++) {
+                out[c] = from >= 3 ? in[c] : gray;
+            }
+        }
+        if (to == 2 || to == 4) {
+            out[to - 1] = alpha;
+        }
+    }
+}
+
+/// Decodes the rows of a non-interlaced PNG file one after the other,
+/// keeping only the previous row and the deflate window in memory.
+///
+/// Pixels are expanded as stb_image does: palettes into RGB or RGBA, a
+/// transparent color key into an alpha channel, and gray below 8 bits
+/// scaled to the full range.
+template <typename T>
+class PngRowReader {
+public:
+    /// Opens a file, or returns null if it is not a PNG file or is interlaced.
+    static std::unique_ptr<PngRowReader> open(const std::filesystem::path& file_name)
+    {
+        std::unique_ptr<PngRowReader> reader { new PngRowReader { file_name } };
+        if (!reader->parse_header()) {
+            return nullptr;
+        }
+        return reader;
+    }
+
+    int width() const noexcept
+    {
+        return this->m_width;
+    }
+
+    int height() const noexcept
+    {
+        return this->m_height;
+    }
+
+    /// Returns the number of channels of the decoded rows.
+    int channels() const noexcept
+    {
+        return this->m_channels;
+    }
+
+    /// Decodes the next row into `width() * channels()` values.
+    void read_row(T* out)
+    {
+        auto size = this->m_raw.size();
+        if (this->m_inflater->read(this->m_raw.data(), size) != size) {
+            throw std::runtime_error { "Truncated PNG file: " + this->m_file_name.string() };
+        }
+        this->unfilter();
+        this->expand(out);
+    }
+
+private:
+    explicit PngRowReader(const std::filesystem::path& file_name)
+        : m_file_name { file_name }
+        , m_file { file_name }
+    {
+    }
+
+    static std::uint32_t big_endian(const unsigned char* data) noexcept
+    {
+        return static_cast<std::uint32_t>(data[0]) << 24 | static_cast<std::uint32_t>(data[1]) << 16
+            | static_cast<std::uint32_t>(data[2]) << 8 | data[3];
+    }
+
+    [[noreturn]] void corrupt() const
+    {
+        throw std::runtime_error { "Corrupt PNG file: " + this->m_file_name.string() };
+    }
+
+    bool parse_header()
+    {
+        static constexpr unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+        const auto* data = this->m_file.data();
+        auto size = this->m_file.size();
+        if (size < 8 || std::memcmp(data, signature, 8) != 0) {
+            return false;
+        }
+        int color_type = -1;
+        bool has_key = false;
+        bool has_palette = false;
+        std::size_t position = 8;
+        for (;;) {
+            if (size - position < 12) {
+                this->corrupt();
+            }
+            std::size_t length = big_endian(data + position);
+            const auto* type = data + position + 4;
+            const auto* body = data + position + 8;
+            if (length > size - position - 12) {
+                this->corrupt();
+            }
+            if (std::memcmp(type, "IHDR", 4) == 0) {
+                if (length != 13) {
+                    this->corrupt();
+                }
+                auto width = big_endian(body);
+                auto height = big_endian(body + 4);
+                if (width == 0 || height == 0 || width > 0x7FFFFFFF || height > 0x7FFFFFFF) {
+                    this->corrupt();
+                }
+                this->m_width = static_cast<int>(width);
+                this->m_height = static_cast<int>(height);
+                this->m_depth = body[8];
+                color_type = body[9];
+                if (body[12] != 0) {
+                    return false;
+                }
+            } else if (color_type < 0) {
+                this->corrupt();
+            } else if (std::memcmp(type, "PLTE", 4) == 0) {
+                if (length % 3 != 0 || length > 3 * 256) {
+                    this->corrupt();
+                }
+                for (std::size_t i = 0; i < length / 3; i++) {
+                    this->m_palette[4 * i] = body[3 * i];
+                    this->m_palette[4 * i + 1] = body[3 * i + 1];
+                    this->m_palette[4 * i + 2] = body[3 * i + 2];
+                    this->m_palette[4 * i + 3] = 255;
+                }
+                has_palette = true;
+            } else if (std::memcmp(type, "tRNS", 4) == 0) {
+                if (color_type == 3) {
+                    if (length > 256) {
+                        this->corrupt();
+                    }
+                    for (std::size_t i = 0; i < length; i++) {
+                        this->m_palette[4 * i + 3] = body[i];
+                    }
+                    has_key = true;
+                } else if (color_type == 0 || color_type == 2) {
+                    if (length != (color_type == 0 ? 2u : 6u)) {
+                        this->corrupt();
+                    }
+                    for (std::size_t c = 0; c < length / 2; c++) {
+                        this->m_key[c] = static_cast<std::uint16_t>(body[2 * c] << 8 | body[2 * c + 1]);
+                    }
+                    has_key = true;
+                }
+            } else if (std::memcmp(type, "IDAT", 4) == 0) {
+                this->m_next_chunk = position;
+                break;
+            } else if (std::memcmp(type, "IEND", 4) == 0) {
+                this->corrupt();
+            }
+            position += length + 12;
+        }
+
+        int depth = this->m_depth;
+        bool valid = false;
+        switch (color_type) {
+        case 0:
+            valid = depth == 1 || depth == 2 || depth == 4 || depth == 8 || depth == 16;
+            this->m_samples = 1;
+            break;
+        case 3:
+            valid = depth == 1 || depth == 2 || depth == 4 || depth == 8;
+            this->m_samples = 1;
+            break;
+        case 2:
+        case 4:
+        case 6:
+            valid = depth == 8 || depth == 16;
+            this->m_samples = color_type == 2 ? 3 : color_type == 4 ? 2 : 4;
+            break;
+        default:
+            break;
+        }
+        if (!valid || (color_type == 3 && !has_palette)) {
+            this->corrupt();
+        }
+        this->m_palette_based = color_type == 3;
+        this->m_has_key = has_key && !this->m_palette_based;
+        if (this->m_palette_based) {
+            this->m_channels = has_key ? 4 : 3;
+        } else {
+            this->m_channels = this->m_samples + (this->m_has_key ? 1 : 0);
+        }
+
+        auto row_bits = static_cast<std::size_t>(this->m_width) * static_cast<std::size_t>(this->m_samples * depth);
+        this->m_raw.resize(1 + (row_bits + 7) / 8);
+        this->m_previous.assign(this->m_raw.size() - 1, 0);
+        this->m_pixel_bytes = std::max(1, this->m_samples * depth / 8);
+
+        this->m_inflater = std::make_unique<Inflater>([this](const unsigned char*& piece, std::size_t& piece_size) {
+            return this->next_chunk(piece, piece_size);
+        });
+        read_zlib_header(*this->m_inflater);
+        return true;
+    }
+
+    /// Provides the data of the next IDAT chunk to the inflater.
+    bool next_chunk(const unsigned char*& piece, std::size_t& piece_size)
+    {
+        const auto* data = this->m_file.data();
+        auto size = this->m_file.size();
+        auto position = this->m_next_chunk;
+        if (size - position < 12 || std::memcmp(data + position + 4, "IDAT", 4) != 0) {
+            return false;
+        }
+        std::size_t length = big_endian(data + position);
+        if (length > size - position - 12) {
+            this->corrupt();
+        }
+        piece = data + position + 8;
+        piece_size = length;
+        this->m_next_chunk = position + length + 12;
+        return true;
+    }
+
+    /// Reverses the filter of the row in `m_raw`, then keeps it as previous row.
+    void unfilter()
+    {
+        auto* row = this->m_raw.data() + 1;
+        const auto* prior = this->m_previous.data();
+        auto size = this->m_previous.size();
+        auto bpp = static_cast<std::size_t>(this->m_pixel_bytes);
+        switch (this->m_raw[0]) {
+        case 0:
+            break;
+        case 1:
+            for (std::size_t i = bpp; i < size; i++) {
+                row[i] = static_cast<unsigned char>(row[i] + row[i - bpp]);
+            }
+            break;
+        case 2:
+            for (std::size_t i = 0; i < size; i++) {
+                row[i] = static_cast<unsigned char>(row[i] + prior[i]);
+            }
+            break;
+        case 3:
+            for (std::size_t i = 0; i < size; i++) {
+                int left = i >= bpp ? row[i - bpp] : 0;
+                row[i] = static_cast<unsigned char>(row[i] + ((left + prior[i]) >> 1));
+            }
+            break;
+        case 4:
+            for (std::size_t i = 0; i < size; i++) {
+                int a = i >= bpp ? row[i - bpp] : 0;
+                int b = prior[i];
+                int c = i >= bpp ? prior[i - bpp] : 0;
+                int p = a + b - c;
+                int pa = std::abs(p - a);
+                int pb = std::abs(p - b);
+                int pc = std::abs(p - c);
+                int predicted = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                row[i] = static_cast<unsigned char>(row[i] + predicted);
+            }
+            break;
+        default:
+            this->corrupt();
+        }
+        std::copy_n(row, size, this->m_previous.begin());
+    }
+
+    /// Returns a sample of the file at the bit depth of `T`.
+    static T from_unorm8(unsigned value) noexcept
+    {
+        if constexpr (std::is_same_v<T, unsigned char>) {
+            return static_cast<T>(value);
+        } else {
+            return static_cast<T>(value * 257);
+        }
+    }
+
+    static T from_unorm16(unsigned value) noexcept
+    {
+        if constexpr (std::is_same_v<T, unsigned char>) {
+            return static_cast<T>(value >> 8);
+        } else {
+            return static_cast<T>(value);
+        }
+    }
+
+    void expand(T* out) const
+    {
+        const auto* row = this->m_previous.data();
+        auto width = static_cast<std::size_t>(this->m_width);
+        int depth = this->m_depth;
+        int samples = this->m_samples;
+        if (depth < 8) {
+            // Gray or palette indices packed from the most significant bit.
+            unsigned mask = (1u << depth) - 1;
+            unsigned scale = this->m_palette_based ? 1 : 255 / mask;
+            for (std::size_t x = 0; x < width; x++) {
+                auto bit = x * static_cast<std::size_t>(depth);
+                unsigned value = (row[bit / 8] >> (8 - depth - static_cast<int>(bit % 8))) & mask;
+                if (this->m_palette_based) {
+                    for (int c = 0; c < this->m_channels; c++) {
+                        *out++ = from_unorm8(this->m_palette[4 * value + static_cast<unsigned>(c)]);
+                    }
+                } else {
+                    *out++ = from_unorm8(value * scale);
+                    if (this->m_has_key) {
+                        *out++ = from_unorm8(value == this->m_key[0] ? 0 : 255);
+                    }
+                }
+            }
+        } else if (this->m_palette_based) {
+            for (std::size_t x = 0; x < width; x++) {
+                for (int c = 0; c < this->m_channels; c++) {
+                    *out++ = from_unorm8(this->m_palette[4 * row[x] + static_cast<unsigned>(c)]);
+                }
+            }
+        } else if (depth == 8) {
+            for (std::size_t x = 0; x < width; x++) {
+                const auto* in = row + x * static_cast<std::size_t>(samples);
+                bool keyed = this->m_has_key;
+                for (int c = 0; c < samples; c++) {
+                    *out++ = from_unorm8(in[c]);
+                    keyed = keyed && in[c] == this->m_key[c];
+                }
+                if (this->m_has_key) {
+                    *out++ = from_unorm8(keyed ? 0 : 255);
+                }
+            }
+        } else {
+            for (std::size_t x = 0; x < width; x++) {
+                const auto* in = row + 2 * x * static_cast<std::size_t>(samples);
+                bool keyed = this->m_has_key;
+                for (int c = 0; c < samples; c++) {
+                    unsigned value = static_cast<unsigned>(in[2 * c] << 8 | in[2 * c + 1]);
+                    *out++ = from_unorm16(value);
+                    keyed = keyed && value == this->m_key[c];
+                }
+                if (this->m_has_key) {
+                    *out++ = from_unorm16(keyed ? 0 : 0xFFFF);
+                }
+            }
+        }
+    }
+
+    std::filesystem::path m_file_name;
+    MappedFile m_file;
+    std::size_t m_next_chunk { 0 };
+    std::unique_ptr<Inflater> m_inflater {};
+
+    int m_width { 0 };
+    int m_height { 0 };
+    int m_depth { 0 };
+    /// Number of samples per pixel stored in the file.
+    int m_samples { 0 };
+    int m_channels { 0 };
+    int m_pixel_bytes { 1 };
+    bool m_palette_based { false };
+    bool m_has_key { false };
+    std::array<std::uint16_t, 3> m_key {};
+    std::array<unsigned char, 4 * 256> m_palette {};
+
+    /// Filter type and bytes of the row being decoded.
+    std::vector<unsigned char> m_raw {};
+    /// Unfiltered bytes of the last row.
+    std::vector<unsigned char> m_previous {};
+};
+
+} // namespace detail
+
+/// Image decoded in tiles on demand, for images that do not fit in memory.
+///
+/// Opening the file decodes it once, streaming, into a temporary file of
+/// tiles with a pyramid of levels, each half the size of the previous one.
+/// Tiles are loaded back when requested and cached up to a memory budget,
+/// so viewers can fetch the level matching their zoom, and processing can
+/// walk the image tile by tile.
+///
+/// Non-interlaced PNG files are decoded row by row, holding one band of
+/// tiles per level in memory, about twice `width * tile_size` pixels. Other
+/// files are decoded whole by stb_image before being split into tiles.
+///
+/// Tiles may be requested from several threads at once.
+///
+/// @tparam T Type of a single channel, `unsigned char` or `unsigned short`.
+/// @tparam Channels Number of channels, or `DynamicChannels` for those of the file.
+template <typename T, int Channels = DynamicChannels>
+class BasicTiledImageSource {
+    static_assert(std::is_same_v<T, unsigned char> || std::is_same_v<T, unsigned short>,
+        "The channel type must be one of unsigned char or unsigned short.");
+    static_assert(Channels >= 0 && Channels <= 4, "The image must have between 1 and 4 channels.");
+
+public:
+    using value_type = T;
+
+    /// Number of channels, or `DynamicChannels` if only known at runtime.
+    static constexpr int static_channels = Channels;
+
+    /// Pixels of a tile, kept alive while referenced even once evicted.
+    using Tile = std::shared_ptr<const BasicImage<T, Channels>>;
+
+    /// Decodes an image file into tiles.
+    ///
+    /// @param file_name Absolute path to the image file.
+    /// @param options Tile size, memory budget and location of the tiles.
+    explicit BasicTiledImageSource(const std::filesystem::path& file_name, TileCacheOptions options = {})
+        : m_tile_size { options.tile_size }
+        , m_budget { options.memory_budget }
+    {
+        int tile_size = options.tile_size;
+        if (tile_size < 16 || tile_size > 4096 || (tile_size & (tile_size - 1)) != 0) {
+            throw std::runtime_error { "The tile size must be a power of two between 16 and 4096." };
+        }
+
+        auto directory = options.cache_directory.empty() ? std::filesystem::temp_directory_path() : options.cache_directory;
+        std::random_device random {};
+        auto name = std::to_string(random()) + std::to_string(random());
+        this->m_cache_path = directory / ("tiles-" + name + ".bin");
+        this->m_file.open(this->m_cache_path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!this->m_file) {
+            throw std::runtime_error { "Could not create tile file: " + this->m_cache_path.string() };
+        }
+
+        try {
+            if (auto png = detail::PngRowReader<T>::open(file_name)) {
+                int from = png->channels();
+                std::vector<T> row(static_cast<std::size_t>(png->width()) * static_cast<std::size_t>(from));
+                this->build(png->width(), png->height(), Channels != DynamicChannels ? Channels : from, [&](T* out) {
+                    png->read_row(row.data());
+                    detail::convert_row_channels(row.data(), from, out, this->m_channels, row.size() / from);
+                });
+            } else {
+                BasicImage<T, Channels> image { file_name, ImageLoadMode::MemoryMapped };
+                int y = 0;
+                this->build(image.width(), image.height(), image.channels(), [&](T* out) {
+                    std::copy_n(image.pixel(0, y), static_cast<std::size_t>(image.width()) * image.channels(), out);
+                    y++;
+                });
+            }
+            this->m_file.flush();
+        } catch (...) {
+            this->m_file.close();
+            std::error_code error {};
+            std::filesystem::remove(this->m_cache_path, error);
+            throw;
+        }
+    }
+
+    BasicTiledImageSource(const BasicTiledImageSource&) = delete;
+    BasicTiledImageSource& operator=(const BasicTiledImageSource&) = delete;
+
+    /// Deletes the file of tiles.
+    ~BasicTiledImageSource()
+    {
+        this->m_file.close();
+        std::error_code error {};
+        std::filesystem::remove(this->m_cache_path, error);
+    }
+
+    /// Returns the width of a level in pixel.
+    ///
+    /// @param level Level of the pyramid, 0 for the full resolution.
+    int width(int level = 0) const noexcept
+    {
+        return mip_level_size(this->m_width, level);
+    }
+
+    /// Returns the height of a level in pixel.
+    ///
+    /// @param level Level of the pyramid, 0 for the full resolution.
+    int height(int level = 0) const noexcept
+    {
+        return mip_level_size(this->m_height, level);
+    }
+
+    /// Returns the number of channels.
+    int channels() const noexcept
+    {
+        return this->m_channels;
+    }
+
+    /// Returns the number of levels, the last one fitting in a single tile.
+    int levels() const noexcept
+    {
+        return this->m_levels;
+    }
+
+    /// Returns the width and height of a tile in pixels.
+    int tile_size() const noexcept
+    {
+        return this->m_tile_size;
+    }
+
+    /// Returns the number of tile columns of a level.
+    int tiles_x(int level = 0) const noexcept
+    {
+        return (this->width(level) + this->m_tile_size - 1) / this->m_tile_size;
+    }
+
+    /// Returns the number of tile rows of a level.
+    int tiles_y(int level = 0) const noexcept
+    {
+        return (this->height(level) + this->m_tile_size - 1) / this->m_tile_size;
+    }
+
+    /// Returns the level to display at a zoom factor, the finest one with
+    /// at most one pixel per screen pixel.
+    ///
+    /// @param scale Screen pixels per pixel of the full resolution image.
+    int level_for_scale(double scale) const noexcept
+    {
+        if (!(scale > 0.0)) {
+            return this->m_levels - 1;
+        }
+        int level = static_cast<int>(std::floor(std::log2(1.0 / scale)));
+        return std::clamp(level, 0, this->m_levels - 1);
+    }
+
+    /// Returns the number of bytes of tiles cached in memory.
+    std::size_t cached_bytes() const
+    {
+        std::lock_guard<std::mutex> lock { this->m_cache_mutex };
+        return this->m_cached_bytes;
+    }
+
+    /// Returns a tile, loading it if it is not cached.
+    ///
+    /// Tiles on the right and bottom edges are cropped to the level.
+    ///
+    /// @param level Level of the pyramid.
+    /// @param x Column of the tile.
+    /// @param y Row of the tile.
+    Tile tile(int level, int x, int y) const
+    {
+        if (level < 0 || level >= this->m_levels || x < 0 || x >= this->tiles_x(level) || y < 0
+            || y >= this->tiles_y(level)) {
+            throw std::runtime_error { "Tile out of the image." };
+        }
+        auto key = static_cast<std::uint64_t>(level) << 48 | static_cast<std::uint64_t>(y) << 24
+            | static_cast<std::uint64_t>(x);
+        {
+            std::lock_guard<std::mutex> lock { this->m_cache_mutex };
+            auto found = this->m_tiles.find(key);
+            if (found != this->m_tiles.end()) {
+                this->m_recent.splice(this->m_recent.begin(), this->m_recent, found->second.position);
+                return found->second.tile;
+            }
+        }
+
+        Tile tile = this->load(level, x, y);
+        auto bytes = tile->size() * sizeof(T);
+        std::lock_guard<std::mutex> lock { this->m_cache_mutex };
+        auto found = this->m_tiles.find(key);
+        if (found != this->m_tiles.end()) {
+            // Loaded by another thread meanwhile.
+            return found->second.tile;
+        }
+        this->m_recent.push_front(key);
+        this->m_tiles.emplace(key, Entry { tile, this->m_recent.begin() });
+        this->m_cached_bytes += bytes;
+        while (this->m_cached_bytes > this->m_budget && this->m_recent.size() > 1) {
+            auto evicted = this->m_tiles.find(this->m_recent.back());
+            this->m_cached_bytes -= evicted->second.tile->size() * sizeof(T);
+            this->m_tiles.erase(evicted);
+            this->m_recent.pop_back();
+        }
+        return tile;
+    }
+
+    /// Copies a rectangle of a level into a view.
+    ///
+    /// @param level Level of the pyramid.
+    /// @param x Left column of the rectangle.
+    /// @param y Top row of the rectangle.
+    /// @param destination Pixels receiving the rectangle, of its size.
+    void read(int level, int x, int y, BasicImageView<T> destination) const
+    {
+        if (destination.channels() != this->m_channels) {
+            throw std::runtime_error { "The number of channels does not match the image." };
+        }
+        if (level < 0 || level >= this->m_levels || x < 0 || y < 0 || destination.width() > this->width(level) - x
+            || destination.height() > this->height(level) - y) {
+            throw std::runtime_error { "Rectangle out of the image." };
+        }
+        int size = this->m_tile_size;
+        auto channels = static_cast<std::size_t>(this->m_channels);
+        int right = x + destination.width();
+        int bottom = y + destination.height();
+        for (int ty = y / size; ty <= (bottom - 1) / size; ty++) {
+            for (int tx = x / size; tx <= (right - 1) / size; tx++) {
+                auto tile = this->tile(level, tx, ty);
+                int left = std::max(x, tx * size);
+                int top = std::max(y, ty * size);
+                auto count = static_cast<std::size_t>(std::min(right, tx * size + size) - left) * channels;
+                for (int row = top; row < std::min(bottom, ty * size + size); row++) {
+                    std::copy_n(tile->pixel(left - tx * size, row - ty * size), count,
+                        destination.row(row - y) + static_cast<std::size_t>(left - x) * channels);
+                }
+            }
+        }
+    }
+
+    /// Returns a copy of a rectangle of a level.
+    ///
+    /// @param level Level of the pyramid.
+    /// @param x Left column of the rectangle.
+    /// @param y Top row of the rectangle.
+    /// @param width Width of the rectangle.
+    /// @param height Height of the rectangle.
+    BasicImage<T, Channels> read(int level, int x, int y, int width, int height) const
+    {
+        BasicImage<T, Channels> image { width, height, this->m_channels };
+        this->read(level, x, y, BasicImageView<T> { image });
+        return image;
+    }
+
+    /// Calls a function on every tile of a level, in parallel.
+    ///
+    /// @param level Level of the pyramid.
+    /// @param body Callable invoked as `body(tile, x, y)` with the pixels of
+    /// a tile and the position of its top left pixel in the level.
+    /// @param pool Pool processing the tiles.
+    template <typename F>
+    void for_each_tile(int level, F&& body, ThreadPool& pool = ThreadPool::global()) const
+    {
+        int columns = this->tiles_x(level);
+        auto count = static_cast<std::size_t>(columns) * static_cast<std::size_t>(this->tiles_y(level));
+        pool.parallel_for(count, 1, [&](std::size_t begin, std::size_t end) {
+            for (auto i = begin; i < end; i++) {
+                int x = static_cast<int>(i % static_cast<std::size_t>(columns));
+                int y = static_cast<int>(i / static_cast<std::size_t>(columns));
+                auto tile = this->tile(level, x, y);
+                body(*tile, x * this->m_tile_size, y * this->m_tile_size);
+            }
+        });
+    }
+
+private:
+    /// Rows of a level waiting to be written as a band of tiles.
+    struct LevelBand {
+        std::vector<T> rows {};
+        /// Downsampled row passed to the next level.
+        std::vector<T> half {};
+        int filled { 0 };
+        int next_row { 0 };
+    };
+
+    struct Entry {
+        Tile tile;
+        std::list<std::uint64_t>::iterator position;
+    };
+
+    std::size_t tile_bytes() const noexcept
+    {
+        auto size = static_cast<std::size_t>(this->m_tile_size);
+        return size * size * static_cast<std::size_t>(this->m_channels) * sizeof(T);
+    }
+
+    /// Writes the tiles of every level, reading the rows of the full resolution in order.
+    template <typename F>
+    void build(int width, int height, int channels, F&& next_row)
+    {
+        this->m_width = width;
+        this->m_height = height;
+        this->m_channels = channels;
+        this->m_levels = 1;
+        while (std::max(this->width(this->m_levels - 1), this->height(this->m_levels - 1)) > this->m_tile_size) {
+            this->m_levels++;
+        }
+        std::uint64_t offset = 0;
+        for (int level = 0; level < this->m_levels; level++) {
+            this->m_level_offsets.push_back(offset);
+            offset += static_cast<std::uint64_t>(this->tiles_x(level)) * static_cast<std::uint64_t>(this->tiles_y(level))
+                * this->tile_bytes();
+        }
+
+        std::vector<LevelBand> bands(static_cast<std::size_t>(this->m_levels));
+        for (int level = 0; level < this->m_levels; level++) {
+            auto row_size = static_cast<std::size_t>(this->width(level)) * static_cast<std::size_t>(channels);
+            bands[level].rows.resize(row_size * static_cast<std::size_t>(this->m_tile_size));
+            if (level + 1 < this->m_levels) {
+                bands[level].half.resize(static_cast<std::size_t>(this->width(level + 1)) * static_cast<std::size_t>(channels));
+            }
+        }
+        std::vector<T> tile(this->tile_bytes() / sizeof(T));
+        auto row_size = static_cast<std::size_t>(width) * static_cast<std::size_t>(channels);
+        for (int y = 0; y < height; y++) {
+            auto& band = bands[0];
+            next_row(band.rows.data() + static_cast<std::size_t>(band.filled) * row_size);
+            this->add_row(bands, 0, tile);
+        }
+    }
+
+    /// Takes the row just stored in the band of a level, passing halved
+    /// rows down the pyramid and writing the band once complete.
+    void add_row(std::vector<LevelBand>& bands, int level, std::vector<T>& tile)
+    {
+        auto& band = bands[level];
+        auto channels = static_cast<std::size_t>(this->m_channels);
+        auto width = static_cast<std::size_t>(this->width(level));
+        auto row_size = width * channels;
+        int height = this->height(level);
+        int y = band.next_row++;
+        band.filled++;
+
+        if (level + 1 < this->m_levels && (y % 2 == 1 || height == 1)) {
+            // 2x2 box filter, repeating the last row and column of levels one pixel wide.
+            const T* below = band.rows.data() + static_cast<std::size_t>(band.filled - 1) * row_size;
+            const T* above = height == 1 ? below : below - row_size;
+            auto half_width = static_cast<std::size_t>(this->width(level + 1));
+            auto& next = bands[level + 1];
+            T* out = next.rows.data() + static_cast<std::size_t>(next.filled) * half_width * channels;
+            for (std::size_t x = 0; x < half_width; x++) {
+                auto left = std::min(2 * x, width - 1) * channels;
+                auto right = std::min(2 * x + 1, width - 1) * channels;
+                for (std::size_t c = 0; c < channels; c++) {
+                    unsigned sum = static_cast<unsigned>(above[left + c]) + above[right + c] + below[left + c] + below[right + c];
+                    out[x * channels + c] = static_cast<T>((sum + 2) >> 2);
+                }
+            }
+            this->add_row(bands, level + 1, tile);
+        }
+
+        if (band.filled < this->m_tile_size && band.next_row < height) {
+            return;
+        }
+        // Writes the band, whose tiles are consecutive in the file.
+        auto size = static_cast<std::size_t>(this->m_tile_size);
+        int band_index = (band.next_row - 1) / this->m_tile_size;
+        int columns = this->tiles_x(level);
+        auto offset = this->m_level_offsets[level]
+            + static_cast<std::uint64_t>(band_index) * static_cast<std::uint64_t>(columns) * this->tile_bytes();
+        this->m_file.seekp(static_cast<std::streamoff>(offset));
+        for (int tx = 0; tx < columns; tx++) {
+            auto left = static_cast<std::size_t>(tx) * size;
+            auto count = std::min(size, width - left) * channels;
+            std::fill(tile.begin(), tile.end(), T {});
+            for (int row = 0; row < band.filled; row++) {
+                const T* src = band.rows.data() + static_cast<std::size_t>(row) * row_size + left * channels;
+                std::copy_n(src, count, tile.data() + static_cast<std::size_t>(row) * size * channels);
+            }
+            this->m_file.write(reinterpret_cast<const char*>(tile.data()), static_cast<std::streamsize>(this->tile_bytes()));
+        }
+        if (!this->m_file) {
+            throw std::runtime_error { "Could not write tile file: " + this->m_cache_path.string() };
+        }
+        band.filled = 0;
+    }
+
+    Tile load(int level, int x, int y) const
+    {
+        auto size = static_cast<std::size_t>(this->m_tile_size);
+        int width = std::min(this->m_tile_size, this->width(level) - x * this->m_tile_size);
+        int height = std::min(this->m_tile_size, this->height(level) - y * this->m_tile_size);
+        auto tile = std::make_shared<BasicImage<T, Channels>>(width, height, this->m_channels);
+        auto offset = this->m_level_offsets[level]
+            + (static_cast<std::uint64_t>(y) * static_cast<std::uint64_t>(this->tiles_x(level)) + static_cast<std::uint64_t>(x))
+                * this->tile_bytes();
+        auto row_size = size * static_cast<std::size_t>(this->m_channels);
+        std::vector<T> cropped {};
+        T* destination = tile->data();
+        if (!tile->contiguous() || static_cast<std::size_t>(width) != size) {
+            cropped.resize(row_size * static_cast<std::size_t>(height));
+            destination = cropped.data();
+        }
+        {
+            std::lock_guard<std::mutex> lock { this->m_file_mutex };
+            this->m_file.seekg(static_cast<std::streamoff>(offset));
+            this->m_file.read(reinterpret_cast<char*>(destination),
+                static_cast<std::streamsize>(row_size * static_cast<std::size_t>(height) * sizeof(T)));
+            if (!this->m_file) {
+                this->m_file.clear();
+                throw std::runtime_error { "Could not read tile file: " + this->m_cache_path.string() };
+            }
+        }
+        if (!cropped.empty()) {
+            auto count = static_cast<std::size_t>(width) * static_cast<std::size_t>(this->m_channels);
+            for (int row = 0; row < height; row++) {
+                std::copy_n(cropped.data() + static_cast<std::size_t>(row) * row_size, count, tile->pixel(0, row));
+            }
+        }
+        return tile;
+    }
+
+    std::filesystem::path m_cache_path {};
+    int m_width { 0 };
+    int m_height { 0 };
+    int m_channels { 0 };
+    int m_levels { 0 };
+    int m_tile_size;
+    std::size_t m_budget;
+    /// Byte offset of the first tile of every level in the file.
+    std::vector<std::uint64_t> m_level_offsets {};
+
+    mutable std::fstream m_file {};
+    mutable std::mutex m_file_mutex {};
+
+    mutable std::mutex m_cache_mutex {};
+    /// Keys of the cached tiles, most recently used first.
+    mutable std::list<std::uint64_t> m_recent {};
+    mutable std::unordered_map<std::uint64_t, Entry> m_tiles {};
+    mutable std::size_t m_cached_bytes { 0 };
+};
+
+/// 8-bit tiled image source with the channels of the file.
+using TiledImageSource = BasicTiledImageSource<unsigned char>;
+/// 16-bit tiled image source with the channels of the file.
+using TiledImageSource16 = BasicTiledImageSource<unsigned short>;
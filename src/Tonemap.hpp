@@ -0,0 +1,433 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageView.hpp"
+#include "Simd.hpp"
+#include "ThreadPool.hpp"
+
+/// Curves mapping high dynamic range values to displayable ones.
+enum class ToneCurve {
+    /// No curve, values above one are clipped. Only exposure and gamma apply.
+    Clamp,
+    /// Extended Reinhard curve `x * (1 + x / white²) / (1 + x)`, per channel.
+    Reinhard,
+    /// Stephen Hill's fit of the ACES reference and output transforms.
+    AcesFitted,
+    /// John Hable's filmic curve from Uncharted 2.
+    Uncharted2,
+};
+
+/// Settings of the tonemapping of float images to 8-bit images.
+struct TonemapOptions {
+    /// Curve applied after the exposure.
+    ToneCurve curve { ToneCurve::AcesFitted };
+    /// Exposure adjustment in stops, `1` doubles the brightness.
+    float exposure { 0.0f };
+    /// Linear value mapped to white by the Reinhard and Uncharted 2 curves.
+    float white { 11.2f };
+    /// Gamma of the output encoding, or `0` for the sRGB transfer function.
+    float gamma { 0.0f };
+};
+
+namespace detail {
+
+/// Number of pixels tonemapped at once, split into one plane per color channel.
+inline constexpr std::size_t tonemap_chunk = 256;
+
+/// Encodes linear values in `[0, 1]` to 8-bit.
+///
+/// The table is indexed by the square root of the value, which spends more
+/// entries on the dark values where the encodings are steepest. The codes
+/// are stored as 32-bit integers so that they can be gathered.
+struct TonemapEncoding {
+    static constexpr int steps = 4096;
+
+    std::array<std::int32_t, steps + 1> table;
+
+    /// @param gamma Gamma of the encoding, or `0` for sRGB.
+    explicit TonemapEncoding(float gamma)
+    {
+        for (int i = 0; i <= steps; i++) {
+            double root = i / static_cast<double>(steps);
+            double linear = root * root;
+            double encoded = 0.0;
+            if (gamma > 0.0f) {
+                encoded = std::pow(linear, 1.0 / gamma);
+            } else {
+                encoded = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            }
+            this->table[i] = static_cast<std::int32_t>(std::lround(encoded * 255.0));
+        }
+    }
+
+    static const TonemapEncoding& srgb()
+    {
+        static const TonemapEncoding encoding { 0.0f };
+        return encoding;
+    }
+};
+
+/// Constants of a tonemapping pass, derived from the options.
+struct TonemapConstants {
+    ToneCurve curve;
+    /// Linear multiplier of the exposure.
+    float scale;
+    /// `1 / white²` for the Reinhard curve.
+    float reinhard_white;
+    /// Inverse of the Uncharted 2 curve at the white point.
+    float uncharted_white;
+};
+
+// Coefficients of the Uncharted 2 curve: shoulder strength, linear strength,
+// linear angle, toe strength, toe numerator and toe denominator.
+inline constexpr float uncharted_a = 0.15f;
+inline constexpr float uncharted_b = 0.50f;
+inline constexpr float uncharted_c = 0.10f;
+inline constexpr float uncharted_d = 0.20f;
+inline constexpr float uncharted_e = 0.02f;
+inline constexpr float uncharted_f = 0.30f;
+/// Exposure bias of the original presentation, applied before the curve.
+inline constexpr float uncharted_bias = 2.0f;
+
+// The AVX2 kernels evaluate the same expressions as the scalar code, in the
+// same order, so that both give the same codes. Their target includes FMA:
+// contraction is turned off up to `tonemap_encode()`.
+#if defined(__clang__)
+#pragma float_control(push)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+inline float uncharted_curve(float x) noexcept
+{
+    constexpr float a = uncharted_a, b = uncharted_b, c = uncharted_c;
+    constexpr float d = uncharted_d, e = uncharted_e, f = uncharted_f;
+    return (x * (a * x + c * b) + d * e) / (x * (a * x + b) + d * f) - e / f;
+}
+
+/// ACES input matrix, from linear sRGB to the rendering space, rows first.
+inline constexpr float aces_input[3][3] = {
+    { 0.59719f, 0.35458f, 0.04823f },
+    { 0.07600f, 0.90834f, 0.01566f },
+    { 0.02840f, 0.13383f, 0.83777f },
+};
+
+/// ACES output matrix, from the output space back to linear sRGB, rows first.
+inline constexpr float aces_output[3][3] = {
+    { 1.60475f, -0.53108f, -0.07367f },
+    { -0.10208f, 1.10813f, -0.00605f },
+    { -0.00327f, -0.07276f, 1.07602f },
+};
+
+inline void aces_transform(float* const* planes, const float (&matrix)[3][3], std::size_t begin, std::size_t count) noexcept
+{
+    for (auto i = begin; i < count; i++) {
+        float r = planes[0][i];
+        float g = planes[1][i];
+        float b = planes[2][i];
+        for (int c = 0; c < 3; c++) {
+            planes[c][i] = matrix[c][0] * r + matrix[c][1] * g + matrix[c][2] * b;
+        }
+    }
+}
+
+inline float tonemap_value(float x, const TonemapConstants& constants) noexcept
+{
+    // Written so that NaN maps to zero.
+    x = x > 0.0f ? x : 0.0f;
+    switch (constants.curve) {
+    case ToneCurve::Clamp:
+        return x;
+    case ToneCurve::Reinhard:
+        return x * (1.0f + x * constants.reinhard_white) / (1.0f + x);
+    case ToneCurve::AcesFitted: {
+        float a = x * (x + 0.0245786f) - 0.000090537f;
+        float b = x * (0.983729f * x + 0.4329510f) + 0.238081f;
+        return a / b;
+    }
+    case ToneCurve::Uncharted2:
+        return uncharted_curve(x * uncharted_bias) * constants.uncharted_white;
+    }
+    return x;
+}
+
+/// Applies the exposure and the curve to planes of linear values, with the
+/// ACES matrices when `colors` is three.
+inline void tonemap_planes_scalar(float* const* planes, int colors, std::size_t begin, std::size_t count,
+    const TonemapConstants& constants) noexcept
+{
+    bool aces = constants.curve == ToneCurve::AcesFitted && colors == 3;
+    for (int c = 0; c < colors; c++) {
+        for (auto i = begin; i < count; i++) {
+            planes[c][i] *= constants.scale;
+        }
+    }
+    if (aces) {
+        aces_transform(planes, aces_input, begin, count);
+    }
+    for (int c = 0; c < colors; c++) {
+        for (auto i = begin; i < count; i++) {
+            planes[c][i] = tonemap_value(planes[c][i], constants);
+        }
+    }
+    if (aces) {
+        aces_transform(planes, aces_output, begin, count);
+    }
+}
+
+/// Encodes linear values with a `TonemapEncoding` table, clamping to `[0, 1]`.
+inline void tonemap_encode_scalar(
+    const float* src, std::uint8_t* dst, std::size_t begin, std::size_t count, const std::int32_t* table) noexcept
+{
+    for (auto i = begin; i < count; i++) {
+        float value = src[i] > 0.0f ? src[i] : 0.0f;
+        value = value < 1.0f ? value : 1.0f;
+        dst[i] = static_cast<std::uint8_t>(table[static_cast<int>(std::sqrt(value) * TonemapEncoding::steps + 0.5f)]);
+    }
+}
+
+#if SIMD_X86
+SIMD_TARGET_AVX2 inline std::size_t tonemap_planes_avx2(
+    float* const* planes, int colors, std::size_t count, const TonemapConstants& constants) noexcept
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 scale = _mm256_set1_ps(constants.scale);
+    bool aces = constants.curve == ToneCurve::AcesFitted && colors == 3;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 values[3];
+        for (int c = 0; c < colors; c++) {
+            values[c] = _mm256_mul_ps(_mm256_loadu_ps(planes[c] + i), scale);
+        }
+        if (aces) {
+            __m256 r = values[0];
+            __m256 g = values[1];
+            __m256 b = values[2];
+            for (int c = 0; c < 3; c++) {
+                __m256 rg = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(aces_input[c][0]), r),
+                    _mm256_mul_ps(_mm256_set1_ps(aces_input[c][1]), g));
+                values[c] = _mm256_add_ps(rg, _mm256_mul_ps(_mm256_set1_ps(aces_input[c][2]), b));
+            }
+        }
+        for (int c = 0; c < colors; c++) {
+            // max(x, 0) returns the second operand for NaN.
+            __m256 x = _mm256_max_ps(values[c], zero);
+            switch (constants.curve) {
+            case ToneCurve::Clamp:
+                break;
+            case ToneCurve::Reinhard: {
+                __m256 numerator = _mm256_mul_ps(x, _mm256_add_ps(one, _mm256_mul_ps(x, _mm256_set1_ps(constants.reinhard_white))));
+                x = _mm256_div_ps(numerator, _mm256_add_ps(x, one));
+                break;
+            }
+            case ToneCurve::AcesFitted: {
+                __m256 a = _mm256_sub_ps(_mm256_mul_ps(x, _mm256_add_ps(x, _mm256_set1_ps(0.0245786f))),
+                    _mm256_set1_ps(0.000090537f));
+                __m256 b = _mm256_add_ps(
+                    _mm256_mul_ps(x, _mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.983729f)), _mm256_set1_ps(0.4329510f))),
+                    _mm256_set1_ps(0.238081f));
+                x = _mm256_div_ps(a, b);
+                break;
+            }
+            case ToneCurve::Uncharted2: {
+                x = _mm256_mul_ps(x, _mm256_set1_ps(uncharted_bias));
+                __m256 ax = _mm256_mul_ps(x, _mm256_set1_ps(uncharted_a));
+                __m256 numerator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(ax, _mm256_set1_ps(uncharted_c * uncharted_b))),
+                    _mm256_set1_ps(uncharted_d * uncharted_e));
+                __m256 denominator = _mm256_add_ps(_mm256_mul_ps(x, _mm256_add_ps(ax, _mm256_set1_ps(uncharted_b))),
+                    _mm256_set1_ps(uncharted_d * uncharted_f));
+                x = _mm256_sub_ps(_mm256_div_ps(numerator, denominator), _mm256_set1_ps(uncharted_e / uncharted_f));
+                x = _mm256_mul_ps(x, _mm256_set1_ps(constants.uncharted_white));
+                break;
+            }
+            }
+            values[c] = x;
+        }
+        if (aces) {
+            __m256 r = values[0];
+            __m256 g = values[1];
+            __m256 b = values[2];
+            for (int c = 0; c < 3; c++) {
+                __m256 rg = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(aces_output[c][0]), r),
+                    _mm256_mul_ps(_mm256_set1_ps(aces_output[c][1]), g));
+                values[c] = _mm256_add_ps(rg, _mm256_mul_ps(_mm256_set1_ps(aces_output[c][2]), b));
+            }
+        }
+        for (int c = 0; c < colors; c++) {
+            _mm256_storeu_ps(planes[c] + i, values[c]);
+        }
+    }
+    return i;
+}
+
+SIMD_TARGET_AVX2 inline std::size_t tonemap_encode_avx2(
+    const float* src, std::uint8_t* dst, std::size_t count, const std::int32_t* table) noexcept
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 steps = _mm256_set1_ps(static_cast<float>(TonemapEncoding::steps));
+    const __m256 half = _mm256_set1_ps(0.5f);
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Rounds like the scalar encoding: plus a half, truncated.
+        __m256 value = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(src + i), zero), one);
+        __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(_mm256_sqrt_ps(value), steps), half));
+        __m256i codes = _mm256_i32gather_epi32(table, index, 4);
+        __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(codes), _mm256_extracti128_si256(codes, 1));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(words, words));
+    }
+    return i;
+}
+#endif
+
+inline void tonemap_planes(float* const* planes, int colors, std::size_t count, const TonemapConstants& constants) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = tonemap_planes_avx2(planes, colors, count, constants);
+    }
+#endif
+    tonemap_planes_scalar(planes, colors, i, count, constants);
+}
+
+inline void tonemap_encode(const float* src, std::uint8_t* dst, std::size_t count, const std::int32_t* table) noexcept
+{
+    std::size_t i = 0;
+#if SIMD_X86
+    if (simd_level() >= SimdLevel::AVX2) {
+        i = tonemap_encode_avx2(src, dst, count, table);
+    }
+#endif
+    tonemap_encode_scalar(src, dst, i, count, table);
+}
+
+#if defined(__clang__)
+#pragma float_control(pop)
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+/// Tonemaps a row of `N` channel pixels, one chunk of planes at a time.
+template <int N>
+void tonemap_row(const float* src, std::uint8_t* dst, std::size_t width, const TonemapConstants& constants,
+    const std::int32_t* table) noexcept
+{
+    constexpr int colors = N >= 3 ? 3 : 1;
+    alignas(32) float values[colors][tonemap_chunk];
+    alignas(16) std::uint8_t codes[colors][tonemap_chunk];
+    float* planes[colors];
+    for (int c = 0; c < colors; c++) {
+        planes[c] = values[c];
+    }
+
+    for (std::size_t start = 0; start < width; start += tonemap_chunk) {
+        auto count = std::min(tonemap_chunk, width - start);
+        const float* in = src + start * N;
+        std::uint8_t* out = dst + start * N;
+        for (std::size_t i = 0; i < count; i++) {
+            for (int c = 0; c < colors; c++) {
+                values[c][i] = in[i * N + c];
+            }
+        }
+        tonemap_planes(planes, colors, count, constants);
+        for (int c = 0; c < colors; c++) {
+            tonemap_encode(values[c], codes[c], count, table);
+        }
+        for (std::size_t i = 0; i < count; i++) {
+            for (int c = 0; c < colors; c++) {
+                out[i * N + c] = codes[c][i];
+            }
+            if constexpr (has_alpha(N)) {
+                out[i * N + N - 1] = unorm8_from_float(in[i * N + N - 1]);
+            }
+        }
+    }
+}
+
+} // namespace detail
+
+/// Tonemaps the linear pixels of a float view into an 8-bit view of the same size.
+///
+/// The exposure, curve and output encoding are applied with vector kernels
+/// on planes of a few hundred pixels, and bands of rows are processed in
+/// parallel on the pool. Gray images go through the curve alone, and the
+/// alpha channel of two and four channel pixels is only clamped.
+///
+/// @param src Linear pixels, e.g. a Radiance `.hdr` file loaded into an `ImageF`.
+/// @param dst Destination of the encoded pixels, with the same number of channels as `src`.
+/// @param options Curve and encoding settings.
+/// @param pool Pool used to process the rows.
+inline void tonemap(ConstImageViewF src, ImageView dst, const TonemapOptions& options = {},
+    ThreadPool& pool = ThreadPool::global())
+{
+    if (src.width() != dst.width() || src.height() != dst.height() || src.channels() != dst.channels()) {
+        throw std::runtime_error { "The images must have the same size and number of channels." };
+    }
+    if (!(options.white > 0.0f)) {
+        throw std::runtime_error { "The white point must be positive." };
+    }
+    if (!(options.gamma >= 0.0f)) {
+        throw std::runtime_error { "The gamma must not be negative." };
+    }
+
+    detail::TonemapConstants constants {};
+    constants.curve = options.curve;
+    constants.scale = std::exp2(options.exposure);
+    constants.reinhard_white = 1.0f / (options.white * options.white);
+    constants.uncharted_white = 1.0f / detail::uncharted_curve(options.white);
+
+    std::optional<detail::TonemapEncoding> custom {};
+    if (options.gamma > 0.0f) {
+        custom.emplace(options.gamma);
+    }
+    const auto* table = (custom ? *custom : detail::TonemapEncoding::srgb()).table.data();
+
+    auto width = static_cast<std::size_t>(src.width());
+    pool.parallel_for(static_cast<std::size_t>(src.height()), 16, [&](std::size_t begin, std::size_t end) {
+        for (auto y = begin; y < end; y++) {
+            const float* in = src.row(static_cast<int>(y));
+            auto* out = dst.row(static_cast<int>(y));
+            switch (src.channels()) {
+            case 1:
+                detail::tonemap_row<1>(in, out, width, constants, table);
+                break;
+            case 2:
+                detail::tonemap_row<2>(in, out, width, constants, table);
+                break;
+            case 3:
+                detail::tonemap_row<3>(in, out, width, constants, table);
+                break;
+            default:
+                detail::tonemap_row<4>(in, out, width, constants, table);
+                break;
+            }
+        }
+    });
+}
+
+/// Tonemaps a linear float image to an 8-bit image.
+///
+/// @param image Linear pixels, e.g. a Radiance `.hdr` file loaded into an `ImageF`.
+/// @param options Curve and encoding settings.
+/// @param pool Pool used to process the rows.
+template <int C>
+BasicImage<unsigned char, C> tonemap(
+    const BasicImage<float, C>& image, const TonemapOptions& options = {}, ThreadPool& pool = ThreadPool::global())
+{
+    BasicImage<unsigned char, C> result { image.width(), image.height(), image.channels() };
+    tonemap(image, result, options, pool);
+    return result;
+}
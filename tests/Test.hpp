@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Minimal checks shared by the test executables.
+//
+// A failed check is reported with its location and the test keeps going,
+// so that one run lists every failure. `test_result()` is returned from
+// `main()`.
+
+namespace detail {
+
+inline int& test_failures() noexcept
+{
+    static int failures = 0;
+    return failures;
+}
+
+inline void report_failure(const char* file, int line, const char* message)
+{
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, message);
+    test_failures()++;
+}
+
+} // namespace detail
+
+#define CHECK(condition)                                                \
+    do {                                                                \
+        if (!(condition)) {                                             \
+            detail::report_failure(__FILE__, __LINE__, #condition);     \
+        }                                                               \
+    } while (false)
+
+/// Compares two spans bit for bit, reporting the first difference.
+///
+/// Floats are compared by representation, so NaN matches NaN and `-0.0f`
+/// does not match `0.0f`.
+///
+/// @param name Name of the compared kernel, for the report.
+/// @param actual Values to check.
+/// @param expected Reference values.
+/// @param count Number of values.
+template <typename T>
+bool check_same(const char* name, const T* actual, const T* expected, std::size_t count)
+{
+    for (std::size_t i = 0; i < count; i++) {
+        if (std::memcmp(actual + i, expected + i, sizeof(T)) != 0) {
+            std::cerr << name << ": value " << i << " is " << +actual[i] << ", expected " << +expected[i] << "\n";
+            detail::test_failures()++;
+            return false;
+        }
+    }
+    return true;
+}
+
+/// Returns floats for conversion tests: values around every 8-bit and
+/// 16-bit rounding boundary, out of range values and NaN, then uniform
+/// values in `[-0.25, 1.25]`.
+///
+/// @param random_count Number of uniform values appended.
+inline std::vector<float> test_floats(std::size_t random_count)
+{
+    std::vector<float> values {
+        0.0f,
+        -0.0f,
+        1.0f,
+        -1.0f,
+        2.0f,
+        1e-30f,
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+        -std::numeric_limits<float>::infinity(),
+    };
+    for (float steps : { 255.0f, 65535.0f, 4096.0f }) {
+        for (int i = 0; i <= static_cast<int>(steps); i++) {
+            float boundary = (static_cast<float>(i) + 0.5f) / steps;
+            values.push_back(std::nextafter(boundary, 0.0f));
+            values.push_back(boundary);
+            values.push_back(std::nextafter(boundary, 1.0f));
+        }
+    }
+    std::mt19937 random { 1234 };
+    std::uniform_real_distribution<float> uniform { -0.25f, 1.25f };
+    for (std::size_t i = 0; i < random_count; i++) {
+        values.push_back(uniform(random));
+    }
+    return values;
+}
+
+/// Returns the exit code of a test: failure if any check failed.
+inline int test_result()
+{
+    if (detail::test_failures() > 0) {
+        std::cerr << detail::test_failures() << " checks failed\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
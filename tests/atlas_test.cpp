@@ -0,0 +1,122 @@
+#include "Test.hpp"
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <random>
+#include <vector>
+
+// Checks the invariants of packed atlases: slots within their page, apart
+// from each other and aligned, pixels and gutters copied, and texture
+// coordinates matching the slots.
+
+std::vector<Image> test_images(int count, int max_size, int channels)
+{
+    std::mt19937 random { 11 };
+    std::uniform_int_distribution<int> size { 1, max_size };
+    std::vector<Image> images {};
+    for (int i = 0; i < count; i++) {
+        Image image { size(random), size(random), channels };
+        for (int y = 0; y < image.height(); y++) {
+            for (int x = 0; x < image.width(); x++) {
+                for (int c = 0; c < channels; c++) {
+                    image.pixel(x, y)[c] = static_cast<unsigned char>(i * 31 + x * 7 + y * 13 + c);
+                }
+            }
+        }
+        images.push_back(std::move(image));
+    }
+    return images;
+}
+
+bool is_power_of_two(int value)
+{
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+void test_atlas(const std::vector<Image>& images, const AtlasOptions& options)
+{
+    auto atlas = build_atlas(images, options);
+    CHECK(atlas.entries.size() == images.size());
+    CHECK(!atlas.pages.empty());
+
+    int alignment = std::max(options.alignment, 1 << (options.mip_levels - 1));
+    for (const auto& page : atlas.pages) {
+        CHECK(page.width() <= options.max_width && page.height() <= options.max_height);
+        CHECK(!options.power_of_two || (is_power_of_two(page.width()) && is_power_of_two(page.height())));
+    }
+
+    int gutter = options.gutter;
+    for (std::size_t i = 0; i < images.size(); i++) {
+        const auto& entry = atlas.entries[i];
+        const auto& image = images[i];
+        CHECK(entry.page >= 0 && entry.page < static_cast<int>(atlas.pages.size()));
+        const auto& page = atlas.pages[static_cast<std::size_t>(entry.page)];
+        CHECK(entry.width == image.width() && entry.height == image.height());
+        CHECK(entry.x - gutter >= 0 && entry.y - gutter >= 0);
+        CHECK(entry.x + entry.width + gutter <= page.width() && entry.y + entry.height + gutter <= page.height());
+        CHECK((entry.x - gutter) % alignment == 0 && (entry.y - gutter) % alignment == 0);
+        CHECK(entry.u0 == static_cast<float>(entry.x) / static_cast<float>(page.width()));
+        CHECK(entry.v1 == static_cast<float>(entry.y + entry.height) / static_cast<float>(page.height()));
+
+        // Slots, with their gutter and padding, do not overlap.
+        for (std::size_t j = 0; j < i; j++) {
+            const auto& other = atlas.entries[j];
+            if (other.page != entry.page) {
+                continue;
+            }
+            bool apart = entry.x + entry.width + gutter + options.padding <= other.x - gutter
+                || other.x + other.width + gutter + options.padding <= entry.x - gutter
+                || entry.y + entry.height + gutter + options.padding <= other.y - gutter
+                || other.y + other.height + gutter + options.padding <= entry.y - gutter;
+            CHECK(apart);
+        }
+
+        // The pixels, and the gutter repeating the edges.
+        bool same = true;
+        for (int y = -gutter; y < entry.height + gutter; y++) {
+            for (int x = -gutter; x < entry.width + gutter; x++) {
+                const auto* expected = image.pixel(std::clamp(x, 0, entry.width - 1), std::clamp(y, 0, entry.height - 1));
+                const auto* actual = page.pixel(entry.x + x, entry.y + y);
+                same = same && std::equal(expected, expected + image.channels(), actual);
+            }
+        }
+        CHECK(same);
+    }
+}
+
+int main()
+{
+    auto images = test_images(200, 60, 3);
+
+    AtlasOptions options {};
+    options.max_width = 256;
+    options.max_height = 256;
+    test_atlas(images, options);
+
+    options.gutter = 2;
+    options.padding = 3;
+    options.alignment = 4;
+    test_atlas(images, options);
+
+    options.gutter = 4;
+    options.padding = 0;
+    options.alignment = 1;
+    options.mip_levels = 3;
+    options.power_of_two = true;
+    test_atlas(images, options);
+
+    // Several pages are needed, and an image larger than a page is rejected.
+    auto atlas = build_atlas(images, options);
+    CHECK(atlas.pages.size() > 1);
+    options.max_width = 32;
+    options.max_height = 32;
+    bool rejected = false;
+    try {
+        build_atlas(images, options);
+    } catch (std::exception&) {
+        rejected = true;
+    }
+    CHECK(rejected);
+    return test_result();
+}
@@ -0,0 +1,204 @@
+#include "ImageConvert.hpp"
+#include "Test.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Checks every vectorized conversion kernel against the scalar conversion
+// of the public functions, for each instruction set the CPU supports.
+
+#if SIMD_X86
+
+std::vector<std::uint8_t> test_bytes(std::size_t count)
+{
+    std::mt19937 random { 42 };
+    std::vector<std::uint8_t> bytes(count);
+    for (std::size_t i = 0; i < count; i++) {
+        bytes[i] = static_cast<std::uint8_t>(i < 256 ? i : random());
+    }
+    return bytes;
+}
+
+void test_swizzles(bool avx2)
+{
+    constexpr std::size_t pixels = 1000;
+    auto src = test_bytes(pixels * 4);
+
+    std::vector<std::uint8_t> expected(pixels * 4);
+    std::vector<std::uint8_t> actual(pixels * 4);
+    std::size_t done = 0;
+
+    for (std::size_t i = 0; i < pixels; i++) {
+        expected[i * 4 + 0] = src[i * 4 + 2];
+        expected[i * 4 + 1] = src[i * 4 + 1];
+        expected[i * 4 + 2] = src[i * 4 + 0];
+        expected[i * 4 + 3] = src[i * 4 + 3];
+    }
+    done = avx2 ? detail::swap_red_blue_avx2(src.data(), actual.data(), pixels)
+                : detail::swap_red_blue_sse2(src.data(), actual.data(), pixels);
+    CHECK(done > 0);
+    check_same("swap_red_blue", actual.data(), expected.data(), done * 4);
+
+    if (avx2) {
+        for (std::size_t i = 0; i < pixels; i++) {
+            expected[i * 4 + 0] = src[i * 3 + 0];
+            expected[i * 4 + 1] = src[i * 3 + 1];
+            expected[i * 4 + 2] = src[i * 3 + 2];
+            expected[i * 4 + 3] = 200;
+        }
+        done = detail::rgb_to_rgba_avx2(src.data(), actual.data(), pixels, 200);
+        CHECK(done > 0);
+        check_same("rgb_to_rgba", actual.data(), expected.data(), done * 4);
+
+        for (std::size_t i = 0; i < pixels; i++) {
+            expected[i * 3 + 0] = src[i * 4 + 0];
+            expected[i * 3 + 1] = src[i * 4 + 1];
+            expected[i * 3 + 2] = src[i * 4 + 2];
+        }
+        done = detail::rgba_to_rgb_avx2(src.data(), actual.data(), pixels);
+        CHECK(done > 0);
+        check_same("rgba_to_rgb", actual.data(), expected.data(), done * 3);
+    } else {
+        for (std::size_t i = 0; i < pixels; i++) {
+            expected[i * 4 + 0] = src[i];
+            expected[i * 4 + 1] = src[i];
+            expected[i * 4 + 2] = src[i];
+            expected[i * 4 + 3] = 200;
+        }
+        done = detail::gray_to_rgba_sse2(src.data(), actual.data(), pixels, 200);
+        CHECK(done > 0);
+        check_same("gray_to_rgba", actual.data(), expected.data(), done * 4);
+    }
+}
+
+void test_integer_depths()
+{
+    constexpr std::size_t count = 70000;
+    auto bytes = test_bytes(count);
+    std::vector<std::uint16_t> words(count);
+    for (std::size_t i = 0; i < count; i++) {
+        words[i] = static_cast<std::uint16_t>(i);
+    }
+
+    std::vector<std::uint16_t> expected16(count);
+    std::vector<std::uint16_t> actual16(count);
+    for (std::size_t i = 0; i < count; i++) {
+        expected16[i] = static_cast<std::uint16_t>(bytes[i] * 257);
+    }
+    auto done = detail::unorm8_to_unorm16_sse2(bytes.data(), actual16.data(), count);
+    CHECK(done > 0);
+    check_same("unorm8_to_unorm16", actual16.data(), expected16.data(), done);
+
+    std::vector<std::uint8_t> expected8(count);
+    std::vector<std::uint8_t> actual8(count);
+    for (std::size_t i = 0; i < count; i++) {
+        expected8[i] = detail::unorm8_from_unorm16(words[i]);
+    }
+    done = detail::unorm16_to_unorm8_sse2(words.data(), actual8.data(), count);
+    CHECK(done > 0);
+    check_same("unorm16_to_unorm8", actual8.data(), expected8.data(), done);
+}
+
+void test_float_depths(bool avx2)
+{
+    auto floats = test_floats(100000);
+    auto count = floats.size();
+    auto bytes = test_bytes(count);
+    std::vector<std::uint16_t> words(count);
+    for (std::size_t i = 0; i < count; i++) {
+        words[i] = static_cast<std::uint16_t>(i);
+    }
+
+    std::vector<float> expected_f(count);
+    std::vector<float> actual_f(count);
+    for (std::size_t i = 0; i < count; i++) {
+        expected_f[i] = bytes[i] * (1.0f / 255.0f);
+    }
+    auto done = avx2 ? detail::unorm8_to_float_avx2(bytes.data(), actual_f.data(), count)
+                     : detail::unorm8_to_float_sse2(bytes.data(), actual_f.data(), count);
+    CHECK(done > 0);
+    check_same("unorm8_to_float", actual_f.data(), expected_f.data(), done);
+
+    for (std::size_t i = 0; i < count; i++) {
+        expected_f[i] = words[i] * (1.0f / 65535.0f);
+    }
+    done = avx2 ? detail::unorm16_to_float_avx2(words.data(), actual_f.data(), count)
+                : detail::unorm16_to_float_sse2(words.data(), actual_f.data(), count);
+    CHECK(done > 0);
+    check_same("unorm16_to_float", actual_f.data(), expected_f.data(), done);
+
+    std::vector<std::uint8_t> expected8(count);
+    std::vector<std::uint8_t> actual8(count);
+    for (std::size_t i = 0; i < count; i++) {
+        expected8[i] = detail::unorm8_from_float(floats[i]);
+    }
+    done = avx2 ? detail::float_to_unorm8_avx2(floats.data(), actual8.data(), count)
+                : detail::float_to_unorm8_sse2(floats.data(), actual8.data(), count);
+    CHECK(done > 0);
+    check_same("float_to_unorm8", actual8.data(), expected8.data(), done);
+
+    std::vector<std::uint16_t> expected16(count);
+    std::vector<std::uint16_t> actual16(count);
+    for (std::size_t i = 0; i < count; i++) {
+        expected16[i] = detail::unorm16_from_float(floats[i]);
+    }
+    done = avx2 ? detail::float_to_unorm16_avx2(floats.data(), actual16.data(), count)
+                : detail::float_to_unorm16_sse2(floats.data(), actual16.data(), count);
+    CHECK(done > 0);
+    check_same("float_to_unorm16", actual16.data(), expected16.data(), done);
+}
+
+void test_srgb(bool avx2)
+{
+    auto floats = test_floats(100000);
+    auto count = floats.size();
+    auto bytes = test_bytes(count);
+    const auto& tables = detail::SrgbTables::get();
+
+    if (avx2) {
+        std::vector<float> expected(count);
+        std::vector<float> actual(count);
+        for (std::size_t i = 0; i < count; i++) {
+            expected[i] = tables.to_linear[bytes[i]];
+        }
+        auto done = detail::srgb_to_linear_avx2(bytes.data(), actual.data(), count, tables.to_linear.data());
+        CHECK(done > 0);
+        check_same("srgb_to_linear", actual.data(), expected.data(), done);
+    } else {
+        std::vector<std::uint8_t> expected(count);
+        std::vector<std::uint8_t> actual(count);
+        for (std::size_t i = 0; i < count; i++) {
+            expected[i] = tables.to_srgb[detail::linear_to_srgb_index(floats[i])];
+        }
+        auto done = detail::linear_to_srgb_sse2(floats.data(), actual.data(), count);
+        CHECK(done > 0);
+        check_same("linear_to_srgb", actual.data(), expected.data(), done);
+    }
+}
+
+int main()
+{
+    for (bool avx2 : { false, true }) {
+        if (avx2 && simd_level() < SimdLevel::AVX2) {
+            std::cout << "AVX2 not supported, skipped\n";
+            continue;
+        }
+        test_swizzles(avx2);
+        test_float_depths(avx2);
+        test_srgb(avx2);
+    }
+    test_integer_depths();
+    return test_result();
+}
+
+#else
+
+int main()
+{
+    std::cout << "No vectorized kernels on this architecture\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
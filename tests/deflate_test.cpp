@@ -0,0 +1,146 @@
+#include "Deflate.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <random>
+#include <stb_image.h>
+#include <vector>
+
+// Round trips data through the serial and parallel compressors, checked
+// with `zlib_decompress()` and with the independent decoder of stb_image.
+// The inputs contain every byte value and are chosen so that the first
+// block is stored, fixed Huffman or dynamic Huffman.
+
+enum class BlockType {
+    Stored = 0,
+    Fixed = 1,
+    Dynamic = 2,
+};
+
+/// Returns the type of the first block of a zlib stream.
+BlockType first_block(const std::vector<unsigned char>& stream)
+{
+    return static_cast<BlockType>((stream.at(2) >> 1) & 3);
+}
+
+/// Every byte value, then every byte value again: one match after 256 literals.
+std::vector<unsigned char> fixed_input()
+{
+    std::vector<unsigned char> data {};
+    for (int repeat = 0; repeat < 2; repeat++) {
+        for (int i = 0; i < 256; i++) {
+            data.push_back(static_cast<unsigned char>(i));
+        }
+    }
+    return data;
+}
+
+/// Every byte value, then bytes with a skewed distribution, some repeated.
+std::vector<unsigned char> dynamic_input(std::size_t size)
+{
+    std::vector<unsigned char> data {};
+    for (int i = 0; i < 256; i++) {
+        data.push_back(static_cast<unsigned char>(i));
+    }
+    std::mt19937 random { 3 };
+    std::geometric_distribution<int> skewed { 0.1 };
+    while (data.size() < size) {
+        if (random() % 8 == 0 && data.size() > 300) {
+            auto start = data.size() - 1 - random() % 300;
+            for (std::size_t i = 0; i < 20 && data.size() < size; i++) {
+                data.push_back(data[start + i]);
+            }
+        } else {
+            data.push_back(static_cast<unsigned char>(std::min(skewed(random), 255)));
+        }
+    }
+    return data;
+}
+
+/// Every byte value, then uniform random bytes, which do not compress.
+std::vector<unsigned char> stored_input(std::size_t size)
+{
+    std::vector<unsigned char> data {};
+    for (int i = 0; i < 256; i++) {
+        data.push_back(static_cast<unsigned char>(i));
+    }
+    std::mt19937 random { 5 };
+    while (data.size() < size) {
+        data.push_back(static_cast<unsigned char>(random()));
+    }
+    return data;
+}
+
+bool decodes_to(const std::vector<unsigned char>& stream, const std::vector<unsigned char>& data)
+{
+    try {
+        if (zlib_decompress(stream.data(), stream.size()) != data) {
+            return false;
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return false;
+    }
+    int length = 0;
+    char* decoded = stbi_zlib_decode_malloc(
+        reinterpret_cast<const char*>(stream.data()), static_cast<int>(stream.size()), &length);
+    bool same = decoded != nullptr && static_cast<std::size_t>(length) == data.size()
+        && std::equal(data.begin(), data.end(), reinterpret_cast<unsigned char*>(decoded));
+    stbi_image_free(decoded);
+    return same;
+}
+
+void test_round_trip(const std::vector<unsigned char>& data, int level, BlockType block)
+{
+    auto serial = zlib_compress(data.data(), data.size(), level);
+    CHECK(first_block(serial) == block);
+    CHECK(decodes_to(serial, data));
+
+    // Chunks of one window, so that large inputs span several chunks.
+    auto parallel = zlib_compress_parallel(data.data(), data.size(), level, ThreadPool::global(), detail::deflate_window);
+    CHECK(first_block(parallel) == block);
+    CHECK(decodes_to(parallel, data));
+}
+
+void test_checksums()
+{
+    const unsigned char check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    CHECK(crc32(check, sizeof(check)) == 0xCBF43926u);
+    CHECK(adler32(check, sizeof(check)) == 0x091E01DEu);
+    // Checksums computed in pieces match the whole.
+    CHECK(crc32(check + 4, 5, crc32(check, 4)) == 0xCBF43926u);
+    CHECK(adler32(check + 4, 5, adler32(check, 4)) == 0x091E01DEu);
+}
+
+int main()
+{
+    test_checksums();
+
+    auto fixed = fixed_input();
+    auto dynamic = dynamic_input(200000);
+    auto stored = stored_input(100000);
+    for (int level = 1; level <= 9; level++) {
+        test_round_trip(fixed, level, BlockType::Fixed);
+        test_round_trip(dynamic, level, BlockType::Dynamic);
+        test_round_trip(stored, level, BlockType::Stored);
+    }
+    test_round_trip(dynamic, 0, BlockType::Stored);
+
+    // Sizes around the block and window boundaries, and empty input.
+    for (std::size_t size : { std::size_t { 0 }, std::size_t { 1 }, detail::deflate_window - 1, detail::deflate_window,
+             detail::deflate_window + 1, std::size_t { 65535 }, std::size_t { 65536 }, std::size_t { 3 * 65536 + 7 } }) {
+        std::vector<unsigned char> data(dynamic.begin(), dynamic.begin() + static_cast<std::ptrdiff_t>(std::min(size, dynamic.size())));
+        while (data.size() < size) {
+            data.push_back(static_cast<unsigned char>(data.size() * 7));
+        }
+        for (int level : { 0, 1, 6, 9 }) {
+            CHECK(decodes_to(zlib_compress(data.data(), data.size(), level), data));
+            auto parallel = zlib_compress_parallel(data.data(), data.size(), level, ThreadPool::global(), detail::deflate_window);
+            CHECK(decodes_to(parallel, data));
+        }
+    }
+    return test_result();
+}
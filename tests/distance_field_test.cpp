@@ -0,0 +1,134 @@
+#include "DistanceField.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Checks the distance transforms against a brute force search of the
+// nearest pixel, on random masks wider than a band of columns and on
+// masks of a single row or column.
+
+/// Returns a mask with random discs, or random pixels at a density.
+Image random_mask(int width, int height, double density, bool discs, unsigned seed)
+{
+    std::mt19937 random { seed };
+    std::uniform_real_distribution<double> uniform { 0.0, 1.0 };
+    Image mask { width, height, 1 };
+    if (discs) {
+        for (int disc = 0; disc < 6; disc++) {
+            double cx = uniform(random) * width;
+            double cy = uniform(random) * height;
+            double radius = 1.0 + uniform(random) * 10.0;
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= radius * radius) {
+                        mask.pixel(x, y)[0] = 255;
+                    }
+                }
+            }
+        }
+    } else {
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                mask.pixel(x, y)[0] = uniform(random) < density ? 200 : 10;
+            }
+        }
+    }
+    return mask;
+}
+
+/// Returns the squared distance of every pixel to the nearest pixel inside, or outside, the shape.
+std::vector<std::int64_t> brute_force(const Image& mask, bool inside)
+{
+    int width = mask.width();
+    int height = mask.height();
+    std::vector<std::int64_t> squared(static_cast<std::size_t>(width) * static_cast<std::size_t>(height),
+        std::numeric_limits<std::int64_t>::max());
+    for (int fy = 0; fy < height; fy++) {
+        for (int fx = 0; fx < width; fx++) {
+            if ((mask.pixel(fx, fy)[0] > 127) != inside) {
+                continue;
+            }
+            for (int y = 0; y < height; y++) {
+                for (int x = 0; x < width; x++) {
+                    std::int64_t dx = x - fx;
+                    std::int64_t dy = y - fy;
+                    auto& best = squared[static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x)];
+                    best = std::min(best, dx * dx + dy * dy);
+                }
+            }
+        }
+    }
+    return squared;
+}
+
+void test_mask(const Image& mask)
+{
+    int width = mask.width();
+    int height = mask.height();
+    auto to_inside = brute_force(mask, true);
+    auto to_outside = brute_force(mask, false);
+    auto diagonal = std::sqrt(static_cast<double>(width) * width + static_cast<double>(height) * height);
+
+    auto distances = distance_transform(mask);
+    auto field = signed_distance_field(mask);
+    bool exact = true;
+    bool signed_exact = true;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            auto i = static_cast<std::size_t>(y) * static_cast<std::size_t>(width) + static_cast<std::size_t>(x);
+            auto distance = distances.pixel(x, y)[0];
+            if (to_inside[i] == std::numeric_limits<std::int64_t>::max()) {
+                exact = exact && distance > diagonal;
+            } else {
+                exact = exact && distance == static_cast<float>(std::sqrt(static_cast<double>(to_inside[i])));
+            }
+
+            bool is_inside = mask.pixel(x, y)[0] > 127;
+            auto nearest = is_inside ? to_outside[i] : to_inside[i];
+            if (nearest != std::numeric_limits<std::int64_t>::max()) {
+                auto expected = static_cast<float>(std::sqrt(static_cast<double>(nearest))) - 0.5f;
+                signed_exact = signed_exact && field.pixel(x, y)[0] == (is_inside ? expected : -expected);
+            }
+        }
+    }
+    CHECK(exact);
+    CHECK(signed_exact);
+
+    // Supersampled fields average blocks of the full resolution field, in field pixels.
+    DistanceFieldOptions options {};
+    options.supersample = 2;
+    auto coarse = signed_distance_field(mask, options);
+    CHECK(coarse.width() == (width + 1) / 2 && coarse.height() == (height + 1) / 2);
+    bool averaged = true;
+    for (int y = 0; y < coarse.height(); y++) {
+        for (int x = 0; x < coarse.width(); x++) {
+            float sum = 0.0f;
+            int count = 0;
+            for (int row = 2 * y; row < std::min(2 * y + 2, height); row++) {
+                for (int column = 2 * x; column < std::min(2 * x + 2, width); column++) {
+                    sum += field.pixel(column, row)[0];
+                    count++;
+                }
+            }
+            averaged = averaged && std::abs(coarse.pixel(x, y)[0] - sum / static_cast<float>(count * 2)) <= 1e-5f;
+        }
+    }
+    CHECK(averaged);
+}
+
+int main()
+{
+    test_mask(random_mask(64, 48, 0.02, false, 1));
+    test_mask(random_mask(64, 48, 0.5, false, 2));
+    test_mask(random_mask(300, 20, 0.0, true, 3));
+    test_mask(random_mask(1, 70, 0.1, false, 4));
+    test_mask(random_mask(70, 1, 0.1, false, 5));
+    test_mask(random_mask(17, 13, 0.0, false, 6));
+    test_mask(random_mask(17, 13, 1.0, false, 7));
+    return test_result();
+}
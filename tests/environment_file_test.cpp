@@ -0,0 +1,106 @@
+#include "EnvironmentLighting.hpp"
+#include "Test.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+
+// Checks that baked lighting is read back from its file as written, and
+// that a failed write leaves neither the destination nor its temporary file.
+
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    TemporaryDirectory()
+        : path { std::filesystem::temp_directory_path() / ("environment_file_test_" + std::to_string(std::rand())) }
+    {
+        std::filesystem::create_directories(this->path);
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code error {};
+        std::filesystem::remove_all(this->path, error);
+    }
+};
+
+bool same_cube(const CubeMap& a, const CubeMap& b)
+{
+    if (a.faces.size() != b.faces.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.faces.size(); i++) {
+        const auto& face = a.faces[i];
+        if (face.width() != b.faces[i].width() || face.height() != b.faces[i].height()) {
+            return false;
+        }
+        auto size = static_cast<std::size_t>(face.width()) * 3 * sizeof(float);
+        for (int y = 0; y < face.height(); y++) {
+            if (std::memcmp(face.pixel(0, y), b.faces[i].pixel(0, y), size) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    TemporaryDirectory directory {};
+    ImageF equirect { 32, 16, 3 };
+    for (int y = 0; y < equirect.height(); y++) {
+        for (int x = 0; x < equirect.width(); x++) {
+            for (int c = 0; c < 3; c++) {
+                equirect.pixel(x, y)[c] = static_cast<float>(x + y * c) * 0.25f;
+            }
+        }
+    }
+    EnvironmentOptions options {};
+    options.cube_size = 8;
+    options.specular_size = 8;
+    options.specular_levels = 3;
+    options.sample_count = 4;
+    auto lighting = bake_environment(equirect, options);
+
+    auto path = directory.path / "lighting.ibl";
+    write_environment_file(path, lighting, options);
+    CHECK(!std::filesystem::exists(directory.path / "lighting.ibl.tmp"));
+    auto read = read_environment_file(path, options);
+    CHECK(read.has_value());
+    if (read) {
+        CHECK(read->irradiance.coefficients == lighting.irradiance.coefficients);
+        CHECK(same_cube(read->radiance, lighting.radiance));
+        CHECK(read->specular.size() == lighting.specular.size());
+        for (std::size_t i = 0; i < lighting.specular.size() && i < read->specular.size(); i++) {
+            CHECK(same_cube(read->specular[i], lighting.specular[i]));
+        }
+    }
+    auto other = options;
+    other.sample_count = 8;
+    CHECK(!read_environment_file(path, other).has_value());
+
+    // The destination is a directory that is not empty, so renaming fails.
+    auto blocked = directory.path / "blocked.ibl";
+    std::filesystem::create_directories(blocked / "content");
+    bool thrown = false;
+    try {
+        write_environment_file(blocked, lighting, options);
+    } catch (std::exception&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    CHECK(std::filesystem::is_directory(blocked / "content"));
+    CHECK(!std::filesystem::exists(directory.path / "blocked.ibl.tmp"));
+
+    // The temporary file cannot be created in a missing directory.
+    thrown = false;
+    try {
+        write_environment_file(directory.path / "missing" / "lighting.ibl", lighting, options);
+    } catch (std::exception&) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    return test_result();
+}
@@ -0,0 +1,81 @@
+#include "Image.hpp"
+#include "ImageWriter.hpp"
+#include "Test.hpp"
+
+#include <climits>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <string>
+
+// Checks that probing reads the header of image files, including files
+// too large to be decoded, and that lazy images only decode on access.
+
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    TemporaryDirectory()
+        : path { std::filesystem::temp_directory_path() / ("image_probe_test_" + std::to_string(std::rand())) }
+    {
+        std::filesystem::create_directories(this->path);
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code error {};
+        std::filesystem::remove_all(this->path, error);
+    }
+};
+
+template <typename F>
+bool throws(F&& function)
+{
+    try {
+        function();
+    } catch (std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+int main()
+{
+    TemporaryDirectory directory {};
+    auto rgb_path = directory.path / "rgb.png";
+    auto gray16_path = directory.path / "gray16.png";
+
+    Image rgb { 37, 19, 3 };
+    rgb.pixel(5, 7)[1] = 200;
+    write_image(rgb, rgb_path);
+    Image16 gray16 { 8, 300, 1 };
+    write_image(gray16, gray16_path);
+
+    auto info = Image::probe(rgb_path);
+    CHECK(info.width == 37 && info.height == 19 && info.channels == 3);
+    CHECK(info.bit_depth == 8 && !info.hdr);
+    info = Image::probe(gray16_path);
+    CHECK(info.width == 8 && info.height == 300 && info.channels == 1);
+    CHECK(info.bit_depth == 16 && !info.hdr);
+
+    LazyImage lazy { rgb_path };
+    CHECK(lazy.width() == 37 && lazy.height() == 19 && lazy.channels() == 3);
+    CHECK(!lazy.decoded());
+    CHECK(lazy.image().pixel(5, 7)[1] == 200);
+    CHECK(lazy.decoded());
+
+    auto empty_path = directory.path / "empty.png";
+    std::filesystem::resize_file(rgb_path, 0);
+    std::filesystem::rename(rgb_path, empty_path);
+    CHECK(throws([&] { Image::probe(empty_path); }));
+
+    // A header followed by more than INT_MAX bytes, sparse on most file systems.
+    auto large_path = directory.path / "large.png";
+    write_image(rgb, large_path);
+    std::filesystem::resize_file(large_path, static_cast<std::uintmax_t>(INT_MAX) + 4096);
+    info = Image::probe(large_path);
+    CHECK(info.width == 37 && info.height == 19 && info.channels == 3);
+    LazyImage large { large_path, ImageLoadMode::MemoryMapped };
+    CHECK(large.width() == 37 && !large.decoded());
+    CHECK(throws([&] { Image { large_path, ImageLoadMode::MemoryMapped }; }));
+    return test_result();
+}
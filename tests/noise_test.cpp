@@ -0,0 +1,94 @@
+#include "Noise.hpp"
+#include "Test.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Checks that the SSE2 and AVX2 noise kernels give the same values as the
+// scalar kernel, bit for bit, for every kind of noise and fractal in 2D
+// and 3D, and that the values stay roughly within [-1, 1].
+
+#if SIMD_X86
+
+void test_rows(NoiseType type, NoiseFractal fractal, bool volume, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> coordinate { -5000.0f, 5000.0f };
+    std::uniform_real_distribution<float> frequency { 0.001f, 0.2f };
+    constexpr std::size_t count = 64;
+    bool avx2 = simd_level() >= SimdLevel::AVX2;
+    bool in_range = true;
+    for (int i = 0; i < 40; i++) {
+        NoiseOptions options {};
+        options.type = type;
+        options.fractal = fractal;
+        options.seed = static_cast<std::uint32_t>(random());
+        options.octaves = 1 + i % 6;
+
+        // Consecutive samples, as in images, then scattered ones.
+        std::vector<float> xs(count);
+        float step = frequency(random);
+        float start = coordinate(random);
+        for (std::size_t j = 0; j < count; j++) {
+            xs[j] = i % 2 == 0 ? start + static_cast<float>(j) * step : coordinate(random);
+        }
+        detail::NoiseRow row { xs.data(), coordinate(random), coordinate(random), count, volume, options.seed };
+
+        std::vector<float> expected(count);
+        std::vector<float> actual(count);
+        detail::noise_row_scalar(row, options, expected.data());
+        detail::noise_row_sse2(row, options, actual.data());
+        check_same("noise_row_sse2", actual.data(), expected.data(), count);
+        if (avx2) {
+            detail::noise_row_avx2(row, options, actual.data());
+            check_same("noise_row_avx2", actual.data(), expected.data(), count);
+        }
+        for (auto value : expected) {
+            in_range = in_range && std::abs(value) <= 1.5f;
+        }
+    }
+    CHECK(in_range);
+}
+
+int main()
+{
+    if (simd_level() < SimdLevel::AVX2) {
+        std::cout << "AVX2 not supported, only SSE2 checked\n";
+    }
+    std::mt19937 random { 3 };
+    for (auto type : { NoiseType::Perlin, NoiseType::Simplex, NoiseType::Worley }) {
+        for (auto fractal : { NoiseFractal::None, NoiseFractal::Fbm, NoiseFractal::Ridged }) {
+            test_rows(type, fractal, false, random);
+            test_rows(type, fractal, true, random);
+        }
+    }
+
+    // Images are generated with the best kernel, whatever the number of threads.
+    NoiseOptions options {};
+    options.type = NoiseType::Perlin;
+    auto image = noise_image(77, 9, options);
+    auto xs = detail::noise_coordinates(77, options.frequency, options.offset[0]);
+    std::vector<float> expected(xs.size());
+    bool same = true;
+    for (int y = 0; y < 9; y++) {
+        float row_y = static_cast<float>(y) * options.frequency + options.offset[1];
+        detail::noise_row_scalar({ xs.data(), row_y, options.offset[2], xs.size(), false, options.seed }, options,
+            expected.data());
+        for (int x = 0; x < 77; x++) {
+            same = same && image.pixel(x, y)[0] == expected[static_cast<std::size_t>(x)];
+        }
+    }
+    CHECK(same);
+    return test_result();
+}
+
+#else
+
+int main()
+{
+    std::cout << "No vectorized kernels on this architecture\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,185 @@
+#include "ImagePyramid.hpp"
+#include "SummedAreaTable.hpp"
+#include "Test.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+// Checks summed-area tables and image pyramids against brute force sums
+// and filters, on images wider than a band of the column pass and with
+// odd sizes.
+
+Image random_image(int width, int height, int channels, unsigned seed)
+{
+    std::mt19937 random { seed };
+    std::uniform_int_distribution<int> value { 0, 255 };
+    Image image { width, height, channels };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width * channels; x++) {
+            image.pixel(0, y)[x] = static_cast<unsigned char>(value(random));
+        }
+    }
+    return image;
+}
+
+void test_table(int width, int height, int channels, unsigned seed)
+{
+    auto image = random_image(width, height, channels, seed);
+    ImageF floats { width, height, channels };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width * channels; x++) {
+            floats.pixel(0, y)[x] = static_cast<float>(image.pixel(0, y)[x]) * 0.1f - 7.0f;
+        }
+    }
+    SummedAreaTable table { image };
+    SummedAreaTable64 squares { image, true };
+    SummedAreaTableF float_table { floats };
+    CHECK(table.width() == width && table.height() == height && table.channels() == channels);
+
+    std::mt19937 random { seed };
+    std::uniform_int_distribution<int> column { -3, width + 3 };
+    std::uniform_int_distribution<int> row { -3, height + 3 };
+    std::uniform_int_distribution<int> channel { 0, channels - 1 };
+    bool exact = true;
+    bool close = true;
+    for (int i = 0; i < 500; i++) {
+        int x0 = column(random);
+        int x1 = column(random);
+        int y0 = row(random);
+        int y1 = row(random);
+        int c = channel(random);
+        if (i == 0) {
+            x0 = 0, y0 = 0, x1 = width, y1 = height;
+        }
+        std::uint64_t sum = 0;
+        std::uint64_t sum_squares = 0;
+        double float_sum = 0.0;
+        for (int y = std::max(y0, 0); y < std::min(y1, height); y++) {
+            for (int x = std::max(x0, 0); x < std::min(x1, width); x++) {
+                std::uint64_t value = image.pixel(x, y)[c];
+                sum += value;
+                sum_squares += value * value;
+                float_sum += floats.pixel(x, y)[c];
+            }
+        }
+        exact = exact && table.sum(x0, y0, x1, y1, c) == sum && squares.sum(x0, y0, x1, y1, c) == sum_squares;
+        close = close && std::abs(float_table.sum(x0, y0, x1, y1, c) - float_sum) <= 1e-6 * (1.0 + std::abs(float_sum));
+
+        // Box means clip the window to the image.
+        int x = std::clamp(x0, 0, width - 1);
+        int y = std::clamp(y0, 0, height - 1);
+        int radius = i % 5;
+        double box = 0.0;
+        int count = 0;
+        for (int v = std::max(y - radius, 0); v <= std::min(y + radius, height - 1); v++) {
+            for (int u = std::max(x - radius, 0); u <= std::min(x + radius, width - 1); u++) {
+                box += image.pixel(u, v)[c];
+                count++;
+            }
+        }
+        close = close && std::abs(table.box_mean(x, y, radius, c) - box / count) <= 1e-9;
+    }
+    CHECK(exact);
+    CHECK(close);
+}
+
+/// Returns the value of a level at a pixel clamped to its edges.
+float clamped(const ImageF& level, int x, int y, int c)
+{
+    return level.pixel(std::clamp(x, 0, level.width() - 1), std::clamp(y, 0, level.height() - 1))[c];
+}
+
+void test_pyramid(int width, int height, int channels, unsigned seed)
+{
+    auto image = random_image(width, height, channels, seed);
+    auto pyramid = gaussian_pyramid(image);
+    CHECK(static_cast<int>(pyramid.size()) == pyramid_level_count(width, height));
+    CHECK(pyramid.back().width() == 1 && pyramid.back().height() == 1);
+
+    bool loaded = true;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width * channels; x++) {
+            loaded = loaded && std::abs(pyramid[0].pixel(0, y)[x] - image.pixel(0, y)[x] / 255.0f) <= 1e-6f;
+        }
+    }
+    CHECK(loaded);
+
+    // Every level filters the previous one with the binomial kernel.
+    static constexpr double weights[5] = { 1.0 / 16.0, 4.0 / 16.0, 6.0 / 16.0, 4.0 / 16.0, 1.0 / 16.0 };
+    bool reduced = true;
+    for (std::size_t i = 1; i < pyramid.size(); i++) {
+        const auto& below = pyramid[i - 1];
+        const auto& level = pyramid[i];
+        reduced = reduced && level.width() == (below.width() + 1) / 2 && level.height() == (below.height() + 1) / 2;
+        for (int y = 0; y < level.height(); y++) {
+            for (int x = 0; x < level.width(); x++) {
+                for (int c = 0; c < channels; c++) {
+                    double expected = 0.0;
+                    for (int v = 0; v < 5; v++) {
+                        for (int u = 0; u < 5; u++) {
+                            expected += weights[u] * weights[v] * clamped(below, 2 * x - 2 + u, 2 * y - 2 + v, c);
+                        }
+                    }
+                    reduced = reduced && std::abs(level.pixel(x, y)[c] - expected) <= 1e-6;
+                }
+            }
+        }
+    }
+    CHECK(reduced);
+
+    // Expanding interpolates with [1 6 1] / 8 on even pixels and [1 1] / 2 on odd ones.
+    auto expanded = pyramid_expand(pyramid[1], width, height);
+    auto taps = [](int x, int& first, double* kernel) {
+        first = x % 2 == 0 ? x / 2 - 1 : x / 2;
+        kernel[0] = x % 2 == 0 ? 0.125 : 0.5;
+        kernel[1] = x % 2 == 0 ? 0.75 : 0.5;
+        kernel[2] = x % 2 == 0 ? 0.125 : 0.0;
+    };
+    bool interpolated = true;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int left = 0;
+            int top = 0;
+            double horizontal[3];
+            double vertical[3];
+            taps(x, left, horizontal);
+            taps(y, top, vertical);
+            for (int c = 0; c < channels; c++) {
+                double expected = 0.0;
+                for (int v = 0; v < 3; v++) {
+                    for (int u = 0; u < 3; u++) {
+                        expected += horizontal[u] * vertical[v] * clamped(pyramid[1], left + u, top + v, c);
+                    }
+                }
+                interpolated = interpolated && std::abs(expanded.pixel(x, y)[c] - expected) <= 1e-6;
+            }
+        }
+    }
+    CHECK(interpolated);
+
+    // Collapsing the Laplacian pyramid gives the image back.
+    auto collapsed = collapse_laplacian_pyramid(laplacian_pyramid(image));
+    bool rebuilt = collapsed.width() == width && collapsed.height() == height;
+    for (int y = 0; y < height && rebuilt; y++) {
+        for (int x = 0; x < width * channels; x++) {
+            rebuilt = rebuilt && std::abs(collapsed.pixel(0, y)[x] - pyramid[0].pixel(0, y)[x]) <= 1e-5f;
+        }
+    }
+    CHECK(rebuilt);
+}
+
+int main()
+{
+    test_table(700, 37, 3, 1);
+    test_table(1, 50, 1, 2);
+    test_table(61, 1, 4, 3);
+    test_table(33, 29, 2, 4);
+
+    test_pyramid(64, 48, 3, 5);
+    test_pyramid(37, 13, 1, 6);
+    test_pyramid(1, 9, 2, 7);
+    test_pyramid(10, 1, 4, 8);
+    return test_result();
+}
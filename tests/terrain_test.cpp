@@ -0,0 +1,139 @@
+#include "TerrainMaps.hpp"
+#include "Test.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Checks that the AVX2 terrain kernels give the same normals, curvature and
+// occlusion as the scalar code, and the curvature of a known surface.
+
+#if SIMD_X86
+
+/// Heights padded on every side, the rows of a band of a heightmap.
+struct TestHeights {
+    int width;
+    int height;
+    int padding;
+    std::vector<float> values;
+
+    TestHeights(int width, int height, int padding, std::mt19937& random)
+        : width { width }
+        , height { height }
+        , padding { padding }
+        , values(static_cast<std::size_t>(width + 2 * padding) * static_cast<std::size_t>(height + 2 * padding))
+    {
+        // Smooth hills with noise, steep enough for the occlusion, and flat areas.
+        std::uniform_real_distribution<float> noise { -0.5f, 0.5f };
+        for (int y = -padding; y < height + padding; y++) {
+            for (int x = -padding; x < width + padding; x++) {
+                float hills = 20.0f * std::sin(0.15f * static_cast<float>(x)) * std::cos(0.1f * static_cast<float>(y));
+                this->at(x, y) = x % 37 < 5 ? 3.0f : hills + noise(random);
+            }
+        }
+    }
+
+    float& at(int x, int y)
+    {
+        auto stride = static_cast<std::size_t>(this->width + 2 * this->padding);
+        return this->values[static_cast<std::size_t>(y + this->padding) * stride + static_cast<std::size_t>(x + this->padding)];
+    }
+
+    const float* row(int y)
+    {
+        return &this->at(0, y);
+    }
+};
+
+void test_kernels(std::mt19937& random)
+{
+    TerrainMapOptions options {};
+    options.occlusion_radius = 6.0f;
+    options.occlusion_directions = 8;
+    options.occlusion_steps = 5;
+    auto kernel = detail::terrain_occlusion_kernel(options);
+    TestHeights heights { 101, 6, kernel.reach, random };
+    auto count = static_cast<std::size_t>(heights.width);
+
+    for (auto gradient : { GradientOperator::Sobel, GradientOperator::Scharr }) {
+        auto weights = detail::terrain_gradient(gradient);
+        for (int y = 0; y < heights.height; y++) {
+            const float* above = heights.row(y - 1);
+            const float* center = heights.row(y);
+            const float* below = heights.row(y + 1);
+
+            for (float green : { 1.0f, -1.0f }) {
+                std::vector<std::uint8_t> expected(4 * count);
+                std::vector<std::uint8_t> actual(4 * count);
+                detail::terrain_normals_scalar(above, center, below, weights, green, expected.data(), 0, count);
+                auto done = detail::terrain_normals_avx2(above, center, below, weights, green, actual.data(), count);
+                CHECK(done > 0);
+                check_same("terrain_normals", actual.data(), expected.data(), 4 * done);
+            }
+
+            std::vector<float> expected(count);
+            std::vector<float> actual(count);
+            detail::terrain_curvature_scalar(above, center, below, weights, 0.5f, 16.0f, expected.data(), 0, count);
+            auto done = detail::terrain_curvature_avx2(above, center, below, weights, 0.5f, 16.0f, actual.data(), count);
+            CHECK(done > 0);
+            check_same("terrain_curvature", actual.data(), expected.data(), done);
+        }
+    }
+
+    std::vector<const float*> samples(kernel.offsets.size());
+    for (int y = 0; y < heights.height; y++) {
+        for (std::size_t s = 0; s < samples.size(); s++) {
+            samples[s] = heights.row(y + kernel.offsets[s].second) + kernel.offsets[s].first;
+        }
+        std::vector<float> expected(count);
+        std::vector<float> actual(count);
+        detail::terrain_occlusion_scalar(heights.row(y), samples.data(), kernel, 0.8f, expected.data(), 0, count);
+        auto done = detail::terrain_occlusion_avx2(heights.row(y), samples.data(), kernel, 0.8f, actual.data(), count);
+        CHECK(done > 0);
+        check_same("terrain_occlusion", actual.data(), expected.data(), done);
+    }
+}
+
+/// Checks the curvature map of a parabolic ridge against its formula.
+void test_ridge()
+{
+    // h = 0.5 - c (x - 20)^2 has hx = 0, hxx = -2c at its crest, where the
+    // map stores 0.5 - 0.5 * scale * hxx.
+    constexpr float c = 0.001f;
+    ImageR32F heights { 41, 8 };
+    for (int y = 0; y < heights.height(); y++) {
+        for (int x = 0; x < heights.width(); x++) {
+            auto dx = static_cast<float>(x - 20);
+            heights.pixel(x, y)[0] = 0.5f - c * dx * dx;
+        }
+    }
+    TerrainMapOptions options {};
+    options.height_scale = 1.0f;
+    auto curvature = curvature_map(heights, options);
+    CHECK(curvature.pixel(20, 4)[0] == detail::unorm8_from_float(0.5f + options.curvature_scale * c));
+    CHECK(curvature.pixel(20, 4)[0] > 128);
+}
+
+int main()
+{
+    std::mt19937 random { 5 };
+    test_ridge();
+    if (simd_level() < SimdLevel::AVX2) {
+        std::cout << "AVX2 not supported, skipped\n";
+        return test_result();
+    }
+    test_kernels(random);
+    return test_result();
+}
+
+#else
+
+int main()
+{
+    std::cout << "No vectorized kernels on this architecture\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,101 @@
+#include "ImageStatistics.hpp"
+#include "ImageWriter.hpp"
+#include "Test.hpp"
+#include "TextureCompression.hpp"
+#include "TextureContainer.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+// Checks the block format chosen from the statistics of gray, gray-alpha,
+// RGB and RGBA images, linear and sRGB, and that cooked containers use it.
+
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    TemporaryDirectory()
+        : path { std::filesystem::temp_directory_path() / ("texture_format_test_" + std::to_string(std::rand())) }
+    {
+        std::filesystem::create_directories(this->path);
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code error {};
+        std::filesystem::remove_all(this->path, error);
+    }
+};
+
+/// Returns an image with varied colors and the given alpha, if it has an alpha channel.
+Image test_image(int channels, int (*alpha)(int x, int y))
+{
+    Image image { 19, 13, channels };
+    for (int y = 0; y < image.height(); y++) {
+        for (int x = 0; x < image.width(); x++) {
+            unsigned char* pixel = image.pixel(x, y);
+            for (int c = 0; c < channels; c++) {
+                pixel[c] = static_cast<unsigned char>(x * 11 + y * 17 + c * 70);
+            }
+            if (channels == 2 || channels == 4) {
+                pixel[channels - 1] = static_cast<unsigned char>(alpha(x, y));
+            }
+        }
+    }
+    return image;
+}
+
+int opaque(int, int)
+{
+    return 255;
+}
+
+int translucent(int x, int y)
+{
+    return (x + y) % 2 == 0 ? 255 : 128;
+}
+
+int binary(int x, int)
+{
+    return x < 5 ? 0 : 255;
+}
+
+void test_format(const TemporaryDirectory& directory, const std::string& name, const Image& image, bool srgb,
+    BlockFormat expected)
+{
+    auto chosen = choose_block_format(image_statistics(image), srgb);
+    if (chosen != expected) {
+        std::cerr << name << (srgb ? " sRGB" : " linear") << ": chose format " << static_cast<int>(chosen)
+                  << ", expected " << static_cast<int>(expected) << "\n";
+        detail::test_failures()++;
+    }
+
+    auto source = directory.path / (name + ".png");
+    auto destination = directory.path / (name + (srgb ? "_srgb" : "_linear") + ".tex");
+    write_image(image, source);
+    TextureCookOptions options {};
+    options.choose_compression = true;
+    options.mipmap_options.srgb = srgb;
+    cook_texture(source, destination, options);
+    TextureFile file { destination };
+    CHECK(file.format() == texture_file_format(expected));
+    CHECK(file.srgb() == srgb);
+    CHECK(file.width() == image.width() && file.height() == image.height());
+}
+
+int main()
+{
+    TemporaryDirectory directory {};
+    for (bool srgb : { false, true }) {
+        // BC4 has no sRGB variant, so sRGB gray images are stored as BC1.
+        test_format(directory, "gray", test_image(1, opaque), srgb, srgb ? BlockFormat::BC1 : BlockFormat::BC4);
+        test_format(
+            directory, "gray_alpha_opaque", test_image(2, opaque), srgb, srgb ? BlockFormat::BC1 : BlockFormat::BC4);
+        test_format(directory, "gray_alpha", test_image(2, translucent), srgb, BlockFormat::BC7);
+        test_format(directory, "rgb", test_image(3, opaque), srgb, BlockFormat::BC1);
+        test_format(directory, "rgba_opaque", test_image(4, opaque), srgb, BlockFormat::BC1);
+        test_format(directory, "rgba", test_image(4, translucent), srgb, BlockFormat::BC7);
+        test_format(directory, "rgba_binary", test_image(4, binary), srgb, BlockFormat::BC7);
+    }
+    return test_result();
+}
@@ -0,0 +1,139 @@
+#include "ImageWriter.hpp"
+#include "Test.hpp"
+#include "TiledImageSource.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+// Checks the tiles of a tiled image source against the source image, and
+// the least recently used eviction of its tile cache.
+
+struct TemporaryDirectory {
+    std::filesystem::path path;
+
+    TemporaryDirectory()
+        : path { std::filesystem::temp_directory_path() / ("tile_cache_test_" + std::to_string(std::rand())) }
+    {
+        std::filesystem::create_directories(this->path);
+    }
+
+    ~TemporaryDirectory()
+    {
+        std::error_code error {};
+        std::filesystem::remove_all(this->path, error);
+    }
+};
+
+Image pattern(int width, int height)
+{
+    Image image { width, height, 4 };
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 4; c++) {
+                image.pixel(x, y)[c] = static_cast<unsigned char>(x * 3 + y * 7 + c * 50);
+            }
+        }
+    }
+    return image;
+}
+
+void test_tiles(const TemporaryDirectory& directory)
+{
+    auto path = directory.path / "edges.png";
+    auto image = pattern(70, 40);
+    write_image(image, path);
+
+    TileCacheOptions options {};
+    options.tile_size = 16;
+    options.cache_directory = directory.path;
+    TiledImageSource source { path, options };
+    CHECK(source.width() == 70 && source.height() == 40 && source.channels() == 4);
+    CHECK(source.tiles_x() == 5 && source.tiles_y() == 3);
+
+    for (int ty = 0; ty < source.tiles_y(); ty++) {
+        for (int tx = 0; tx < source.tiles_x(); tx++) {
+            auto tile = source.tile(0, tx, ty);
+            CHECK(tile->width() == std::min(16, 70 - tx * 16));
+            CHECK(tile->height() == std::min(16, 40 - ty * 16));
+            bool same = true;
+            for (int y = 0; y < tile->height(); y++) {
+                for (int x = 0; x < tile->width(); x++) {
+                    for (int c = 0; c < 4; c++) {
+                        same = same && tile->pixel(x, y)[c] == image.pixel(tx * 16 + x, ty * 16 + y)[c];
+                    }
+                }
+            }
+            CHECK(same);
+        }
+    }
+
+    // A rectangle across tile boundaries.
+    auto rectangle = source.read(0, 10, 5, 40, 30);
+    bool same = true;
+    for (int y = 0; y < 30; y++) {
+        for (int x = 0; x < 40; x++) {
+            for (int c = 0; c < 4; c++) {
+                same = same && rectangle.pixel(x, y)[c] == image.pixel(10 + x, 5 + y)[c];
+            }
+        }
+    }
+    CHECK(same);
+}
+
+void test_eviction(const TemporaryDirectory& directory)
+{
+    auto path = directory.path / "lru.png";
+    write_image(pattern(64, 64), path);
+
+    // Room for three tiles of 16 x 16 RGBA8 pixels.
+    constexpr std::size_t tile_bytes = 16 * 16 * 4;
+    TileCacheOptions options {};
+    options.tile_size = 16;
+    options.memory_budget = 3 * tile_bytes;
+    options.cache_directory = directory.path;
+    TiledImageSource source { path, options };
+
+    // A cached tile is returned as the same pixels, an evicted one is loaded again.
+    // The tiles are held so that their addresses are not reused.
+    auto a = source.tile(0, 0, 0);
+    auto b = source.tile(0, 1, 0);
+    auto c = source.tile(0, 2, 0);
+    CHECK(source.cached_bytes() == 3 * tile_bytes);
+    CHECK(source.tile(0, 0, 0) == a);
+
+    // Recently used: a, c, b. Loading d evicts b.
+    auto d = source.tile(0, 3, 0);
+    CHECK(source.cached_bytes() == 3 * tile_bytes);
+    CHECK(source.tile(0, 0, 0) == a);
+    CHECK(source.tile(0, 2, 0) == c);
+    CHECK(source.tile(0, 3, 0) == d);
+
+    // Recently used: d, c, a. Loading b again evicts a.
+    auto b_again = source.tile(0, 1, 0);
+    CHECK(b_again != b);
+    CHECK(source.tile(0, 3, 0) == d);
+    CHECK(source.tile(0, 2, 0) == c);
+    CHECK(source.tile(0, 1, 0) == b_again);
+    CHECK(source.tile(0, 0, 0) != a);
+    CHECK(source.cached_bytes() == 3 * tile_bytes);
+
+    // The last tile requested is kept even beyond the budget.
+    options.memory_budget = tile_bytes / 2;
+    TiledImageSource small { path, options };
+    auto e = small.tile(0, 0, 1);
+    CHECK(small.cached_bytes() == tile_bytes);
+    CHECK(small.tile(0, 0, 1) == e);
+    small.tile(0, 1, 1);
+    CHECK(small.cached_bytes() == tile_bytes);
+    CHECK(small.tile(0, 0, 1) != e);
+}
+
+int main()
+{
+    TemporaryDirectory directory {};
+    test_tiles(directory);
+    test_eviction(directory);
+    return test_result();
+}
@@ -0,0 +1,78 @@
+#include "Test.hpp"
+#include "TiledImage.hpp"
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Checks that the iterators of tiled images reach the same pixels as
+// `pixel()`, including in the padded edge tiles.
+
+void test_rows(int width, int height)
+{
+    TiledImage image { width, height, 3 };
+    const auto& view = image;
+    for (int y = 0; y < height; y++) {
+        int x = 0;
+        for (unsigned char* pixel : image.row(y)) {
+            CHECK(pixel == image.pixel(x, y));
+            x++;
+        }
+        CHECK(x == width);
+
+        x = 0;
+        for (const unsigned char* pixel : view.row(y)) {
+            CHECK(pixel == view.pixel(x, y));
+            x++;
+        }
+        CHECK(x == width);
+    }
+}
+
+void test_tiles(int width, int height)
+{
+    TiledImage image { width, height, 2 };
+    std::vector<int> visits(static_cast<std::size_t>(width) * static_cast<std::size_t>(height), 0);
+    int count = 0;
+    for (auto tile : image.tiles()) {
+        CHECK(tile.data == image.tile(tile.tile_x, tile.tile_y));
+        CHECK(tile.left == tile.tile_x * TiledImage::tile_size);
+        CHECK(tile.top == tile.tile_y * TiledImage::tile_size);
+        CHECK(tile.width >= 1 && tile.left + tile.width <= width);
+        CHECK(tile.height >= 1 && tile.top + tile.height <= height);
+        CHECK(tile.left + tile.width == width || tile.width == TiledImage::tile_size);
+        CHECK(tile.top + tile.height == height || tile.height == TiledImage::tile_size);
+        for (int y = 0; y < tile.height; y++) {
+            for (int x = 0; x < tile.width; x++) {
+                CHECK(tile.pixel(x, y) == image.pixel(tile.left + x, tile.top + y));
+                visits[static_cast<std::size_t>(tile.top + y) * static_cast<std::size_t>(width)
+                    + static_cast<std::size_t>(tile.left + x)]++;
+            }
+        }
+        count++;
+    }
+    CHECK(count == image.tiles_x() * image.tiles_y());
+    for (int visit : visits) {
+        CHECK(visit == 1);
+    }
+}
+
+void test_alignment()
+{
+    TiledImageRGBA8 image { 100, 70 };
+    CHECK(reinterpret_cast<std::uintptr_t>(image.tile(0, 0)) % 4096 == 0);
+    // One tile of RGBA8 pixels fills exactly one page.
+    for (auto tile : image.tiles()) {
+        CHECK(reinterpret_cast<std::uintptr_t>(tile.data) % 4096 == 0);
+    }
+}
+
+int main()
+{
+    for (auto [width, height] : { std::pair { 1, 1 }, std::pair { 32, 32 }, std::pair { 33, 31 }, std::pair { 100, 70 } }) {
+        test_rows(width, height);
+        test_tiles(width, height);
+    }
+    test_alignment();
+    return test_result();
+}
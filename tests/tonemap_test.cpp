@@ -0,0 +1,114 @@
+#include "Test.hpp"
+#include "Tonemap.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <vector>
+
+// Checks that the AVX2 tonemapping kernels give the same values and codes
+// as the scalar code, for every curve, on gray and color planes.
+
+#if SIMD_X86
+
+/// Returns HDR values spread over a few decades, with edge cases first.
+std::vector<float> hdr_values(std::size_t count)
+{
+    std::vector<float> values {
+        0.0f,
+        -0.0f,
+        -1.0f,
+        1.0f,
+        1e-8f,
+        1e4f,
+        std::numeric_limits<float>::quiet_NaN(),
+        std::numeric_limits<float>::infinity(),
+    };
+    std::mt19937 random { 7 };
+    std::uniform_real_distribution<float> stops { -12.0f, 8.0f };
+    while (values.size() < count) {
+        values.push_back(std::exp2(stops(random)));
+    }
+    return values;
+}
+
+void test_curve(ToneCurve curve, int colors, const std::vector<float>& values)
+{
+    detail::TonemapConstants constants {};
+    constants.curve = curve;
+    constants.scale = std::exp2(0.5f);
+    constants.reinhard_white = 1.0f / (4.0f * 4.0f);
+    constants.uncharted_white = 1.0f / detail::uncharted_curve(11.2f);
+
+    auto count = values.size() / static_cast<std::size_t>(colors);
+    std::vector<std::vector<float>> expected(colors);
+    std::vector<std::vector<float>> actual(colors);
+    float* expected_planes[3] {};
+    float* actual_planes[3] {};
+    for (int c = 0; c < colors; c++) {
+        auto first = values.begin() + static_cast<std::ptrdiff_t>(count * static_cast<std::size_t>(c));
+        expected[c].assign(first, first + static_cast<std::ptrdiff_t>(count));
+        actual[c] = expected[c];
+        expected_planes[c] = expected[c].data();
+        actual_planes[c] = actual[c].data();
+    }
+
+    detail::tonemap_planes_scalar(expected_planes, colors, 0, count, constants);
+    auto done = detail::tonemap_planes_avx2(actual_planes, colors, count, constants);
+    CHECK(done > 0);
+    for (int c = 0; c < colors; c++) {
+        check_same("tonemap_planes", actual[c].data(), expected[c].data(), done);
+    }
+
+    const auto* table = detail::TonemapEncoding::srgb().table.data();
+    std::vector<std::uint8_t> expected_codes(count);
+    std::vector<std::uint8_t> actual_codes(count);
+    for (int c = 0; c < colors; c++) {
+        detail::tonemap_encode_scalar(expected[c].data(), expected_codes.data(), 0, count, table);
+        done = detail::tonemap_encode_avx2(expected[c].data(), actual_codes.data(), count, table);
+        CHECK(done > 0);
+        check_same("tonemap_encode", actual_codes.data(), expected_codes.data(), done);
+    }
+}
+
+int main()
+{
+    if (simd_level() < SimdLevel::AVX2) {
+        std::cout << "AVX2 not supported, skipped\n";
+        return EXIT_SUCCESS;
+    }
+    auto values = hdr_values(3 * 40000);
+    for (auto curve : { ToneCurve::Clamp, ToneCurve::Reinhard, ToneCurve::AcesFitted, ToneCurve::Uncharted2 }) {
+        test_curve(curve, 1, values);
+        test_curve(curve, 3, values);
+    }
+
+    // Every code boundary of the encoding table, and the values next to it.
+    std::vector<float> boundaries {};
+    for (int i = 0; i < detail::TonemapEncoding::steps; i++) {
+        float root = (static_cast<float>(i) + 0.5f) / detail::TonemapEncoding::steps;
+        float boundary = root * root;
+        boundaries.push_back(std::nextafter(boundary, 0.0f));
+        boundaries.push_back(boundary);
+        boundaries.push_back(std::nextafter(boundary, 1.0f));
+    }
+    const auto* table = detail::TonemapEncoding::srgb().table.data();
+    std::vector<std::uint8_t> expected(boundaries.size());
+    std::vector<std::uint8_t> actual(boundaries.size());
+    detail::tonemap_encode_scalar(boundaries.data(), expected.data(), 0, boundaries.size(), table);
+    auto done = detail::tonemap_encode_avx2(boundaries.data(), actual.data(), boundaries.size(), table);
+    check_same("tonemap_encode", actual.data(), expected.data(), done);
+    return test_result();
+}
+
+#else
+
+int main()
+{
+    std::cout << "No vectorized kernels on this architecture\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
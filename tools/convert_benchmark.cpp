@@ -0,0 +1,91 @@
+#include "ImageConvert.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: convert_benchmark [pixels] [repeats]\n"
+                 "\n"
+                 "Times every pixel format conversion kernel on spans of RGBA pixels and\n"
+                 "reports its throughput, counting the bytes read and written. Defaults\n"
+                 "to 4M pixels, keeping the best of 5 runs.\n";
+    exit(EXIT_FAILURE);
+}
+
+template <typename F>
+double time_ms(F&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+const char* simd_name(SimdLevel level)
+{
+    switch (level) {
+    case SimdLevel::AVX2:
+        return "AVX2";
+    case SimdLevel::SSE2:
+        return "SSE2";
+    case SimdLevel::Scalar:
+        break;
+    }
+    return "scalar";
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3) {
+        exit_usage();
+    }
+    long pixels_arg = argc > 1 ? std::atol(argv[1]) : 4L << 20;
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+    if (pixels_arg <= 0 || repeats <= 0) {
+        exit_usage();
+    }
+    auto pixels = static_cast<std::size_t>(pixels_arg);
+    auto values = 4 * pixels;
+
+    std::vector<std::uint8_t> bytes(values);
+    std::vector<std::uint8_t> bytes_out(values);
+    std::vector<std::uint16_t> words(values);
+    std::vector<std::uint16_t> words_out(values);
+    std::vector<float> floats(values);
+    std::vector<float> floats_out(values);
+    for (std::size_t i = 0; i < values; i++) {
+        bytes[i] = static_cast<std::uint8_t>(i * 7 + i / 4099);
+        words[i] = static_cast<std::uint16_t>(i * 1543 + i / 65521);
+        floats[i] = static_cast<float>(i % 1031) / 1000.0f - 0.01f;
+    }
+
+    // Throughput of the best run, from the bytes read and written by a call.
+    auto report = [&](const char* name, std::size_t bytes_moved, auto&& kernel) {
+        double best = time_ms(kernel);
+        for (int i = 1; i < repeats; i++) {
+            best = std::min(best, time_ms(kernel));
+        }
+        std::printf("%-18s %8.2f ms %8.2f GB/s\n", name, best, static_cast<double>(bytes_moved) / (best * 1e6));
+    };
+
+    std::printf("%zu RGBA pixels, %s kernels, best of %d\n", pixels, simd_name(simd_level()), repeats);
+    report("rgb_to_rgba", 7 * pixels, [&] { rgb_to_rgba(bytes.data(), bytes_out.data(), pixels); });
+    report("rgba_to_rgb", 7 * pixels, [&] { rgba_to_rgb(bytes.data(), bytes_out.data(), pixels); });
+    report("swap_red_blue", 8 * pixels, [&] { swap_red_blue(bytes.data(), bytes_out.data(), pixels); });
+    report("gray_to_rgba", 5 * pixels, [&] { gray_to_rgba(bytes.data(), bytes_out.data(), pixels); });
+    report("unorm8_to_unorm16", 3 * values, [&] { unorm8_to_unorm16(bytes.data(), words_out.data(), values); });
+    report("unorm16_to_unorm8", 3 * values, [&] { unorm16_to_unorm8(words.data(), bytes_out.data(), values); });
+    report("unorm8_to_float", 5 * values, [&] { unorm8_to_float(bytes.data(), floats_out.data(), values); });
+    report("float_to_unorm8", 5 * values, [&] { float_to_unorm8(floats.data(), bytes_out.data(), values); });
+    report("unorm16_to_float", 6 * values, [&] { unorm16_to_float(words.data(), floats_out.data(), values); });
+    report("float_to_unorm16", 6 * values, [&] { float_to_unorm16(floats.data(), words_out.data(), values); });
+    report("srgb_to_linear", 5 * values, [&] { srgb_to_linear(bytes.data(), floats_out.data(), pixels, 4); });
+    report("linear_to_srgb", 5 * values, [&] { linear_to_srgb(floats.data(), bytes_out.data(), pixels, 4); });
+    return 0;
+}
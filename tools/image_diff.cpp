@@ -0,0 +1,204 @@
+#include "Image.hpp"
+#include "ImageConvert.hpp"
+#include "ImageDiff.hpp"
+#include "ImageWriter.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: image_diff [options] <reference> <candidate>\n"
+                 "\n"
+                 "Compares two images, or every image of a reference directory with the\n"
+                 "image of the same name in a candidate directory, and prints the MSE,\n"
+                 "PSNR and SSIM. Exits with a failure if an image is missing or differs\n"
+                 "beyond the thresholds, or differs at all without thresholds.\n"
+                 "\n"
+                 "Options:\n"
+                 "  --min-psnr <dB>     Fail only below this PSNR.\n"
+                 "  --min-ssim <value>  Fail only below this SSIM.\n"
+                 "  --no-ssim           Skip the SSIM, the slowest metric.\n"
+                 "  --heatmap <path>    Write heat maps of the differences, to a PNG file\n"
+                 "                      for two images or into a directory otherwise.\n"
+                 "  --gain <factor>     Amplification of the heat maps, 4 by default.\n";
+    exit(EXIT_FAILURE);
+}
+
+struct Thresholds {
+    std::optional<double> min_psnr {};
+    std::optional<double> min_ssim {};
+
+    bool passes(const ImageDifference& difference) const
+    {
+        if (!this->min_psnr && !this->min_ssim) {
+            return difference.max_difference == 0;
+        }
+        if (this->min_psnr && difference.psnr < *this->min_psnr) {
+            return false;
+        }
+        return !this->min_ssim || !(difference.ssim < *this->min_ssim);
+    }
+};
+
+/// Outcome of the comparison of a pair of files.
+struct Comparison {
+    std::string name;
+    std::optional<ImageDifference> difference {};
+    std::string error {};
+};
+
+Comparison compare_files(const std::filesystem::path& reference_path, const std::filesystem::path& candidate_path,
+    const std::optional<std::filesystem::path>& heatmap_path, const ImageDiffOptions& options, ThreadPool& pool)
+{
+    Comparison comparison { reference_path.filename().string() };
+    try {
+        Image reference { reference_path, ImageLoadMode::MemoryMapped };
+        Image candidate { candidate_path, ImageLoadMode::MemoryMapped };
+        if (candidate.channels() != reference.channels()) {
+            candidate = convert_channels(candidate, reference.channels());
+        }
+        auto difference = compare_images(reference, candidate, options, pool);
+        if (heatmap_path) {
+            ImageWriteOptions write_options {};
+            write_options.parallel_deflate = false;
+            write_image(*difference.heatmap, *heatmap_path, write_options, pool);
+            difference.heatmap.reset();
+        }
+        comparison.difference = std::move(difference);
+    } catch (std::exception& e) {
+        comparison.error = e.what();
+    }
+    return comparison;
+}
+
+bool is_image_file(const std::filesystem::path& path)
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](char c) { return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); });
+    for (const char* known : { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".psd", ".gif", ".pnm", ".ppm", ".pgm" }) {
+        if (extension == known) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char** argv)
+{
+    Thresholds thresholds {};
+    ImageDiffOptions options {};
+    std::optional<std::filesystem::path> heatmap {};
+    std::string paths[2];
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--min-psnr" && i + 1 < argc) {
+            thresholds.min_psnr = std::atof(argv[++i]);
+        } else if (argument == "--min-ssim" && i + 1 < argc) {
+            thresholds.min_ssim = std::atof(argv[++i]);
+        } else if (argument == "--no-ssim") {
+            options.ssim = false;
+        } else if (argument == "--heatmap" && i + 1 < argc) {
+            heatmap = argv[++i];
+        } else if (argument == "--gain" && i + 1 < argc) {
+            options.heatmap_gain = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument.rfind("--", 0) != 0 && path_count < 2) {
+            paths[path_count++] = argument;
+        } else {
+            exit_usage();
+        }
+    }
+    if (path_count != 2) {
+        exit_usage();
+    }
+    if (thresholds.min_ssim && !options.ssim) {
+        std::cerr << "--min-ssim requires the SSIM." << std::endl;
+        return EXIT_FAILURE;
+    }
+    options.heatmap = heatmap.has_value();
+
+    // Pairs of reference and candidate files, with the path of their heat map.
+    struct Pair {
+        std::filesystem::path reference;
+        std::filesystem::path candidate;
+        std::optional<std::filesystem::path> heatmap;
+    };
+    std::vector<Pair> pairs {};
+    bool directories = false;
+    try {
+        std::filesystem::path reference { paths[0] };
+        std::filesystem::path candidate { paths[1] };
+        directories = std::filesystem::is_directory(reference);
+        if (directories) {
+            if (heatmap) {
+                std::filesystem::create_directories(*heatmap);
+            }
+            std::vector<std::filesystem::path> files {};
+            for (const auto& entry : std::filesystem::directory_iterator { reference }) {
+                if (entry.is_regular_file() && is_image_file(entry.path())) {
+                    files.push_back(entry.path());
+                }
+            }
+            std::sort(files.begin(), files.end());
+            for (const auto& file : files) {
+                std::optional<std::filesystem::path> heatmap_file {};
+                if (heatmap) {
+                    heatmap_file = *heatmap / file.filename().replace_extension(".png");
+                }
+                pairs.push_back({ file, candidate / file.filename(), heatmap_file });
+            }
+        } else {
+            pairs.push_back({ reference, candidate, heatmap });
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Pairs are compared in parallel, a few more than there are threads at
+    // a time to bound the memory, and reported in order.
+    auto& pool = ThreadPool::global();
+    auto in_flight = 2 * pool.size();
+    std::deque<std::future<Comparison>> pending {};
+    std::size_t next = 0;
+    std::size_t failed = 0;
+    while (next < pairs.size() || !pending.empty()) {
+        while (next < pairs.size() && pending.size() < in_flight) {
+            const auto& pair = pairs[next++];
+            pending.push_back(pool.submit([&pair, &options, &pool] {
+                return compare_files(pair.reference, pair.candidate, pair.heatmap, options, pool);
+            }));
+        }
+        auto comparison = pending.front().get();
+        pending.pop_front();
+
+        if (!comparison.difference) {
+            std::printf("%-32s error: %s\n", comparison.name.c_str(), comparison.error.c_str());
+            failed++;
+            continue;
+        }
+        const auto& difference = *comparison.difference;
+        bool passed = thresholds.passes(difference);
+        failed += passed ? 0 : 1;
+        std::printf("%-32s mse %10.4f  psnr %7.2f dB  ssim %8.6f  max %3d  differing %zu px%s\n", comparison.name.c_str(),
+            difference.mse, difference.psnr, difference.ssim, difference.max_difference, difference.differing_pixels,
+            passed ? "" : "  FAIL");
+    }
+    if (directories) {
+        std::printf("%zu images compared, %zu failed\n", pairs.size(), failed);
+    }
+    return failed == 0 ? 0 : EXIT_FAILURE;
+}
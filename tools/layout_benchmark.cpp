@@ -0,0 +1,159 @@
+#include "Image.hpp"
+#include "TiledImage.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: layout_benchmark [size] [radius]\n"
+                 "\n"
+                 "Times box filter passes over a square RGBA8 image stored row-major\n"
+                 "and in Morton ordered tiles. Defaults to a 4096 pixel image and a\n"
+                 "radius of 8 pixels.\n";
+    exit(EXIT_FAILURE);
+}
+
+/// Box filters every column, walking down the image with a sliding sum.
+template <typename ImageType>
+void vertical_pass(const ImageType& src, ImageType& dst, int radius)
+{
+    int width = src.width();
+    int height = src.height();
+    int count = 2 * radius + 1;
+    for (int x = 0; x < width; x++) {
+        int sum[4] = {};
+        for (int y = -radius; y < radius; y++) {
+            const auto* pixel = src.pixel(x, std::clamp(y, 0, height - 1));
+            for (int c = 0; c < 4; c++) {
+                sum[c] += pixel[c];
+            }
+        }
+        for (int y = 0; y < height; y++) {
+            const auto* in = src.pixel(x, std::min(y + radius, height - 1));
+            auto* result = dst.pixel(x, y);
+            for (int c = 0; c < 4; c++) {
+                sum[c] += in[c];
+                result[c] = static_cast<unsigned char>(sum[c] / count);
+            }
+            const auto* out = src.pixel(x, std::max(y - radius, 0));
+            for (int c = 0; c < 4; c++) {
+                sum[c] -= out[c];
+            }
+        }
+    }
+}
+
+/// Box filters every row, walking right with a sliding sum.
+template <typename ImageType>
+void horizontal_pass(const ImageType& src, ImageType& dst, int radius)
+{
+    int width = src.width();
+    int height = src.height();
+    int count = 2 * radius + 1;
+    for (int y = 0; y < height; y++) {
+        int sum[4] = {};
+        for (int x = -radius; x < radius; x++) {
+            const auto* pixel = src.pixel(std::clamp(x, 0, width - 1), y);
+            for (int c = 0; c < 4; c++) {
+                sum[c] += pixel[c];
+            }
+        }
+        for (int x = 0; x < width; x++) {
+            const auto* in = src.pixel(std::min(x + radius, width - 1), y);
+            auto* result = dst.pixel(x, y);
+            for (int c = 0; c < 4; c++) {
+                sum[c] += in[c];
+                result[c] = static_cast<unsigned char>(sum[c] / count);
+            }
+            const auto* out = src.pixel(std::max(x - radius, 0), y);
+            for (int c = 0; c < 4; c++) {
+                sum[c] -= out[c];
+            }
+        }
+    }
+}
+
+/// Box filters a window around every pixel, without separating the axes.
+template <typename ImageType>
+void window_pass(const ImageType& src, ImageType& dst, int radius)
+{
+    int width = src.width();
+    int height = src.height();
+    int count = (2 * radius + 1) * (2 * radius + 1);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int sum[4] = {};
+            for (int v = -radius; v <= radius; v++) {
+                int row = std::clamp(y + v, 0, height - 1);
+                for (int u = -radius; u <= radius; u++) {
+                    const auto* pixel = src.pixel(std::clamp(x + u, 0, width - 1), row);
+                    for (int c = 0; c < 4; c++) {
+                        sum[c] += pixel[c];
+                    }
+                }
+            }
+            auto* result = dst.pixel(x, y);
+            for (int c = 0; c < 4; c++) {
+                result[c] = static_cast<unsigned char>(sum[c] / count);
+            }
+        }
+    }
+}
+
+template <typename F>
+double time_ms(F&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename ImageType>
+void run(const char* name, const ImageType& src, int radius)
+{
+    ImageType dst { src.width(), src.height() };
+    ImageType temp { src.width(), src.height() };
+    double vertical = time_ms([&] { vertical_pass(src, dst, radius); });
+    double horizontal = time_ms([&] { horizontal_pass(src, dst, radius); });
+    double separable = time_ms([&] {
+        horizontal_pass(src, temp, radius);
+        vertical_pass(temp, dst, radius);
+    });
+    // The window pass is quadratic in the radius, time it on a small radius.
+    double window = time_ms([&] { window_pass(src, dst, 2); });
+    std::printf("%-10s vertical %8.1f ms  horizontal %8.1f ms  separable %8.1f ms  5x5 window %8.1f ms\n", name,
+        vertical, horizontal, separable, window);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3) {
+        exit_usage();
+    }
+    int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    int radius = argc > 2 ? std::atoi(argv[2]) : 8;
+    if (size <= 0 || radius < 0) {
+        exit_usage();
+    }
+
+    ImageRGBA8 linear { size, size };
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            auto* pixel = linear.pixel(x, y);
+            for (int c = 0; c < 4; c++) {
+                pixel[c] = static_cast<unsigned char>((x * 7 + y * 13 + c * 61) & 0xFF);
+            }
+        }
+    }
+    TiledImageRGBA8 tiled { linear };
+
+    std::printf("%dx%d RGBA8, radius %d\n", size, size, radius);
+    run("row-major", linear, radius);
+    run("tiled", tiled, radius);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "Image.hpp"
+#include "Resources.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: load_benchmark [directory] [repeats]\n"
+                 "\n"
+                 "Loads every image of a directory as 8-bit pixels through stdio and\n"
+                 "through a memory mapping, and reports the time of both paths. The\n"
+                 "files are read once beforehand so that both run from the page cache.\n"
+                 "Defaults to the resource directory, keeping the best of 3 runs.\n";
+    exit(EXIT_FAILURE);
+}
+
+bool is_image_file(const std::filesystem::path& path)
+{
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](char c) { return static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c); });
+    for (const char* known :
+        { ".png", ".jpg", ".jpeg", ".bmp", ".tga", ".psd", ".gif", ".hdr", ".pnm", ".ppm", ".pgm" }) {
+        if (extension == known) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename F>
+double time_ms(F&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3) {
+        exit_usage();
+    }
+    std::filesystem::path directory = argc > 1 ? std::filesystem::path { argv[1] } : get_resource_dir();
+    int repeats = argc > 2 ? std::atoi(argv[2]) : 3;
+    if (repeats <= 0) {
+        exit_usage();
+    }
+
+    std::vector<std::filesystem::path> files {};
+    std::uintmax_t bytes = 0;
+    try {
+        for (const auto& entry : std::filesystem::recursive_directory_iterator { directory }) {
+            if (entry.is_regular_file() && is_image_file(entry.path())) {
+                files.push_back(entry.path());
+                bytes += entry.file_size();
+            }
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::sort(files.begin(), files.end());
+    if (files.empty()) {
+        std::cerr << "No image files in " << directory.string() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // Files stb_image cannot decode are skipped by both paths.
+    std::size_t failed = 0;
+    auto load_all = [&](ImageLoadMode mode) {
+        failed = 0;
+        for (const auto& file : files) {
+            try {
+                Image image { file, mode };
+            } catch (std::exception&) {
+                failed++;
+            }
+        }
+    };
+    load_all(ImageLoadMode::Stdio);
+
+    double stdio = 0.0;
+    double mapped = 0.0;
+    for (int i = 0; i < repeats; i++) {
+        double stdio_run = time_ms([&] { load_all(ImageLoadMode::Stdio); });
+        double mapped_run = time_ms([&] { load_all(ImageLoadMode::MemoryMapped); });
+        stdio = i == 0 ? stdio_run : std::min(stdio, stdio_run);
+        mapped = i == 0 ? mapped_run : std::min(mapped, mapped_run);
+    }
+
+    auto megabytes = static_cast<double>(bytes) / 1e6;
+    std::printf("%zu files, %.1f MB in %s, best of %d", files.size(), megabytes, directory.string().c_str(), repeats);
+    if (failed > 0) {
+        std::printf(", %zu not decodable", failed);
+    }
+    std::printf("\n");
+    std::printf("stdio   %9.1f ms %8.1f MB/s\n", stdio, megabytes / stdio * 1e3);
+    std::printf("mmap    %9.1f ms %8.1f MB/s (x%.2f)\n", mapped, megabytes / mapped * 1e3, stdio / mapped);
+    return 0;
+}
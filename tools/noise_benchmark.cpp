@@ -0,0 +1,99 @@
+#include "Noise.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/gtc/noise.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: noise_benchmark [size] [depth]\n"
+                 "\n"
+                 "Times single octave Perlin and simplex noise filling a square heightmap\n"
+                 "and a volume of depth slices, with glm::perlin and glm::simplex one\n"
+                 "sample at a time and with the batch generator on one and on all threads.\n"
+                 "Defaults to a 4096 pixel heightmap and 64 slices of 256x256 voxels.\n";
+    exit(EXIT_FAILURE);
+}
+
+template <typename F>
+double time_ms(F&& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    function();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void report(const char* name, double glm, double single, double pooled, double samples)
+{
+    auto ns = [&](double ms) { return ms * 1e6 / samples; };
+    std::printf("%-11s glm %7.2f ns  batch %6.2f ns (x%5.1f)  threads %6.2f ns (x%5.1f)\n", name, ns(glm), ns(single),
+        glm / single, ns(pooled), glm / pooled);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3) {
+        exit_usage();
+    }
+    int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+    int depth = argc > 2 ? std::atoi(argv[2]) : 64;
+    if (size <= 0 || depth <= 0) {
+        exit_usage();
+    }
+    constexpr int slice = 256;
+    constexpr float frequency = 1.0f / 64.0f;
+
+    ThreadPool single { 0 };
+    auto& pool = ThreadPool::global();
+    NoiseOptions options {};
+    options.fractal = NoiseFractal::None;
+    options.frequency = frequency;
+    ImageR32F heightmap { size, size };
+    std::vector<float> volume(static_cast<std::size_t>(slice) * slice * static_cast<std::size_t>(depth));
+
+    // glm evaluates the same lattice noise one sample at a time.
+    auto glm_heightmap = [&](auto noise) {
+        for (int y = 0; y < size; y++) {
+            float* row = heightmap.pixel(0, y);
+            for (int x = 0; x < size; x++) {
+                row[x] = noise(glm::vec2 { static_cast<float>(x) * frequency, static_cast<float>(y) * frequency });
+            }
+        }
+    };
+    auto glm_volume = [&](auto noise) {
+        float* out = volume.data();
+        for (int z = 0; z < depth; z++) {
+            for (int y = 0; y < slice; y++) {
+                for (int x = 0; x < slice; x++) {
+                    *out++ = noise(glm::vec3 { static_cast<float>(x) * frequency, static_cast<float>(y) * frequency,
+                        static_cast<float>(z) * frequency });
+                }
+            }
+        }
+    };
+    auto batch_heightmap = [&](ThreadPool& threads) { fill_noise(heightmap, options, threads); };
+    auto batch_volume = [&](ThreadPool& threads) { fill_noise_volume(volume.data(), slice, slice, depth, options, threads); };
+
+    std::printf("%dx%d heightmap, %dx%dx%d volume, %zu threads\n", size, size, slice, slice, depth, pool.size() + 1);
+    double pixels = static_cast<double>(size) * size;
+    double voxels = static_cast<double>(volume.size());
+
+    options.type = NoiseType::Perlin;
+    report("perlin 2D", time_ms([&] { glm_heightmap([](glm::vec2 p) { return glm::perlin(p); }); }),
+        time_ms([&] { batch_heightmap(single); }), time_ms([&] { batch_heightmap(pool); }), pixels);
+    report("perlin 3D", time_ms([&] { glm_volume([](glm::vec3 p) { return glm::perlin(p); }); }),
+        time_ms([&] { batch_volume(single); }), time_ms([&] { batch_volume(pool); }), voxels);
+
+    options.type = NoiseType::Simplex;
+    report("simplex 2D", time_ms([&] { glm_heightmap([](glm::vec2 p) { return glm::simplex(p); }); }),
+        time_ms([&] { batch_heightmap(single); }), time_ms([&] { batch_heightmap(pool); }), pixels);
+    report("simplex 3D", time_ms([&] { glm_volume([](glm::vec3 p) { return glm::simplex(p); }); }),
+        time_ms([&] { batch_volume(single); }), time_ms([&] { batch_volume(pool); }), voxels);
+    return 0;
+}
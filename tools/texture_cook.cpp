@@ -0,0 +1,92 @@
+#include "TextureContainer.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+
+[[noreturn]] void exit_usage()
+{
+    std::cerr << "Usage: texture_cook [options] <input> <output>\n"
+                 "\n"
+                 "Converts an image file into a precooked texture container.\n"
+                 "\n"
+                 "Options:\n"
+                 "  --format <bc1|bc3|bc4|bc5|bc7|auto>\n"
+                 "                                   Block compress 8-bit images, auto picking\n"
+                 "                                   the format from their channels and alpha.\n"
+                 "  --filter <box|triangle|kaiser|lanczos3>\n"
+                 "                                   Mipmap filter, kaiser by default.\n"
+                 "  --linear                         Color channels are not sRGB encoded.\n"
+                 "  --no-mipmaps                     Only store the base level.\n";
+    exit(EXIT_FAILURE);
+}
+
+BlockFormat parse_format(const std::string& name)
+{
+    if (name == "bc1") {
+        return BlockFormat::BC1;
+    } else if (name == "bc3") {
+        return BlockFormat::BC3;
+    } else if (name == "bc4") {
+        return BlockFormat::BC4;
+    } else if (name == "bc5") {
+        return BlockFormat::BC5;
+    } else if (name == "bc7") {
+        return BlockFormat::BC7;
+    }
+    exit_usage();
+}
+
+Filter parse_filter(const std::string& name)
+{
+    if (name == "box") {
+        return Filter::Box;
+    } else if (name == "triangle") {
+        return Filter::Triangle;
+    } else if (name == "kaiser") {
+        return Filter::Kaiser;
+    } else if (name == "lanczos3") {
+        return Filter::Lanczos3;
+    }
+    exit_usage();
+}
+
+int main(int argc, char** argv)
+{
+    TextureCookOptions options {};
+    std::string paths[2];
+    int path_count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument == "--format" && i + 1 < argc && std::strcmp(argv[i + 1], "auto") == 0) {
+            options.choose_compression = true;
+            i++;
+        } else if (argument == "--format" && i + 1 < argc) {
+            options.compression = parse_format(argv[++i]);
+        } else if (argument == "--filter" && i + 1 < argc) {
+            options.mipmap_options.filter = parse_filter(argv[++i]);
+        } else if (argument == "--linear") {
+            options.mipmap_options.srgb = false;
+        } else if (argument == "--no-mipmaps") {
+            options.mipmaps = false;
+        } else if (argument.rfind("--", 0) != 0 && path_count < 2) {
+            paths[path_count++] = argument;
+        } else {
+            exit_usage();
+        }
+    }
+    if (path_count != 2) {
+        exit_usage();
+    }
+
+    try {
+        cook_texture(paths[0], paths[1], options);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return 0;
+}